@@ -0,0 +1,474 @@
+// Microbenchmarks of engine hot paths, results are written as JSON so runs can be compared over time.
+// Built with -DGRAPHICENGINE_BUILD_BENCH=ON.
+//
+// usage: graphicengine_bench [options]
+//   --size N          generated meshes are N x N quad grids, default 256
+//   --iterations N    timed iterations of every benchmark, default 20
+//   --filter text     only runs benchmarks whose name contains the text
+//   --output file     JSON result file, default graphicengine_bench.json
+//
+// Inputs are generated with fixed seeds, so runs with the same options do the same work.
+// Benchmarks that need OpenGL run in a hidden window and are reported as skipped when no context can be created.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "graphicengine.hpp"
+#include "meshoptimization.hpp"
+#include "meshsimplifier.hpp"
+#include "occlusionculler.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+
+Engine ge("graphicengine_bench", 64, 64, EngineSettings{.hidden_window = true, .mesh_cache = false, .program_binary_cache = false});
+
+
+namespace {
+    struct Options {
+        int size = 256;
+        int iterations = 20;
+        std::string filter{};
+        std::string output = "graphicengine_bench.json";
+    };
+
+    struct Result {
+        std::string name;
+        /// amount of processed items per iteration (triangles, transforms, lights, ...)
+        size_t items = 0;
+        std::vector<double> times_ms{};
+        /// reason the benchmark didn't run, empty if it did
+        std::string skipped{};
+    };
+
+    /// Results are summed in here, so the compiler can't drop the measured work
+    volatile double sink = 0.0;
+
+    bool has_gl_context() {
+        return ge.window.glfwwindow != nullptr and glfwGetCurrentContext() != nullptr;
+    }
+
+    /// Runs setup once, body twice as a warm-up and then Options.iterations times measured
+    Result run_benchmark(const Options& options, const std::string& name, const bool needs_gl, const std::function<size_t()>& setup, const std::function<void()>& body) {
+        Result result{name};
+        if (needs_gl and !has_gl_context()) {
+            result.skipped = "no OpenGL context";
+            return result;
+        }
+        result.items = setup();
+        body();
+        body();
+        for (int i = 0; i < options.iterations; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            result.times_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return result;
+    }
+
+    /// Writes an N x N quad grid with positions, uvs and normals, split into material groups by rows
+    void write_grid_obj(const std::filesystem::path& obj_path, const std::string& mtl_name, const int size, const int material_count) {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> height(-0.05f, 0.05f);
+        std::ofstream file(obj_path);
+        file << "mtllib " << mtl_name << "\n";
+        for (int y = 0; y <= size; y++) {
+            for (int x = 0; x <= size; x++) {
+                file << "v " << static_cast<float>(x) / size << " " << height(random) << " " << static_cast<float>(y) / size << "\n";
+                file << "vt " << static_cast<float>(x) / size << " " << static_cast<float>(y) / size << "\n";
+                file << "vn 0 1 0\n";
+            }
+        }
+        const int rows_per_material = std::max(1, size / material_count);
+        for (int y = 0; y < size; y++) {
+            if (y % rows_per_material == 0)
+                file << "usemtl material_" << std::min(y / rows_per_material, material_count - 1) << "\n";
+            for (int x = 0; x < size; x++) {
+                // 1 based, v, vt and vn share indices
+                const int a = y * (size + 1) + x + 1;
+                const int b = a + 1;
+                const int c = a + size + 2;
+                const int d = a + size + 1;
+                file << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " "
+                     << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+            }
+        }
+    }
+
+    /// Writes an .mtl library without textures
+    void write_mtl(const std::filesystem::path& mtl_path, const int material_count) {
+        std::ofstream file(mtl_path);
+        for (int i = 0; i < material_count; i++) {
+            const float value = static_cast<float>(i) / material_count;
+            file << "newmtl material_" << i << "\n"
+                 << "Ka 0.1 0.1 0.1\nKd " << value << " 0.5 " << 1.0f - value << "\nKs 0.5 0.5 0.5\nNs " << 8 + i << "\nd 1.0\nillum 2\n\n";
+        }
+    }
+
+    void write_json(std::ostream& out, const Options& options, const std::vector<Result>& results) {
+        out << "{\n  \"size\": " << options.size << ",\n  \"iterations\": " << options.iterations
+            << ",\n  \"worker_threads\": " << ge.workers.get_thread_count()
+            << ",\n  \"opengl\": " << (has_gl_context() ? "true" : "false") << ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name << "\"";
+            if (!result.skipped.empty()) {
+                out << ", \"skipped\": \"" << result.skipped << "\"}";
+                continue;
+            }
+            std::vector<double> sorted = result.times_ms;
+            std::ranges::sort(sorted);
+            double mean = 0.0;
+            for (const double time : sorted)
+                mean += time;
+            mean /= static_cast<double>(sorted.size());
+            const double median = sorted[sorted.size() / 2];
+            out << ", \"items\": " << result.items
+                << ", \"min_ms\": " << sorted.front() << ", \"median_ms\": " << median
+                << ", \"mean_ms\": " << mean << ", \"max_ms\": " << sorted.back()
+                << ", \"items_per_second\": " << (median > 0.0 ? static_cast<double>(result.items) / median * 1000.0 : 0.0) << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    bool parse_int(const char* text, int& value) {
+        char* end = nullptr;
+        const long parsed = std::strtol(text, &end, 10);
+        if (end == text or *end != '\0' or parsed <= 0)
+            return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    /// Ends the program, without a context the engine's GPU resources were never created and can't be released by the destructors
+    int finish(const int exit_code) {
+        if (!has_gl_context())
+            std::_Exit(exit_code);
+        return exit_code;
+    }
+
+    void print_usage() {
+        std::cout << "usage: graphicengine_bench [--size N] [--iterations N] [--filter text] [--output file]" << std::endl;
+    }
+}
+
+
+int main(const int argc, char** argv) {
+    Options options{};
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--size") == 0 and has_value and parse_int(argv[i + 1], options.size)) {
+            i++;
+        } else if (std::strcmp(argv[i], "--iterations") == 0 and has_value and parse_int(argv[i + 1], options.iterations)) {
+            i++;
+        } else if (std::strcmp(argv[i], "--filter") == 0 and has_value) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--output") == 0 and has_value) {
+            options.output = argv[++i];
+        } else {
+            print_usage();
+            return finish(1);
+        }
+    }
+
+    constexpr int MATERIAL_COUNT = 16;
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "graphicengine_bench";
+    std::filesystem::create_directories(directory);
+    const std::filesystem::path obj_path = directory / ("grid_" + std::to_string(options.size) + ".obj");
+    const std::filesystem::path mtl_path = directory / "grid.mtl";
+    write_mtl(mtl_path, MATERIAL_COUNT);
+    write_grid_obj(obj_path, mtl_path.filename().string(), options.size, MATERIAL_COUNT);
+    const std::string obj_file = obj_path.string();
+    const std::string mtl_file = mtl_path.string();
+
+    std::vector<Result> results{};
+    auto add = [&](const std::string& name, const bool needs_gl, const std::function<size_t()>& setup, const std::function<void()>& body) {
+        if (!options.filter.empty() and name.find(options.filter) == std::string::npos)
+            return;
+        results.push_back(run_benchmark(options, name, needs_gl, setup, body));
+        const Result& result = results.back();
+        if (!result.skipped.empty()) {
+            std::cout << result.name << ": skipped (" << result.skipped << ")" << std::endl;
+        } else {
+            std::cout << result.name << ": " << *std::ranges::min_element(result.times_ms) << " ms (min of " << result.times_ms.size() << ")" << std::endl;
+        }
+    };
+
+    // OBJ / MTL PARSING
+    std::vector<float> vertex_data_vec[3];
+    std::vector<std::vector<size_t>> vertex_groups{};
+    std::vector<std::string> material_names{};
+    std::string parsed_mtl_path{};
+    bool has_uvs = false, has_normals = false;
+    auto parse_setup = [&] {
+        return static_cast<size_t>(options.size) * options.size * 2;
+    };
+    add("obj_parse", false, parse_setup, [&] {
+        for (auto& data : vertex_data_vec)
+            data.clear();
+        vertex_groups.clear();
+        material_names.clear();
+        parse_obj_file(obj_file.c_str(), vertex_data_vec, vertex_groups, material_names, parsed_mtl_path, has_uvs, has_normals);
+        sink = sink + static_cast<double>(vertex_groups.size());
+    });
+    add("obj_parse_parallel", false, parse_setup, [&] {
+        for (auto& data : vertex_data_vec)
+            data.clear();
+        vertex_groups.clear();
+        material_names.clear();
+        parse_obj_file_parallel(obj_file.c_str(), vertex_data_vec, vertex_groups, material_names, parsed_mtl_path, has_uvs, has_normals, ge.workers);
+        sink = sink + static_cast<double>(vertex_groups.size());
+    });
+    add("mtl_parse", true, [] { return static_cast<size_t>(MATERIAL_COUNT); }, [&] {
+        const auto materials = parse_mtl_file(mtl_file.c_str(), true, true, Model::AUTO_GENERATE);
+        sink = sink + static_cast<double>(materials.size());
+    });
+
+    // MESH DATA CONSTRUCTION, on the whole grid as one vertex group
+    std::vector<float> mesh_data_vec[3];
+    std::vector<size_t> vertex_group{};
+    std::vector<float> tangents{};
+    std::vector<float> out_vertex_data{};
+    std::vector<unsigned int> out_indices{};
+    auto mesh_setup = [&] {
+        if (vertex_group.empty()) {
+            bool uvs = false, normals = false;
+            parse_obj_file(obj_file.c_str(), mesh_data_vec, vertex_group, uvs, normals);
+        }
+        return vertex_group.size() / 9;
+    };
+    add("vertex_welding", false, mesh_setup, [&] {
+        out_vertex_data.clear();
+        out_indices.clear();
+        construct_mesh_data_from_parsed_obj_data(mesh_data_vec, vertex_group, {}, true, true, out_vertex_data, out_indices);
+        sink = sink + static_cast<double>(out_indices.size());
+    });
+    add("vertex_welding_tangents", false, [&] {
+        const size_t faces = mesh_setup();
+        tangents = calculate_tangents(mesh_data_vec, vertex_group);
+        return faces;
+    }, [&] {
+        out_vertex_data.clear();
+        out_indices.clear();
+        construct_mesh_data_from_parsed_obj_data(mesh_data_vec, vertex_group, tangents, true, true, out_vertex_data, out_indices);
+        sink = sink + static_cast<double>(out_indices.size());
+    });
+    add("calculate_tangents", false, mesh_setup, [&] {
+        const std::vector<float> result = calculate_tangents(mesh_data_vec, vertex_group);
+        sink = sink + static_cast<double>(result.size());
+    });
+    // LOD CHAIN of the welded grid, 4 levels halving the triangle count
+    std::vector<float> lod_vertex_data{};
+    std::vector<unsigned int> lod_indices{};
+    std::vector<unsigned int> lod_chain_indices{};
+    std::vector<MeshLod> lods{};
+    add("mesh_lods", false, [&] {
+        const size_t faces = mesh_setup();
+        construct_mesh_data_from_parsed_obj_data(mesh_data_vec, vertex_group, {}, true, true, lod_vertex_data, lod_indices);
+        return faces;
+    }, [&] {
+        generate_mesh_lods(lod_vertex_data, VertexLayout{true, true, false, false}.get_floats_per_vertex(), lod_indices, 4, 0.5f, 0.05f, lod_chain_indices, lods);
+        sink = sink + static_cast<double>(lod_chain_indices.size());
+    });
+    // VERTEX CACHE OPTIMIZATION of the welded grid, every iteration starts from the welded order
+    std::vector<unsigned int> optimized_indices{};
+    add("optimize_vertex_cache", false, [&] {
+        const size_t faces = mesh_setup();
+        lod_vertex_data.clear();
+        lod_indices.clear();
+        construct_mesh_data_from_parsed_obj_data(mesh_data_vec, vertex_group, {}, true, true, lod_vertex_data, lod_indices);
+        return faces;
+    }, [&] {
+        const size_t vertex_count = lod_vertex_data.size() / VertexLayout{true, true, false, false}.get_floats_per_vertex();
+        optimized_indices = lod_indices;
+        optimize_vertex_cache(optimized_indices, vertex_count);
+        sink = sink + analyze_vertex_cache(optimized_indices, vertex_count).get_acmr();
+    });
+
+    // TRANSFORMS
+    const size_t transform_count = static_cast<size_t>(options.size) * 64;
+    std::vector<Transform> transforms{};
+    std::vector<Rotation> rotations{};
+    float angle = 0.0f;
+    add("transform_world_matrix", false, [&] {
+        std::mt19937 random(2);
+        std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+        transforms.resize(transform_count);
+        for (Transform& transform : transforms) {
+            transform.position = Position{coordinate(random), coordinate(random), coordinate(random)};
+            transform.scale = Scale{1.0f, 2.0f, 1.0f};
+        }
+        return transforms.size();
+    }, [&] {
+        // every transform changes, so every matrix gets rebuilt
+        angle += 0.01f;
+        glm::vec3 sum{0.0f};
+        for (Transform& transform : transforms) {
+            transform.rotation = glm::vec3{angle, angle * 0.5f, 0.0f};
+            transform.position.x += 0.001f;
+            sum += glm::vec3(transform.get_world_matrix()[3]) + transform.get_normal_matrix()[0];
+        }
+        sink = sink + sum.x;
+    });
+    add("rotation_matrix", false, [&] {
+        rotations.assign(transform_count, Rotation{});
+        return rotations.size();
+    }, [&] {
+        angle += 0.01f;
+        float sum = 0.0f;
+        for (Rotation& rotation : rotations) {
+            rotation.x = angle;
+            rotation.y = angle * 0.5f;
+            rotation.euler_2_quat();
+            sum += rotation.get_transformation_matrix()[0][0];
+        }
+        sink = sink + sum;
+    });
+    // chains of 4 entities (root + 3 attached), only the roots move, their children follow through the propagation
+    std::vector<geRef<SpatialThing>> hierarchy_roots{};
+    add("transform_hierarchy", false, [&] {
+        for (size_t i = 0; i < transform_count / 4; i++) {
+            auto parent = ge.add<SpatialThing>();
+            hierarchy_roots.push_back(parent);
+            for (int depth = 0; depth < 3; depth++) {
+                auto child = ge.add<SpatialThing>();
+                child->transform.position = Position{0.0f, 1.0f, 0.0f};
+                ge.transforms.set_parent(child.id, parent.id);
+                parent = child;
+            }
+        }
+        ge.transforms.propagate();
+        return ge.transforms.size();
+    }, [&] {
+        angle += 0.01f;
+        for (geRef<SpatialThing>& root : hierarchy_roots) {
+            root->transform.rotation = glm::vec3{angle, 0.0f, 0.0f};
+        }
+        ge.transforms.propagate();
+        sink = sink + ge.transforms.get_world_matrix(ge.transforms.size() - 1)[3][1];
+    });
+
+    // LIGHT SELECTION, more point lights than rendered, sorted by proximity every frame
+    constexpr size_t LIGHT_COUNT = 1024;
+    Position camera_position{0.0f, 0.0f, 0.0f};
+    add("lights_update", true, [&] {
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+        for (size_t i = 0; i < LIGHT_COUNT; i++) {
+            auto light = ge.add<PointLight>(Color{1.0f, 1.0f, 1.0f, 1.0f}, 1.0f);
+            if (light.get() != nullptr)
+                light->transform.position = Position{coordinate(random), coordinate(random), coordinate(random)};
+        }
+        return LIGHT_COUNT;
+    }, [&] {
+        camera_position.x += 0.5f;
+        ge.lights.update(camera_position);
+    });
+
+    // MATERIAL BUCKETS, a render queue of random draws sorted and walked bucket by bucket (replaced the per shader program thing id lists)
+    RenderQueue render_queue{};
+    std::vector<uint64_t> draw_keys{};
+    add("material_buckets", false, [&] {
+        std::mt19937 random(4);
+        std::uniform_int_distribution<unsigned int> program(0, 7), material(0, 255), mesh(0, 63);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        draw_keys.resize(static_cast<size_t>(options.size) * 64);
+        for (uint64_t& key : draw_keys)
+            key = RenderQueue::make_key(0, program(random), material(random), mesh(random), depth(random));
+        return draw_keys.size();
+    }, [&] {
+        render_queue.clear();
+        for (const uint64_t key : draw_keys)
+            render_queue.push(key, nullptr);
+        render_queue.sort();
+        // layer, program and material bits above the mesh and depth fields
+        size_t buckets = 0;
+        uint64_t current_bucket = ~0ull;
+        for (const RenderQueue::Item& item : render_queue.get_items()) {
+            if (item.key >> 32 != current_bucket) {
+                current_bucket = item.key >> 32;
+                buckets += 1;
+            }
+        }
+        sink = sink + static_cast<double>(buckets);
+    });
+
+    // OCCLUSION CULLING, a street of box buildings seen from the ground, small boxes scattered between them
+    OcclusionCuller occlusion_culler{};
+    std::vector<glm::mat4> occluder_matrices{};
+    const OccluderMesh building = OccluderMesh::box(BoundingBox{glm::vec3(-0.5f, 0.0f, -0.5f), glm::vec3(0.5f, 1.0f, 0.5f)});
+    // the street ends with a wall of buildings behind the last row, the far plane always reaches past it
+    const float end_wall_z = -20.0f - 14.0f * static_cast<float>(options.size / 8);
+    const glm::mat4 occlusion_view_projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, std::max(500.0f, 50.0f - end_wall_z)) * glm::lookAt(glm::vec3(0.0f, 1.7f, 0.0f), glm::vec3(0.0f, 1.7f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    auto rasterize_occluders = [&] {
+        occlusion_culler.begin_frame(occlusion_view_projection);
+        for (const glm::mat4& matrix : occluder_matrices)
+            occlusion_culler.rasterize(building, matrix);
+        occlusion_culler.build_hierarchy();
+    };
+    // the scene is built once, so both occlusion benchmarks also run alone (--filter)
+    auto occlusion_setup = [&] {
+        if (occluder_matrices.empty()) {
+            std::mt19937 random(5);
+            std::uniform_real_distribution<float> size(4.0f, 12.0f), height(6.0f, 30.0f), offset(-2.0f, 2.0f);
+            for (int row = 0; row < options.size / 8; row++) {
+                for (int side = -1; side <= 1; side += 2) {
+                    for (int column = 0; column < 4; column++) {
+                        // both sides of the street and the blocks behind them
+                        const glm::vec3 position{static_cast<float>(side) * (8.0f + 14.0f * column) + offset(random), 0.0f, -6.0f - 14.0f * row + offset(random)};
+                        occluder_matrices.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(size(random), height(random), size(random))));
+                    }
+                }
+            }
+            occluder_matrices.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, end_wall_z)), glm::vec3(200.0f, 40.0f, 4.0f)));
+        }
+        return occluder_matrices.size() * building.get_triangle_count();
+    };
+    add("occlusion_rasterize", false, occlusion_setup, [&] {
+        rasterize_occluders();
+        sink = sink + occlusion_culler.get_depth_buffer()[0];
+    });
+    std::vector<BoundingBox> occludee_boxes{};
+    bool occlusion_check_failed = false;
+    add("occlusion_test", false, [&] {
+        occlusion_setup();
+        rasterize_occluders();
+        // the end wall (4 deep, 40 high) has to hide a box behind it and must not hide one in front of it,
+        // that one reaches up to the top of the wall, above the buildings that may line the middle of the street
+        const BoundingBox behind_wall{glm::vec3(-2.0f, 10.0f, end_wall_z - 10.0f), glm::vec3(2.0f, 14.0f, end_wall_z - 6.0f)};
+        const BoundingBox in_front_of_wall{glm::vec3(-2.0f, 0.0f, end_wall_z + 3.0f), glm::vec3(2.0f, 39.0f, end_wall_z + 4.0f)};
+        if (!occlusion_culler.is_occluded(behind_wall) or occlusion_culler.is_occluded(in_front_of_wall)) {
+            std::cerr << "occlusion_test: the end wall doesn't hide the box behind it or hides the one in front of it" << std::endl;
+            occlusion_check_failed = true;
+        }
+        std::mt19937 random(6);
+        std::uniform_real_distribution<float> x(-60.0f, 60.0f), z(-14.0f * (options.size / 8), -1.0f), size(0.5f, 2.0f);
+        occludee_boxes.resize(static_cast<size_t>(options.size) * 64);
+        for (BoundingBox& box : occludee_boxes) {
+            const glm::vec3 corner{x(random), 0.0f, z(random)};
+            box = BoundingBox{corner, corner + glm::vec3(size(random))};
+        }
+        return occludee_boxes.size();
+    }, [&] {
+        size_t occluded = 0;
+        for (const BoundingBox& box : occludee_boxes)
+            occluded += occlusion_culler.is_occluded(box);
+        sink = sink + static_cast<double>(occluded);
+    });
+
+    std::ofstream output(options.output);
+    write_json(output, options, results);
+    output.close();
+    if (!output) {
+        std::cerr << "failed to write " << options.output << std::endl;
+        return finish(1);
+    }
+    std::cout << "results written to " << options.output << std::endl;
+    return finish(occlusion_check_failed ? 1 : 0);
+}
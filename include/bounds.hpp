@@ -0,0 +1,69 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+#include <array>
+#include <limits>
+#include <glm/glm.hpp>
+
+/// Axis aligned bounding box
+/// @ingroup Coordinates
+class BoundingBox {
+public:
+    /// minimal corner, an empty box has min > max
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    /// maximal corner
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+    BoundingBox() = default;
+    /// Constructs a box from its corners
+    BoundingBox(const glm::vec3 &min, const glm::vec3 &max);
+
+    /// If the box contains no points
+    [[nodiscard]] bool is_empty() const;
+    /// Center of the box
+    [[nodiscard]] glm::vec3 get_center() const;
+    /// Half of the size of the box
+    [[nodiscard]] glm::vec3 get_extents() const;
+
+    /// Grows the box so that it contains the point
+    void expand(const glm::vec3 &point);
+    /// Grows the box so that it contains another box
+    void expand(const BoundingBox &box);
+
+    /// Returns an axis aligned box containing this box transformed by a matrix (e.g. local box -> world box)
+    /// @param matrix affine transformation matrix
+    [[nodiscard]] BoundingBox transformed(const glm::mat4 &matrix) const;
+};
+
+/// Bounding sphere
+/// @ingroup Coordinates
+class BoundingSphere {
+public:
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+
+    /// Returns a sphere containing this sphere transformed by a matrix, the radius is scaled by the largest axis scale
+    /// @param matrix affine transformation matrix
+    [[nodiscard]] BoundingSphere transformed(const glm::mat4 &matrix) const;
+};
+
+/// 6 planes of a camera view volume, used for frustum culling
+/// @ingroup Coordinates
+class Frustum {
+    /// planes as (normal.xyz, distance), normals point inside, order: left, right, bottom, top, near, far
+    std::array<glm::vec4, 6> planes{};
+public:
+    Frustum() = default;
+    /// Extracts the planes from a PROJECTION * VIEW matrix (Gribb-Hartmann), planes are in world space
+    explicit Frustum(const glm::mat4 &view_projection);
+
+    /// Plane getter
+    /// @param index 0 - 5, left, right, bottom, top, near, far
+    [[nodiscard]] const glm::vec4& get_plane(size_t index) const;
+
+    /// If the world space box is at least partially inside the frustum
+    [[nodiscard]] bool intersects(const BoundingBox &box) const;
+    /// If the world space sphere is at least partially inside the frustum
+    [[nodiscard]] bool intersects(const BoundingSphere &sphere) const;
+};
+
+#endif //BOUNDS_HPP
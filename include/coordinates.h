@@ -1,5 +1,6 @@
 #ifndef COORDINATES_H
 #define COORDINATES_H
+#include <array>
 #include "glm/glm.hpp"
 
 /// An in Engine 3D vector data type
@@ -130,8 +131,24 @@ public:
 };
 
 /// Container class combining Position, Rotation, and Scale, used by all SpatialThing(s)
+/// Caches the world (model) matrix and the normal matrix, they are only rebuilt when position, rotation (Euler angles) or scale change.
 /// @ingroup Coordinates
 class Transform {
+    /// Cached world matrix (position * rotation * scale)
+    glm::mat4 world_matrix = glm::mat4(1.0f);
+    /// Cached normal matrix (inverse transpose of the world matrix)
+    glm::mat3 normal_matrix = glm::mat3(1.0f);
+    /// Position, Euler rotation and scale values the cached matrices were built from
+    std::array<float, 9> cached_state{};
+    /// Forces a rebuild on the next matrix get
+    bool dirty = true;
+    /// Incremented every time the cached matrices get rebuilt
+    unsigned int version = 0;
+
+    /// Current position, Euler rotation and scale values
+    [[nodiscard]] std::array<float, 9> current_state() const;
+    /// Rebuilds cached matrices if anything changed
+    void update_matrices();
 public:
     /// Global translation
     Position position{0, 0, 0};
@@ -139,6 +156,18 @@ public:
     Rotation rotation{1, 0, 0, 0};
     /// Global scale
     Scale scale{1, 1, 1};
+
+    /// Forces the cached matrices to be rebuilt on the next get.
+    /// @note Changes to position, rotation (Euler x, y, z) and scale are detected automatically, this is only needed if you changed the quaternion components directly.
+    void mark_dirty();
+    /// If the cached matrices are out of date
+    [[nodiscard]] bool is_dirty() const;
+    /// Returns the cached world (model) matrix, rebuilds it only if the transform changed
+    const glm::mat4& get_world_matrix();
+    /// Returns the cached normal matrix, rebuilds it only if the transform changed
+    const glm::mat3& get_normal_matrix();
+    /// Returns a counter incremented every time the cached matrices get rebuilt, useful for render passes caching per-object data
+    unsigned int get_version();
 };
 
 /// Useful Color class, can be used for RGBA or RGB formats
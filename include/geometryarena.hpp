@@ -0,0 +1,114 @@
+#ifndef GEOMETRYARENA_HPP
+#define GEOMETRYARENA_HPP
+#include <map>
+#include <vector>
+#include <span>
+#include "meshes.hpp"
+
+/// First fit free list allocator over a range of elements [0, capacity).
+/// Freed ranges are merged with their free neighbours, so the range doesn't fragment over time.
+class FreeListAllocator {
+    /// free ranges, offset -> size, sorted by offset
+    std::map<unsigned int, unsigned int> free_ranges{};
+    /// amount of free elements
+    unsigned int free_size = 0;
+public:
+    /// returned by allocate() when no free range is large enough
+    static constexpr unsigned int INVALID_OFFSET = -1;
+
+    /// @param capacity amount of elements managed by the allocator
+    explicit FreeListAllocator(unsigned int capacity);
+
+    /// Reserves a continuous range
+    /// @param size amount of elements
+    /// @returns offset of the range or INVALID_OFFSET
+    [[nodiscard]] unsigned int allocate(unsigned int size);
+    /// Returns a range received from allocate()
+    void free(unsigned int offset, unsigned int size);
+    /// amount of free elements (not necessarily continuous)
+    [[nodiscard]] unsigned int get_free_size() const;
+};
+
+/// Command of glMultiDrawElementsIndirect, layout defined by OpenGL
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instance_count;
+    unsigned int first_index;
+    int base_vertex;
+    unsigned int base_instance;
+};
+
+/// One large vertex and index buffer pair shared by Meshes with the same VertexLayout (and vertex format) and index size.
+/// Meshes are suballocated with a free list, so all of them are drawn from one VAO with base vertex / first index offsets
+/// and a whole material bucket can be submitted with one glMultiDrawElementsIndirect.
+/// @note Arenas don't grow, when one is full Meshes creates another one.
+/// @ingroup Resources
+class GeometryArena {
+    VertexLayout layout;
+    /// bytes of one index, 2 (GL_UNSIGNED_SHORT) or 4 (GL_UNSIGNED_INT)
+    unsigned int index_size;
+
+    unsigned int vertex_buffer_object = 0;
+    unsigned int element_buffer_object = 0;
+    unsigned int vertex_array_object = 0;
+    /// VAO with the per instance attributes of the instanced draw path, created on first use
+    unsigned int instanced_vertex_array_object = 0;
+    /// instance buffer the instanced VAO reads from
+    unsigned int instanced_vao_instance_buffer = 0;
+    /// buffer holding only the positions, 0 if the arena has none
+    unsigned int position_buffer_object = 0;
+    /// VAO with only positions and the per instance attributes, used by depth only draws, created on first use
+    unsigned int depth_vertex_array_object = 0;
+    /// instance buffer the depth VAO reads from
+    unsigned int depth_vao_instance_buffer = 0;
+
+    /// allocator of vertex buffer, in vertices
+    FreeListAllocator vertex_allocator;
+    /// allocator of element buffer, in indices
+    FreeListAllocator index_allocator;
+public:
+    /// amount of vertices of a default arena
+    static constexpr unsigned int DEFAULT_VERTEX_CAPACITY = 1 << 16;
+    /// amount of indices of a default arena
+    static constexpr unsigned int DEFAULT_INDEX_CAPACITY = 1 << 18;
+
+    /// Allocates the buffers on the GPU
+    /// @param layout vertex layout of all meshes in this arena
+    /// @param index_size bytes of one index of all meshes in this arena (2 or 4)
+    /// @param vertex_capacity amount of vertices the arena can hold
+    /// @param index_capacity amount of indices the arena can hold
+    /// @param position_stream if the arena keeps a position-only copy of the vertices for depth only draws (see Meshes.position_streams)
+    GeometryArena(const VertexLayout& layout, unsigned int index_size, unsigned int vertex_capacity, unsigned int index_capacity, bool position_stream = false);
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    /// Uploads mesh data into free ranges of the buffers
+    /// @param vertex_data interleaved vertex data in the layout of the arena, encoded in its format (see VertexLayout.encode)
+    /// @param index_data triangle indices in the index size of the arena, relative to the first vertex of vertex_data
+    /// @param allocation where the data was placed
+    /// @returns false if the arena doesn't have enough continuous space
+    bool allocate(std::span<const std::byte> vertex_data, std::span<const std::byte> index_data, GeometryAllocation& allocation);
+    /// Returns the ranges of a mesh, the data stays in the buffers until overwritten
+    void free(const GeometryAllocation& allocation);
+
+    /// getter for the VAO reading the arena buffers
+    [[nodiscard]] unsigned int get_vertex_array_object() const;
+    /// Returns a VAO that reads the arena buffers and per instance data (InstanceData) from the instance buffer, created on first use
+    /// @param instance_buffer OpenGL buffer holding InstanceData
+    [[nodiscard]] unsigned int get_instanced_vertex_array_object(unsigned int instance_buffer);
+    /// Returns a VAO that reads only positions (from the position-only stream if the arena has one) and per instance data (InstanceData), created on first use
+    /// @param instance_buffer OpenGL buffer holding InstanceData
+    [[nodiscard]] unsigned int get_depth_vertex_array_object(unsigned int instance_buffer);
+    /// if the arena keeps a position-only stream
+    [[nodiscard]] bool has_position_stream() const;
+    /// getter for the vertex layout of the arena
+    [[nodiscard]] const VertexLayout& get_layout() const;
+    /// OpenGL type of the indices, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    [[nodiscard]] unsigned int get_index_type() const;
+
+    /// Deallocates the buffers from the GPU
+    /// @warning do not do on a thread different from the main
+    ~GeometryArena();
+};
+
+#endif //GEOMETRYARENA_HPP
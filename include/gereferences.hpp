@@ -6,7 +6,7 @@ class Engine;
 template<typename T>
 class geRef {
 public:
-    /// In engine ID
+    /// In engine ID (slot index + generation, so IDs of removed entities don't point to new ones)
     unsigned int id;
     /// Pointer to engine object
     Engine* ge;
@@ -18,6 +18,7 @@ public:
     geRef(unsigned int _id, Engine* _ge);
 
     /// Returns temporary pointer to entity, that is held inside a std::unique_ptr
+    /// @returns nullptr if the entity was already removed
     T* get();
 
     /// Operator substitute for get method for user friendliness
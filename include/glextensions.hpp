@@ -0,0 +1,60 @@
+#ifndef GLEXTENSIONS_HPP
+#define GLEXTENSIONS_HPP
+#include <glad/glad.h>
+
+/// OpenGL functionality newer than the GL 3.3 core profile glad is generated for.
+/// Loaded at runtime after glad, every feature has a flag and callers have to fall back to GL 3.3 when it is false.
+class GLExtensions {
+public:
+    /// GL_DRAW_INDIRECT_BUFFER buffer target (GL 4.0, ARB_draw_indirect)
+    static constexpr GLenum DRAW_INDIRECT_BUFFER = 0x8F3F;
+
+    /// glProgramParameteri pname marking a program's binary as retrievable (GL 4.1, ARB_get_program_binary)
+    static constexpr GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+    /// glGetProgramiv pname of the program binary size (GL 4.1, ARB_get_program_binary)
+    static constexpr GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+    /// glGetIntegerv pname of the amount of supported program binary formats (GL 4.1, ARB_get_program_binary)
+    static constexpr GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+    /// block compressed internal formats (EXT_texture_compression_s3tc, EXT_texture_sRGB, GL 4.2 / ARB_texture_compression_bptc), BC5 is GL 3.0 core (GL_COMPRESSED_RG_RGTC2)
+    static constexpr GLenum COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+    static constexpr GLenum COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+    static constexpr GLenum COMPRESSED_SRGB_S3TC_DXT1 = 0x8C4C;
+    static constexpr GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+    static constexpr GLenum COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+    static constexpr GLenum COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D;
+
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+    /// glMultiDrawElementsIndirect is available and respects base_instance (GL 4.3 or ARB_multi_draw_indirect + ARB_base_instance)
+    bool multi_draw_indirect = false;
+    /// glMultiDrawElementsIndirect, nullptr if not supported
+    MultiDrawElementsIndirectProc multi_draw_elements_indirect = nullptr;
+
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    /// Linked programs can be saved and loaded as driver specific binaries (GL 4.1 or ARB_get_program_binary, with at least one binary format)
+    bool program_binaries = false;
+    /// glGetProgramBinary, nullptr if not supported
+    GetProgramBinaryProc get_program_binary = nullptr;
+    /// glProgramBinary, nullptr if not supported
+    ProgramBinaryProc program_binary = nullptr;
+    /// glProgramParameteri, nullptr if not supported
+    ProgramParameteriProc program_parameteri = nullptr;
+
+    /// BC1 and BC3 textures can be uploaded (EXT_texture_compression_s3tc)
+    bool texture_compression_s3tc = false;
+    /// BC7 textures can be uploaded (GL 4.2 or ARB_texture_compression_bptc)
+    bool texture_compression_bptc = false;
+
+    /// Checks the context version and extensions, loads function pointers
+    /// @warning requires a current OpenGL context and loaded glad
+    void load();
+
+    /// If the context version is at least major.minor
+    [[nodiscard]] static bool has_version(int major, int minor);
+};
+
+#endif //GLEXTENSIONS_HPP
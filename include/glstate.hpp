@@ -0,0 +1,116 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+
+/// Cache of the OpenGL binding state (Engine.gl_state), redundant calls are dropped before they reach the driver.
+/// Covers the current program, vertex array, textures per unit, uniform buffer ranges, enabled capabilities, the depth test function and the depth and color write masks.
+/// All engine code binds this state through it, code calling OpenGL directly has to call invalidate() afterward.
+/// Objects have to be forgotten before they are deleted, OpenGL reuses the names.
+/// @warning main thread only
+class GLState {
+public:
+    /// Amount of texture units tracked, binds to higher units are always issued
+    static constexpr unsigned int MAX_TEXTURE_UNITS = 32;
+    /// Amount of uniform buffer binding points tracked, binds to higher ones are always issued
+    static constexpr unsigned int MAX_UNIFORM_BUFFER_BINDINGS = 16;
+
+    /// Kinds of filtered calls
+    enum Category {
+        PROGRAM,
+        VERTEX_ARRAY,
+        TEXTURE,
+        UNIFORM_BUFFER,
+        CAPABILITY,
+        /// depth function, depth mask and color mask
+        WRITE_STATE,
+        CATEGORY_COUNT
+    };
+
+    /// Calls of one Category
+    struct CallCounters {
+        /// calls that reached the driver
+        unsigned int issued = 0;
+        /// redundant calls that were dropped
+        unsigned int skipped = 0;
+    };
+private:
+    /// Marks state that isn't known (before the first bind and after invalidate()), the next call is always issued
+    static constexpr unsigned int UNKNOWN = -1;
+
+    struct TextureBinding {
+        GLenum target = 0;
+        unsigned int texture = UNKNOWN;
+    };
+    struct BufferRange {
+        unsigned int buffer = UNKNOWN;
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    unsigned int program = UNKNOWN;
+    unsigned int vertex_array = UNKNOWN;
+    unsigned int active_texture_unit = UNKNOWN;
+    std::array<TextureBinding, MAX_TEXTURE_UNITS> textures{};
+    std::array<BufferRange, MAX_UNIFORM_BUFFER_BINDINGS> uniform_buffers{};
+    /// known capability states
+    std::vector<std::pair<GLenum, bool>> capabilities{};
+    GLenum depth_func = UNKNOWN;
+    /// 0 / 1, UNKNOWN
+    unsigned int depth_mask = UNKNOWN;
+    /// red, green, blue and alpha write bits, UNKNOWN
+    unsigned int color_mask = UNKNOWN;
+
+    std::array<CallCounters, CATEGORY_COUNT> counters{};
+    std::array<CallCounters, CATEGORY_COUNT> last_frame_counters{};
+
+    /// Counts a call, returns if it has to be issued
+    bool count(Category category, bool redundant);
+public:
+    /// glUseProgram
+    void use_program(unsigned int program_id);
+    /// glBindVertexArray
+    void bind_vertex_array(unsigned int vertex_array_object);
+    /// glActiveTexture + glBindTexture, the active unit is only switched when needed
+    /// @param unit texture unit index (not GL_TEXTURE0 based)
+    /// @param target e.g. GL_TEXTURE_2D, GL_TEXTURE_BUFFER
+    /// @param texture texture ID
+    void bind_texture(unsigned int unit, GLenum target, unsigned int texture);
+    /// glBindBufferRange with GL_UNIFORM_BUFFER
+    void bind_uniform_buffer_range(unsigned int index, unsigned int buffer, size_t offset, size_t size);
+    /// glEnable / glDisable
+    void set_capability(GLenum capability, bool enabled);
+    /// glDepthFunc
+    void set_depth_func(GLenum func);
+    /// Current depth function, so it can be restored after a temporary change, queried from OpenGL when it isn't known
+    [[nodiscard]] GLenum get_depth_func();
+    /// glDepthMask
+    void set_depth_mask(bool write);
+    /// Current depth mask, so it can be restored after a temporary change, queried from OpenGL when it isn't known
+    [[nodiscard]] bool get_depth_mask();
+    /// glColorMask
+    void set_color_mask(bool red, bool green, bool blue, bool alpha);
+
+    /// Drops cached state of a program that is going to be deleted
+    void forget_program(unsigned int program_id);
+    /// Drops cached state of a vertex array that is going to be deleted
+    void forget_vertex_array(unsigned int vertex_array_object);
+    /// Drops cached state of a texture that is going to be deleted
+    void forget_texture(unsigned int texture);
+    /// Drops cached state of a buffer that is going to be deleted
+    void forget_buffer(unsigned int buffer);
+    /// Forgets everything, for when OpenGL state was changed outside of the cache
+    void invalidate();
+
+    /// Moves the counters of the running frame to the last frame ones, called by Engine.send_to_window()
+    void end_frame();
+    /// Counters of a Category in the last finished frame
+    [[nodiscard]] const CallCounters& get_frame_counters(Category category) const;
+    /// Counters of all categories together in the last finished frame
+    [[nodiscard]] CallCounters get_frame_counters() const;
+};
+
+#endif //GLSTATE_HPP
@@ -1,22 +1,32 @@
 #ifndef MAIN_H
 #define MAIN_H
+#include <functional>
 #include <map>
 #include <unordered_map>
 #include <memory>
-#include <deque>
+#include <mutex>
+#include <tuple>
+#include <utility>
 
 #include "glad/glad.h"
+#include "glextensions.hpp"
+#include "glstate.hpp"
 #include "gereferences.hpp"
+#include "slotmap.hpp"
+#include "threadpool.hpp"
+#include "profiler.hpp"
 #include "input.hpp"
 #include "meshes.hpp"
 #include "shaders.hpp"
 #include "things.hpp"
 #include "renderer.hpp"
+#include "transformhierarchy.hpp"
 #include "lights.hpp"
+#include "resources.hpp"
 
 #include <GLFW/glfw3.h>
 
-typedef std::unordered_map<unsigned int, std::unique_ptr<Thing>> things_container;
+typedef ThingSlotMap things_container;
 typedef std::unordered_map<int, std::unique_ptr<RenderPass>> render_layer_container;
 
 
@@ -29,11 +39,13 @@ class Window {
     /// if vsync is on
     bool vsync = true;
 public:
-    /// pointer to a glfwwindow;
-    GLFWwindow *glfwwindow;
+    /// pointer to a glfwwindow, nullptr if the window couldn't be created
+    GLFWwindow *glfwwindow = nullptr;
     /// Window dimensions
     int width, height;
-    Window(const char* title, int _width, int _height, bool _fullscreen);
+    /// Framebuffer dimensions in pixels, what is actually rendered to (differs from width and height in fullscreen and on HiDPI displays)
+    int framebuffer_width = 0, framebuffer_height = 0;
+    Window(const char* title, int _width, int _height, bool _fullscreen, bool _visible = true);
     /// Makes this window context the one which is render on.
     void select() const;
     /// Sets VSync on this window
@@ -53,14 +65,30 @@ public:
 /// @param light_overflow_action what does the engine do if max amount of rendered lights is excited, more at Lights page
 /// @param gamma_correction If gamma correction is applied to final image + Engine interprets Colors and Albedo textures in sRGB
 /// @param auto_clear_window If TRUE window framebuffers will be cleared automatically at the start of each frame or if FALSE you have to clear them manually
+/// @param clustered_lighting If point and spot lights are culled into screen space clusters, so only lights touching a fragment are shaded, more at Lights page
+/// @param MAX_NR_CLUSTERED_LIGHTS the maximum amount of rendered point and spot lights together with clustered lighting (default = 1024)
+/// @param mesh_cache If parsed .obj files are cached in binary .gemesh files, so following starts skip the parsing
+/// @param mesh_cache_directory Where .gemesh files are written, if empty they are written next to the .obj file
+/// @param hidden_window If the window is never shown, for running the engine without presenting anything (benchmarks, tools), an OpenGL context is still created
 struct EngineSettings {
     bool fullscreen = false;
+    bool hidden_window = false;
     unsigned int MAX_NR_POINT_LIGHTS = 8;
     unsigned int MAX_NR_DIRECTIONAL_LIGHTS = 3;
     unsigned int MAX_NR_SPOT_LIGHTS = 4;
     Lights::LightOverflowAction light_overflow_action = Lights::SORT_BY_PROXIMITY;
     bool gamma_correction = true;
     bool auto_clear_window = true;
+    bool clustered_lighting = false;
+    unsigned int MAX_NR_CLUSTERED_LIGHTS = 1024;
+    bool mesh_cache = true;
+    const char* mesh_cache_directory = "";
+    bool program_binary_cache = true;
+    const char* program_binary_cache_directory = "engine/shader_cache";
+    /// how meshes store vertex attributes on the GPU, e.g. VertexFormat::compact() for about half the vertex memory (see Meshes.vertex_format)
+    VertexFormat vertex_format{};
+    /// amount of worker threads of Engine.workers, 0 = one less than the amount of hardware threads
+    unsigned int worker_threads = 0;
 };
 
 /// Engine class, it's initialization starts the engine. Holds all managers. Is ment to be a global variable instanced only once, all engine managing is accessible through that object.
@@ -72,12 +100,10 @@ class Engine {
 
     /// Inits render pipeline using OpenGL functions, called in the constructor
     void init_render_pipeline();
-    /// Auto increment ID counter for entities
-    unsigned int next_thing_id = 0;
     /// The last geRef ID that was used
     unsigned int last_used_thing_id = -1;
-    /// Deleted geRef IDs, which can be used
-    std::deque<unsigned int> deleted_geRef_ids{};
+    /// ID of the Thing whose constructor runs on this thread (see get_constructing_thing_id())
+    static inline thread_local unsigned int constructing_thing_id = ThingSlotMap::NULL_ID;
 
     std::vector<unsigned int> queued_things_to_be_removed{};
 
@@ -91,38 +117,98 @@ class Engine {
     bool depth_buffer_cleared_this_frame;
 
     bool in_update_loop = false;
+    /// Whether Things with parallel_update are being updated on the workers
+    bool in_parallel_update = false;
+
+    /// Spawns, queued removals and parent links of one thread during the parallel update, merged into temp_things, queued_things_to_be_removed and transforms afterward
+    struct alignas(64) UpdateBuffer {
+        /// reserved IDs and the constructors of the spawned entities, run on the main thread during the merge
+        std::vector<std::pair<unsigned int, std::function<std::unique_ptr<Thing>()>>> added_things{};
+        std::vector<unsigned int> removed_things{};
+        /// child and parent IDs of queued TransformHierarchy.set_parent() calls
+        std::vector<std::pair<unsigned int, unsigned int>> parent_links{};
+        /// spawns that got no ID from the prepared free slots (see parallel_spawn_budget), run through add() during the merge
+        std::vector<std::function<void()>> overflow_spawns{};
+        /// reserved IDs that weren't used (a light couldn't be registered), released during the merge
+        std::vector<unsigned int> released_ids{};
+    };
+    /// One UpdateBuffer per thread (indexed by ThreadPool::get_worker_index())
+    std::vector<UpdateBuffer> update_buffers{};
+    /// Things updated in parallel this frame, in dense order
+    std::vector<Thing*> parallel_things{};
+    /// Guards ID reservation and light registration when spawning during the parallel update
+    std::mutex spawn_mutex{};
+
+    /// Moves a spawned entity into things, registers MeshThings in mesh_things
+    void insert_thing(unsigned int id, std::unique_ptr<Thing> thing);
+    /// Constructs a spawned entity, its constructor can read the reserved ID through get_constructing_thing_id()
+    template<typename T, typename... Args>
+    std::unique_ptr<T> construct_thing(const unsigned int id, Args&&... args) {
+        const unsigned int outer_constructing_id = std::exchange(constructing_thing_id, id);
+        auto thing = std::make_unique<T>(std::forward<Args>(args)...);
+        constructing_thing_id = outer_constructing_id;
+        return thing;
+    }
 public:
     /// The main window in which the engine draws images (the only window)
     Window window;
     /// Input manager, through here you interact with all the input system features.
     Input input{};
+    /// Cache of the OpenGL binding state, all engine code binds programs, vertex arrays, textures and uniform buffers through it, see GLState
+    /// @note declared before the managers owning GPU objects, so they can still forget their objects when destroyed
+    GLState gl_state{};
     /// Mesh manager
     Meshes meshes{};
     /// Shader manager, hold base materials, has shader gen features, more on Shaders page
     Shaders shaders{};
+    /// Parent / child relations between SpatialThings, world matrices are propagated at the end of update(), see TransformHierarchy
+    TransformHierarchy transforms{};
     /// Light system manager
     Lights lights;
-
-    /// Get the lowest unused ID for a geRef
+    /// OpenGL features above GL 3.3 available on this driver
+    GLExtensions gl_extensions{};
+    /// CPU and GPU frame profiler, zones are recorded when built with GRAPHICENGINE_PROFILER, see Profiler
+    /// @note declared before resources and workers, so zones of finishing worker tasks still have a profiler
+    Profiler profiler{};
+    /// Asynchronous resource loading, uploads are processed in update()
+    /// @note declared before workers, so running loads can still queue uploads while the workers shut down
+    Resources resources{};
+    /// Worker threads for CPU heavy work (e.g. parsing large .obj files), see ThreadPool
+    ThreadPool workers;
+
+    /// Reserves a free ID for a geRef (slot index + generation, see ThingSlotMap)
     /// @note By getting it, the id is considered to be in use. This method is mainly intended for the Engine.
     [[nodiscard]] unsigned int get_next_geRef_id();
+    /// @warning another thread may reserve an ID right after, constructors of Things use get_constructing_thing_id() instead
     [[nodiscard]] unsigned int get_last_used_geRef_id() const;
+    /// ID reserved by add() for the Thing whose constructor is running on the calling thread, so constructors can reference their own entity
+    /// @returns ThingSlotMap::NULL_ID outside of constructors called by add()
+    [[nodiscard]] static unsigned int get_constructing_thing_id();
 
     /// Camera Matrices Uniform Buffer Object ID.
     unsigned int camera_matrix_ubo = -1;
     /// Time elapsed between the last 2 frames. Used as a normalizer so that movement can occur approximately the same speed regardless of the frame rate.
     float frame_delta = 0.0f;
-    /// Container that hold all the std::unique_ptr of all spawned entities. You can receive a pointer through the entity ID.
+    /// Slot map that holds all the std::unique_ptr of all spawned entities. You can receive a pointer through the entity ID.
     things_container things{};
     /// temporary container if you create entities in update method of entity
     std::vector<std::pair<unsigned int, std::unique_ptr<Thing>>> temp_things{};
-    /// Data structure that holds entity ids sorted by Materials, so that entities can be rendered in an optimized order.
-    std::multimap<std::shared_ptr<Material>, unsigned int, MaterialSorter> thing_ids_by_shader_program;
+    /// All spawned MeshThings in no particular order, render passes sort them each frame (see RenderQueue)
+    std::vector<MeshThing*> mesh_things{};
     /// Container holding all the render layers, at this point in time usually only one, but serves as a scalable infrastructure
     render_layer_container render_layers{};
+    /// Buffer streaming per instance data of instanced draw calls, shared by all render passes
+    StreamBuffer instance_buffer{};
+    /// Buffer streaming indirect draw commands of multi draw calls, shared by all render passes
+    StreamBuffer indirect_buffer{};
 
     /// If screen clearing will be handled automatically or if you want to manage it manually (usually auto works just fine)
     bool auto_clear_screen = true;
+    /// Amount of Things with parallel_update one worker task updates
+    unsigned int parallel_update_chunk_size = 64;
+    /// Amount of free IDs prepared before the parallel update, the slot map can't grow while workers read it.
+    /// Spawns beyond it still happen, but only when the update is merged, and their geRef is null.
+    unsigned int parallel_spawn_budget = 256;
 
     /// Starts the entire Engine, instances all managers.
     /// @param display_name name of the window
@@ -139,6 +225,7 @@ public:
     ~Engine();
 
     /// Calls update on all spawned updatable entities, also calls Input.update(); Ment to be called every frame in the games update function. More in getting started guide.
+    /// Entities with Thing.parallel_update are updated first, in chunks on Engine.workers, then all the others in order on the calling thread.
     void update();
 
     /// Processes received inputs. Ment to be called every frame.
@@ -163,7 +250,8 @@ public:
     [[nodiscard]] bool is_running() const;
 
     /// Things container getter, the propper way of getting a Thing* if you are not using a geRef
-    Thing* get_thing(unsigned int id);
+    /// @returns nullptr if the ID is stale (entity was removed) or invalid
+    Thing* get_thing(unsigned int id) const;
 
     /// Render layer container getter, the propper way of getting a RenderPass* if you are not using a geRendRef
     RenderPass* get_render_layer(int id);
@@ -179,37 +267,62 @@ public:
     /// @tparam T any class base of Thing, because it's saved in the things_container
     /// @param args a list of arguments passed to the constructor of templated class
     /// @return a geRef<T> object, by which you can reference the entity
+    /// @note Called during the parallel update, the arguments are copied and the constructor runs on the main thread once the workers finish.
+    /// Like every Thing spawned during update(), the entity can be reached through the geRef after the update.
     template<typename T, typename... Args>
     requires std::is_base_of_v<Thing, T>
     geRef<T> add(Args&&... args) {
-        geRef<T> ref{get_next_geRef_id(), this};
+        // ID reservation and light registration aren't thread-safe, workers take turns during the parallel update
+        std::unique_lock spawn_lock(spawn_mutex, std::defer_lock);
+        if (in_parallel_update)
+            spawn_lock.lock();
 
-        auto thing = std::make_unique<T>(std::forward<Args>(args)...);
-
-        if constexpr (std::is_base_of_v<MeshThing, T>) {
-            thing_ids_by_shader_program.insert({thing.get()->get_material(), ref.id});
-        } else if constexpr (std::is_base_of_v<PointLight, T>) {
-            if (!lights.add_point_light(ref.id)) {
-                ref.id = -1;
-                ref.ge = nullptr;
-                return ref;
+        geRef<T> ref{get_next_geRef_id(), this};
+        if (ref.id == ThingSlotMap::NULL_ID) {
+            ref.ge = nullptr;
+            if (in_parallel_update) {
+                // the free slots prepared for the parallel update ran out, spawned again once the workers finish
+                spawn_lock.unlock();
+                auto arguments = std::make_shared<std::tuple<std::decay_t<Args>...>>(std::forward<Args>(args)...);
+                update_buffers[ThreadPool::get_worker_index()].overflow_spawns.emplace_back([this, arguments] {
+                    std::apply([this](auto&... unpacked) { add<T>(std::move(unpacked)...); }, *arguments);
+                });
             }
+            return ref;
+        }
+
+        bool light_added = true;
+        if constexpr (std::is_base_of_v<PointLight, T>) {
+            light_added = lights.add_point_light(ref.id);
         } else if constexpr (std::is_base_of_v<DirectionalLight, T>) {
-            if (!lights.add_directional_light(ref.id)) {
-                ref.id = -1;
-                ref.ge = nullptr;
-                return ref;
-            }
+            light_added = lights.add_directional_light(ref.id);
         } else if constexpr (std::is_base_of_v<SpotLight, T>) {
-            if (!lights.add_spot_light(ref.id)) {
-                ref.id = -1;
-                ref.ge = nullptr;
-                return ref;
-            }
+            light_added = lights.add_spot_light(ref.id);
+        }
+        if (!light_added) {
+            // releasing bumps the slot generation, which other workers may be reading
+            if (in_parallel_update)
+                update_buffers[ThreadPool::get_worker_index()].released_ids.push_back(ref.id);
+            else
+                things.release(ref.id);
+            ref.id = -1;
+            ref.ge = nullptr;
+            return ref;
         }
 
+        if (in_parallel_update) {
+            spawn_lock.unlock();
+            // constructors may call OpenGL or attach children, so the Thing is constructed on the main thread when the buffers are merged
+            auto arguments = std::make_shared<std::tuple<std::decay_t<Args>...>>(std::forward<Args>(args)...);
+            update_buffers[ThreadPool::get_worker_index()].added_things.emplace_back(ref.id, [this, id = ref.id, arguments]() -> std::unique_ptr<Thing> {
+                return std::apply([this, id](auto&... unpacked) { return construct_thing<T>(id, std::move(unpacked)...); }, *arguments);
+            });
+            return ref;
+        }
+
+        auto thing = construct_thing<T>(ref.id, std::forward<Args>(args)...);
         if (!in_update_loop) {
-            things[ref.id] = std::move(thing);
+            insert_thing(ref.id, std::move(thing));
         } else {
             temp_things.push_back(std::pair<unsigned int, std::unique_ptr<Thing>>{ref.id, std::move(thing)});
         }
@@ -235,10 +348,19 @@ public:
     };
 
     /// Queues the removal of an entity to the time after all entities were updated
+    /// @note Thread-safe during the parallel update, the removals of each thread are merged afterward
     void queue_remove_thing(unsigned int id);
 
+    /// Attaches an entity to a parent (see TransformHierarchy.set_parent()), during the parallel update the link is queued and applied when the buffers are merged
+    /// @note Thread-safe during the parallel update, TransformHierarchy.set_parent() goes through here then
+    void queue_set_parent(unsigned int child_id, unsigned int parent_id);
+
+    /// Whether Things with parallel_update are being updated on the workers right now
+    [[nodiscard]] bool is_in_parallel_update() const;
+
     /// Removes a spawned entity
     /// @param id the ID in the geRef.
+    /// @note During the parallel update the removal is queued instead (see queue_remove_thing)
     void remove_thing(unsigned int id);
 
     [[nodiscard]] double get_game_time() const;
@@ -2,6 +2,7 @@
 #define LIGHTS_H
 
 #include <vector>
+#include <array>
 #include "coordinates.h"
 #include "things.hpp"
 
@@ -14,10 +15,14 @@ public:
     Color color;
     /// Light intensity
     float intensity;
+    /// Distance at which the light stops affecting surfaces, used by clustered lighting. 0 = derived from intensity, see get_range()
+    float range = 0.0f;
     /// PointLight constructor
     /// @param color light color
     /// @param intensity light intesity
     PointLight(Color color, float intensity);
+    /// Returns range or, if it is 0, the distance at which the attenuation of the light falls under 1/256
+    [[nodiscard]] float get_range() const;
 };
 
 /// A Directional (Sun) Light
@@ -48,10 +53,14 @@ public:
     float intensity;
     /// Angle of light cone
     float angle;
+    /// Distance at which the light stops affecting surfaces, used by clustered lighting. 0 = derived from intensity, see get_range()
+    float range = 0.0f;
     /// PointLight constructor
     /// @param color light color
     /// @param intensity light intesity
     SpotLight(Color color, float intensity, float angle);
+    /// Returns range or, if it is 0, the distance at which a point light of the same intensity falls under 1/256
+    [[nodiscard]] float get_range() const;
 };
 
 
@@ -65,7 +74,45 @@ class Lights {
     std::vector<unsigned int> spot_lights;
     /// OpenGL ID of the Uniform Buffer Object
     unsigned int lights_ubo = -1;
+
+    /// If point and spot lights are culled into clusters instead of being uploaded to the LIGHTS UBO
+    bool clustered_lighting = false;
+    /// OpenGL ID of the CLUSTERS Uniform Buffer Object
+    unsigned int clusters_ubo = -1;
+    /// Texture buffers of clustered lighting: per cluster (offset, count), light index lists, light data
+    unsigned int cluster_grid_buffer = -1, cluster_index_buffer = -1, cluster_light_buffer = -1;
+    unsigned int cluster_grid_texture = -1, cluster_index_texture = -1, cluster_light_texture = -1;
+    /// Maximum amount of texels of a texture buffer on this driver
+    unsigned int max_cluster_indices = 0;
+    /// CPU side cluster data (reused between frames)
+    std::vector<unsigned int> cluster_grid{};
+    std::vector<unsigned int> cluster_indices{};
+    std::vector<glm::vec4> cluster_light_data{};
+    /// inclusive cluster range (min x, min y, min z, max x, max y, max z) of every clustered light this frame
+    std::vector<std::array<int, 6>> cluster_light_ranges{};
+    /// Amount of light indices that didn't fit into the index buffer last frame
+    size_t dropped_cluster_indices = 0;
+
+    /// Orders lights by distance from the camera, so that the first max_count are the closest
+    static void sort_by_proximity(std::vector<unsigned int>& light_ids, size_t max_count, const Position& camera_pos);
+    /// Computes the inclusive cluster range a light sphere touches, false if it isn't in the view
+    bool light_cluster_range(const Camera& camera, const glm::vec3& world_position, float range, float z_scale, float z_bias, std::array<int, 6>& cluster_range) const;
 public:
+    /// Clusters along the screen width
+    static constexpr int CLUSTER_GRID_X = 16;
+    /// Clusters along the screen height
+    static constexpr int CLUSTER_GRID_Y = 9;
+    /// Depth slices, exponentially distributed between the near and far plane
+    static constexpr int CLUSTER_GRID_Z = 24;
+    /// Uniform buffer binding of the CLUSTERS block
+    static constexpr unsigned int CLUSTERS_UBO_BINDING = 2;
+    /// Texture units the cluster texture buffers are bound to, the highest units a GL 3.3 fragment shader is guaranteed to have, so they don't collide with material textures
+    static constexpr int CLUSTER_GRID_TEXTURE_UNIT = 13;
+    static constexpr int CLUSTER_INDEX_TEXTURE_UNIT = 14;
+    static constexpr int CLUSTER_LIGHT_TEXTURE_UNIT = 15;
+    /// Texels of one light in the cluster light buffer (color + intensity, position + range, direction + cut off)
+    static constexpr unsigned int CLUSTER_LIGHT_TEXELS = 3;
+
     /// Two types of Light Limit Overflow actions
     enum LightOverflowAction {
         CANCEL_NEW,
@@ -85,12 +132,17 @@ public:
     /// Light overflow solution
     LightOverflowAction light_overflow_action;
 
+    /// Maximum amount of rendered point and spot lights together when clustered lighting is enabled
+    unsigned int MAX_NR_CLUSTERED_LIGHTS;
+
     /// Constructor of Light Manager
     /// @param MAX_NR_POINT_LIGHTS Max amount of rendered PointLights
     /// @param MAX_NR_DIRECTIONAL_LIGHTS Max amount of rendered DirectionalLights
     /// @param MAX_NR_SPOT_LIGHTS Max amount of rendered SpotLights
     /// @param light_overflow_action Light overflow solution
-    explicit Lights(unsigned int MAX_NR_POINT_LIGHTS = 16, unsigned int MAX_NR_DIRECTIONAL_LIGHTS = 3, unsigned int MAX_NR_SPOT_LIGHTS = 8, LightOverflowAction light_overflow_action = SORT_BY_PROXIMITY);
+    /// @param clustered_lighting If point and spot lights are culled per cluster, lifts the MAX_NR_POINT_LIGHTS and MAX_NR_SPOT_LIGHTS limits (both are replaced by MAX_NR_CLUSTERED_LIGHTS)
+    /// @param MAX_NR_CLUSTERED_LIGHTS Max amount of rendered point and spot lights together with clustered lighting
+    explicit Lights(unsigned int MAX_NR_POINT_LIGHTS = 16, unsigned int MAX_NR_DIRECTIONAL_LIGHTS = 3, unsigned int MAX_NR_SPOT_LIGHTS = 8, LightOverflowAction light_overflow_action = SORT_BY_PROXIMITY, bool clustered_lighting = false, unsigned int MAX_NR_CLUSTERED_LIGHTS = 1024);
 
     /// Destroys light UBO
     ~Lights();
@@ -101,6 +153,17 @@ public:
     /// Update central light system based on the Cameras position (for SORT_BY_PROXIMITY solution)
     void update(Position& camera_pos);
 
+    /// Builds per cluster light lists of point and spot lights for the camera and uploads them. Only does something with clustered lighting.
+    /// @param camera camera with an up to date VIEW matrix
+    /// @param width width of the render target in pixels
+    /// @param height height of the render target in pixels
+    void update_clusters(const Camera& camera, int width, int height);
+
+    /// If clustered lighting is enabled (shaders are generated with CLUSTERED_LIGHTING)
+    [[nodiscard]] bool is_clustered_lighting_enabled() const;
+    /// Amount of light indices that didn't fit into the cluster index buffer in the last update_clusters() call
+    [[nodiscard]] size_t get_dropped_cluster_indices() const;
+
     /// Add a PointLight to the Central Light System
     /// @note Engine does this automatically, no need to do so for the user
     /// @param ge_ref_id geRef ID of the PointLight entity
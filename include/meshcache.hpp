@@ -0,0 +1,94 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+#include "meshes.hpp"
+
+/// Read only view of a whole file. Memory mapped on POSIX systems, read into memory elsewhere.
+class MappedFile {
+    const std::byte* data = nullptr;
+    size_t size = 0;
+    /// mmap address, nullptr if the file is not mapped
+    void* mapping = nullptr;
+    /// file contents when mmap is not available
+    std::vector<std::byte> fallback{};
+    bool opened = false;
+public:
+    /// Opens and maps the file
+    /// @param path path to the file
+    explicit MappedFile(const std::filesystem::path& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    /// Unmaps the file
+    ~MappedFile();
+
+    /// If the file was opened successfully
+    [[nodiscard]] bool is_open() const;
+    /// Contents of the file
+    [[nodiscard]] std::span<const std::byte> get_data() const;
+};
+
+/// One mesh stored in a .gemesh file, spans point into the mapped file
+struct CachedMesh {
+    VertexLayout layout{};
+    std::span<const float> vertex_data{};
+    /// triangle indices of all levels of detail
+    std::span<const unsigned int> indices{};
+    /// levels of detail in indices, empty if there are none
+    std::span<const MeshLod> lods{};
+};
+
+/// Contents of a .gemesh file
+struct MeshCacheData {
+    /// hash of the source .obj file
+    uint64_t source_hash = 0;
+    /// load options the data was generated with (tangent generation etc.)
+    uint32_t options = 0;
+    bool has_uvs = false;
+    bool has_normals = false;
+    /// path to the .mtl library the material names refer to, empty if there is none
+    std::string mtl_path{};
+    /// hash of the .mtl library, tangent generation depends on it
+    uint64_t mtl_hash = 0;
+    /// material name of every material group (in .obj order)
+    std::vector<std::string> material_names{};
+    /// final interleaved vertex data and indices of every mesh
+    std::vector<CachedMesh> meshes{};
+};
+
+/// Versioned binary cache of parsed .obj files (.gemesh).
+/// Holds final interleaved vertex data, indices and levels of detail, so a cache hit skips the text parse, vertex deduplication, tangent generation and simplification.
+/// A file is valid only for the same source content hash, .mtl content hash, load options and format version.
+/// @note Data is stored in the byte order of the machine that wrote it, the file is treated as stale on a mismatch.
+/// @ingroup Resources
+class MeshCache {
+public:
+    /// Bumped on every change of the file layout, older files are regenerated
+    static constexpr uint32_t VERSION = 2;
+
+    /// 64-bit FNV-1a hash of bytes
+    [[nodiscard]] static uint64_t hash(std::span<const std::byte> data);
+    /// Hash of a file content, 0 if it can't be opened
+    [[nodiscard]] static uint64_t hash_file(const std::filesystem::path& path);
+
+    /// Reads a .gemesh file, validating it against the source
+    /// @param file the mapped .gemesh file, the returned spans point into it
+    /// @param source_hash hash of the current source .obj file
+    /// @param options load options the data has to be generated with
+    /// @param data parsed contents
+    /// @returns false if the file is missing, corrupted or stale
+    [[nodiscard]] static bool read(const MappedFile& file, uint64_t source_hash, uint32_t options, MeshCacheData& data);
+
+    /// Writes a .gemesh file (through a temporary file, so readers never see a partial file)
+    /// @param path destination
+    /// @param data contents, spans have to stay valid during the call
+    /// @returns false if the file couldn't be written
+    static bool write(const std::filesystem::path& path, const MeshCacheData& data);
+    /// Temporary file next to a cache file, unique per process and call, so concurrent writers of the same cache never share one
+    [[nodiscard]] static std::filesystem::path get_temp_path(const std::filesystem::path& path);
+};
+
+#endif //MESHCACHE_HPP
@@ -2,9 +2,146 @@
 #define MESHES_HPP
 
 #pragma once
+#include <cstdint>
 #include <vector>
+#include <span>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <filesystem>
 #include <memory>
 #include "shaders.hpp"
+#include "bounds.hpp"
+#include "meshoptimization.hpp"
+#include "threadpool.hpp"
+
+/// Per instance data of the instanced draw path, layout of the instance buffer.
+/// Attribute locations in the INSTANCED vertex shader: 4-7 transform, 8-10 normal matrix, 11 tint.
+struct InstanceData {
+    /// world matrix of the instance
+    glm::mat4 transform;
+    /// normal matrix of the instance (3 columns)
+    glm::vec3 normal_matrix[3];
+    /// color multiplied into the final fragment color
+    glm::vec4 tint;
+
+    /// first vertex attribute location used by instance data
+    static constexpr unsigned int FIRST_ATTRIBUTE_LOCATION = 4;
+
+    /// Sets up per instance attribute pointers of the currently bound VAO
+    /// @param instance_buffer OpenGL buffer holding InstanceData
+    /// @param first_instance index of the InstanceData read by the first instance of a draw
+    static void setup_vertex_attributes(unsigned int instance_buffer, size_t first_instance = 0);
+};
+
+/// How vertex attributes are stored in GPU vertex buffers. Mesh data on the CPU (and in .gemesh caches) stays in floats and is encoded on upload.
+/// Vertex shaders generated by Shaders::base_vertex_shader_gen decode the format of Meshes.vertex_format.
+struct VertexFormat {
+    enum UvEncoding : unsigned char {
+        /// 2 floats, 8 bytes
+        UV_FLOAT,
+        /// 2 half floats, 4 bytes, keeps tiling UVs outside [0, 1]
+        UV_HALF_FLOAT,
+        /// 2 normalized unsigned shorts, 4 bytes, UVs outside [0, 1] are clamped
+        UV_UNORM16,
+    };
+    UvEncoding uv_encoding = UV_FLOAT;
+    /// normals and tangents octahedral encoded into 2 normalized shorts each, 4 bytes instead of 12
+    bool octahedral_normals = false;
+    /// positions as normalized shorts in the bounding box of the mesh, 8 bytes instead of 12, dequantized by a per mesh matrix folded into the transform (see Mesh.get_dequantization_matrix())
+    bool quantized_positions = false;
+
+    /// 24 instead of 44 bytes per vertex with uvs, normals and tangents, 20 with quantized positions
+    static constexpr VertexFormat compact(const bool quantize_positions = false) {
+        return VertexFormat{UV_HALF_FLOAT, true, quantize_positions};
+    }
+    /// if every attribute is stored in floats, the vertex data is uploaded as is
+    [[nodiscard]] bool is_float() const;
+    /// #define lines selecting the matching vertex shader permutation
+    [[nodiscard]] std::string get_shader_defines() const;
+};
+
+/// Which attributes interleaved vertex data contains, in this order: position, uvs, normals, tangents, vertex colors.
+/// Meshes with the same layout can share vertex buffers (see GeometryArena).
+struct VertexLayout {
+    bool has_uvs = false;
+    bool has_normals = false;
+    bool has_tangents = false;
+    bool has_vertex_colors = false;
+    /// how the attributes are stored on the GPU, float vertex data on the CPU is always in floats
+    VertexFormat format{};
+
+    /// amount of floats of one vertex
+    [[nodiscard]] unsigned int get_floats_per_vertex() const;
+    /// amount of bytes of one vertex in a vertex buffer, in format
+    [[nodiscard]] unsigned int get_vertex_size() const;
+    /// amount of bytes of the position of one vertex in a vertex buffer, in format
+    [[nodiscard]] unsigned int get_position_size() const;
+    /// bit mask identifying the layout
+    [[nodiscard]] unsigned int get_key() const;
+    /// sets up vertex attribute pointers of the currently bound VAO, the vertex buffer has to be bound as GL_ARRAY_BUFFER
+    void setup_vertex_attributes() const;
+    /// Encodes interleaved float vertex data into format
+    /// @param vertex_data interleaved vertex data in floats
+    /// @param position_bounds bounding box the positions are quantized in (see VertexFormat.quantized_positions)
+    /// @param out output, encoded vertex buffer data
+    void encode(std::span<const float> vertex_data, const BoundingBox& position_bounds, std::vector<std::byte>& out) const;
+    /// sets up only the position attribute of the currently bound VAO, the buffer bound as GL_ARRAY_BUFFER holds interleaved vertices or only positions
+    /// @param position_stream if the bound buffer holds only positions (see extract_positions)
+    void setup_position_attribute(bool position_stream) const;
+    /// Copies the positions out of encoded vertex data into a position-only vertex stream
+    /// @param vertex_data interleaved vertex data encoded in format
+    /// @param out output, positions one after another
+    void extract_positions(std::span<const std::byte> vertex_data, std::vector<std::byte>& out) const;
+};
+
+class GeometryArena;
+
+/// Range of a GeometryArena used by one Mesh
+struct GeometryAllocation {
+    /// index of the first vertex in the arena vertex buffer (added to every index when drawing)
+    unsigned int base_vertex = 0;
+    /// amount of vertices
+    unsigned int vertex_count = 0;
+    /// index of the first index in the arena index buffer
+    unsigned int first_index = 0;
+    /// amount of indices
+    unsigned int index_count = 0;
+};
+
+/// One level of detail of a Mesh, a range of its indices. All levels index the same vertices (see generate_mesh_lods).
+struct MeshLod {
+    /// first index of the level, relative to the first index of the mesh
+    unsigned int first_index = 0;
+    /// amount of indices
+    unsigned int index_count = 0;
+    /// geometric error of the level relative to the full detail mesh, as a fraction of the largest bounding box dimension
+    float error = 0.0f;
+};
+
+
+class MappedFile;
+
+/// Final vertex data and indices of a mesh read from a file, produced on the CPU (on any thread) and uploaded by a Mesh constructor
+struct MeshFileData {
+    /// which attributes the vertices contain
+    VertexLayout layout{};
+    /// interleaved vertex data, points into owned_vertex_data or into cache_file
+    std::span<const float> vertex_data{};
+    /// triangle indices of all levels of detail one after another, points into owned_indices or into cache_file
+    std::span<const unsigned int> indices{};
+    /// levels of detail in indices, empty if indices hold only the full detail mesh
+    std::vector<MeshLod> lods{};
+    std::vector<float> owned_vertex_data{};
+    std::vector<unsigned int> owned_indices{};
+    /// mapped .gemesh file the data was read from, nullptr if it was parsed
+    std::unique_ptr<MappedFile> cache_file;
+
+    MeshFileData();
+    MeshFileData(MeshFileData&&) noexcept;
+    MeshFileData& operator=(MeshFileData&&) noexcept;
+    ~MeshFileData();
+};
 
 
 /// @brief Represents a mesh resource on the GPU.
@@ -14,25 +151,96 @@ class Mesh {
     /// loads mesh data to the GPU and creates Buffers
     /// @param vertex_data list of floats containing all the vertice data by N float
     /// @param indices triangle definition using indexes that reference vertex_data
-    /// @param has_uvs data contains uvs
-    /// @param has_normals data contains normals
-    /// @param has_tangents data contains tangent data
     /// @param has_vertex_colors data contains vertex colors
-    void load_mesh_to_gpu(const std::vector<float>* vertex_data, const std::vector<unsigned int>* indices, bool has_uvs, bool has_normals, bool has_tangents, bool has_vertex_colors = false);
+    /// @param lods levels of detail in indices, empty if indices hold only the full detail mesh
+    /// @note has_uvs, has_normals and has_tangents have to be set before, they define the layout of vertex_data
+    void load_mesh_to_gpu(std::span<const float> vertex_data, std::span<const unsigned int> indices, bool has_vertex_colors = false, std::span<const MeshLod> lods = {});
     bool has_uvs = false;
     bool has_normals = false;
     bool has_tangents = false;
+    bool has_vertex_colors = false;
+    /// how the vertex buffer stores the attributes, Meshes.vertex_format at load time
+    VertexFormat vertex_format{};
+    /// maps quantized positions back into the local space of the mesh, identity if positions aren't quantized
+    glm::mat4 dequantization_matrix{1.0f};
+    /// Unique mesh id, assigned on load
+    unsigned int id = -1;
 
     unsigned int vertex_buffer_object = 0;
     unsigned int vertex_array_object = 0;
     unsigned int element_buffer_object = 0;
+    /// VAO with the per instance attributes of the instanced draw path, created on first use
+    unsigned int instanced_vertex_array_object = 0;
+    /// instance buffer the instanced VAO reads from
+    unsigned int instanced_vao_instance_buffer = 0;
+    /// buffer holding only the positions, 0 if the mesh has none (see Meshes.position_streams)
+    unsigned int position_buffer_object = 0;
+    /// VAO with only positions and the per instance attributes, used by depth only draws, created on first use
+    unsigned int depth_vertex_array_object = 0;
+    /// instance buffer the depth VAO reads from
+    unsigned int depth_vao_instance_buffer = 0;
     /// amount of vertices in mesh
     int vertex_count = 0;
+    /// bytes of one index, meshes with less than 65536 vertices use 16-bit indices
+    unsigned int index_size = sizeof(unsigned int);
+    /// levels of detail, at least the full detail one, all in the index range of the mesh
+    std::vector<MeshLod> lods{};
+
+    /// shared buffers the mesh data lives in, nullptr if the mesh owns its buffers
+    std::shared_ptr<GeometryArena> arena = nullptr;
+    /// range of the arena (or of the own buffers) holding the mesh data
+    GeometryAllocation allocation{};
+    /// if the mesh is placed into a GeometryArena on load
+    bool use_geometry_arena = false;
+
+    /// local space bounding box, computed from vertex data at load time
+    BoundingBox bounding_box{};
+    /// local space bounding sphere, computed from vertex data at load time
+    BoundingSphere bounding_sphere{};
+    /// computes bounding volumes from interleaved vertex data (position first)
+    void compute_bounds(std::span<const float> vertex_data);
 public:
+    /// getter for read-only attribute id
+    [[nodiscard]] unsigned int get_id() const;
+    /// getter for the local space bounding box
+    [[nodiscard]] const BoundingBox& get_bounding_box() const;
+    /// getter for the local space bounding sphere
+    [[nodiscard]] const BoundingSphere& get_bounding_sphere() const;
     /// getter for read-only vertex_buffer_object variable
+    /// @note meshes in a GeometryArena return the VAO of the arena, draw them with get_first_index() and get_base_vertex()
     [[nodiscard]] unsigned int get_vertex_array_object() const;
+    /// Returns a VAO that reads mesh data and per instance data (InstanceData) from the instance buffer, created on first use
+    /// @param instance_buffer OpenGL buffer holding InstanceData
+    [[nodiscard]] unsigned int get_instanced_vertex_array_object(unsigned int instance_buffer);
+    /// Returns a VAO that reads only positions (from the position-only stream if the mesh has one) and per instance data (InstanceData), created on first use
+    /// @param instance_buffer OpenGL buffer holding InstanceData
+    [[nodiscard]] unsigned int get_depth_vertex_array_object(unsigned int instance_buffer);
     /// getter for read-only vertex count variable
     [[nodiscard]] int get_vertex_count() const;
+    /// amount of levels of detail, 1 if the mesh has only the full detail one
+    [[nodiscard]] unsigned int get_lod_count() const;
+    /// a level of detail, levels past the last one return the last one
+    /// @note level 0 is the full detail mesh (get_vertex_count() indices from get_first_index())
+    [[nodiscard]] const MeshLod& get_lod(unsigned int level) const;
+    /// index of the first index of the mesh in the bound index buffer
+    [[nodiscard]] unsigned int get_first_index() const;
+    /// OpenGL type of the indices, GL_UNSIGNED_SHORT for meshes with less than 65536 vertices, GL_UNSIGNED_INT otherwise
+    [[nodiscard]] unsigned int get_index_type() const;
+    /// bytes of one index (2 or 4)
+    [[nodiscard]] unsigned int get_index_size() const;
+    /// byte offset of the first index of a level of detail in the bound index buffer, the indices parameter of glDrawElements calls
+    /// @param level level of detail of this mesh (see get_lod())
+    [[nodiscard]] const void* get_index_offset(const MeshLod& level) const;
+    /// value added to indices of the mesh when drawing (glDrawElementsBaseVertex)
+    [[nodiscard]] int get_base_vertex() const;
+    /// getter for the arena the mesh data lives in, nullptr if the mesh owns its buffers
+    [[nodiscard]] GeometryArena* get_geometry_arena() const;
+    /// getter for the vertex layout of the mesh data, including the format of its vertex buffer
+    [[nodiscard]] VertexLayout get_vertex_layout() const;
+    /// if the positions in the vertex buffer are quantized and the transform of the mesh has to be multiplied by get_dequantization_matrix()
+    [[nodiscard]] bool has_quantized_positions() const;
+    /// matrix mapping quantized positions into the local space of the mesh, identity if positions aren't quantized
+    [[nodiscard]] const glm::mat4& get_dequantization_matrix() const;
 
     /// Allocates Mesh to GPU based on mesh data
     /// @param vertices list of floats containing all the vertice data by N float
@@ -40,11 +248,31 @@ public:
     /// @param has_uvs has uvs
     /// @param has_normals has normals
     /// @param has_vertex_colors has vertex colors
-    Mesh(const std::vector<float>* vertices, const std::vector<unsigned int>* indices, bool has_uvs = true, bool has_normals = true, bool has_tangents = false, bool has_vertex_colors = false);
-    /// Allocates Mesh to GPU from .obj file
+    /// @param use_geometry_arena place the mesh into a GeometryArena shared with meshes of the same vertex layout instead of own buffers
+    Mesh(const std::vector<float>* vertices, const std::vector<unsigned int>* indices, bool has_uvs = true, bool has_normals = true, bool has_tangents = false, bool has_vertex_colors = false, bool use_geometry_arena = false);
+    /// Allocates Mesh to GPU from final interleaved vertex data (e.g. from a MeshCache)
+    /// @param vertices interleaved vertex data in the layout
+    /// @param indices triangle definition using indexes that reference vertex_data
+    /// @param layout which attributes vertices contain
+    /// @param use_geometry_arena place the mesh into a GeometryArena shared with meshes of the same vertex layout instead of own buffers
+    /// @param lods levels of detail in indices (see generate_mesh_lods), empty if indices hold only the full detail mesh
+    Mesh(std::span<const float> vertices, std::span<const unsigned int> indices, const VertexLayout& layout, bool use_geometry_arena = false, std::span<const MeshLod> lods = {});
+    /// Allocates Mesh to GPU from .obj file, the parsed data is cached in a .gemesh file (see MeshCache)
     /// @param file_path path to a .obj file relative from .exe
     /// @param generate_tangents if tangents need to be generated and added to mesh data, say yes if you plan on using HEIGHT or NORMAL MAPS in FRAGMENT SHADER.
+    /// @note Loads a new copy every time, use ge.resources.load_mesh() to share one instance of the same file.
     explicit Mesh(const char* file_path, bool generate_tangents = false);
+    /// Allocates Mesh to GPU from data read by read_file()
+    /// @param data mesh data
+    /// @param use_geometry_arena place the mesh into a GeometryArena shared with meshes of the same vertex layout instead of own buffers
+    explicit Mesh(const MeshFileData& data, bool use_geometry_arena = false);
+
+    /// Reads an .obj file into final mesh data with levels of detail (from the .gemesh cache if fresh, writes the cache otherwise), no OpenGL calls so it may run on a worker thread
+    /// @param file_path path to a .obj file relative from .exe
+    /// @param generate_tangents if tangents are generated
+    /// @param data output mesh data
+    /// @returns false if the file produced no triangles
+    static bool read_file(const char* file_path, bool generate_tangents, MeshFileData& data);
 
     /// getter for read-only has_uvs parameter
     [[nodiscard]] bool does_have_uvs() const;
@@ -58,12 +286,21 @@ public:
 
 /// Model contain N meshes and N materials, represents a multicolored 3D model.
 /// @ingroup Resources
+struct ModelFileData;
+
 class Model {
+    friend class Resources;
     std::vector<std::shared_ptr<Mesh>> meshes;
     std::vector<std::shared_ptr<Material>> materials;
 
     bool has_uvs = false;
     bool has_normals = false;
+
+    /// local space bounding box of all meshes
+    BoundingBox bounding_box{};
+    /// local space bounding sphere of all meshes
+    BoundingSphere bounding_sphere{};
+
 public:
     /// @brief 3 ways to deal with Tangents when parsing a model
     /// AUTO_GENERATE - will handle decisions for you, if tangents are needed the will generated otherwise not
@@ -74,6 +311,29 @@ public:
         FORCE_GENERATE_ALL,
         FORCE_NO_GENERATION
     };
+private:
+    /// Empty model, filled step by step by Resources::load_model_async
+    Model() = default;
+    /// Parses the .mtl library and picks the material of every material group
+    /// @param async_textures textures are loaded through Resources::load_texture_async
+    void load_materials(const std::string& mtl_path, const std::vector<std::string>& material_names, const TangentAction& action, bool async_textures = false);
+    /// Adds a mesh and grows the bounding volumes
+    void add_mesh(const std::shared_ptr<Mesh>& mesh);
+
+    // LOADING STEPS, read_file and build_meshes make no OpenGL calls and may run on worker threads
+
+    /// Reads the .gemesh cache if fresh, otherwise parses the .obj file
+    /// @returns false if the file has no material groups
+    static bool read_file(const char* file_path, const TangentAction& action, ModelFileData& data);
+    /// Decides which material groups get tangents, depends on the loaded materials
+    void pick_tangent_groups(ModelFileData& data) const;
+    /// Turns parsed material groups into final mesh data and writes the .gemesh cache, does nothing for data read from the cache
+    static void build_meshes(ModelFileData& data);
+    /// Uploads the final mesh data
+    void create_meshes(const ModelFileData& data, bool use_geometry_arena);
+    /// Runs the loading steps after read_file() at once, on the main thread
+    void load(ModelFileData& data, bool use_geometry_arena);
+public:
     /// a material by index getter, because list of pointers is read only
     /// @param index index
     [[nodiscard]] std::shared_ptr<Material> get_material(size_t index) const;
@@ -89,7 +349,45 @@ public:
     /// getter for read-only has_normals
     bool get_has_normals() const;
 
-    explicit Model(const char* file_path, const TangentAction& action = AUTO_GENERATE);
+    /// getter for the local space bounding box of the whole model
+    [[nodiscard]] const BoundingBox& get_bounding_box() const;
+    /// getter for the local space bounding sphere of the whole model
+    [[nodiscard]] const BoundingSphere& get_bounding_sphere() const;
+
+    /// Parses an .obj file, every material group becomes a Mesh. The parsed data is cached in a .gemesh file (see MeshCache)
+    /// @param file_path path to a .obj file relative from .exe
+    /// @param action how tangents are handled
+    /// @param use_geometry_arena place meshes into shared GeometryArenas, so they can be drawn without VAO switches
+    /// @note Loads a new copy every time, use ge.resources.load_model() to share one instance of the same file.
+    explicit Model(const char* file_path, const TangentAction& action = AUTO_GENERATE, bool use_geometry_arena = true);
+};
+
+/// Intermediate state of loading a Model from a file
+struct ModelFileData {
+    std::string file_path{};
+    Model::TangentAction action = Model::AUTO_GENERATE;
+    /// hash of the source .obj file, 0 when the cache is disabled
+    uint64_t source_hash = 0;
+    /// if meshes were read from the .gemesh cache
+    bool from_cache = false;
+    bool has_uvs = false;
+    bool has_normals = false;
+    std::string mtl_path{};
+    std::vector<std::string> material_names{};
+    /// parsed .obj data, empty when read from the cache
+    std::vector<float> vertex_data_vec[3];
+    std::vector<std::vector<size_t>> vertex_groups{};
+    /// if a material group gets tangents (see Model::pick_tangent_groups)
+    std::vector<char> group_tangents{};
+    /// final data of every mesh
+    std::vector<MeshFileData> meshes{};
+    /// mapped .gemesh file mesh data points into
+    std::unique_ptr<MappedFile> cache_file;
+
+    ModelFileData();
+    ModelFileData(ModelFileData&&) noexcept;
+    ModelFileData& operator=(ModelFileData&&) noexcept;
+    ~ModelFileData();
 };
 
 /// A default Mesh houser
@@ -102,7 +400,54 @@ class Meshes {
     std::shared_ptr<Mesh> tangent_plane;
     std::shared_ptr<Mesh> tangent_sphere;
     std::shared_ptr<Mesh> tangent_cube;
+
+    /// GeometryArenas by VertexLayout key, position stream and index size
+    std::map<unsigned int, std::vector<std::shared_ptr<GeometryArena>>> geometry_arenas{};
+    /// AUTO increment Mesh ID value
+    unsigned int next_mesh_id = 0;
 public:
+    /// Next ID mesh getter
+    unsigned int get_mesh_identificator();
+
+    /// If parsed .obj files are cached in binary .gemesh files and loaded from them when fresh
+    bool mesh_cache_enabled = true;
+    /// Amount of levels of detail generated for meshes read from files, including the full detail one, 1 = none (see generate_mesh_lods)
+    unsigned int lod_levels = 4;
+    /// Index count of a level of detail relative to the previous level
+    float lod_reduction = 0.5f;
+    /// Largest geometric error of a level of detail, as a fraction of the largest bounding box dimension of the mesh
+    float lod_max_error = 0.05f;
+    /// Appends levels of detail to final mesh data read from a file, does nothing if lod_levels is 1 or the mesh is too small, no OpenGL calls
+    /// @param data mesh data owning its vertices and indices
+    void generate_lods(MeshFileData& data) const;
+    /// If meshes read from files get their triangles reordered for the vertex cache and overdraw and their vertices for fetch locality (see meshoptimization.hpp)
+    bool optimize_meshes = true;
+    /// Allowed ACMR growth of the triangle clusters reordered against overdraw (see optimize_overdraw)
+    float overdraw_threshold = 1.05f;
+    /// Cooks final mesh data read from a file: optimizes the full detail triangle order, generates levels of detail, optimizes their triangle order and reorders vertices, no OpenGL calls
+    /// @param data mesh data owning its vertices and indices
+    /// @returns vertex cache stats of the full detail mesh before and after the optimization
+    std::pair<VertexCacheStats, VertexCacheStats> process_mesh_data(MeshFileData& data) const;
+    /// If meshes loaded from now on also get a position-only vertex stream, which depth only draws (the depth pre-pass of ForwardOpaque3DPass) read instead of the interleaved vertices
+    /// @note costs 12 more bytes per vertex (8 with quantized positions), meshes without a stream are drawn from the positions of the interleaved vertices
+    bool position_streams = false;
+    /// How Meshes store vertex attributes on the GPU, set by EngineSettings.vertex_format
+    /// @warning meshes and shaders created before a change keep the old format, a material only draws meshes of the format its vertex shader was generated for
+    VertexFormat vertex_format{};
+    /// Bits of the .gemesh load options identifying the LOD and optimization settings, a cache written with other settings is stale
+    [[nodiscard]] uint32_t get_processing_cache_options() const;
+
+    /// Directory of .gemesh files, if empty they are written next to the source file
+    std::filesystem::path mesh_cache_directory{};
+    /// Returns where the .gemesh file of a source file is stored
+    /// @param source_path path to the source .obj file
+    [[nodiscard]] std::filesystem::path get_mesh_cache_path(const char* source_path) const;
+    /// .obj files of at least this many bytes are parsed in parallel chunks on Engine.workers, 0 = always serial
+    size_t parallel_parsing_threshold = 4 << 20;
+    /// If a source file is big enough to be parsed in parallel (see parallel_parsing_threshold)
+    /// @param source_path path to the source .obj file
+    [[nodiscard]] bool should_parse_in_parallel(const char* source_path) const;
+
     /// default plane
     /// @param with_tangents if the Mesh has tangent data, meaning that normal or bump maps can be applied
     [[nodiscard]] std::shared_ptr<Mesh> get_plane(bool with_tangents = false) const;
@@ -119,6 +464,58 @@ public:
     /// unload default Meshes form GPU
     void unload_base_meshes();
 
+    /// Places mesh data into the first GeometryArena of the layout with enough free space, creates a new arena if none has
+    /// @param layout vertex layout of the data
+    /// @param index_size bytes of one index (2 or 4), arenas hold indices of one size
+    /// @param vertex_data interleaved vertex data encoded in the format of the layout (see VertexLayout.encode)
+    /// @param index_data triangle indices of index_size bytes, relative to the first vertex of vertex_data
+    /// @param allocation where the data was placed
+    /// @returns the arena or nullptr on failure
+    /// @note arenas created while position_streams is on keep a position-only stream
+    std::shared_ptr<GeometryArena> allocate_geometry(const VertexLayout& layout, unsigned int index_size, std::span<const std::byte> vertex_data, std::span<const std::byte> index_data, GeometryAllocation& allocation);
+
     Meshes() = default;
 };
+
+/// Parses an .mtl library, every call creates new Materials (Resources::load_mtl_materials shares them)
+/// @param file_path .mtl file path
+/// @param has_normals if the meshes using the materials have normals
+/// @param has_uvs if the meshes using the materials have uvs
+/// @param tangent_maps_action how normal and bump maps are handled
+/// @param async_textures textures are decoded on worker threads, materials bind placeholders until they are uploaded (see Resources)
+/// @returns [material name : material]
+std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const char* file_path, bool has_normals, bool has_uvs, const Model::TangentAction& tangent_maps_action, bool async_textures = false);
+
+/// Smallest part of an .obj file given to one worker by parse_obj_file_parallel
+constexpr size_t OBJ_PARALLEL_MIN_CHUNK_SIZE = 256 << 10;
+
+/// Parses an .obj file line by line, every usemtl starts a new vertex group. Faces before the first usemtl are skipped.
+/// @param file_path path to the .obj file
+/// @param vertex_data_vec output v, vt and vn data
+/// @param vertex_groups output face indices (v/vt/vn, only the ones present) per usemtl group, quads are split into triangles
+/// @param material_names output usemtl name per vertex group
+/// @param mtl_path output path of the last mtllib, relative from .exe
+/// @param has_uvs output if the file has vt data
+/// @param has_normals output if the file has vn data
+void parse_obj_file(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<std::vector<size_t>>& vertex_groups, std::vector<std::string>& material_names, std::string& mtl_path, bool &has_uvs, bool &has_normals);
+/// Parses an .obj file line by line as one vertex group, ignoring materials
+void parse_obj_file(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<size_t>& vertex_group, bool &has_uvs, bool &has_normals);
+/// Same output as parse_obj_file, but the file is split at line boundaries into chunks tokenized on worker threads and merged in file order
+/// @param workers thread pool doing the work, the calling thread helps
+void parse_obj_file_parallel(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<std::vector<size_t>>& vertex_groups, std::vector<std::string>& material_names, std::string& mtl_path, bool &has_uvs, bool &has_normals, ThreadPool& workers);
+/// Same output as parse_obj_file, but the file is split at line boundaries into chunks tokenized on worker threads and merged in file order
+/// @param workers thread pool doing the work, the calling thread helps
+void parse_obj_file_parallel(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<size_t>& vertex_group, bool &has_uvs, bool &has_normals, ThreadPool& workers);
+/// Welds parsed v/vt/vn triplets into unique interleaved vertices and triangle indices
+/// @param vertex_data_vec v, vt and vn data from parse_obj_file
+/// @param vertex_triplets face indices of one vertex group
+/// @param tangents one tangent per face (calculate_tangents) or empty
+/// @param has_normals if the triplets contain normal indices
+/// @param has_texture_cords if the triplets contain uv indices
+/// @param out_vertex_data output interleaved vertex data
+/// @param out_indices output triangle indices
+void construct_mesh_data_from_parsed_obj_data(const std::vector<float> (&vertex_data_vec)[3], const std::vector<size_t>& vertex_triplets, const std::vector<float>& tangents, bool has_normals, bool has_texture_cords, std::vector<float>& out_vertex_data, std::vector<unsigned int>& out_indices);
+/// Calculates one tangent per face of a vertex group, the group has to have uvs
+/// @returns 3 floats per face
+std::vector<float> calculate_tangents(const std::vector<float> (&vertex_data_vec)[3], const std::vector<size_t>& vertex_group);
 #endif //MESHES_HPP
@@ -0,0 +1,50 @@
+#ifndef MESHOPTIMIZATION_HPP
+#define MESHOPTIMIZATION_HPP
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/// Size of the simulated post-transform vertex cache (FIFO) used by analyze_vertex_cache
+constexpr unsigned int VERTEX_CACHE_ANALYSIS_SIZE = 16;
+
+/// Post-transform vertex cache efficiency of an index buffer, can be summed over meshes
+struct VertexCacheStats {
+    size_t triangle_count = 0;
+    /// amount of distinct vertices the indices reference
+    size_t vertex_count = 0;
+    /// vertices the simulated cache had to transform
+    size_t cache_misses = 0;
+
+    /// Average cache miss ratio, transformed vertices per triangle (0.5 - 3, lower is better)
+    [[nodiscard]] float get_acmr() const;
+    /// Average transform to vertex ratio, transformed vertices per distinct vertex (1 is optimal)
+    [[nodiscard]] float get_atvr() const;
+    VertexCacheStats& operator+=(const VertexCacheStats& other);
+};
+
+/// Simulates a FIFO post-transform vertex cache over triangle indices
+/// @param indices triangle indices
+/// @param vertex_count amount of vertices the indices point into
+/// @param cache_size amount of cached vertices
+[[nodiscard]] VertexCacheStats analyze_vertex_cache(std::span<const unsigned int> indices, size_t vertex_count, unsigned int cache_size = VERTEX_CACHE_ANALYSIS_SIZE);
+
+/// Reorders triangles so vertices are reused while still in the post-transform cache (Forsyth's linear-speed vertex cache optimization)
+/// @param indices triangle indices, reordered in place
+/// @param vertex_count amount of vertices the indices point into
+void optimize_vertex_cache(std::span<unsigned int> indices, size_t vertex_count);
+
+/// Reorders clusters of a cache optimized triangle order, so outward facing clusters are drawn first and hide the ones behind them (Tipsify-style)
+/// Clusters are cut where the cache restarts and, within a cluster, where the cache efficiency stays within the threshold, so the cache gains mostly stay.
+/// @param indices triangle indices from optimize_vertex_cache, reordered in place
+/// @param vertex_data interleaved vertex data, position first
+/// @param floats_per_vertex amount of floats of one vertex
+/// @param threshold allowed ACMR growth of a cut cluster (e.g. 1.05 = 5 %)
+void optimize_overdraw(std::span<unsigned int> indices, std::span<const float> vertex_data, unsigned int floats_per_vertex, float threshold = 1.05f);
+
+/// Reorders vertices in the order the indices first use them, so vertex fetches read memory mostly forward. Unused vertices are dropped.
+/// @param vertex_data interleaved vertex data, reordered in place and shrunk to the used vertices
+/// @param floats_per_vertex amount of floats of one vertex
+/// @param indices indices of all ranges drawing the vertices (e.g. all levels of detail), remapped in place
+void optimize_vertex_fetch(std::vector<float>& vertex_data, unsigned int floats_per_vertex, std::span<unsigned int> indices);
+
+#endif //MESHOPTIMIZATION_HPP
@@ -0,0 +1,35 @@
+#ifndef MESHSIMPLIFIER_HPP
+#define MESHSIMPLIFIER_HPP
+#include <span>
+#include <vector>
+#include "meshes.hpp"
+
+/// Smallest amount of triangles a generated level of detail may have, smaller meshes get no levels
+constexpr size_t MIN_LOD_TRIANGLES = 16;
+
+/// Simplifies a triangle mesh by quadric error edge collapses (Garland & Heckbert).
+/// Vertices are only collapsed onto other existing vertices, so the result indexes the same vertex data and needs no new vertex buffer.
+/// Vertices split by attributes (uv seams, hard normals) stay in place, open borders only collapse along themselves, collapses flipping a triangle are rejected.
+/// No OpenGL calls, may run on a worker thread.
+/// @param vertex_data interleaved vertex data, position first
+/// @param floats_per_vertex amount of floats of one vertex
+/// @param indices triangle indices
+/// @param target_index_count amount of indices to reach, the result may stay above it if the error limit or the locked vertices stop the collapses
+/// @param max_error largest allowed error, as a fraction of the largest bounding box dimension
+/// @param out_error output, error of the result as a fraction of the largest bounding box dimension (may be nullptr)
+/// @returns simplified triangle indices
+std::vector<unsigned int> simplify_mesh(std::span<const float> vertex_data, unsigned int floats_per_vertex, std::span<const unsigned int> indices, size_t target_index_count, float max_error, float* out_error = nullptr);
+
+/// Builds a chain of levels of detail, every level simplified from the previous one by simplify_mesh.
+/// The chain stops early when a level would have less than MIN_LOD_TRIANGLES triangles or when simplification stops making progress.
+/// @param vertex_data interleaved vertex data, position first
+/// @param floats_per_vertex amount of floats of one vertex
+/// @param indices triangle indices of the full detail mesh
+/// @param max_levels amount of levels including the full detail one
+/// @param reduction index count of a level relative to the previous level (e.g. 0.5)
+/// @param max_error largest error of a level, as a fraction of the largest bounding box dimension
+/// @param out_indices output, indices of all levels one after another, the full detail ones first
+/// @param out_lods output, one MeshLod per level
+void generate_mesh_lods(std::span<const float> vertex_data, unsigned int floats_per_vertex, std::span<const unsigned int> indices, unsigned int max_levels, float reduction, float max_error, std::vector<unsigned int>& out_indices, std::vector<MeshLod>& out_lods);
+
+#endif //MESHSIMPLIFIER_HPP
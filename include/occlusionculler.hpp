@@ -0,0 +1,112 @@
+#ifndef OCCLUSIONCULLER_HPP
+#define OCCLUSIONCULLER_HPP
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.hpp"
+
+struct MeshFileData;
+
+/// Triangle mesh kept on the CPU and drawn into the depth buffer of an OcclusionCuller.
+/// Usually a simplified version of a rendered Mesh (walls, buildings, terrain), it has to lie inside the rendered geometry, otherwise it hides entities that are visible.
+/// @ingroup Resources
+class OccluderMesh {
+    /// vertex positions
+    std::vector<glm::vec3> positions{};
+    /// triangle indices into positions
+    std::vector<unsigned int> indices{};
+    /// box around positions
+    BoundingBox bounding_box{};
+public:
+    OccluderMesh() = default;
+    /// Constructs an occluder from positions and triangle indices
+    OccluderMesh(std::vector<glm::vec3> positions, std::vector<unsigned int> indices);
+    /// Constructs an occluder from interleaved vertex data
+    /// @param vertex_data interleaved vertex data, position first
+    /// @param floats_per_vertex amount of floats of one vertex
+    /// @param indices triangle indices
+    OccluderMesh(std::span<const float> vertex_data, unsigned int floats_per_vertex, std::span<const unsigned int> indices);
+    /// Constructs an occluder from the data a Mesh is created from (see Mesh::read_file)
+    /// @param data mesh data
+    /// @param lod level of detail the triangles are taken from, coarser levels may stick out of the full detail mesh
+    explicit OccluderMesh(const MeshFileData& data, unsigned int lod = 0);
+
+    /// Constructs a closed box occluder, a cheap stand-in for walls and buildings
+    /// @param box the box, in the local space of the entity
+    static OccluderMesh box(const BoundingBox& box);
+
+    [[nodiscard]] const std::vector<glm::vec3>& get_positions() const;
+    [[nodiscard]] const std::vector<unsigned int>& get_indices() const;
+    [[nodiscard]] const BoundingBox& get_bounding_box() const;
+    [[nodiscard]] size_t get_triangle_count() const;
+};
+
+/// Software hierarchical depth buffer occlusion culling, runs only on the CPU.
+/// Every frame designated OccluderMeshes are rasterized (SSE2 when available) into a low resolution depth buffer,
+/// a min/max depth hierarchy is built over it and bounding boxes are tested against the hierarchy.
+/// A box is occluded when its nearest point is behind the farthest occluder depth of every texel its screen rectangle covers.
+/// @note not fully conservative: a pixel is covered when its center is inside an occluder triangle, so an occluder can hide up to half a
+/// depth buffer pixel past its silhouette (keep OccluderMeshes that far inside the rendered geometry, or raise the resolution where it matters).
+/// Depth is conservative, covered pixels get the farthest occluder depth over the pixel, occluder triangles crossing the near plane are skipped
+/// and boxes crossing it are visible.
+class OcclusionCuller {
+    /// one level of the depth hierarchy, level 0 is the rasterized depth buffer
+    struct HierarchyLevel {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        /// nearest occluder depth of the texels covered by a texel, empty on level 0 (min and max are the same there)
+        std::vector<float> min_depth{};
+        /// farthest occluder depth of the texels covered by a texel
+        std::vector<float> max_depth{};
+    };
+    /// levels of the hierarchy, each halves the resolution of the previous one down to 1 x 1
+    std::vector<HierarchyLevel> levels{};
+    /// PROJECTION * VIEW matrix of the current frame
+    glm::mat4 view_projection{1.0f};
+    /// occluder triangles rasterized since begin_frame()
+    size_t rasterized_triangle_count = 0;
+    /// transformed vertices of the rasterized occluder, x and y in pixels, z depth in [0, 1] (reused between calls)
+    std::vector<glm::vec4> screen_vertices{};
+
+    /// Rasterizes one screen space triangle into level 0, pixels with their center inside get the farthest depth of the triangle over the pixel, the nearest depth of all triangles is kept
+    void rasterize_triangle(const glm::vec4& v0, glm::vec4 v1, glm::vec4 v2);
+    /// Tests depth against the texels of a level covering a rectangle of level 0 pixels, refining texels that can't decide into the level below
+    [[nodiscard]] bool is_region_occluded(size_t level, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, float depth) const;
+public:
+    /// resolution used unless the constructor or resize() sets another
+    static constexpr unsigned int DEFAULT_WIDTH = 256;
+    static constexpr unsigned int DEFAULT_HEIGHT = 128;
+
+    /// Constructs the culler
+    /// @param width depth buffer width, rounded up to a multiple of 4
+    /// @param height depth buffer height
+    explicit OcclusionCuller(unsigned int width = DEFAULT_WIDTH, unsigned int height = DEFAULT_HEIGHT);
+    /// Changes the resolution of the depth buffer, the aspect ratio of the camera keeps the pixels square
+    /// @param width depth buffer width, rounded up to a multiple of 4
+    /// @param height depth buffer height
+    void resize(unsigned int width, unsigned int height);
+
+    /// Clears the depth buffer and sets the camera occluders are rasterized and boxes tested with
+    /// @param view_projection PROJECTION * VIEW matrix of the camera
+    void begin_frame(const glm::mat4& view_projection);
+    /// Rasterizes an occluder into the depth buffer, both faces of the triangles are drawn
+    /// @param occluder occluder triangles
+    /// @param world_matrix transformation of the occluder into world space
+    void rasterize(const OccluderMesh& occluder, const glm::mat4& world_matrix);
+    /// Builds the min/max hierarchy over the depth buffer, call after all occluders are rasterized and before testing
+    void build_hierarchy();
+
+    /// If a world space box is hidden behind the rasterized occluders
+    /// @param box world space bounding box
+    /// @returns false if any part of the box may be visible
+    [[nodiscard]] bool is_occluded(const BoundingBox& box) const;
+
+    [[nodiscard]] unsigned int get_width() const;
+    [[nodiscard]] unsigned int get_height() const;
+    /// Depth buffer (level 0), row by row from the bottom of the screen, depth in [0, 1], 1 where there are no occluders
+    [[nodiscard]] std::span<const float> get_depth_buffer() const;
+    /// amount of occluder triangles rasterized since begin_frame()
+    [[nodiscard]] size_t get_rasterized_triangle_count() const;
+};
+
+#endif //OCCLUSIONCULLER_HPP
@@ -0,0 +1,149 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Frame profiler of the Engine (Engine.profiler).
+/// CPU zones are timed with a steady clock on any thread, GPU zones with OpenGL timestamp queries, which are read back one frame later, so the GPU is never waited for.
+/// Zones are placed with the GE_PROFILE_* macros, which compile to nothing unless the engine is built with -DGRAPHICENGINE_PROFILER=ON (defines GE_PROFILER).
+/// Captured frames are exported as Chrome trace JSON (open in chrome://tracing or ui.perfetto.dev).
+/// @note zone names have to outlive the profiler, use string literals
+class Profiler {
+public:
+    /// Thread ID GPU zones are exported under (CPU zones use ThreadPool::get_worker_index())
+    static constexpr unsigned int GPU_THREAD = 1000;
+
+    /// One finished zone
+    struct Event {
+        const char* name;
+        /// nanoseconds since the profiler was created
+        uint64_t start;
+        uint64_t duration;
+        unsigned int thread;
+    };
+private:
+    /// Amount of frames whose GPU zones are in flight, the oldest is read back when a new one starts
+    static constexpr size_t GPU_FRAME_COUNT = 2;
+
+    struct GpuZone {
+        const char* name;
+        /// index of the begin timestamp query in GpuFrame.queries, the end is the following one
+        size_t query;
+    };
+    struct GpuFrame {
+        std::vector<unsigned int> queries{};
+        size_t used_queries = 0;
+        /// index of the last issued query
+        size_t last_query = 0;
+        std::vector<GpuZone> zones{};
+        /// CPU and GPU time taken at the same moment, maps GPU timestamps onto the CPU timeline
+        uint64_t cpu_sync = 0;
+        int64_t gpu_sync = 0;
+        /// if the zones are added to the capture once read back
+        bool captured = false;
+    };
+
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    /// guards the CPU events, zones may end on worker threads
+    mutable std::mutex events_mutex{};
+    /// CPU events of the running frame
+    std::vector<Event> frame_events{};
+    /// CPU events of the last finished frame and GPU events of the one before
+    std::vector<Event> last_frame_events{};
+    std::vector<Event> captured_events{};
+    /// amount of frames that still get captured
+    unsigned int capture_frames_left = 0;
+    uint64_t frame_start = 0;
+
+    std::array<GpuFrame, GPU_FRAME_COUNT> gpu_frames{};
+    size_t current_gpu_frame = 0;
+    /// begin query indices of the open GPU zones
+    std::vector<size_t> open_gpu_zones{};
+    /// frames whose GPU zones were dropped because their timestamps weren't available in time
+    unsigned int dropped_gpu_frames = 0;
+
+    /// Reads back the timestamps of a GPU frame into last_frame_events (and the capture), drops the frame if the GPU isn't done with it yet
+    void resolve_gpu_frame(GpuFrame& frame);
+public:
+    /// If zones are recorded, turning it off skips the timing and the GPU queries
+    bool enabled = true;
+
+    Profiler() = default;
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    /// Deletes the GPU queries
+    ~Profiler();
+
+    /// Nanoseconds since the profiler was created
+    [[nodiscard]] uint64_t now() const;
+
+    /// Records a finished CPU zone of the calling thread (thread-safe)
+    void add_cpu_event(const char* name, uint64_t start, uint64_t end);
+    /// Starts a GPU zone, zones can be nested
+    /// @warning main thread only
+    void begin_gpu_zone(const char* name);
+    /// Ends the last started GPU zone
+    void end_gpu_zone();
+
+    /// Finishes the frame, called by Engine.send_to_window() after the buffer swap
+    void end_frame();
+
+    /// Starts capturing, the previous capture is discarded
+    /// @param frame_count amount of following frames that are captured
+    void capture(unsigned int frame_count);
+    /// If a capture still waits for frames (or their GPU zones)
+    [[nodiscard]] bool is_capturing() const;
+    /// Zones of the last frame, CPU zones of the last finished frame and GPU zones of the one before
+    [[nodiscard]] const std::vector<Event>& get_last_frame_events() const;
+    /// Amount of frames whose GPU zones were dropped, because the GPU was more than a frame behind
+    [[nodiscard]] unsigned int get_dropped_gpu_frames() const;
+    /// Writes the captured frames as a Chrome trace JSON file
+    /// @param file_path output file
+    /// @returns false if the file couldn't be written
+    bool write_chrome_trace(const char* file_path) const;
+};
+
+/// Times a scope on the CPU, see GE_PROFILE_ZONE
+class ProfileZone {
+    const char* name;
+    uint64_t start = 0;
+public:
+    explicit ProfileZone(const char* name);
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+    ~ProfileZone();
+};
+
+/// Times a scope on the CPU and on the GPU, see GE_PROFILE_GPU_ZONE
+class GpuProfileZone {
+    ProfileZone cpu_zone;
+    bool active;
+public:
+    explicit GpuProfileZone(const char* name);
+    GpuProfileZone(const GpuProfileZone&) = delete;
+    GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+    ~GpuProfileZone();
+};
+
+#define GE_PROFILE_CONCAT_INNER(a, b) a##b
+#define GE_PROFILE_CONCAT(a, b) GE_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef GE_PROFILER
+/// Times the rest of the scope on the CPU under a name (string literal)
+#define GE_PROFILE_ZONE(name) const ProfileZone GE_PROFILE_CONCAT(ge_profile_zone_, __LINE__){name}
+/// Times the rest of the scope on the CPU and the GPU under a name (string literal), main thread only
+#define GE_PROFILE_GPU_ZONE(name) const GpuProfileZone GE_PROFILE_CONCAT(ge_gpu_profile_zone_, __LINE__){name}
+/// Times the rest of the function on the CPU
+#define GE_PROFILE_FUNCTION() GE_PROFILE_ZONE(__func__)
+#else
+#define GE_PROFILE_ZONE(name) ((void)0)
+#define GE_PROFILE_GPU_ZONE(name) ((void)0)
+#define GE_PROFILE_FUNCTION() ((void)0)
+#endif
+
+#endif //PROFILER_HPP
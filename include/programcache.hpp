@@ -0,0 +1,42 @@
+#ifndef PROGRAMCACHE_HPP
+#define PROGRAMCACHE_HPP
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/// On-disk cache of linked ShaderProgram binaries (.gebin), see glGetProgramBinary.
+/// A binary is keyed by both expanded shader sources (including the injected #define header) and the driver vendor, renderer and version,
+/// so changing a shader, a light limit or the driver produces a new key. The driver may still reject a binary, then the program is compiled from source.
+/// @ingroup Resources
+class ProgramBinaryCache {
+public:
+    /// Bumped on every change of the file layout, older files are ignored
+    static constexpr uint32_t VERSION = 1;
+
+    /// If binaries are loaded and stored, set by the Engine (requires GLExtensions::program_binaries)
+    bool enabled = false;
+    /// Directory of .gebin files
+    std::filesystem::path directory{"engine/shader_cache"};
+
+    /// Cache key of a program
+    /// @param vertex_source expanded vertex shader source
+    /// @param fragment_source expanded fragment shader source
+    /// @warning requires a current OpenGL context (reads the driver strings)
+    [[nodiscard]] static uint64_t get_key(const std::string& vertex_source, const std::string& fragment_source);
+
+    /// Path of the .gebin file of a key
+    [[nodiscard]] std::filesystem::path get_path(uint64_t key) const;
+
+    /// Loads a cached binary into a program object
+    /// @param program OpenGL program id, nothing attached
+    /// @param key program key
+    /// @returns false if there is no valid file or the driver rejected the binary (the program is then left unlinked)
+    [[nodiscard]] bool load(unsigned int program, uint64_t key) const;
+
+    /// Stores the binary of a successfully linked program
+    /// @param program OpenGL program id, linked with GLExtensions::PROGRAM_BINARY_RETRIEVABLE_HINT
+    /// @param key program key
+    void save(unsigned int program, uint64_t key) const;
+};
+
+#endif //PROGRAMCACHE_HPP
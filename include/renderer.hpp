@@ -1,10 +1,38 @@
 #ifndef RENDERER_HPP
 #define RENDERER_HPP
 
+#include <array>
+#include <cstdint>
+#include <vector>
 #include "gereferences.hpp"
 #include "coordinates.h"
+#include "meshes.hpp"
+#include "geometryarena.hpp"
+#include "bounds.hpp"
+#include "renderqueue.hpp"
+#include "occlusionculler.hpp"
 
 class Camera;
+class MeshThing;
+
+/// GPU buffer that streams per frame data of draw calls (InstanceData, indirect draw commands).
+/// Instances are held by the Engine and shared by all passes, so every Mesh builds its instanced VAO only once.
+class StreamBuffer {
+    /// OpenGL buffer id, created on first use
+    unsigned int buffer = 0;
+    /// allocated size in bytes
+    size_t capacity = 0;
+public:
+    /// OpenGL buffer id getter, creates the buffer if needed
+    unsigned int get_id();
+    /// Uploads data, orphaning the previous contents so the driver doesn't have to wait for draws still reading them
+    /// @param target buffer target the buffer is bound to during the upload (unbound afterward)
+    /// @param data data to upload, placed at the start of the buffer
+    /// @param size size of data in bytes
+    void upload(unsigned int target, const void* data, size_t size);
+    /// Deletes the buffer from the GPU
+    ~StreamBuffer();
+};
 
 /// A base RenderPass method for polymorphism
 /// It's like this so that the Engine can hold these objects safely and call change_resolution() update methods based on what happens to the Window.
@@ -25,14 +53,109 @@ public:
     void render();
 };
 
+/// How much shading a depth pre-pass saved, counted by occlusion queries (GL_SAMPLES_PASSED)
+struct DepthPrepassStats {
+    /// samples that passed the depth test in the pre-pass, about what the color pass would shade without it
+    uint64_t depth_samples = 0;
+    /// samples shaded by the instanced draws of the color pass, the ones the pre-pass covers
+    uint64_t shaded_samples = 0;
+
+    /// samples the color pass didn't shade thanks to the pre-pass (overdraw eliminated), 0 if the color pass shaded more
+    [[nodiscard]] uint64_t get_eliminated_samples() const;
+};
+
 /// Standard forward opaque renderer
-/// Minimizes shader switching and uniform calls
+/// Minimizes shader switching and uniform calls, visible entities are ordered every frame by a RenderQueue
+/// MeshThings sharing a Mesh and a Material that has an instanced ShaderProgram variant are drawn with one instanced draw call.
+/// Instanced Meshes of one Material that live in the same GeometryArena are drawn with one multi draw call.
+/// With depth_prepass the depth of instanced entities is laid down first, so the color pass shades every pixel only once.
 class ForwardOpaque3DPass : public RenderPass {
+    /// Occlusion queries of one frame of the depth pre-pass
+    struct PrepassQueries {
+        /// counts samples of the pre-pass
+        unsigned int depth = 0;
+        /// count samples of the instanced draws of the color pass, one per material, grown when needed
+        std::vector<unsigned int> color{};
+        /// color queries issued in the frame
+        size_t color_count = 0;
+        /// if the queries were issued and their results not read yet
+        bool pending = false;
+    };
+    /// amount of frames the queries are kept for, results are read when the slot is reused, so the CPU doesn't wait for the GPU
+    static constexpr size_t PREPASS_QUERY_FRAME_COUNT = 2;
+
+    /// Visible MeshThings of the current frame sorted by state and depth (reused between frames)
+    RenderQueue render_queue{};
+    /// MeshThings of the current material bucket that will be drawn instanced (reused between frames)
+    std::vector<MeshThing*> instanced_batch{};
+    /// Instance data of the current instanced batch (reused between frames)
+    std::vector<InstanceData> instance_data{};
+    /// Indirect draw commands of one GeometryArena of the current instanced batch (reused between frames)
+    std::vector<DrawElementsIndirectCommand> draw_commands{};
+
+    /// view frustum of the camera for the current frame
+    Frustum frustum{};
+    /// how many entities were culled by the frustum last frame
+    unsigned int frustum_culled_count = 0;
+    /// how many entities were hidden behind occluders last frame
+    unsigned int occlusion_culled_count = 0;
+
+    /// pre-pass queries of the last frames, created on first use
+    std::array<PrepassQueries, PREPASS_QUERY_FRAME_COUNT> prepass_queries{};
+    /// slot of prepass_queries used by the next frame
+    size_t current_prepass_query = 0;
+    /// latest available pre-pass statistics
+    DepthPrepassStats prepass_stats{};
+
+    /// currently used ShaderProgram id
+    unsigned int current_sp = -1;
+    /// id of the Material which uniforms are currently applied
+    uint64_t current_mat_id = -1;
+
+    /// Switches ShaderProgram and applies material uniforms, but only if they are not already in use
+    void use_material(const Material& material, const ShaderProgram& shader_program);
+    /// Draws instanced_batch with the currently used ShaderProgram, one multi draw call per GeometryArena if supported, otherwise one instanced draw call per Mesh and level of detail
+    /// @param position_only if the batch is drawn from only positions (depth only draws)
+    void draw_instanced_batch(bool position_only);
+    /// Rasterizes the occluders of the visible entities into occlusion_culler and builds its hierarchy
+    void rasterize_occluders();
+    /// Draws the depth of every queued entity drawn by the instanced path, with color writes off
+    void draw_depth_prepass();
+    /// If an entity is drawn by the instanced path (and so by the depth pre-pass)
+    [[nodiscard]] static bool is_instanced(const MeshThing& thing, const ShaderProgram* instanced_shader_program);
+    /// Reads the pre-pass queries of the slot about to be reused, if the GPU has finished them
+    void resolve_prepass_queries(PrepassQueries& queries);
+    /// Picks a level of detail from the projected size, moving away from the current one only past the hysteresis
+    /// @param lod level used last frame
+    /// @param max_lod last level that can be picked
+    /// @param screen_size projected bounding sphere diameter as a fraction of the screen height
+    [[nodiscard]] unsigned int choose_lod(unsigned int lod, unsigned int max_lod, float screen_size) const;
 public:
     /// Holds a reference to the camera from which the 3D scene is rendered. Can be changed before calling render, but usually you don't switch cameras often so, it saves the one you are using
     geRef<Camera> camera;
     /// A bit mask that shows which entities will be rendered by this pass. Useful for view model for FPS gun, or for 3D UI.
     unsigned int render_layer;
+    /// If entities outside the camera view frustum are skipped (tested with their Mesh bounding box)
+    bool frustum_culling = true;
+    /// If entities hidden behind occluders (MeshThing.occluder) are skipped, tested on the CPU with their Mesh bounding box after frustum culling
+    bool occlusion_culling = false;
+    /// Depth buffer the occluders are rasterized into every frame when occlusion_culling is on, its resolution can be changed
+    OcclusionCuller occlusion_culler{};
+    /// If draws sharing a ShaderProgram, Material and Mesh are ordered front-to-back, so the depth test rejects hidden fragments early
+    bool front_to_back = true;
+    /// If instanced meshes sharing a GeometryArena are submitted with one glMultiDrawElementsIndirect (only when supported by the driver)
+    bool multi_draw_indirect = true;
+    /// If MeshThing.lod is chosen every frame from the projected size of the Mesh bounding sphere (meshes read from files have levels of detail, see Meshes.lod_levels)
+    /// @note the chosen level is stored in the entity, so passes sharing entities should use the same thresholds
+    bool lod_selection = true;
+    /// Projected bounding sphere diameters (fraction of the screen height), level i + 1 is drawn below the i-th one
+    std::vector<float> lod_screen_sizes{0.25f, 0.12f, 0.06f, 0.03f};
+    /// Fraction of a threshold the size has to pass it by before the level changes, keeps objects near a threshold from switching every frame
+    float lod_hysteresis = 0.1f;
+    /// If the depth of instanced entities is drawn first by a position only pass, then the color pass shades only the visible surface (GL_EQUAL depth test, no depth writes)
+    /// @note pays off with expensive fragment shaders and overlapping geometry. Entities drawn without instancing keep the regular depth test.
+    /// Instanced ShaderPrograms have to transform positions like the vertex shader template (see Shaders.get_depth_only_program()) and not discard fragments.
+    bool depth_prepass = false;
 
     /// Construct the Pass Object, parameters are updatable
     /// @param camera the camera from which the scene is rendered
@@ -41,9 +164,17 @@ public:
 
     /// Main 3D render function. Forward renderer, only opaque unless discard called
     void render();
+    /// How many entities were skipped by frustum culling in the last render() call
+    [[nodiscard]] unsigned int get_frustum_culled_count() const;
+    /// How many entities were skipped by occlusion culling in the last render() call
+    [[nodiscard]] unsigned int get_occlusion_culled_count() const;
+    /// Overdraw eliminated by the depth pre-pass, the results trail the current frame by a frame or two, so the GPU isn't waited on
+    [[nodiscard]] const DepthPrepassStats& get_depth_prepass_stats() const;
     /// Changes the Camera matrix based on resolution change.
     /// @note If you switch cameras Camera matrix might not be updated properly, because it was not attached when the resolution changed.
     void change_resolution(int width, int height) override;
+    /// Deletes the pre-pass queries
+    ~ForwardOpaque3DPass() override;
 };
 
 #endif //RENDERER_HPP
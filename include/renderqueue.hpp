@@ -0,0 +1,47 @@
+#ifndef RENDERQUEUE_HPP
+#define RENDERQUEUE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MeshThing;
+
+/// List of draws of one RenderPass frame, ordered by packed 64-bit sort keys.
+/// Key layout (most significant first): layer 4 bits | ShaderProgram 12 bits | Material 16 bits | Mesh 16 bits | depth 16 bits.
+/// Sorting groups draws by GPU state, draws in the same state bucket are ordered front-to-back by the quantized depth.
+/// Ids are truncated to their field width, colliding ids only cost extra state switches, so users of the queue still compare the real objects.
+/// @ingroup Rendering
+class RenderQueue {
+public:
+    /// One draw
+    struct Item {
+        uint64_t key;
+        MeshThing* thing;
+    };
+private:
+    std::vector<Item> items{};
+    /// scratch buffer of the radix sort (reused between frames)
+    std::vector<Item> sort_buffer{};
+public:
+    /// Packs a sort key
+    /// @param layer ordering layer, 0 - 15 (higher values are clamped)
+    /// @param program ShaderProgram id
+    /// @param material Material id
+    /// @param mesh Mesh id
+    /// @param depth view depth normalized to [0, 1], values outside are clamped, 0 is the nearest
+    [[nodiscard]] static uint64_t make_key(unsigned int layer, unsigned int program, uint64_t material, unsigned int mesh, float depth);
+
+    /// Removes all draws, keeps the memory
+    void clear();
+    /// Adds a draw
+    void push(uint64_t key, MeshThing* thing);
+    /// Sorts the draws by key (LSD radix sort, 8 bit digits, digits equal in all keys are skipped), stable
+    void sort();
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+    /// Sorted draws after sort()
+    [[nodiscard]] const std::vector<Item>& get_items() const;
+};
+
+#endif //RENDERQUEUE_HPP
@@ -0,0 +1,189 @@
+#ifndef RESOURCES_HPP
+#define RESOURCES_HPP
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include "meshes.hpp"
+#include "shaders.hpp"
+#include "textures.hpp"
+
+/// Handle of an asynchronously loaded resource, see Resources
+/// @tparam T Mesh or Model
+/// @note only valid to query on the main thread
+template<typename T>
+class ResourceHandle {
+    friend class Resources;
+    struct State {
+        std::shared_ptr<T> resource = nullptr;
+        bool done = false;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+public:
+    /// If loading finished, successfully or not
+    [[nodiscard]] bool is_done() const {
+        return state->done;
+    }
+    /// If the resource is loaded and on the GPU
+    [[nodiscard]] bool is_ready() const {
+        return state->resource != nullptr;
+    }
+    /// The resource, nullptr until it's ready or if loading failed
+    [[nodiscard]] std::shared_ptr<T> get() const {
+        return state->resource;
+    }
+};
+
+/// Resources by key that are handed out as shared instances, but only weakly referenced, so unused resources still get released
+/// @tparam T resource type
+template<typename T>
+class ResourceRegistry {
+    std::unordered_map<std::string, std::weak_ptr<T>> entries{};
+    /// size at which expired entries are removed next
+    size_t purge_size = 64;
+public:
+    /// Returns the living resource of a key, nullptr if there is none
+    [[nodiscard]] std::shared_ptr<T> find(const std::string& key) const {
+        const auto it = entries.find(key);
+        return it != entries.end() ? it->second.lock() : nullptr;
+    }
+    /// Registers a resource under a key, replacing an expired one
+    void add(const std::string& key, const std::shared_ptr<T>& resource) {
+        entries[key] = resource;
+        if (entries.size() >= purge_size) {
+            release_expired();
+            purge_size = std::max<size_t>(64, entries.size() * 2);
+        }
+    }
+    /// Removes entries of resources that no longer exist
+    void release_expired() {
+        std::erase_if(entries, [](const auto& entry) { return entry.second.expired(); });
+    }
+    /// Amount of entries, including expired ones
+    [[nodiscard]] size_t size() const {
+        return entries.size();
+    }
+};
+
+/// Asynchronous resource loader and registry of loaded resources.
+/// File reading, decoding and parsing run on Engine.workers, OpenGL uploads are queued and run on the main thread in Engine.update(),
+/// at most upload_budget_ms per frame, so loading doesn't freeze frames.
+/// Every load function goes through a registry keyed by the normalized path and the load options, so the same file is loaded once while in use.
+/// @note Call the load functions on the main thread.
+/// @ingroup Resources
+class Resources {
+    std::mutex uploads_mutex{};
+    /// queued main thread work
+    std::deque<std::function<void()>> uploads{};
+    /// loads that didn't finish yet
+    std::atomic<size_t> pending_count{0};
+
+    ResourceRegistry<Texture> textures{};
+    ResourceRegistry<Mesh> meshes{};
+    ResourceRegistry<Model> models{};
+    /// MTL materials by library key + material name
+    ResourceRegistry<Material> materials{};
+    /// handles of asynchronous loads in flight, so loading the same file again returns the same handle
+    std::unordered_map<std::string, ResourceHandle<Mesh>> loading_meshes{};
+    std::unordered_map<std::string, ResourceHandle<Model>> loading_models{};
+
+    /// Queues work for the main thread (thread safe)
+    void queue_upload(std::function<void()> upload);
+    /// Completes a handle (main thread)
+    template<typename T>
+    void finish(const ResourceHandle<T>& handle, std::shared_ptr<T> resource) {
+        handle.state->resource = std::move(resource);
+        handle.state->done = true;
+        pending_count -= 1;
+    }
+public:
+    /// Registry key of a file, the normalized absolute path and the load options
+    /// @param file_path path to the file
+    /// @param options load options packed into an integer
+    [[nodiscard]] static std::string get_resource_key(const std::string& file_path, uint32_t options);
+
+    /// Time per frame that may be spent on GPU uploads in process_uploads() (at least one upload always runs)
+    double upload_budget_ms = 2.0;
+
+    /// Shared texture of a file, loaded synchronously if it's not loaded yet
+    /// @param file_path path to the image
+    /// @param sRGB if the image is in sRGB color space
+    /// @param generate_minimap if mipmaps are generated
+    /// @param clamp if the texture is clamped to the border instead of repeated
+    std::shared_ptr<Texture> load_texture(const char* file_path, bool sRGB = false, bool generate_minimap = true, bool clamp = false);
+    /// Shared Mesh of an .obj file, loaded synchronously if it's not loaded yet (see Mesh::read_file)
+    /// @param file_path path to a .obj file relative from .exe
+    /// @param generate_tangents if tangents are generated
+    /// @param use_geometry_arena place the mesh into a shared GeometryArena
+    std::shared_ptr<Mesh> load_mesh(const char* file_path, bool generate_tangents = false, bool use_geometry_arena = false);
+    /// Shared Model of an .obj file, loaded synchronously if it's not loaded yet (parsed and cached like Mesh::read_file)
+    /// @param file_path path to a .obj file relative from .exe
+    /// @param action how tangents are handled
+    /// @param use_geometry_arena place meshes into shared GeometryArenas
+    std::shared_ptr<Model> load_model(const char* file_path, const Model::TangentAction& action = Model::AUTO_GENERATE, bool use_geometry_arena = true);
+    /// Shared materials of an .mtl library, the library is parsed only if some of the materials aren't loaded
+    /// @param mtl_path path to the .mtl file
+    /// @param material_names materials to return, in order
+    /// @param has_normals if the meshes using the materials have normals
+    /// @param has_uvs if the meshes using the materials have uvs
+    /// @param action how tangent maps are handled
+    /// @param async_textures if textures of newly parsed materials load asynchronously
+    /// @returns a material per name, nullptr for names not found in the library
+    std::vector<std::shared_ptr<Material>> load_mtl_materials(const std::string& mtl_path, const std::vector<std::string>& material_names, bool has_normals, bool has_uvs, const Model::TangentAction& action, bool async_textures = false);
+
+    /// Removes registry entries of resources that no longer exist (done automatically as the registries grow)
+    void release_expired();
+
+    /// Starts loading a texture, the returned texture is usable right away, materials bind the placeholder until the image is uploaded
+    /// @param file_path path to the image
+    /// @param sRGB if the image is in sRGB color space
+    /// @param generate_minimap if mipmaps are generated
+    /// @param clamp if the texture is clamped to the border instead of repeated
+    /// @param placeholder texture bound while loading
+    std::shared_ptr<Texture> load_texture_async(const char* file_path, bool sRGB = false, bool generate_minimap = true, bool clamp = false, Shaders::PlaceholderTextures placeholder = Shaders::WHITE);
+
+    /// Starts loading a Mesh from an .obj file (see Mesh::read_file)
+    /// @param file_path path to a .obj file relative from .exe
+    /// @param generate_tangents if tangents are generated
+    /// @param use_geometry_arena place the mesh into a shared GeometryArena
+    /// @returns handle, ready once the mesh is on the GPU
+    ResourceHandle<Mesh> load_mesh_async(const char* file_path, bool generate_tangents = false, bool use_geometry_arena = false);
+
+    /// Starts loading a Model from an .obj file (parsed and cached like Mesh::read_file), its textures load asynchronously too
+    /// @param file_path path to a .obj file relative from .exe
+    /// @param action how tangents are handled
+    /// @param use_geometry_arena place meshes into shared GeometryArenas
+    /// @returns handle, ready once all meshes are on the GPU (textures may still show placeholders)
+    ResourceHandle<Model> load_model_async(const char* file_path, const Model::TangentAction& action = Model::AUTO_GENERATE, bool use_geometry_arena = true);
+
+    /// Runs queued uploads until upload_budget_ms is used, called by Engine.update()
+    void process_uploads();
+    /// Runs queued uploads until the budget is used
+    /// @param budget_ms time budget in milliseconds
+    void process_uploads(double budget_ms);
+
+    /// Blocks until a handle is done, running uploads meanwhile
+    /// @returns the resource, nullptr if loading failed
+    /// @warning main thread only
+    template<typename T>
+    std::shared_ptr<T> wait(const ResourceHandle<T>& handle) {
+        while (!handle.is_done()) {
+            process_uploads(std::numeric_limits<double>::infinity());
+            if (!handle.is_done())
+                std::this_thread::yield();
+        }
+        return handle.get();
+    }
+
+    /// Amount of loads that didn't finish yet
+    [[nodiscard]] size_t get_pending_count() const;
+};
+
+#endif //RESOURCES_HPP
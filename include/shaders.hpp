@@ -5,9 +5,12 @@
 #include <variant>
 #include <memory>
 #include <map>
+#include <optional>
 #include <array>
+#include <vector>
 #include "textures.hpp"
 #include "coordinates.h"
+#include "programcache.hpp"
 
 typedef std::variant<float, int, bool, Vector3, Vector2, Color, std::shared_ptr<Texture>>  uniform_variant;
 typedef std::map<int, uniform_variant> uniform_map;
@@ -17,15 +20,27 @@ typedef std::map<int, uniform_variant> uniform_map;
 /// @note This resource is not ment to be used as a std::shared_ptr and has no central counter. You just create it, use it, and once you don't need it delete it.
 /// @warning If you try to copy this class somewhere, the deconstructor will be called and the shader will no longer exist on the GPU thus the copy will be useless, even harmful.
 class Shader {
-    /// OpenGL Shader ID
-    unsigned int id = -1;
+    /// OpenGL Shader ID, created on the first get_id() call
+    mutable unsigned int id = -1;
+    /// If the source was already compiled
+    mutable bool compiled = false;
+    /// Expanded source code (with the define header)
+    std::string source;
+    /// GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
+    unsigned int type;
+
+    /// Compiles the source and reports errors
+    void compile() const;
 public:
     enum ShaderType {
         VERTEX_SHADER = GL_VERTEX_SHADER,
         FRAGMENT_SHADER = GL_FRAGMENT_SHADER,
     };
-    /// read-only id getter
+    /// read-only id getter, compiles the shader on the first call
+    /// @note compilation is deferred, so a ShaderProgram loaded from the ProgramBinaryCache never compiles its shaders
     [[nodiscard]] unsigned int get_id() const;
+    /// Expanded source code, empty if the shader file couldn't be loaded
+    [[nodiscard]] const std::string& get_source() const;
 
     /// Shader Constructor and Compiler from file_path
     /// @param file_path file path of shader code
@@ -102,14 +117,88 @@ public:
 };
 
 
+/// Layout of the std140 MATERIAL uniform block of a ShaderProgram, as reported by the driver
+struct MaterialBlockLayout {
+    struct Member {
+        /// byte offset in the block
+        int offset;
+        /// GL type (GL_FLOAT, GL_FLOAT_VEC3, ...)
+        unsigned int type;
+    };
+    /// size of the block in bytes
+    int size = 0;
+    /// active members [uniform name (e.g. "material.diffuse") : member]
+    std::map<std::string, Member> members{};
+};
+
+/// One uniform buffer holding the MATERIAL blocks of all Materials, every Material owns a slice of it.
+/// Slices are multiples of SLOT_SIZE (rounded to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT), freed slices are reused by blocks of the same slot count.
+class MaterialUniformBuffer {
+    unsigned int buffer = 0;
+    size_t capacity = 0;
+    /// end of the used part of the buffer
+    size_t end = 0;
+    /// SLOT_SIZE rounded to the offset alignment
+    size_t slot_size = 0;
+    /// free slice offsets [slot count : offsets]
+    std::map<size_t, std::vector<size_t>> free_slices{};
+
+    /// Reallocates the buffer, keeps its contents
+    void grow(size_t min_capacity);
+    [[nodiscard]] size_t get_slot_count(size_t size) const;
+public:
+    /// allocation granularity in bytes
+    static constexpr size_t SLOT_SIZE = 256;
+
+    /// Allocates a slice
+    /// @param size block size in bytes
+    /// @returns offset of the slice
+    size_t allocate(size_t size);
+    /// Returns a slice for reuse
+    void release(size_t offset, size_t size);
+    /// Writes into a slice
+    void upload(size_t offset, const void* data, size_t size) const;
+    /// Binds a slice to Shaders::MATERIAL_UBO_BINDING
+    void bind(size_t offset, size_t size) const;
+
+    MaterialUniformBuffer() = default;
+    MaterialUniformBuffer(const MaterialUniformBuffer&) = delete;
+    MaterialUniformBuffer& operator=(const MaterialUniformBuffer&) = delete;
+    ~MaterialUniformBuffer();
+};
+
 /// Holds uniform values of a ShaderProgram and is responsible for their correct usage.
 /// It's the intended way of adding colors to Meshes.
+/// Uniforms inside the program's std140 MATERIAL block are kept in a CPU copy of the block, uploaded to the Material's slice of Shaders.material_uniform_buffer when changed,
+/// so switching to the Material binds the slice with one call instead of setting every value. Other uniforms (textures, programs without the block) are set one by one.
 class Material : public std::enable_shared_from_this<Material> {
     /// Unique material id
     uint64_t id = -1;
     /// ShaderProgram that is applied to the geometry
     ShaderProgram shader_program;
     std::map<std::string, int> uniform_name_to_loc;
+    /// Uniform locations of this material translated to other ShaderPrograms [ShaderProgram id : [own location : target location]]
+    mutable std::map<unsigned int, std::map<int, int>> uniform_location_remaps;
+
+    /// MATERIAL block layout of the shader program, nullptr if it has none
+    const MaterialBlockLayout* block_layout = nullptr;
+    /// values of the uniforms in the MATERIAL block [name : value]
+    std::map<std::string, uniform_variant> block_uniforms{};
+    /// std140 CPU copy of the block
+    std::vector<unsigned char> block_data{};
+    /// offset of the slice in Shaders.material_uniform_buffer
+    size_t block_offset = 0;
+    /// if block_data changed since the last upload
+    mutable bool block_dirty = false;
+
+    /// Applies uniform values onto a ShaderProgram, optionally translating the locations
+    void apply_uniform_values(unsigned int program_id, const std::map<int, int>* location_remap) const;
+    /// Looks up the MATERIAL block of the shader program and allocates a slice for it
+    void setup_block();
+    /// Frees the slice
+    void release_block();
+    /// Writes a value into the CPU copy of the block, converted to the member type
+    void write_block_value(const MaterialBlockLayout::Member& member, const uniform_variant& value);
 public:
     /// getter for read-only attribute id
     [[nodiscard]] uint64_t get_id() const;
@@ -123,15 +212,28 @@ public:
 
     /// Container for the shader values
     uniform_map uniforms = {};
+    /// Amount of spawned MeshThings using this Material
+    /// @note maintained by the Engine
+    unsigned int mesh_thing_count = 0;
     /// You create a material by supplying a shader program to be used
     /// @param _shader_program the shader program that is used
     explicit Material(const ShaderProgram &_shader_program);
+    Material(const Material&) = delete;
+    Material& operator=(const Material&) = delete;
+    /// Frees the MATERIAL block slice
+    ~Material();
 
     /// ONE TIME applies all uniform values saved by the material
     /// @note used by the renderer to material switch
     void apply_uniform_values() const;
 
+    /// ONE TIME applies all uniform values saved by the material onto a different ShaderProgram with the same uniforms (e.g. the instanced variant of the material ShaderProgram)
+    /// @param target_program the ShaderProgram that's currently in use
+    /// @note used by the renderer for instanced rendering
+    void apply_uniform_values(const ShaderProgram &target_program) const;
+
     /// Saves a uniform value and holds on this value util it's resaved. Primary way of changing material values.
+    /// @note values in the MATERIAL block are uploaded the next time the Material is applied
     /// @param uniform_name name of the uniform you want to change
     /// @param val the value you want to change it to (limited by the uniform variant type)
     void set_uniform(const char* uniform_name, const uniform_variant &val);
@@ -157,25 +259,27 @@ public:
     void shader_program_switch(ShaderProgram new_sp);
 };
 
-/// Helper Struct for a std::map in Engine class, that sorts renderable objects by shader_program first, material_id second
-/// Useful for rendering order optimization.
-struct MaterialSorter {
-    bool operator()(const std::shared_ptr<Material>& m1, const std::shared_ptr<Material>& m2) const {
-        if (m1->get_shader_program_id() != m2->get_shader_program_id()) {
-            return m1->get_shader_program_id() < m2->get_shader_program_id();
-        }
-        return m1->get_id() < m2->get_id();
-    }
-};
-
-
 /// Shader Helper class. Holds base materials for .obj parser and convenience for the user.
 class Shaders {
     /// central shader program use counter
     std::map<unsigned int, unsigned int> shader_programs_id_used = {};
+    /// Instanced variants of ShaderPrograms [ShaderProgram id : instanced ShaderProgram]
+    /// @note declared after the use counter, so it's destroyed before it
+    std::map<unsigned int, ShaderProgram> instanced_variants = {};
+    /// Position only instanced ShaderProgram writing only depth, created on first use
+    /// @note declared after the use counter, so it's destroyed before it
+    std::optional<ShaderProgram> depth_only_program{};
 
     std::array<std::shared_ptr<Texture>, 3> texture_placeholders{};
 
+    /// MATERIAL block layouts [ShaderProgram id : layout, nullptr if the program has no block]
+    std::map<unsigned int, std::unique_ptr<MaterialBlockLayout>> material_block_layouts{};
+public:
+    /// Slices of all Material blocks
+    /// @note declared before the base materials, so it's destroyed after them
+    MaterialUniformBuffer material_uniform_buffer{};
+private:
+
     /// BASE SHADER PROGRAMS
     /// a set of shader programs useful for loading MTL materials,
     /// all here, so that they can be universally used across all loaded models
@@ -190,6 +294,9 @@ class Shaders {
     /// AUTO increment Shader ID value
     uint64_t next_material_id = 0;
 public:
+    /// Uniform buffer binding of the MATERIAL block
+    static constexpr unsigned int MATERIAL_UBO_BINDING = 3;
+
     enum PlaceholderTextures{
         WHITE,
         NORMAL_MAP,
@@ -228,9 +335,27 @@ public:
 
     /// Debug output Shader Program use table
     void debug_show_shader_program_use();
+
+    /// Registers an instanced variant of a ShaderProgram. Materials using the ShaderProgram can then be drawn by the instanced path of ForwardOpaque3DPass.
+    /// @param shader_program the regular ShaderProgram (uses uniform mat4 transform)
+    /// @param instanced_shader_program the same program compiled with INSTANCED defined (reads per instance attributes, see InstanceData)
+    /// @note base materials and MTL materials have their variants registered automatically
+    void register_instanced_variant(const ShaderProgram &shader_program, const ShaderProgram &instanced_shader_program);
+    /// Returns the instanced variant of a ShaderProgram
+    /// @param sp_id id of the regular ShaderProgram
+    /// @returns nullptr if the ShaderProgram has no instanced variant
+    [[nodiscard]] const ShaderProgram* get_instanced_variant(unsigned int sp_id) const;
+    /// Returns the ShaderProgram of depth only draws, the instanced vertex shader template reading only positions with an empty fragment shader
+    /// @note its depth matches the programs generated from the template exactly (gl_Position is invariant), custom vertex shaders have to transform positions the same way
+    [[nodiscard]] const ShaderProgram& get_depth_only_program();
     /// Next ID material getter
     uint64_t get_material_identificator();
 
+    /// Layout of the MATERIAL uniform block of a ShaderProgram, queried once per program
+    /// @param sp_id id of the ShaderProgram
+    /// @returns nullptr if the program has no MATERIAL block
+    [[nodiscard]] const MaterialBlockLayout* get_material_block_layout(unsigned int sp_id);
+
     /// Base material getter
     /// @param with_uvs whether you want the Material for a mesh with UVs
     /// @param with_normals whether you want the Material for a mesh with Normals
@@ -249,28 +374,35 @@ public:
 
     /// If this computer running the program supports bindless textures
     bool bindless_textures_supported = false;
+    /// Cache of linked program binaries, used by every ShaderProgram linked from Shaders
+    ProgramBinaryCache program_binary_cache{};
 
     /// Generates a ShaderProgram with a basic phong lighting system
     /// @param has_uvs Whether you want the shader to be for a mesh with UVs (usually yes)
     /// @param has_tangents Whether you want the shader to be used for a mesh with tangents (for Normal Maps)
-    [[nodiscard]] ShaderProgram phong_shader_program_gen(bool has_uvs, bool has_tangents) const;
+    /// @param instanced Whether transforms are read from per instance attributes instead of uniforms
+    [[nodiscard]] ShaderProgram phong_shader_program_gen(bool has_uvs, bool has_tangents, bool instanced = false) const;
     /// Generates a ShaderProgram with ambient lighting (ment for models with No normals)
     /// @param has_uvs Whether you want the shader to be for a model with UVs (usually yes)
-    [[nodiscard]] ShaderProgram no_normal_program_gen(bool has_uvs) const;
+    /// @param instanced Whether transforms are read from per instance attributes instead of uniforms
+    [[nodiscard]] ShaderProgram no_normal_program_gen(bool has_uvs, bool instanced = false) const;
 
-    /// Generates a Vertex Shader applicable to 90% of situations.
+    /// Generates a Vertex Shader applicable to 90% of situations, decoding meshes in Meshes.vertex_format.
     /// @param support_uv If it's ment for a mesh with UV coords
     /// @param support_normal If it's ment for a mesh with Normal coords
     /// @param support_tangents If it's ment for a mesh with Tangents (Usually for Normal Maps) (For this support UV and NORMAL has to be TRUE)
-    static Shader base_vertex_shader_gen(bool support_uv = true, bool support_normal = true, bool support_tangents = false);
+    /// @param instanced If transform, normal matrix and tint are per instance attributes (see InstanceData)
+    static Shader base_vertex_shader_gen(bool support_uv = true, bool support_normal = true, bool support_tangents = false, bool instanced = false);
 
     /// Generates a basic phong lighting Fragment Shader
     /// @param support_uv Whether you want the shader to be for a mesh with UVs (usually yes)
     /// @param support_tangents Whether you want the shader to be for a mesh with tangents (i.e. for a mesh with a shader that supports Normal and Bump Maps)
-    [[nodiscard]] Shader base_phong_shader_gen(bool support_uv = true, bool support_tangents = false) const;
+    /// @param instanced Whether the shader applies the per instance tint
+    [[nodiscard]] Shader base_phong_shader_gen(bool support_uv = true, bool support_tangents = false, bool instanced = false) const;
     /// Generates a basic ambient lighting Fragment Shader
     /// @param support_uv Whether you want the shader to be for a model with UVs (usually yes)
-    [[nodiscard]] Shader base_no_normal_shader_gen(bool support_uv = true) const;
+    /// @param instanced Whether the shader applies the per instance tint
+    [[nodiscard]] Shader base_no_normal_shader_gen(bool support_uv = true, bool instanced = false) const;
 };
 
 #endif //SHADERS_HPP
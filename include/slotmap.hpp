@@ -0,0 +1,103 @@
+#ifndef SLOTMAP_HPP
+#define SLOTMAP_HPP
+#include <vector>
+#include <memory>
+
+class Thing;
+
+/// Dense slot map that owns all spawned entities.
+/// IDs handed out by the map (the ones stored in geRef) are packed index + generation handles.
+/// Lookups are O(1) and validated, so an ID of an already removed entity returns nullptr instead of a different entity.
+/// Entities are stored in a contiguous array, so iterating over them (Engine.update()) doesn't jump around memory.
+/// @note Removal swaps the last entity into the freed place, so the iteration order is not stable across removals.
+class ThingSlotMap {
+public:
+    /// Amount of bits of the ID used for the slot index, the rest is used for the generation
+    static constexpr unsigned int INDEX_BITS = 20;
+    /// Mask extracting the slot index from an ID
+    static constexpr unsigned int INDEX_MASK = (1u << INDEX_BITS) - 1;
+    /// Mask of the generation part of an ID (after shifting by INDEX_BITS)
+    static constexpr unsigned int GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+    /// Maximum amount of simultaneously existing entities (index INDEX_MASK is never used, so that ID -1 stays invalid)
+    static constexpr unsigned int MAX_THINGS = INDEX_MASK;
+    /// ID that never points to an entity
+    static constexpr unsigned int NULL_ID = -1;
+
+    typedef std::vector<std::unique_ptr<Thing>>::iterator iterator;
+    typedef std::vector<std::unique_ptr<Thing>>::const_iterator const_iterator;
+private:
+    /// Marks slot that doesn't point into the dense arrays
+    static constexpr unsigned int EMPTY = -1;
+
+    struct Slot {
+        /// index into dense arrays, EMPTY if the slot is reserved or free
+        unsigned int dense_index = EMPTY;
+        /// current generation of the slot, bumped on every removal
+        unsigned int generation = 1;
+        /// next slot in the free list (only valid while the slot is free)
+        unsigned int next_free = EMPTY;
+    };
+
+    /// Sparse array of slots, indexed by the index part of the ID
+    std::vector<Slot> slots{};
+    /// Densely packed entities
+    std::vector<std::unique_ptr<Thing>> dense_things{};
+    /// IDs of the densely packed entities (same order as dense_things)
+    std::vector<unsigned int> dense_ids{};
+
+    /// FIFO free list of slot indices, the oldest freed slot is reused first, so generations wrap around as late as possible
+    unsigned int free_head = EMPTY;
+    unsigned int free_tail = EMPTY;
+    /// amount of slots in the free list
+    unsigned int free_count = 0;
+    /// if reserve() may append slots, see set_growth_allowed()
+    bool growth_allowed = true;
+
+    /// Puts a slot at the end of the free list
+    void push_free(unsigned int index);
+    /// Bumps generation of a slot and puts it at the end of the free list
+    void free_slot(unsigned int index);
+public:
+    /// Packs slot index and generation into an ID
+    static unsigned int make_id(unsigned int index, unsigned int generation);
+    /// Extracts slot index from an ID
+    static unsigned int index_of(unsigned int id);
+    /// Extracts generation from an ID
+    static unsigned int generation_of(unsigned int id);
+
+    /// Reserves a slot and returns its ID. The slot doesn't hold an entity until insert() is called.
+    /// @returns NULL_ID if MAX_THINGS is reached, or if the free list is empty while growth isn't allowed
+    [[nodiscard]] unsigned int reserve();
+    /// Appends free slots until at least count slots are free, so as many reserve() calls don't have to grow the slot array
+    /// @returns amount of free slots, less than count only if MAX_THINGS is reached
+    unsigned int ensure_free_slots(unsigned int count);
+    /// Allows or forbids reserve() to append slots. Forbidden while other threads read the map (Engine's parallel update), appending may move the slot array under them.
+    void set_growth_allowed(bool allowed);
+    /// Returns a reserved (not yet inserted) ID back to the free list
+    void release(unsigned int id);
+    /// Places an entity into a reserved slot
+    /// @param id ID received from reserve()
+    /// @param thing the entity
+    void insert(unsigned int id, std::unique_ptr<Thing> thing);
+    /// Destroys the entity and frees its slot, every ID pointing to it becomes stale
+    void erase(unsigned int id);
+
+    /// Returns the entity or nullptr if the ID is stale, reserved or invalid
+    [[nodiscard]] Thing* get(unsigned int id) const;
+    /// If the ID points to a living entity
+    [[nodiscard]] bool contains(unsigned int id) const;
+
+    /// Amount of living entities
+    [[nodiscard]] size_t size() const;
+    /// Entity at a position in the dense array
+    [[nodiscard]] Thing* at_dense(size_t dense_index) const;
+    /// ID of the entity at a position in the dense array
+    [[nodiscard]] unsigned int id_at_dense(size_t dense_index) const;
+
+    iterator begin();
+    iterator end();
+    [[nodiscard]] const_iterator begin() const;
+    [[nodiscard]] const_iterator end() const;
+};
+
+#endif //SLOTMAP_HPP
@@ -0,0 +1,107 @@
+#ifndef TEXTURECOMPRESSION_HPP
+#define TEXTURECOMPRESSION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/// Block compressed (BCn) texture formats, all encode blocks of 4x4 pixels.
+/// Files are read, written and encoded without OpenGL or an Engine, so the functions work on worker threads and in tools.
+enum class TextureCompression {
+    NONE,
+    /// RGB, 8 bytes per block (DXT1)
+    BC1,
+    /// RGBA, BC1 color + BC4 alpha, 16 bytes per block (DXT5)
+    BC3,
+    /// two independent channels (RG), 16 bytes per block, meant for tangent space normal maps, z has to be reconstructed in the shader
+    BC5,
+    /// RGBA in higher quality than BC3, 16 bytes per block
+    BC7
+};
+
+/// One mip level of a CompressedImage
+struct CompressedMipLevel {
+    int width = 0;
+    int height = 0;
+    /// offset of the level in CompressedImage.data
+    size_t offset = 0;
+    /// size of the level in bytes
+    size_t size = 0;
+};
+
+/// Block compressed image with its mip chain, as loaded from or saved to .ktx2 and .dds files
+struct CompressedImage {
+    TextureCompression format = TextureCompression::NONE;
+    /// if color channels are in sRGB color space (BC5 never is)
+    bool sRGB = false;
+    /// mip levels, largest first
+    std::vector<CompressedMipLevel> levels{};
+    /// blocks of all levels
+    std::vector<unsigned char> data{};
+    /// if rows are stored top to bottom (as most files are), OpenGL expects bottom to top
+    bool top_down = false;
+
+    /// If the image holds any data
+    [[nodiscard]] bool is_valid() const;
+    /// Width of the largest level
+    [[nodiscard]] int get_width() const;
+    /// Height of the largest level
+    [[nodiscard]] int get_height() const;
+};
+
+/// Bytes of one 4x4 block, 0 for NONE
+[[nodiscard]] size_t get_block_size(TextureCompression format);
+/// Bytes of a whole level of a format
+[[nodiscard]] size_t get_compressed_level_size(TextureCompression format, int width, int height);
+/// OpenGL internal format of a compressed format, 0 if there is none
+[[nodiscard]] unsigned int get_compressed_gl_format(TextureCompression format, bool sRGB);
+
+/// Reads a .ktx2 file (block compressed formats only, no supercompression)
+/// @param file_path path to the file
+/// @param image result
+/// @param error optional, reason of a failure
+/// @returns false if the file can't be read or isn't supported
+bool read_ktx2_file(const char* file_path, CompressedImage& image, std::string* error = nullptr);
+/// Reads a .dds file (DXT1, DXT5, ATI2/BC5U and DX10 headers with BC1, BC3, BC5, BC7)
+/// @param file_path path to the file
+/// @param image result
+/// @param error optional, reason of a failure
+/// @returns false if the file can't be read or isn't supported
+bool read_dds_file(const char* file_path, CompressedImage& image, std::string* error = nullptr);
+/// Reads a .ktx2 or a .dds file, by the extension
+/// @returns false if the file can't be read, isn't supported or has another extension
+bool read_compressed_texture_file(const char* file_path, CompressedImage& image, std::string* error = nullptr);
+/// If the path has an extension of a compressed texture file (.ktx2, .dds)
+[[nodiscard]] bool is_compressed_texture_file(const char* file_path);
+
+/// Writes a .ktx2 file, the row order is stored in the KTXorientation key
+/// @returns false if the file couldn't be written
+bool write_ktx2_file(const char* file_path, const CompressedImage& image, std::string* error = nullptr);
+/// Writes a .dds file with a DX10 header, .dds has no orientation, so the image has to be top_down (as other tools expect)
+/// @returns false if the file couldn't be written or the image is not top_down
+bool write_dds_file(const char* file_path, const CompressedImage& image, std::string* error = nullptr);
+
+/// Flips all levels vertically and toggles top_down, lossless for BC1, BC3 and BC5
+/// @returns false for formats that can't be flipped without re-encoding (BC7), the image is left unchanged
+bool flip_vertically(CompressedImage& image);
+
+/// Encodes an RGBA8 image into a block compressed format on the CPU
+/// @param rgba_pixels width * height RGBA pixels
+/// @param width image width
+/// @param height image height
+/// @param format target format, BC5 encodes red and green
+/// @param sRGB if the pixels are in sRGB color space, mip levels are then averaged in linear space
+/// @param generate_mipmaps if the whole mip chain down to 1x1 is generated
+/// @param top_down if the pixel rows are top to bottom, the rows of the result keep the same order
+/// @param workers optional thread pool the block rows are encoded on
+CompressedImage compress_image(const unsigned char* rgba_pixels, int width, int height, TextureCompression format, bool sRGB, bool generate_mipmaps = true, bool top_down = false, ThreadPool* workers = nullptr);
+
+/// Encodes one block
+/// @param rgba 16 RGBA pixels, rows in the order of the image
+/// @param format target format
+/// @param block output, get_block_size(format) bytes
+void encode_block(const unsigned char* rgba, TextureCompression format, unsigned char* block);
+
+#endif //TEXTURECOMPRESSION_HPP
@@ -1,20 +1,50 @@
 #ifndef TEXTURES_HPP
 #define TEXTURES_HPP
 #pragma once
+#include <memory>
 #include <glad/glad.h>
 #include "coordinates.h"
+#include "texturecompression.hpp"
+
+/// Decoded image of a texture file. Decoding makes no OpenGL calls, so it can run on a worker thread, the upload happens in Texture.
+struct TextureData {
+    /// pixel rows bottom to top (as OpenGL expects), nullptr if decoding failed or the file is compressed
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int channel_count = 0;
+    /// blocks and mip levels of .ktx2 and .dds files, uploaded as they are
+    CompressedImage compressed{};
+
+    /// Decodes an image file (stb_image), .ktx2 and .dds files are read into compressed
+    /// @param file_path path to the image
+    explicit TextureData(const char* file_path);
+    TextureData(const TextureData&) = delete;
+    TextureData& operator=(const TextureData&) = delete;
+    TextureData(TextureData&& other) noexcept;
+    TextureData& operator=(TextureData&& other) noexcept;
+    /// Frees the pixels
+    ~TextureData();
+};
 
 /// A texture GPU resource a wrapper around OpenGL texture ID system, supports normal and also bindless textures
 class Texture {
     void generate_bindless_handle();
+    /// Uploads all levels of a block compressed image, false if the format isn't supported by the context
+    bool upload_compressed(const CompressedImage& image, bool sRGB, bool clamp);
+    /// if the image is uploaded
+    bool ready = false;
+    /// texture bound instead of this one until the image is uploaded
+    std::shared_ptr<Texture> placeholder = nullptr;
 public:
     /// standard OpenGL texture id
-    unsigned int id;
+    unsigned int id = 0;
     /// handle for bindless textures
-    GLint64 handle;
+    GLint64 handle = 0;
     /// Loads texture from file and uploads it to the GPU.
-    /// @note Supports RGB and RGBA formats.
-    /// @warning If you construct the same texture twice, there is no checking as of this point, so it'll be allocated twice on the GPU.
+    /// @note Supports RGB and RGBA formats, and BC1, BC3, BC5, BC7 compressed .ktx2 / .dds files with their mip chains (see tools/texture_compressor).
+    /// @note BC5 normal maps hold only x and y, shaders sampling them have to reconstruct z (sqrt(1 - x² - y²)).
+    /// @note Use ge.resources.load_texture() to share one instance of the same file, or ge.resources.load_texture_async() to not block the frame.
     /// @warning If you want to use this texture twice just give the std::shared_ptr to two materials.
     Texture(const char* file_path, bool sRGB = false, bool generate_minimap = true, bool clamp = false);
 
@@ -22,6 +52,26 @@ public:
     /// @param color the color of the pixel
     /// @param alpha if texture will have an alpha compoment
     explicit Texture(Color color, bool alpha = false);
+
+    /// Creates a texture without an image, materials bind the placeholder until upload() is called
+    /// @param placeholder texture that is bound in the meantime
+    explicit Texture(std::shared_ptr<Texture> placeholder);
+
+    /// Uploads a decoded image to the GPU, after that the texture is bound instead of its placeholder
+    /// @param data decoded image, if decoding failed the placeholder stays in use
+    /// @param sRGB if the image is in sRGB color space, compressed images marked as sRGB in the file always are
+    /// @param generate_minimap if mipmaps are generated
+    /// @param clamp if the texture is clamped to the border instead of repeated
+    /// @warning main thread only (OpenGL)
+    void upload(const TextureData& data, bool sRGB = false, bool generate_minimap = true, bool clamp = false);
+
+    /// If the image is on the GPU
+    [[nodiscard]] bool is_ready() const;
+    /// The texture materials actually bind, itself when ready, otherwise the placeholder
+    [[nodiscard]] const Texture& get_bound_texture() const;
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
     /// Deconstructs and removes the texture from GPU.
     ~Texture();
 };
@@ -8,6 +8,8 @@
 #include "meshes.hpp"
 #include "gereferences.hpp"
 
+class OccluderMesh;
+
 /// Root entity class
 /// @ingroup Things
 class Thing {
@@ -18,6 +20,11 @@ public:
     bool visible = true;
     /// RenderLayer a bit map showing which ForwardOpaque3DPass will render the object based their render_layer values
     unsigned int render_layer;
+    /// Whether update() is thread-safe, such entities are updated on Engine.workers before all the others.
+    /// update() may then only touch the entity itself (and read other data that isn't written during the update), spawning, queued removals and attaching to parents (Engine.transforms.set_parent()) are allowed.
+    /// Spawned entities are constructed on the main thread after the parallel phase, so their constructors may use OpenGL and attach children. Past Engine.parallel_spawn_budget spawns in a frame the returned geRef is null (the entity is still spawned).
+    /// @warning OpenGL can't be called, the update runs on worker threads, so no creating or loading GPU resources.
+    bool parallel_update = false;
 
     Thing () = default;
 
@@ -36,9 +43,18 @@ public:
 /// @ingroup Things
 class SpatialThing : public Thing {
 public:
-    /// describes the position, rotation, and scale
+    /// describes the position, rotation, and scale, relative to the parent if the entity is attached to one (see TransformHierarchy)
     Transform transform;
+    /// position in Engine.transforms, -1 if the entity is neither a parent nor a child
+    /// @note maintained by TransformHierarchy
+    size_t hierarchy_index = -1;
     SpatialThing();
+
+    /// World matrix including all parents, the own Transform matrix if the entity isn't attached
+    /// @note parents are applied by TransformHierarchy.propagate() at the end of Engine.update()
+    [[nodiscard]] const glm::mat4& get_world_matrix();
+    /// Normal matrix of get_world_matrix()
+    [[nodiscard]] const glm::mat3& get_world_normal_matrix();
 };
 
 /// Represents camera, acts as a normal entity. Many instances may be spawned. But ForwardRenderer3DLayer takes only one as a param in the render method.
@@ -78,6 +94,9 @@ public:
     void change_resolution(int width, int height);
     /// transforms the Transform of the camera to the VIEW matrix. Called by the ForwardRenderer3DLayer.render() method.
     void transform_to_view_matrix();
+    /// Returns the world space view frustum of the camera (from PROJECTION * VIEW)
+    /// @note based on the last VIEW matrix, see transform_to_view_matrix()
+    [[nodiscard]] Frustum get_frustum() const;
 };
 
 
@@ -96,11 +115,30 @@ protected:
     /// @note only != -1 if the mesh supports normals
     int vs_uniform_normal_matrix = -1;
 public:
+    /// Color multiplied into the final color of the mesh
+    /// @note only applied when the mesh is drawn by the instanced path (materials with an instanced ShaderProgram variant, e.g. base and MTL materials)
+    Color tint{1.0f, 1.0f, 1.0f, 1.0f, false};
+    /// If ForwardOpaque3DPass may group this entity with others sharing the same Mesh and Material into one instanced draw call.
+    /// @warning Set to false if you override render(), instanced draws don't call it.
+    bool allow_instancing = true;
 
     /// read-only Mesh shared pointer getter, may be used for creating a new entity with the same Mesh
     [[nodiscard]] std::shared_ptr<Mesh> get_mesh();
+    /// raw Mesh pointer getter for render passes (no shared_ptr copy)
+    [[nodiscard]] Mesh* get_mesh_pointer() const;
     /// read-only Material shared pointer getter, may be used for creating a new entity with the same Material
     [[nodiscard]] std::shared_ptr<Material> get_material();
+    /// raw Material pointer getter for render passes (no shared_ptr copy)
+    [[nodiscard]] Material* get_material_pointer() const;
+    /// position in Engine.mesh_things
+    /// @note maintained by the Engine
+    size_t mesh_thing_index = -1;
+    /// level of detail of the Mesh that is drawn (see Mesh.get_lod())
+    /// @note chosen every frame by ForwardOpaque3DPass when its lod_selection is on
+    unsigned int lod = 0;
+    /// Geometry that hides entities behind this one when ForwardOpaque3DPass.occlusion_culling is on, nullptr if it hides nothing
+    /// @note has to lie inside the Mesh (e.g. OccluderMesh::box() of a wall), entities with an occluder are never occlusion culled themselves
+    std::shared_ptr<OccluderMesh> occluder{};
 
     /// Constructs a MeshThing using a Mesh resource and Material resource
     /// @param _mesh the mesh that's going to be rendered
@@ -112,7 +150,7 @@ public:
 };
 
 
-/// A spatial entity representing a Model (multiple MeshThings). Spawns N ModelSlaveThing, which act as a child of this entity.
+/// A spatial entity representing a Model (multiple MeshThings). Spawns N ModelSlaveThing, which are attached to this entity as children (see TransformHierarchy).
 /// @ingroup Things
 class ModelThing : public SpatialThing {
 protected:
@@ -132,7 +170,7 @@ public:
 };
 
 
-/// Spawned by a ModelThing acts as a child of ModelThing. Not ment for inheriting any further.
+/// Spawned by a ModelThing, attached to it as a child, so its transform is relative to the ModelThing (identity by default). Not ment for inheriting any further.
 /// @ingroup Things
 class ModelSlaveThing final : public MeshThing {
 public:
@@ -143,10 +181,8 @@ public:
     /// @param _mesh Forwards parameter to MeshThing constructor
     /// @param _material Forwards parameter to MeshThing constructor
     /// @param _manager Reference to the owner ModelThing
-    ModelSlaveThing (std::shared_ptr<Mesh> _mesh, std::shared_ptr<Material> _material, geRef<ModelThing> _manager);
-
-    /// Inherits transform from manager and submits mesh to GPU for rendering.
-    void render() override;
+    /// @param _render_layer Forwards parameter to MeshThing constructor
+    ModelSlaveThing (std::shared_ptr<Mesh> _mesh, std::shared_ptr<Material> _material, geRef<ModelThing> _manager, unsigned int _render_layer = 1);
 };
 
 #endif //THINGS_H
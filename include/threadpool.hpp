@@ -0,0 +1,61 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of worker threads executing submitted tasks in FIFO order.
+/// The Engine holds one (Engine.workers), used for CPU heavy work like parsing large files.
+/// @warning Tasks must not call OpenGL, the context is only current on the main thread.
+class ThreadPool {
+    std::vector<std::thread> threads{};
+    std::deque<std::function<void()>> tasks{};
+    std::mutex tasks_mutex{};
+    std::condition_variable tasks_available{};
+    bool stopping = false;
+
+    /// Loop of a worker thread
+    void worker_loop(unsigned int worker_index);
+    /// Puts a task into the queue
+    void enqueue(std::function<void()> task);
+public:
+    /// Starts the worker threads
+    /// @param thread_count amount of worker threads, 0 = one less than the amount of hardware threads (the main thread works too)
+    explicit ThreadPool(unsigned int thread_count = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    /// Finishes queued tasks and joins the worker threads
+    ~ThreadPool();
+
+    /// Amount of worker threads
+    [[nodiscard]] size_t get_thread_count() const;
+
+    /// Index of the calling thread, 1 to get_thread_count() on worker threads, 0 on any other thread (e.g. the main thread).
+    /// Useful for indexing per thread data, which then needs get_thread_count() + 1 slots.
+    [[nodiscard]] static unsigned int get_worker_index();
+
+    /// Queues a task
+    /// @param task callable without parameters
+    /// @returns future of the task result
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task) {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+        auto future = packaged->get_future();
+        enqueue([packaged] { (*packaged)(); });
+        return future;
+    }
+
+    /// Calls body(index) for every index in [0, count) on the workers and the calling thread, returns once all calls finished.
+    /// Safe to call from a worker thread, the caller processes indices itself while it waits.
+    /// @param count amount of indices
+    /// @param body callable taking the index
+    void parallel_for(size_t count, const std::function<void(size_t)>& body);
+};
+
+#endif //THREADPOOL_HPP
@@ -0,0 +1,73 @@
+#ifndef TRANSFORMHIERARCHY_HPP
+#define TRANSFORMHIERARCHY_HPP
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+class SpatialThing;
+
+/// Parent / child relations between SpatialThings (Engine.transforms).
+/// The Transform of an attached entity is relative to its parent, world matrices of all attached entities are propagated once per frame (end of Engine.update()),
+/// in a flat array ordered parents before children, so every entity is visited once and reads an already finished parent matrix.
+/// Entities outside of any relation aren't stored, their world matrix is their own Transform.
+/// @note The array is rebuilt only when relations change. Changes made after Engine.update() show up the next frame, unless propagate() is called.
+/// @note Cameras and lights are positioned by their own Transform only.
+/// @warning main thread only, except set_parent() and clear_parent(), which are queued during the parallel update (see Engine.queue_set_parent())
+class TransformHierarchy {
+    /// Marks a node without a parent
+    static constexpr unsigned int NO_PARENT = -1;
+
+    struct Node {
+        unsigned int thing_id;
+        SpatialThing* thing;
+        /// index of the parent node, always lower than the index of this node
+        unsigned int parent;
+        /// Transform version the world matrix was built from
+        unsigned int local_version;
+        /// if the world matrix changed during the last propagation
+        bool changed;
+    };
+
+    /// child ID -> parent ID, the relations themselves
+    std::unordered_map<unsigned int, unsigned int> parents{};
+    /// parent ID -> child IDs, the same relations the other way around
+    std::unordered_map<unsigned int, std::vector<unsigned int>> children{};
+    /// if nodes have to be rebuilt from parents
+    bool relations_changed = false;
+
+    /// topologically ordered entities that are a parent or a child
+    std::vector<Node> nodes{};
+    /// propagated matrices (same order as nodes)
+    std::vector<glm::mat4> world_matrices{};
+    std::vector<glm::mat3> normal_matrices{};
+
+    /// Orders nodes from the relations, resolves the entities and stores their node index in SpatialThing.hierarchy_index
+    void rebuild();
+public:
+    /// Attaches an entity to a parent, its Transform is then relative to the parent
+    /// @param child_id ID of a SpatialThing
+    /// @param parent_id ID of a SpatialThing, ThingSlotMap::NULL_ID detaches the child
+    /// @returns false if the relation would create a cycle, during the parallel update always true, a cycle is reported when the queued link is applied
+    /// @note entities spawned this frame may be attached right away (e.g. in a constructor), relations of IDs that aren't SpatialThings are dropped during propagation
+    bool set_parent(unsigned int child_id, unsigned int parent_id);
+    /// Detaches an entity from its parent, its Transform is then interpreted in world space again
+    void clear_parent(unsigned int child_id);
+    /// Returns the parent ID or ThingSlotMap::NULL_ID
+    [[nodiscard]] unsigned int get_parent(unsigned int child_id) const;
+    /// Returns the IDs of the direct children
+    [[nodiscard]] std::vector<unsigned int> get_children(unsigned int parent_id) const;
+    /// Drops all relations of an entity, its children are detached. Called by Engine.remove_thing().
+    void remove(unsigned int thing_id);
+
+    /// Rebuilds world matrices of entities whose Transform or any parent changed. Called by Engine.update().
+    void propagate();
+
+    /// World matrix of a node, see SpatialThing.get_world_matrix()
+    [[nodiscard]] const glm::mat4& get_world_matrix(size_t index) const;
+    /// Normal matrix of a node, see SpatialThing.get_world_normal_matrix()
+    [[nodiscard]] const glm::mat3& get_normal_matrix(size_t index) const;
+    /// Amount of entities that are a parent or a child
+    [[nodiscard]] size_t size() const;
+};
+
+#endif //TRANSFORMHIERARCHY_HPP
@@ -0,0 +1,5 @@
+#version 330 core
+
+// depth only draws (depth pre-pass of ForwardOpaque3DPass), paired with the position only instanced vertex shader
+void main(){
+}
@@ -15,6 +15,9 @@ in vec2 UV;
 in vec3 NORMAL;
 in vec3 FRAG_GLOBAL_POS;
 in vec3 CAMERA_GLOBAL_POS;
+#ifdef INSTANCED
+in vec4 TINT;
+#endif
 
 struct Material {
     vec3 diffuse;
@@ -54,7 +57,10 @@ layout (std140) uniform LIGHTS
 
 /* </GRAPHIC ENGINE TEMPLATE CODE> */
 
-uniform Material material;
+layout (std140) uniform MATERIAL
+{
+    Material material;
+};
 
 out vec4 FragColor;
 
@@ -66,4 +72,7 @@ void main() {
     #endif
 
     FragColor = vec4(diffuse, 1.0);
+    #ifdef INSTANCED
+    FragColor *= TINT;
+    #endif
 }
\ No newline at end of file
@@ -20,6 +20,10 @@ in vec3 CAMERA_GLOBAL_POS;
 in mat3 TBN;
 #endif
 
+#ifdef INSTANCED
+in vec4 TINT;
+#endif
+
 /* <GRAPHIC ENGINE DEFAULT MATERIAL> */
 
 struct Material {
@@ -41,7 +45,10 @@ vec2 specular_texture_scale;*/
 #endif
 };
 
-uniform Material material;
+layout (std140) uniform MATERIAL
+{
+    Material material;
+};
 SAMPLER_UNIFORM albedo_texture;
 #ifdef HAS_TANGENTS
 SAMPLER_UNIFORM normal_map;
@@ -75,6 +82,19 @@ layout (std140) uniform LIGHTS
     SpotLight spot_lights[NR_SPOT_LIGHTS];
 };
 
+#ifdef CLUSTERED_LIGHTING
+// point and spot lights culled per screen space cluster on the CPU (see Lights::update_clusters)
+layout (std140) uniform CLUSTERS
+{
+    vec4 cluster_view_depth_row;
+    vec4 cluster_params; // z scale, z bias, tile width, tile height
+    uvec4 cluster_grid_size; // x, y, z, light count
+};
+uniform usamplerBuffer cluster_grid; // per cluster: offset into cluster_light_indices, light count
+uniform usamplerBuffer cluster_light_indices;
+uniform samplerBuffer cluster_lights; // per light: color + intensity, position + range, direction + cut off (< -1 for point lights)
+#endif
+
 /* </GRAPHIC ENGINE TEMPLATE CODE> */
 
 
@@ -116,6 +136,44 @@ mat3 blinn_phong_lighting(){
     //shininess = texture(material.specular_texture, (UV * material.specular_texture_scale) + material.specular_texture_offset).r * material.shininess;
     #endif
 
+    #ifdef CLUSTERED_LIGHTING
+    float view_depth = -dot(cluster_view_depth_row, vec4(FRAG_GLOBAL_POS, 1.0));
+    ivec3 cluster = ivec3(
+        ivec2(gl_FragCoord.xy / cluster_params.zw),
+        int(log(max(view_depth, 0.0001)) * cluster_params.x + cluster_params.y)
+    );
+    cluster = clamp(cluster, ivec3(0), ivec3(cluster_grid_size.xyz) - 1);
+    uvec2 cluster_range = texelFetch(cluster_grid, (cluster.z * int(cluster_grid_size.y) + cluster.y) * int(cluster_grid_size.x) + cluster.x).xy;
+
+    for (uint i = 0u; i < cluster_range.y; i++){
+        int light = int(texelFetch(cluster_light_indices, int(cluster_range.x + i)).r) * 3;
+        vec4 light_data = texelFetch(cluster_lights, light);
+        vec4 position_range = texelFetch(cluster_lights, light + 1);
+        vec4 direction_cut_off = texelFetch(cluster_lights, light + 2);
+
+        vec3 dir_to_light = position_range.xyz - FRAG_GLOBAL_POS;
+        float dist_to_light = length(dir_to_light);
+        vec3 dir = dir_to_light / max(dist_to_light, 0.0001);
+
+        float attenuation;
+        if (direction_cut_off.w < -1.5) {
+            attenuation = light_data.w / (1 + pow(dist_to_light, 2));
+        } else {
+            float theta = dot(dir, normalize(-direction_cut_off.xyz));
+            attenuation = min(max(theta - direction_cut_off.w, 0.0) * 50, 1.0);
+        }
+        // fade out towards the range, so lights don't pop at cluster borders
+        float fade = clamp(1.0 - pow(dist_to_light / position_range.w, 4), 0.0, 1.0);
+        attenuation *= fade * fade;
+
+        float diff = max(dot(norm, dir), 0.0);
+        out_light[1] += light_data.rgb * diff * attenuation;
+
+        vec3 halfway_dir = normalize(dir + view_dir);
+        float spec2 = pow(max(dot(norm, halfway_dir), 0.0), 1.0f + shininess);
+        out_light[2] += spec2 * light_data.rgb * attenuation;
+    }
+    #else
     for(int i = 0; i < NR_POINT_LIGHTS; i++){
         vec4 light_data = point_lights[i].light_data;
         vec3 dir_to_light = point_lights[i].position - FRAG_GLOBAL_POS;
@@ -134,6 +192,8 @@ mat3 blinn_phong_lighting(){
         out_light[2] += spec2 * light_data.rgb * attenuation;
     }
 
+    #endif
+
     for(int i = 0; i < NR_DIRECTIONAL_LIGHTS; i++){
         vec4 light_data = directional_lights[i].light_data;
         /// diffuse
@@ -149,6 +209,7 @@ mat3 blinn_phong_lighting(){
         out_light[2] += light_data.rgb * spec2;
     }
 
+    #ifndef CLUSTERED_LIGHTING
     for (int i = 0; i < NR_SPOT_LIGHTS; i++){
         vec4 light_data = spot_lights[i].light_data;
         vec3 dir_to_light = normalize(spot_lights[i].position - FRAG_GLOBAL_POS);
@@ -164,6 +225,7 @@ mat3 blinn_phong_lighting(){
         float spec2 = pow(max(dot(norm, halfway_dir), 0.0), 1.0f + shininess);
         out_light[2] += light_data.rgb * spec2 * attenuation;
     }
+    #endif
 
     return out_light;
 }
@@ -176,6 +238,10 @@ void main() {
     result.xyz = (BASE_AMBINET_LIGHT * material.ambient) + (lighting[1] * material.diffuse) + (lighting[2] * material.specular);
     result.xyz *= material.albedo_color;
 
+    #ifdef INSTANCED
+    result *= TINT;
+    #endif
+
     #ifdef HAS_UV
     result *= texture(albedo_texture, (UV * material.albedo_texture_scale));
 
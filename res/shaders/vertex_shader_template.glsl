@@ -5,23 +5,44 @@ layout (location = 0) in vec3 VERTEX_POS;
 layout (location = 1) in vec2 TEXTURE_COORDS;
 #endif
 
+// octahedral normals and tangents arrive as 2 normalized shorts (see VertexFormat)
+#ifdef OCTAHEDRAL_NORMALS
+#define DIRECTION_ATTRIBUTE vec2
+#else
+#define DIRECTION_ATTRIBUTE vec3
+#endif
+
 #if defined(HAS_NORMALS) && defined(HAS_UV)
-layout (location = 2) in vec3 NORMALS;
+layout (location = 2) in DIRECTION_ATTRIBUTE NORMALS_ATTRIBUTE;
 #elif defined(HAS_NORMALS)
-layout (location = 1) in vec3 NORMALS;
+layout (location = 1) in DIRECTION_ATTRIBUTE NORMALS_ATTRIBUTE;
 #endif
 
 #if defined(HAS_NORMALS) && defined(HAS_UV) && defined(HAS_TANGENTS)
-layout (location = 3) in vec3 TANGENT;
+layout (location = 3) in DIRECTION_ATTRIBUTE TANGENT_ATTRIBUTE;
+#endif
+
+#ifdef INSTANCED
+// per instance data streamed from the instance buffer (see InstanceData)
+layout (location = 4) in mat4 INSTANCE_TRANSFORM;
+layout (location = 8) in mat3 INSTANCE_NORMAL_MATRIX;
+layout (location = 11) in vec4 INSTANCE_TINT;
+out vec4 TINT;
 #endif
 
+// depth only draws (depth pre-pass) use this template too, their depth has to match exactly
+invariant gl_Position;
+
 layout (std140) uniform MATRICES
 {
     mat4 projection;
     mat4 view;
 };
 
+#ifndef INSTANCED
+// with QUANTIZED_POSITIONS it also holds the dequantization of the mesh (see Mesh.get_dequantization_matrix())
 uniform mat4 transform;
+#endif
 
 out vec3 FRAG_GLOBAL_POS;
 out vec3 CAMERA_GLOBAL_POS;
@@ -31,7 +52,9 @@ out vec2 UV;
 #endif
 
 #ifdef HAS_NORMALS
+#ifndef INSTANCED
 uniform mat3 normal_matrix;
+#endif
 out vec3 NORMAL;
 #endif
 
@@ -39,21 +62,50 @@ out vec3 NORMAL;
 out mat3 TBN;
 #endif
 
+#ifdef OCTAHEDRAL_NORMALS
+vec3 decode_octahedral(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+#define DECODE_DIRECTION(e) decode_octahedral(e)
+#else
+#define DECODE_DIRECTION(e) (e)
+#endif
+
 void main(){
-    gl_Position = projection * view * transform * vec4(VERTEX_POS, 1.0);
-    FRAG_GLOBAL_POS = vec3(transform * vec4(VERTEX_POS, 1.0));
+#ifdef INSTANCED
+    mat4 model = INSTANCE_TRANSFORM;
+    TINT = INSTANCE_TINT;
+#else
+    mat4 model = transform;
+#endif
+    gl_Position = projection * view * model * vec4(VERTEX_POS, 1.0);
+    FRAG_GLOBAL_POS = vec3(model * vec4(VERTEX_POS, 1.0));
     CAMERA_GLOBAL_POS = -view[3].xyz;
 #ifdef HAS_UV
     UV = TEXTURE_COORDS;
 #endif
 
 #ifdef HAS_NORMALS
+    vec3 NORMALS = DECODE_DIRECTION(NORMALS_ATTRIBUTE);
+#ifdef INSTANCED
+    NORMAL = INSTANCE_NORMAL_MATRIX * NORMALS;
+#else
     NORMAL = normal_matrix * NORMALS;
 #endif
+#endif
 
 #ifdef HAS_TANGENTS
-    vec3 T = normalize(vec3(transform * vec4(TANGENT, 0.0)));
-    vec3 N = normalize(vec3(transform * vec4(NORMALS, 0.0)));
+    vec3 TANGENT = DECODE_DIRECTION(TANGENT_ATTRIBUTE);
+    vec3 T = normalize(vec3(model * vec4(TANGENT, 0.0)));
+#ifdef QUANTIZED_POSITIONS
+    // the model matrix also scales the quantized positions, tangents are stored scaled against it, normals aren't
+    vec3 N = normalize(NORMAL);
+#else
+    vec3 N = normalize(vec3(model * vec4(NORMALS, 0.0)));
+#endif
     vec3 B = cross(N, T);
     TBN = mat3(T, B, N);
 #endif
@@ -0,0 +1,109 @@
+#include "bounds.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+BoundingBox::BoundingBox(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {
+
+}
+
+bool BoundingBox::is_empty() const {
+    return min.x > max.x or min.y > max.y or min.z > max.z;
+}
+
+glm::vec3 BoundingBox::get_center() const {
+    return (min + max) * 0.5f;
+}
+
+glm::vec3 BoundingBox::get_extents() const {
+    return (max - min) * 0.5f;
+}
+
+void BoundingBox::expand(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void BoundingBox::expand(const BoundingBox &box) {
+    if (box.is_empty())
+        return;
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4 &matrix) const {
+    if (is_empty())
+        return *this;
+
+    // transform center, extents get projected onto the new axes (Arvo)
+    const glm::vec3 center = glm::vec3(matrix * glm::vec4(get_center(), 1.0f));
+    const glm::vec3 extents = get_extents();
+    glm::vec3 new_extents{0.0f};
+    for (int column = 0; column < 3; column++) {
+        new_extents += glm::abs(glm::vec3(matrix[column])) * extents[column];
+    }
+    return {center - new_extents, center + new_extents};
+}
+
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4 &matrix) const {
+    const float scale_x = glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0]));
+    const float scale_y = glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1]));
+    const float scale_z = glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]));
+
+    BoundingSphere sphere;
+    sphere.center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+    sphere.radius = radius * std::sqrt(std::max(scale_x, std::max(scale_y, scale_z)));
+    return sphere;
+}
+
+
+Frustum::Frustum(const glm::mat4 &view_projection) {
+    // rows of the matrix (glm is column major)
+    const glm::vec4 row_x{view_projection[0][0], view_projection[1][0], view_projection[2][0], view_projection[3][0]};
+    const glm::vec4 row_y{view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1]};
+    const glm::vec4 row_z{view_projection[0][2], view_projection[1][2], view_projection[2][2], view_projection[3][2]};
+    const glm::vec4 row_w{view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]};
+
+    planes[0] = row_w + row_x; // left
+    planes[1] = row_w - row_x; // right
+    planes[2] = row_w + row_y; // bottom
+    planes[3] = row_w - row_y; // top
+    planes[4] = row_w + row_z; // near
+    planes[5] = row_w - row_z; // far
+
+    for (auto& plane : planes) {
+        const float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane /= length;
+    }
+}
+
+const glm::vec4& Frustum::get_plane(const size_t index) const {
+    return planes[index];
+}
+
+bool Frustum::intersects(const BoundingBox &box) const {
+    if (box.is_empty())
+        return true;
+
+    const glm::vec3 center = box.get_center();
+    const glm::vec3 extents = box.get_extents();
+    for (const auto& plane : planes) {
+        const glm::vec3 normal{plane};
+        // distance of the center and the projected radius of the box onto the plane normal
+        const float distance = glm::dot(normal, center) + plane.w;
+        const float radius = glm::dot(glm::abs(normal), extents);
+        if (distance + radius < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const BoundingSphere &sphere) const {
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+            return false;
+    }
+    return true;
+}
@@ -1,6 +1,7 @@
 #include "coordinates.h"
 
 #include "graphicengine.hpp"
+#include "gtc/matrix_inverse.hpp"
 
 
 Vector3::Vector3(const float _x, const float _y, const float _z) {
@@ -266,6 +267,51 @@ void Rotation::rotate_point(float _x, float _y, float _z, Vector3& point) {
 }
 
 
+std::array<float, 9> Transform::current_state() const {
+    return {
+        position.x, position.y, position.z,
+        rotation.x, rotation.y, rotation.z,
+        scale.x, scale.y, scale.z
+    };
+}
+
+void Transform::update_matrices() {
+    const auto state = current_state();
+    if (!dirty and state == cached_state)
+        return;
+
+    world_matrix = position.get_transformation_matrix() * rotation.get_transformation_matrix() * scale.get_transformation_matrix();
+    normal_matrix = glm::mat3(glm::inverseTranspose(world_matrix));
+
+    cached_state = state;
+    dirty = false;
+    version += 1;
+}
+
+void Transform::mark_dirty() {
+    dirty = true;
+}
+
+bool Transform::is_dirty() const {
+    return dirty or current_state() != cached_state;
+}
+
+const glm::mat4& Transform::get_world_matrix() {
+    update_matrices();
+    return world_matrix;
+}
+
+const glm::mat3& Transform::get_normal_matrix() {
+    update_matrices();
+    return normal_matrix;
+}
+
+unsigned int Transform::get_version() {
+    update_matrices();
+    return version;
+}
+
+
 Color::Color(float _r, float _g, float _b, float _a, bool auto_sRGB) {
     r = _r;
     g = _g;
@@ -0,0 +1,191 @@
+#include "geometryarena.hpp"
+#include <glad/glad.h>
+#include "graphicengine.hpp"
+
+
+FreeListAllocator::FreeListAllocator(const unsigned int capacity) : free_size(capacity) {
+    if (capacity > 0)
+        free_ranges[0] = capacity;
+}
+
+unsigned int FreeListAllocator::allocate(const unsigned int size) {
+    if (size == 0 or size > free_size)
+        return INVALID_OFFSET;
+
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+        if (it->second < size)
+            continue;
+
+        const unsigned int offset = it->first;
+        const unsigned int remaining = it->second - size;
+        free_ranges.erase(it);
+        if (remaining > 0)
+            free_ranges[offset + size] = remaining;
+        free_size -= size;
+        return offset;
+    }
+    return INVALID_OFFSET;
+}
+
+void FreeListAllocator::free(unsigned int offset, unsigned int size) {
+    if (size == 0)
+        return;
+    free_size += size;
+
+    // merge with the following range
+    auto next = free_ranges.lower_bound(offset);
+    if (next != free_ranges.end() and next->first == offset + size) {
+        size += next->second;
+        next = free_ranges.erase(next);
+    }
+    // merge with the preceding range
+    if (next != free_ranges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    free_ranges[offset] = size;
+}
+
+unsigned int FreeListAllocator::get_free_size() const {
+    return free_size;
+}
+
+
+GeometryArena::GeometryArena(const VertexLayout& layout, const unsigned int index_size, const unsigned int vertex_capacity, const unsigned int index_capacity, const bool position_stream) : layout(layout), index_size(index_size), vertex_allocator(vertex_capacity), index_allocator(index_capacity) {
+    if (position_stream) {
+        glGenBuffers(1, &position_buffer_object);
+        glBindBuffer(GL_ARRAY_BUFFER, position_buffer_object);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertex_capacity) * layout.get_position_size(), nullptr, GL_STATIC_DRAW);
+    }
+
+    glGenBuffers(1, &vertex_buffer_object);
+    glGenBuffers(1, &element_buffer_object);
+    glGenVertexArrays(1, &vertex_array_object);
+
+    ge.gl_state.bind_vertex_array(vertex_array_object);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertex_capacity) * layout.get_vertex_size(), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_capacity) * index_size, nullptr, GL_STATIC_DRAW);
+
+    layout.setup_vertex_attributes();
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ge.gl_state.bind_vertex_array(0);
+}
+
+
+bool GeometryArena::allocate(const std::span<const std::byte> vertex_data, const std::span<const std::byte> index_data, GeometryAllocation& allocation) {
+    const unsigned int vertex_size = layout.get_vertex_size();
+    const auto vertex_count = static_cast<unsigned int>(vertex_data.size() / vertex_size);
+    const auto index_count = static_cast<unsigned int>(index_data.size() / index_size);
+
+    const unsigned int base_vertex = vertex_allocator.allocate(vertex_count);
+    if (base_vertex == FreeListAllocator::INVALID_OFFSET)
+        return false;
+    const unsigned int first_index = index_allocator.allocate(index_count);
+    if (first_index == FreeListAllocator::INVALID_OFFSET) {
+        vertex_allocator.free(base_vertex, vertex_count);
+        return false;
+    }
+
+    allocation = GeometryAllocation{base_vertex, vertex_count, first_index, index_count};
+
+    // the element buffer binding is VAO state, so bind our own VAO to not change another one
+    ge.gl_state.bind_vertex_array(vertex_array_object);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(base_vertex) * vertex_size, static_cast<GLsizeiptr>(vertex_count) * vertex_size, vertex_data.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(first_index) * index_size, static_cast<GLsizeiptr>(index_count) * index_size, index_data.data());
+    if (position_buffer_object != 0) {
+        std::vector<std::byte> positions{};
+        layout.extract_positions(vertex_data, positions);
+        glBindBuffer(GL_ARRAY_BUFFER, position_buffer_object);
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(base_vertex) * layout.get_position_size(), static_cast<GLsizeiptr>(positions.size()), positions.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ge.gl_state.bind_vertex_array(0);
+    return true;
+}
+
+void GeometryArena::free(const GeometryAllocation& allocation) {
+    vertex_allocator.free(allocation.base_vertex, allocation.vertex_count);
+    index_allocator.free(allocation.first_index, allocation.index_count);
+}
+
+
+unsigned int GeometryArena::get_vertex_array_object() const {
+    return vertex_array_object;
+}
+
+unsigned int GeometryArena::get_instanced_vertex_array_object(const unsigned int instance_buffer) {
+    if (instanced_vertex_array_object != 0 and instanced_vao_instance_buffer == instance_buffer)
+        return instanced_vertex_array_object;
+
+    if (instanced_vertex_array_object == 0)
+        glGenVertexArrays(1, &instanced_vertex_array_object);
+    instanced_vao_instance_buffer = instance_buffer;
+
+    ge.gl_state.bind_vertex_array(instanced_vertex_array_object);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object);
+    layout.setup_vertex_attributes();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object);
+    InstanceData::setup_vertex_attributes(instance_buffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ge.gl_state.bind_vertex_array(0);
+    return instanced_vertex_array_object;
+}
+
+unsigned int GeometryArena::get_depth_vertex_array_object(const unsigned int instance_buffer) {
+    if (depth_vertex_array_object != 0 and depth_vao_instance_buffer == instance_buffer)
+        return depth_vertex_array_object;
+
+    if (depth_vertex_array_object == 0)
+        glGenVertexArrays(1, &depth_vertex_array_object);
+    depth_vao_instance_buffer = instance_buffer;
+
+    ge.gl_state.bind_vertex_array(depth_vertex_array_object);
+    const bool position_stream = position_buffer_object != 0;
+    glBindBuffer(GL_ARRAY_BUFFER, position_stream ? position_buffer_object : vertex_buffer_object);
+    layout.setup_position_attribute(position_stream);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object);
+    InstanceData::setup_vertex_attributes(instance_buffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ge.gl_state.bind_vertex_array(0);
+    return depth_vertex_array_object;
+}
+
+bool GeometryArena::has_position_stream() const {
+    return position_buffer_object != 0;
+}
+
+const VertexLayout& GeometryArena::get_layout() const {
+    return layout;
+}
+
+unsigned int GeometryArena::get_index_type() const {
+    return index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+
+GeometryArena::~GeometryArena() {
+    ge.gl_state.forget_vertex_array(vertex_array_object);
+    glDeleteVertexArrays(1, &vertex_array_object);
+    if (instanced_vertex_array_object != 0) {
+        ge.gl_state.forget_vertex_array(instanced_vertex_array_object);
+        glDeleteVertexArrays(1, &instanced_vertex_array_object);
+    }
+    if (depth_vertex_array_object != 0) {
+        ge.gl_state.forget_vertex_array(depth_vertex_array_object);
+        glDeleteVertexArrays(1, &depth_vertex_array_object);
+    }
+    glDeleteBuffers(1, &vertex_buffer_object);
+    glDeleteBuffers(1, &element_buffer_object);
+    if (position_buffer_object != 0)
+        glDeleteBuffers(1, &position_buffer_object);
+}
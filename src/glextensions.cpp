@@ -0,0 +1,57 @@
+#include "glextensions.hpp"
+#include "graphicengine.hpp"
+
+
+bool GLExtensions::has_version(const int major, const int minor) {
+    return GLVersion.major > major or (GLVersion.major == major and GLVersion.minor >= minor);
+}
+
+
+void GLExtensions::load() {
+    // base_instance is needed so every draw of a multi draw reads its own range of the instance buffer
+    const bool base_instance = has_version(4, 2) or glfwExtensionSupported("GL_ARB_base_instance");
+    const bool indirect = has_version(4, 3) or (glfwExtensionSupported("GL_ARB_draw_indirect") and glfwExtensionSupported("GL_ARB_multi_draw_indirect"));
+
+    if (base_instance and indirect) {
+        multi_draw_elements_indirect = reinterpret_cast<MultiDrawElementsIndirectProc>(glfwGetProcAddress("glMultiDrawElementsIndirect"));
+    }
+    multi_draw_indirect = multi_draw_elements_indirect != nullptr;
+
+    if (multi_draw_indirect) {
+        Engine::debug_message("Multi draw indirect supported!");
+    } else {
+        Engine::debug_message("Multi draw indirect NOT supported!");
+    }
+
+    if (has_version(4, 1) or glfwExtensionSupported("GL_ARB_get_program_binary")) {
+        get_program_binary = reinterpret_cast<GetProgramBinaryProc>(glfwGetProcAddress("glGetProgramBinary"));
+        program_binary = reinterpret_cast<ProgramBinaryProc>(glfwGetProcAddress("glProgramBinary"));
+        program_parameteri = reinterpret_cast<ProgramParameteriProc>(glfwGetProcAddress("glProgramParameteri"));
+    }
+    // drivers may expose the functions without any format to save in
+    int binary_format_count = 0;
+    if (get_program_binary != nullptr)
+        glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &binary_format_count);
+    program_binaries = get_program_binary != nullptr and program_binary != nullptr and program_parameteri != nullptr and binary_format_count > 0;
+
+    if (program_binaries) {
+        Engine::debug_message("Program binaries supported!");
+    } else {
+        Engine::debug_message("Program binaries NOT supported!");
+    }
+
+    // BC5 (RGTC) is core since GL 3.0
+    texture_compression_s3tc = glfwExtensionSupported("GL_EXT_texture_compression_s3tc");
+    texture_compression_bptc = has_version(4, 2) or glfwExtensionSupported("GL_ARB_texture_compression_bptc");
+
+    if (texture_compression_s3tc) {
+        Engine::debug_message("S3TC texture compression supported!");
+    } else {
+        Engine::debug_message("S3TC texture compression NOT supported!");
+    }
+    if (texture_compression_bptc) {
+        Engine::debug_message("BPTC texture compression supported!");
+    } else {
+        Engine::debug_message("BPTC texture compression NOT supported!");
+    }
+}
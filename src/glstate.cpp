@@ -0,0 +1,156 @@
+#include "glstate.hpp"
+#include <algorithm>
+
+
+bool GLState::count(const Category category, const bool redundant) {
+    if (redundant) {
+        counters[category].skipped += 1;
+        return false;
+    }
+    counters[category].issued += 1;
+    return true;
+}
+
+void GLState::use_program(const unsigned int program_id) {
+    if (!count(PROGRAM, program == program_id))
+        return;
+    program = program_id;
+    glUseProgram(program_id);
+}
+
+void GLState::bind_vertex_array(const unsigned int vertex_array_object) {
+    if (!count(VERTEX_ARRAY, vertex_array == vertex_array_object))
+        return;
+    vertex_array = vertex_array_object;
+    glBindVertexArray(vertex_array_object);
+}
+
+void GLState::bind_texture(const unsigned int unit, const GLenum target, const unsigned int texture) {
+    const bool tracked = unit < MAX_TEXTURE_UNITS;
+    if (!count(TEXTURE, tracked and textures[unit].target == target and textures[unit].texture == texture))
+        return;
+    if (active_texture_unit != unit) {
+        active_texture_unit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    glBindTexture(target, texture);
+    if (tracked)
+        textures[unit] = TextureBinding{target, texture};
+}
+
+void GLState::bind_uniform_buffer_range(const unsigned int index, const unsigned int buffer, const size_t offset, const size_t size) {
+    const bool tracked = index < MAX_UNIFORM_BUFFER_BINDINGS;
+    if (!count(UNIFORM_BUFFER, tracked and uniform_buffers[index].buffer == buffer and uniform_buffers[index].offset == offset and uniform_buffers[index].size == size))
+        return;
+    glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+    if (tracked)
+        uniform_buffers[index] = BufferRange{buffer, offset, size};
+}
+
+void GLState::set_capability(const GLenum capability, const bool enabled) {
+    const auto it = std::ranges::find(capabilities, capability, &std::pair<GLenum, bool>::first);
+    if (!count(CAPABILITY, it != capabilities.end() and it->second == enabled))
+        return;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+    if (it != capabilities.end())
+        it->second = enabled;
+    else
+        capabilities.emplace_back(capability, enabled);
+}
+
+void GLState::set_depth_func(const GLenum func) {
+    if (!count(WRITE_STATE, depth_func == func))
+        return;
+    depth_func = func;
+    glDepthFunc(func);
+}
+
+GLenum GLState::get_depth_func() {
+    if (depth_func == UNKNOWN) {
+        GLint func = GL_LESS;
+        glGetIntegerv(GL_DEPTH_FUNC, &func);
+        depth_func = static_cast<GLenum>(func);
+    }
+    return depth_func;
+}
+
+void GLState::set_depth_mask(const bool write) {
+    if (!count(WRITE_STATE, depth_mask == static_cast<unsigned int>(write)))
+        return;
+    depth_mask = write;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+bool GLState::get_depth_mask() {
+    if (depth_mask == UNKNOWN) {
+        GLboolean write = GL_TRUE;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &write);
+        depth_mask = write == GL_TRUE;
+    }
+    return depth_mask;
+}
+
+void GLState::set_color_mask(const bool red, const bool green, const bool blue, const bool alpha) {
+    const unsigned int mask = red | green << 1 | blue << 2 | alpha << 3;
+    if (!count(WRITE_STATE, color_mask == mask))
+        return;
+    color_mask = mask;
+    glColorMask(red, green, blue, alpha);
+}
+
+void GLState::forget_program(const unsigned int program_id) {
+    if (program == program_id)
+        program = UNKNOWN;
+}
+
+void GLState::forget_vertex_array(const unsigned int vertex_array_object) {
+    if (vertex_array == vertex_array_object)
+        vertex_array = UNKNOWN;
+}
+
+void GLState::forget_texture(const unsigned int texture) {
+    for (TextureBinding& binding : textures) {
+        if (binding.texture == texture)
+            binding = TextureBinding{};
+    }
+}
+
+void GLState::forget_buffer(const unsigned int buffer) {
+    for (BufferRange& range : uniform_buffers) {
+        if (range.buffer == buffer)
+            range = BufferRange{};
+    }
+}
+
+void GLState::invalidate() {
+    program = UNKNOWN;
+    vertex_array = UNKNOWN;
+    active_texture_unit = UNKNOWN;
+    textures.fill(TextureBinding{});
+    uniform_buffers.fill(BufferRange{});
+    capabilities.clear();
+    depth_func = UNKNOWN;
+    depth_mask = UNKNOWN;
+    color_mask = UNKNOWN;
+}
+
+void GLState::end_frame() {
+    last_frame_counters = counters;
+    counters.fill(CallCounters{});
+}
+
+const GLState::CallCounters& GLState::get_frame_counters(const Category category) const {
+    return last_frame_counters[category];
+}
+
+GLState::CallCounters GLState::get_frame_counters() const {
+    CallCounters total{};
+    for (const CallCounters& category : last_frame_counters) {
+        total.issued += category.issued;
+        total.skipped += category.skipped;
+    }
+    return total;
+}
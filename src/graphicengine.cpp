@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include "graphicengine.hpp"
 
@@ -12,6 +13,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     // we work with the premiss that we have only one window
     glViewport(0, 0, width, height);
     const auto engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+    engine->window.framebuffer_width = width;
+    engine->window.framebuffer_height = height;
     if (!engine->window.is_fullscreen()) {
         engine->window.width = width;
         engine->window.height = height;
@@ -23,7 +26,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 }
 
     /* Create a windowed mode window and its OpenGL context */
-Window::Window(const char* title, const int _width, const int _height, const bool _fullscreen) : fullscreen(_fullscreen) {
+Window::Window(const char* title, const int _width, const int _height, const bool _fullscreen, const bool _visible) : fullscreen(_fullscreen) {
     if (glfwGetCurrentContext()) {
         std::cerr << "ENGINE ERROR: A window already exists, only one window allowed!" << std::endl;
         return;
@@ -36,6 +39,9 @@ Window::Window(const char* title, const int _width, const int _height, const boo
 
     width = _width;
     height = _height;
+    framebuffer_width = width;
+    framebuffer_height = height;
+    glfwWindowHint(GLFW_VISIBLE, _visible ? GLFW_TRUE : GLFW_FALSE);
     if (!fullscreen) {
         glfwwindow = glfwCreateWindow(width, height, title, nullptr, nullptr);
     } else {
@@ -43,7 +49,10 @@ Window::Window(const char* title, const int _width, const int _height, const boo
         const GLFWvidmode* mode = glfwGetVideoMode(main_monitor);
         glfwwindow = glfwCreateWindow(mode->width, mode->height, title, main_monitor, nullptr);
     }
+    if (!glfwwindow)
+        return;
     glfwSetFramebufferSizeCallback(glfwwindow, framebuffer_size_callback);
+    glfwGetFramebufferSize(glfwwindow, &framebuffer_width, &framebuffer_height);
     glfwGetWindowPos(glfwwindow, &pos_x, &pos_x);
 }
 
@@ -85,8 +94,8 @@ bool Window::is_fullscreen() const {
     return fullscreen;
 }
 
-Thing *Engine::get_thing(const unsigned int id) {
-    return things[id].get();
+Thing *Engine::get_thing(const unsigned int id) const {
+    return things.get(id);
 }
 
 RenderPass *Engine::get_render_layer(const int id) {
@@ -99,7 +108,7 @@ void Engine::init_render_pipeline() {
     color_buffer_cleared_this_frame = false;
     depth_buffer_cleared_this_frame = false;
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glEnable(GL_DEPTH_TEST);
+    gl_state.set_capability(GL_DEPTH_TEST, true);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -108,28 +117,86 @@ void Engine::init_render_pipeline() {
     glBindBuffer(GL_UNIFORM_BUFFER, camera_matrix_ubo);
     glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, camera_matrix_ubo, 0, 2 * sizeof(glm::mat4));
+    gl_state.bind_uniform_buffer_range(0, camera_matrix_ubo, 0, 2 * sizeof(glm::mat4));
 }
 
 
 void Engine::update() {
+    GE_PROFILE_ZONE("Engine::update");
     if (!inputs_pooled_this_frame)
         pool_inputs();
 
-    // update entities
-    things_container::const_iterator it;
+    // finish asynchronously loaded resources, within the per frame budget
+    resources.process_uploads();
 
+    // update entities (dense array, new entities go to temp_things, removals are queued, so the array doesn't change)
     in_update_loop = true;
-    for (it = things.begin(); it != things.end(); it++) {
-        if (!it->second->paused) {
-            it->second->update();
+    const size_t thing_count = things.size();
+
+    // thread-safe entities first, in chunks on the workers, spawns and removals go to the buffer of the updating thread
+    parallel_things.clear();
+    for (size_t i = 0; i < thing_count; i++) {
+        Thing* thing = things.at_dense(i);
+        if (thing->parallel_update and !thing->paused) {
+            parallel_things.push_back(thing);
+        }
+    }
+    if (!parallel_things.empty()) {
+        GE_PROFILE_ZONE("Parallel Thing update");
+        const size_t chunk_size = std::max(parallel_update_chunk_size, 1u);
+        const size_t chunk_count = (parallel_things.size() + chunk_size - 1) / chunk_size;
+        // workers reading entities while others spawn, the slot map must not grow, spawns take prepared free slots
+        things.ensure_free_slots(parallel_spawn_budget);
+        things.set_growth_allowed(false);
+        in_parallel_update = true;
+        workers.parallel_for(chunk_count, [this, chunk_size](const size_t chunk) {
+            GE_PROFILE_ZONE("Thing update chunk");
+            const size_t end = std::min(parallel_things.size(), (chunk + 1) * chunk_size);
+            for (size_t i = chunk * chunk_size; i < end; i++) {
+                parallel_things[i]->update();
+            }
+        });
+        in_parallel_update = false;
+        things.set_growth_allowed(true);
+
+        // merge in thread order, so the serial phase sees them as if they were spawned / queued there
+        for (UpdateBuffer& buffer : update_buffers) {
+            for (auto& [id, construct] : buffer.added_things) {
+                temp_things.emplace_back(id, construct());
+            }
+            buffer.added_things.clear();
+            queued_things_to_be_removed.insert(queued_things_to_be_removed.end(), buffer.removed_things.begin(), buffer.removed_things.end());
+            buffer.removed_things.clear();
+            for (const auto& [child_id, parent_id] : buffer.parent_links) {
+                transforms.set_parent(child_id, parent_id);
+            }
+            buffer.parent_links.clear();
+            for (const auto& spawn : buffer.overflow_spawns) {
+                spawn();
+            }
+            buffer.overflow_spawns.clear();
+            for (const unsigned int id : buffer.released_ids) {
+                things.release(id);
+            }
+            buffer.released_ids.clear();
+        }
+    }
+
+    // everything else in order on this thread
+    {
+        GE_PROFILE_ZONE("Serial Thing update");
+        for (size_t i = 0; i < thing_count; i++) {
+            Thing* thing = things.at_dense(i);
+            if (!thing->paused and !thing->parallel_update) {
+                thing->update();
+            }
         }
     }
     in_update_loop = false;
 
     // add queue entities
     for (auto& pair : temp_things) {
-        things[pair.first] = std::move(pair.second);
+        insert_thing(pair.first, std::move(pair.second));
     }
     temp_things.clear();
 
@@ -138,6 +205,9 @@ void Engine::update() {
         remove_thing(id);
     }
     queued_things_to_be_removed.clear();
+
+    // world matrices of attached entities, after all the movement and relation changes of this frame
+    transforms.propagate();
 }
 
 void Engine::pool_inputs() {
@@ -148,7 +218,14 @@ void Engine::pool_inputs() {
 
 void Engine::send_to_window() {
     /* Swap front and back buffers */
-    glfwSwapBuffers(window.glfwwindow);
+    {
+        GE_PROFILE_ZONE("glfwSwapBuffers");
+        glfwSwapBuffers(window.glfwwindow);
+    }
+    gl_state.end_frame();
+#ifdef GE_PROFILER
+    profiler.end_frame();
+#endif
 
     // input update to correctly adjust just pressed keys
     input.update();
@@ -195,41 +272,70 @@ bool Engine::are_bindless_textures_supported() const {
 }
 
 unsigned int Engine::get_next_geRef_id() {
-    if (!deleted_geRef_ids.empty()) {
-        const auto id = deleted_geRef_ids.front();
-        deleted_geRef_ids.pop_front();
-        last_used_thing_id = id;
-        return id;
-    }
-
-    next_thing_id += 1;
-    last_used_thing_id = next_thing_id;
-    return next_thing_id;
+    last_used_thing_id = things.reserve();
+    return last_used_thing_id;
 }
 
 unsigned int Engine::get_last_used_geRef_id() const {
     return last_used_thing_id;
 }
 
+unsigned int Engine::get_constructing_thing_id() {
+    return constructing_thing_id;
+}
+
 void Engine::queue_remove_thing(unsigned int id) {
+    if (in_parallel_update) {
+        update_buffers[ThreadPool::get_worker_index()].removed_things.push_back(id);
+        return;
+    }
     queued_things_to_be_removed.push_back(id);
 }
 
+void Engine::queue_set_parent(const unsigned int child_id, const unsigned int parent_id) {
+    if (in_parallel_update) {
+        update_buffers[ThreadPool::get_worker_index()].parent_links.emplace_back(child_id, parent_id);
+        return;
+    }
+    transforms.set_parent(child_id, parent_id);
+}
+
+bool Engine::is_in_parallel_update() const {
+    return in_parallel_update;
+}
+
+
+void Engine::insert_thing(const unsigned int id, std::unique_ptr<Thing> thing) {
+    if (const auto d = dynamic_cast<MeshThing*>(thing.get())) {
+        d->mesh_thing_index = mesh_things.size();
+        mesh_things.push_back(d);
+        d->get_material_pointer()->mesh_thing_count += 1;
+    }
+    things.insert(id, std::move(thing));
+}
+
 
 void Engine::remove_thing(const unsigned int id) {
+    // other threads may be reading the entity right now
+    if (in_parallel_update) {
+        queue_remove_thing(id);
+        return;
+    }
     const auto thing = get_thing(id);
+    if (thing == nullptr) {
+        debug_warning("Removing a Thing with a stale or invalid ID (" + std::to_string(id) + "). Ignoring it.");
+        return;
+    }
     thing->on_remove();
-    // delete from material : id structure
+    // children stay, detached
+    transforms.remove(id);
+    // swap remove from the renderable list
     if (const auto d = dynamic_cast<MeshThing*>(thing)) {
-        const auto [fst, snd] = thing_ids_by_shader_program.equal_range(d->get_material());
-
-        // delete specific key value pair
-        for (auto it = fst; it != snd; ++it) {
-            if (it->second == id) {
-                thing_ids_by_shader_program.erase(it);
-                break;
-            }
-        }
+        MeshThing* last = mesh_things.back();
+        mesh_things[d->mesh_thing_index] = last;
+        last->mesh_thing_index = d->mesh_thing_index;
+        mesh_things.pop_back();
+        d->get_material_pointer()->mesh_thing_count -= 1;
     }
 
     if (dynamic_cast<PointLight*>(thing)) {
@@ -240,8 +346,7 @@ void Engine::remove_thing(const unsigned int id) {
         ge.lights.remove_spot_light(id);
     }
 
-    deleted_geRef_ids.push_back(id);
-
+    // frees the slot, all geRefs holding this ID are now stale
     things.erase(id);
 }
 
@@ -252,9 +357,11 @@ Engine::Engine(
     const int screen_height,
     const EngineSettings options
     ) :
-    window(display_name, screen_width, screen_height, options.fullscreen),
-    lights(options.MAX_NR_POINT_LIGHTS, options.MAX_NR_DIRECTIONAL_LIGHTS, options.MAX_NR_SPOT_LIGHTS),
+    window(display_name, screen_width, screen_height, options.fullscreen, !options.hidden_window),
+    lights(options.MAX_NR_POINT_LIGHTS, options.MAX_NR_DIRECTIONAL_LIGHTS, options.MAX_NR_SPOT_LIGHTS, options.light_overflow_action, options.clustered_lighting, options.MAX_NR_CLUSTERED_LIGHTS),
+    workers(options.worker_threads),
     auto_clear_screen(options.auto_clear_window) {
+    update_buffers.resize(workers.get_thread_count() + 1);
 
     // handles window initialization
     // error when creating a window
@@ -287,6 +394,7 @@ Engine::Engine(
         ge.set_bindless_texture_support(false);
         std::cout << "ENGINE MESSAGE: Bindless texture NOT supported!" << std::endl;
     }
+    gl_extensions.load();
 
     // engine setup
     set_gamma_correction(options.gamma_correction);
@@ -294,10 +402,16 @@ Engine::Engine(
 
     // placeholder textures
     shaders.setup_placeholder_textures();
-    // base material setup
+    // linked programs are loaded from binaries when the driver supports it
+    shaders.program_binary_cache.enabled = options.program_binary_cache and gl_extensions.program_binaries;
+    shaders.program_binary_cache.directory = options.program_binary_cache_directory;
+    // base material setup, its shaders and the base meshes use the vertex format
+    meshes.vertex_format = options.vertex_format;
     shaders.setup_base_materials();
 
     // base meshes setup
+    meshes.mesh_cache_enabled = options.mesh_cache;
+    meshes.mesh_cache_directory = options.mesh_cache_directory;
     meshes.load_base_meshes();
 
     // init light system
@@ -320,11 +434,7 @@ void Engine::debug_warning(const std::string &message) {
 
 void Engine::set_gamma_correction(const bool state) {
     gamma_correction = state;
-    if (state) {
-        glEnable(GL_FRAMEBUFFER_SRGB);
-    } else {
-        glDisable(GL_FRAMEBUFFER_SRGB);
-    }
+    gl_state.set_capability(GL_FRAMEBUFFER_SRGB, state);
 }
 
 bool Engine::gamma_correction_enabled() const {
@@ -332,6 +442,7 @@ bool Engine::gamma_correction_enabled() const {
 }
 
 Engine::~Engine() {
+    gl_state.forget_buffer(camera_matrix_ubo);
     glDeleteBuffers(1, &camera_matrix_ubo);
 }
 
@@ -1,5 +1,6 @@
 #include "lights.hpp"
 #include <algorithm>
+#include <cmath>
 #include "graphicengine.hpp"
 #include "glad/glad.h"
 #include "things.hpp"
@@ -10,6 +11,15 @@ PointLight::PointLight(const Color color, const float intensity) : color(color),
 
 }
 
+/// distance at which intensity / (1 + d^2) falls under 1/256
+static float range_from_intensity(const float intensity) {
+    return std::sqrt(std::max(intensity * 256.0f - 1.0f, 0.0f));
+}
+
+float PointLight::get_range() const {
+    return range > 0.0f ? range : range_from_intensity(intensity);
+}
+
 DirectionalLight::DirectionalLight(const Color color, const float intensity, const Vector3 &direction) :
 color(color), intensity(intensity), direction(direction) {
 
@@ -20,12 +30,29 @@ color(color), intensity(intensity), angle(angle){
 
 }
 
-Lights::Lights(unsigned int MAX_NR_POINT_LIGHTS, unsigned int MAX_NR_DIRECTIONAL_LIGHTS, unsigned int MAX_NR_SPOT_LIGHTS, LightOverflowAction light_overflow_action) :
-MAX_NR_POINT_LIGHTS(MAX_NR_POINT_LIGHTS), MAX_NR_DIRECTIONAL_LIGHTS(MAX_NR_DIRECTIONAL_LIGHTS), MAX_NR_SPOT_LIGHTS(MAX_NR_SPOT_LIGHTS), light_overflow_action(light_overflow_action), ambient_light(Color::BLACK) { }
+float SpotLight::get_range() const {
+    return range > 0.0f ? range : range_from_intensity(intensity);
+}
+
+Lights::Lights(unsigned int MAX_NR_POINT_LIGHTS, unsigned int MAX_NR_DIRECTIONAL_LIGHTS, unsigned int MAX_NR_SPOT_LIGHTS, LightOverflowAction light_overflow_action, bool clustered_lighting, unsigned int MAX_NR_CLUSTERED_LIGHTS) :
+clustered_lighting(clustered_lighting), MAX_NR_POINT_LIGHTS(MAX_NR_POINT_LIGHTS), MAX_NR_DIRECTIONAL_LIGHTS(MAX_NR_DIRECTIONAL_LIGHTS), MAX_NR_SPOT_LIGHTS(MAX_NR_SPOT_LIGHTS), ambient_light(Color::BLACK), light_overflow_action(light_overflow_action), MAX_NR_CLUSTERED_LIGHTS(MAX_NR_CLUSTERED_LIGHTS) { }
 
 
 Lights::~Lights() {
+    ge.gl_state.forget_buffer(lights_ubo);
     glDeleteBuffers(1, &lights_ubo);
+    if (clustered_lighting) {
+        ge.gl_state.forget_buffer(clusters_ubo);
+        glDeleteBuffers(1, &clusters_ubo);
+        for (const unsigned int texture : {cluster_grid_texture, cluster_index_texture, cluster_light_texture})
+            ge.gl_state.forget_texture(texture);
+        glDeleteTextures(1, &cluster_grid_texture);
+        glDeleteTextures(1, &cluster_index_texture);
+        glDeleteTextures(1, &cluster_light_texture);
+        glDeleteBuffers(1, &cluster_grid_buffer);
+        glDeleteBuffers(1, &cluster_index_buffer);
+        glDeleteBuffers(1, &cluster_light_buffer);
+    }
 }
 
 void Lights::init_central_light_system() {
@@ -36,16 +63,233 @@ void Lights::init_central_light_system() {
     glBindBuffer(GL_UNIFORM_BUFFER, lights_ubo);
     glBufferData(GL_UNIFORM_BUFFER, buffer_size, nullptr, GL_DYNAMIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    glBindBufferRange(GL_UNIFORM_BUFFER, 1, lights_ubo, 0, buffer_size);
+    ge.gl_state.bind_uniform_buffer_range(1, lights_ubo, 0, buffer_size);
+
+    if (!clustered_lighting)
+        return;
+
+    // CLUSTERS uniform buffer: view depth row, (z scale, z bias, tile width, tile height), grid size
+    constexpr unsigned int clusters_buffer_size = 12 * sizeof(float);
+    glGenBuffers(1, &clusters_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, clusters_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, clusters_buffer_size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ge.gl_state.bind_uniform_buffer_range(CLUSTERS_UBO_BINDING, clusters_ubo, 0, clusters_buffer_size);
+
+    // texture buffers, data is uploaded every frame
+    int max_texels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+    max_cluster_indices = static_cast<unsigned int>(max_texels);
+
+    const std::array<std::pair<unsigned int*, unsigned int*>, 3> buffers{{
+        {&cluster_grid_buffer, &cluster_grid_texture},
+        {&cluster_index_buffer, &cluster_index_texture},
+        {&cluster_light_buffer, &cluster_light_texture}
+    }};
+    constexpr std::array<GLenum, 3> formats{GL_RG32UI, GL_R32UI, GL_RGBA32F};
+    constexpr std::array<int, 3> units{CLUSTER_GRID_TEXTURE_UNIT, CLUSTER_INDEX_TEXTURE_UNIT, CLUSTER_LIGHT_TEXTURE_UNIT};
+    for (size_t i = 0; i < buffers.size(); i++) {
+        glGenBuffers(1, buffers[i].first);
+        glBindBuffer(GL_TEXTURE_BUFFER, *buffers[i].first);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+        glGenTextures(1, buffers[i].second);
+        ge.gl_state.bind_texture(units[i], GL_TEXTURE_BUFFER, *buffers[i].second);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], *buffers[i].first);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    cluster_grid.resize(static_cast<size_t>(CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z) * 2);
+}
+
+
+void Lights::sort_by_proximity(std::vector<unsigned int>& light_ids, const size_t max_count, const Position& camera_pos) {
+    if (light_ids.size() <= max_count)
+        return;
+    std::ranges::nth_element(light_ids, light_ids.begin() + static_cast<long>(max_count),
+        [camera_pos](const unsigned int a, const unsigned int b) {
+            return camera_pos.distance_to(dynamic_cast<SpatialThing*>(ge.get_thing(a))->transform.position) < camera_pos.distance_to(dynamic_cast<SpatialThing*>(ge.get_thing(b))->transform.position);
+        }
+    );
+}
+
+
+bool Lights::light_cluster_range(const Camera& camera, const glm::vec3& world_position, const float range, const float z_scale, const float z_bias, std::array<int, 6>& cluster_range) const {
+    const float near_plane = camera.get_near_plane();
+    const float far_plane = camera.get_far_plane();
+
+    // depth range of the sphere (view space looks down -z)
+    const glm::vec3 center = glm::vec3(camera.view * glm::vec4(world_position, 1.0f));
+    const float depth_min = std::max(-center.z - range, near_plane);
+    const float depth_max = std::min(-center.z + range, far_plane);
+    if (depth_min > depth_max)
+        return false;
+
+    cluster_range[2] = std::clamp(static_cast<int>(std::log(depth_min) * z_scale + z_bias), 0, CLUSTER_GRID_Z - 1);
+    cluster_range[5] = std::clamp(static_cast<int>(std::log(depth_max) * z_scale + z_bias), 0, CLUSTER_GRID_Z - 1);
+
+    // screen rect: project corners of the view space box around the sphere, cut at the near plane so every corner is in front of the camera
+    glm::vec2 ndc_min{1.0f}, ndc_max{-1.0f};
+    for (int corner = 0; corner < 8; corner++) {
+        const glm::vec3 point{
+            center.x + ((corner & 1) ? range : -range),
+            center.y + ((corner & 2) ? range : -range),
+            (corner & 4) ? -depth_min : -depth_max
+        };
+        const glm::vec4 clip = camera.projection * glm::vec4(point, 1.0f);
+        const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        ndc_min = glm::min(ndc_min, ndc);
+        ndc_max = glm::max(ndc_max, ndc);
+    }
+    if (ndc_min.x > 1.0f or ndc_min.y > 1.0f or ndc_max.x < -1.0f or ndc_max.y < -1.0f)
+        return false;
+
+    cluster_range[0] = std::clamp(static_cast<int>((ndc_min.x * 0.5f + 0.5f) * CLUSTER_GRID_X), 0, CLUSTER_GRID_X - 1);
+    cluster_range[1] = std::clamp(static_cast<int>((ndc_min.y * 0.5f + 0.5f) * CLUSTER_GRID_Y), 0, CLUSTER_GRID_Y - 1);
+    cluster_range[3] = std::clamp(static_cast<int>((ndc_max.x * 0.5f + 0.5f) * CLUSTER_GRID_X), 0, CLUSTER_GRID_X - 1);
+    cluster_range[4] = std::clamp(static_cast<int>((ndc_max.y * 0.5f + 0.5f) * CLUSTER_GRID_Y), 0, CLUSTER_GRID_Y - 1);
+    return true;
+}
+
+
+void Lights::update_clusters(const Camera& camera, const int width, const int height) {
+    if (!clustered_lighting)
+        return;
+    GE_PROFILE_ZONE("Lights::update_clusters");
+
+    // pick lights, point lights first, spot lights get the rest of the budget
+    const size_t point_count = std::min<size_t>(point_lights.size(), MAX_NR_CLUSTERED_LIGHTS);
+    const size_t spot_count = std::min<size_t>(spot_lights.size(), MAX_NR_CLUSTERED_LIGHTS - point_count);
+    if (light_overflow_action == SORT_BY_PROXIMITY) {
+        sort_by_proximity(point_lights, point_count, camera.transform.position);
+        sort_by_proximity(spot_lights, spot_count, camera.transform.position);
+    }
+
+    // exponential depth slices: slice = log(depth) * z_scale + z_bias, a non perspective camera gets one slice
+    const bool perspective = camera.get_fov() != 0.0f and camera.get_near_plane() > 0.0f and camera.get_far_plane() > camera.get_near_plane();
+    float z_scale = 0.0f, z_bias = 0.0f;
+    if (perspective) {
+        z_scale = static_cast<float>(CLUSTER_GRID_Z) / std::log(camera.get_far_plane() / camera.get_near_plane());
+        z_bias = -z_scale * std::log(camera.get_near_plane());
+    }
+
+    // light data and cluster range of every light
+    cluster_light_data.clear();
+    cluster_light_ranges.clear();
+    auto add_light = [&](const glm::vec3& position, const float range, const glm::vec3& color, const float intensity, const glm::vec3& direction, const float cut_off) {
+        std::array<int, 6> cluster_range{0, 0, 0, CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1, CLUSTER_GRID_Z - 1};
+        if (perspective and !light_cluster_range(camera, position, range, z_scale, z_bias, cluster_range))
+            return;
+        cluster_light_data.emplace_back(color, intensity);
+        cluster_light_data.emplace_back(position, range);
+        cluster_light_data.emplace_back(direction, cut_off);
+        cluster_light_ranges.push_back(cluster_range);
+    };
+
+    for (size_t i = 0; i < point_count; i++) {
+        const auto ptl = dynamic_cast<PointLight*>(ge.get_thing(point_lights[i]));
+        // cut off < -1 marks a point light
+        add_light(ptl->transform.position.glm_vector(), ptl->get_range(), ptl->color.no_alpha().glm_vector(), ptl->intensity, glm::vec3{0.0f}, -2.0f);
+    }
+    for (size_t i = 0; i < spot_count; i++) {
+        const auto spot = dynamic_cast<SpotLight*>(ge.get_thing(spot_lights[i]));
+        spot->transform.rotation.quat_2_euler();
+        const glm::vec3 dir{
+            -sin(spot->transform.rotation.z) * cos(spot->transform.rotation.x),
+            -cos(spot->transform.rotation.z) * cos(spot->transform.rotation.x),
+            sin(spot->transform.rotation.x)
+        };
+        add_light(spot->transform.position.glm_vector(), spot->get_range(), spot->color.no_alpha().glm_vector(), spot->intensity, dir, cos(spot->angle / 2.0f));
+    }
+
+    // count lights per cluster, prefix sum into offsets, then fill the index lists
+    constexpr size_t cluster_count = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+    std::ranges::fill(cluster_grid, 0);
+    for (const auto& r : cluster_light_ranges) {
+        for (int z = r[2]; z <= r[5]; z++)
+            for (int y = r[1]; y <= r[4]; y++)
+                for (int x = r[0]; x <= r[3]; x++)
+                    cluster_grid[((z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x) * 2 + 1] += 1;
+    }
+    size_t total_indices = 0;
+    for (size_t c = 0; c < cluster_count; c++) {
+        cluster_grid[c * 2] = static_cast<unsigned int>(total_indices);
+        total_indices += cluster_grid[c * 2 + 1];
+        cluster_grid[c * 2 + 1] = 0;
+    }
+
+    dropped_cluster_indices = 0;
+    cluster_indices.resize(std::min<size_t>(std::max<size_t>(total_indices, 1), max_cluster_indices));
+    for (size_t light = 0; light < cluster_light_ranges.size(); light++) {
+        const auto& r = cluster_light_ranges[light];
+        for (int z = r[2]; z <= r[5]; z++)
+            for (int y = r[1]; y <= r[4]; y++)
+                for (int x = r[0]; x <= r[3]; x++) {
+                    const size_t c = (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x;
+                    const size_t index = cluster_grid[c * 2] + cluster_grid[c * 2 + 1];
+                    if (index >= cluster_indices.size()) {
+                        dropped_cluster_indices += 1;
+                        continue;
+                    }
+                    cluster_indices[index] = static_cast<unsigned int>(light);
+                    cluster_grid[c * 2 + 1] += 1;
+                }
+    }
+    if (dropped_cluster_indices > 0)
+        Engine::debug_warning("Cluster light index buffer full, " + std::to_string(dropped_cluster_indices) + " light assignments dropped.");
+    if (cluster_light_data.empty())
+        cluster_light_data.emplace_back(0.0f);
+
+    // upload, orphaning last frame's data
+    glBindBuffer(GL_TEXTURE_BUFFER, cluster_grid_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(cluster_grid.size() * sizeof(unsigned int)), cluster_grid.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, cluster_index_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(cluster_indices.size() * sizeof(unsigned int)), cluster_indices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, cluster_light_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(cluster_light_data.size() * sizeof(glm::vec4)), cluster_light_data.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // material textures may have been bound to these units in the meantime (skipped by the state cache if not)
+    constexpr std::array<int, 3> units{CLUSTER_GRID_TEXTURE_UNIT, CLUSTER_INDEX_TEXTURE_UNIT, CLUSTER_LIGHT_TEXTURE_UNIT};
+    const std::array<unsigned int, 3> textures{cluster_grid_texture, cluster_index_texture, cluster_light_texture};
+    for (size_t i = 0; i < units.size(); i++) {
+        ge.gl_state.bind_texture(units[i], GL_TEXTURE_BUFFER, textures[i]);
+    }
+
+    // std140 layout of the CLUSTERS block
+    struct {
+        /// row of the VIEW matrix giving view space z
+        glm::vec4 view_depth_row;
+        /// z scale, z bias, tile width and height in pixels
+        glm::vec4 params;
+        /// grid size and amount of clustered lights
+        glm::uvec4 grid_size;
+    } clusters_data{
+        glm::vec4{camera.view[0][2], camera.view[1][2], camera.view[2][2], camera.view[3][2]},
+        glm::vec4{z_scale, z_bias, static_cast<float>(std::max(width, 1)) / CLUSTER_GRID_X, static_cast<float>(std::max(height, 1)) / CLUSTER_GRID_Y},
+        glm::uvec4{CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, cluster_light_ranges.size()}
+    };
+    glBindBuffer(GL_UNIFORM_BUFFER, clusters_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(clusters_data), &clusters_data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+bool Lights::is_clustered_lighting_enabled() const {
+    return clustered_lighting;
+}
+
+size_t Lights::get_dropped_cluster_indices() const {
+    return dropped_cluster_indices;
 }
 
 
 
 
 void Lights::update(Position& camera_pos) {
+    GE_PROFILE_ZONE("Lights::update");
     // SORT LIGHTS BY PROXIMITY IF ABOVE LIGHT LIMIT
     if (light_overflow_action == SORT_BY_PROXIMITY) {
-        if (point_lights.size() > MAX_NR_POINT_LIGHTS) {
+        if (!clustered_lighting and point_lights.size() > MAX_NR_POINT_LIGHTS) {
             std::ranges::nth_element
             (point_lights, point_lights.begin() + MAX_NR_POINT_LIGHTS,
             [camera_pos](const int a, const int b){
@@ -69,8 +313,8 @@ void Lights::update(Position& camera_pos) {
     // ambient light
     glBufferSubData(GL_UNIFORM_BUFFER, 0, 4 * sizeof(float), &ambient_light);
     constexpr unsigned int BASE_OFFSET = 4 * sizeof(float);
-    // point lights
-    for (size_t i = 0; i < MAX_NR_POINT_LIGHTS; i++) {
+    // point lights (with clustered lighting they are uploaded by update_clusters())
+    for (size_t i = 0; i < (clustered_lighting ? 0 : MAX_NR_POINT_LIGHTS); i++) {
         glm::vec3 plt_pos{0};
         glm::vec3 light_color{0};
         float intensity = 0;
@@ -106,8 +350,8 @@ void Lights::update(Position& camera_pos) {
         glBufferSubData(GL_UNIFORM_BUFFER, byte_offset +  static_cast<unsigned int>(sizeof(float)) * 3, sizeof(float), &intensity);
         glBufferSubData(GL_UNIFORM_BUFFER, byte_offset +  static_cast<unsigned int>(sizeof(float)) * 4, sizeof(float) * 3, &dir);
     }
-    // spotlights
-    for (size_t i = 0; i < MAX_NR_SPOT_LIGHTS; i++) {
+    // spotlights (with clustered lighting they are uploaded by update_clusters())
+    for (size_t i = 0; i < (clustered_lighting ? 0 : MAX_NR_SPOT_LIGHTS); i++) {
         glm::vec3 pos{0};
         glm::vec3 dir {0};
         glm::vec3 light_color{0};
@@ -138,7 +382,8 @@ void Lights::update(Position& camera_pos) {
 }
 
 bool Lights::add_point_light(const unsigned int ge_ref_id) {
-    if (light_overflow_action == CANCEL_NEW and point_lights.size() >= MAX_NR_POINT_LIGHTS) {
+    const bool limit_reached = clustered_lighting ? point_lights.size() + spot_lights.size() >= MAX_NR_CLUSTERED_LIGHTS : point_lights.size() >= MAX_NR_POINT_LIGHTS;
+    if (light_overflow_action == CANCEL_NEW and limit_reached) {
         std::cerr << "ENGINE WARNING: Failed to add point light, LIMIT REACHED. Returning null geRef." << std::endl;
         return false;
     }
@@ -170,7 +415,8 @@ void Lights::remove_directional_light(const unsigned int ge_ref_id) {
 
 
 bool Lights::add_spot_light(const unsigned int ge_ref_id) {
-    if (light_overflow_action == CANCEL_NEW and spot_lights.size() >= MAX_NR_SPOT_LIGHTS) {
+    const bool limit_reached = clustered_lighting ? point_lights.size() + spot_lights.size() >= MAX_NR_CLUSTERED_LIGHTS : spot_lights.size() >= MAX_NR_SPOT_LIGHTS;
+    if (light_overflow_action == CANCEL_NEW and limit_reached) {
         std::cerr << "ENGINE WARNING: Failed to add spot light, LIMIT REACHED. Returning null geRef." << std::endl;
         return false;
     }
@@ -0,0 +1,275 @@
+#include "meshcache.hpp"
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GE_MESH_CACHE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <process.h>
+#endif
+
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef GE_MESH_CACHE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) == 0) {
+        size = static_cast<size_t>(file_stat.st_size);
+        if (size == 0) {
+            opened = true;
+        } else {
+            void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                mapping = address;
+                data = static_cast<const std::byte*>(address);
+                opened = true;
+            }
+        }
+    }
+    ::close(fd);
+    if (opened)
+        return;
+#endif
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.good())
+        return;
+    fallback.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(fallback.data()), static_cast<std::streamsize>(fallback.size()));
+    data = fallback.data();
+    size = fallback.size();
+    opened = file.good();
+}
+
+MappedFile::~MappedFile() {
+#ifdef GE_MESH_CACHE_MMAP
+    if (mapping != nullptr)
+        munmap(mapping, size);
+#endif
+}
+
+bool MappedFile::is_open() const {
+    return opened;
+}
+
+std::span<const std::byte> MappedFile::get_data() const {
+    return {data, size};
+}
+
+
+// .gemesh layout (all values little/native endian, every section 4 byte aligned):
+// FileHeader | mtl path | per material: uint32 size + name | per mesh: MeshHeader + floats + indices + MeshLods
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t mtl_hash;
+    uint32_t options;
+    /// has_uvs | has_normals << 1
+    uint32_t flags;
+    uint32_t mesh_count;
+    uint32_t material_count;
+    uint32_t mtl_path_size;
+    /// written as 1, reads differently on a machine with other byte order
+    uint32_t byte_order;
+};
+
+struct MeshHeader {
+    uint32_t layout_key;
+    uint32_t float_count;
+    uint32_t index_count;
+    uint32_t lod_count;
+};
+
+// stored as is
+static_assert(sizeof(MeshLod) == 3 * sizeof(uint32_t));
+
+static constexpr char MAGIC[4] = {'G', 'E', 'M', 'S'};
+
+static size_t align4(const size_t value) {
+    return (value + 3) & ~static_cast<size_t>(3);
+}
+
+std::filesystem::path MeshCache::get_temp_path(const std::filesystem::path& path) {
+    static std::atomic<unsigned int> write_count{0};
+#ifdef _WIN32
+    const long process_id = _getpid();
+#elif defined(GE_MESH_CACHE_MMAP)
+    const long process_id = ::getpid();
+#else
+    const long process_id = 0;
+#endif
+    std::filesystem::path temp_path = path;
+    temp_path += '.' + std::to_string(process_id) + '.' + std::to_string(write_count.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+    return temp_path;
+}
+
+
+uint64_t MeshCache::hash(const std::span<const std::byte> data) {
+    uint64_t h = 14695981039346656037ull;
+    for (const std::byte b : data) {
+        h ^= static_cast<uint64_t>(b);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t MeshCache::hash_file(const std::filesystem::path& path) {
+    const MappedFile file(path);
+    if (!file.is_open())
+        return 0;
+    return hash(file.get_data());
+}
+
+
+bool MeshCache::read(const MappedFile& file, const uint64_t source_hash, const uint32_t options, MeshCacheData& data) {
+    if (!file.is_open())
+        return false;
+    const std::span<const std::byte> bytes = file.get_data();
+    size_t offset = 0;
+
+    // returns a pointer to the next n bytes or nullptr if the file is too short
+    auto take = [&](const size_t n) -> const std::byte* {
+        if (offset + n > bytes.size())
+            return nullptr;
+        const std::byte* p = bytes.data() + offset;
+        offset = align4(offset + n);
+        return p;
+    };
+
+    FileHeader header{};
+    const std::byte* header_bytes = take(sizeof(FileHeader));
+    if (header_bytes == nullptr)
+        return false;
+    std::memcpy(&header, header_bytes, sizeof(FileHeader));
+    if (std::memcmp(header.magic, MAGIC, 4) != 0 or header.version != VERSION or header.byte_order != 1)
+        return false;
+    if (header.source_hash != source_hash or header.options != options)
+        return false;
+
+    data.source_hash = header.source_hash;
+    data.options = header.options;
+    data.has_uvs = header.flags & 1;
+    data.has_normals = header.flags & 2;
+    data.mtl_hash = header.mtl_hash;
+
+    const std::byte* mtl_path = take(header.mtl_path_size);
+    if (mtl_path == nullptr)
+        return false;
+    data.mtl_path.assign(reinterpret_cast<const char*>(mtl_path), header.mtl_path_size);
+    // materials decide tangent generation, an edited .mtl makes the cache stale
+    if (!data.mtl_path.empty() and hash_file(data.mtl_path) != header.mtl_hash)
+        return false;
+
+    data.material_names.clear();
+    for (uint32_t i = 0; i < header.material_count; i++) {
+        uint32_t name_size = 0;
+        const std::byte* size_bytes = take(sizeof(uint32_t));
+        if (size_bytes == nullptr)
+            return false;
+        std::memcpy(&name_size, size_bytes, sizeof(uint32_t));
+        const std::byte* name = take(name_size);
+        if (name == nullptr)
+            return false;
+        data.material_names.emplace_back(reinterpret_cast<const char*>(name), name_size);
+    }
+
+    data.meshes.clear();
+    for (uint32_t i = 0; i < header.mesh_count; i++) {
+        MeshHeader mesh_header{};
+        const std::byte* mesh_header_bytes = take(sizeof(MeshHeader));
+        if (mesh_header_bytes == nullptr)
+            return false;
+        std::memcpy(&mesh_header, mesh_header_bytes, sizeof(MeshHeader));
+
+        const std::byte* floats = take(static_cast<size_t>(mesh_header.float_count) * sizeof(float));
+        const std::byte* indices = take(static_cast<size_t>(mesh_header.index_count) * sizeof(unsigned int));
+        const std::byte* lods = take(static_cast<size_t>(mesh_header.lod_count) * sizeof(MeshLod));
+        if (floats == nullptr or indices == nullptr or lods == nullptr)
+            return false;
+
+        CachedMesh& mesh = data.meshes.emplace_back();
+        mesh.layout = VertexLayout{
+            static_cast<bool>(mesh_header.layout_key & 1), static_cast<bool>(mesh_header.layout_key & 2),
+            static_cast<bool>(mesh_header.layout_key & 4), static_cast<bool>(mesh_header.layout_key & 8)
+        };
+        // sections are 4 byte aligned and the mapping is page aligned, so the data can be used in place
+        mesh.vertex_data = {reinterpret_cast<const float*>(floats), mesh_header.float_count};
+        mesh.indices = {reinterpret_cast<const unsigned int*>(indices), mesh_header.index_count};
+        mesh.lods = {reinterpret_cast<const MeshLod*>(lods), mesh_header.lod_count};
+    }
+    return true;
+}
+
+
+bool MeshCache::write(const std::filesystem::path& path, const MeshCacheData& data) {
+    std::error_code error;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), error);
+
+    // written aside and renamed over the cache file, so readers never see a partial file
+    const std::filesystem::path temp_path = get_temp_path(path);
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.good())
+        return false;
+
+    auto put = [&](const void* bytes, const size_t n) {
+        file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(n));
+        constexpr char padding[4] = {0, 0, 0, 0};
+        file.write(padding, static_cast<std::streamsize>(align4(n) - n));
+    };
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.source_hash = data.source_hash;
+    header.mtl_hash = data.mtl_hash;
+    header.options = data.options;
+    header.flags = static_cast<uint32_t>(data.has_uvs) | static_cast<uint32_t>(data.has_normals) << 1;
+    header.mesh_count = static_cast<uint32_t>(data.meshes.size());
+    header.material_count = static_cast<uint32_t>(data.material_names.size());
+    header.mtl_path_size = static_cast<uint32_t>(data.mtl_path.size());
+    header.byte_order = 1;
+    put(&header, sizeof(FileHeader));
+    put(data.mtl_path.data(), data.mtl_path.size());
+
+    for (const auto& name : data.material_names) {
+        const auto name_size = static_cast<uint32_t>(name.size());
+        put(&name_size, sizeof(uint32_t));
+        put(name.data(), name.size());
+    }
+
+    for (const auto& mesh : data.meshes) {
+        const MeshHeader mesh_header{
+            mesh.layout.get_key(),
+            static_cast<uint32_t>(mesh.vertex_data.size()),
+            static_cast<uint32_t>(mesh.indices.size()),
+            static_cast<uint32_t>(mesh.lods.size())
+        };
+        put(&mesh_header, sizeof(MeshHeader));
+        put(mesh.vertex_data.data(), mesh.vertex_data.size_bytes());
+        put(mesh.indices.data(), mesh.indices.size_bytes());
+        put(mesh.lods.data(), mesh.lods.size_bytes());
+    }
+
+    file.close();
+    if (!file.good()) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
@@ -1,66 +1,399 @@
 #include "meshes.hpp"
+#include "geometryarena.hpp"
+#include "meshcache.hpp"
+#include "meshsimplifier.hpp"
+#include "meshoptimization.hpp"
 #include "graphicengine.hpp"
 
 #include <filesystem>
 #include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <array>
 #include <algorithm>
+#include <cstring>
+#include <limits>
+
+
+void Mesh::load_mesh_to_gpu(const std::span<const float> vertex_data, const std::span<const unsigned int> indices, const bool has_vertex_colors, const std::span<const MeshLod> lods) {
+    this->has_vertex_colors = has_vertex_colors;
+    vertex_format = ge.meshes.vertex_format;
+    id = ge.meshes.get_mesh_identificator();
+    // levels of detail are stored after the full detail indices, all of them are uploaded together
+    this->lods.assign(lods.begin(), lods.end());
+    const bool lods_valid = std::ranges::all_of(lods, [&](const MeshLod& lod) {
+        return static_cast<size_t>(lod.first_index) + lod.index_count <= indices.size();
+    });
+    if (this->lods.empty() or !lods_valid) {
+        if (!lods_valid)
+            Engine::debug_warning("Mesh levels of detail point outside of its indices, only the full detail mesh is used.");
+        this->lods.assign(1, MeshLod{0, static_cast<unsigned int>(indices.size()), 0.0f});
+    }
+    vertex_count = static_cast<int>(this->lods[0].index_count);
+    compute_bounds(vertex_data);
+
+    // float data is uploaded as is, compact formats are encoded first
+    const VertexLayout layout = get_vertex_layout();
+    std::vector<std::byte> encoded_vertex_data{};
+    std::span<const std::byte> gpu_vertex_data = std::as_bytes(vertex_data);
+    if (!vertex_format.is_float()) {
+        layout.encode(vertex_data, bounding_box, encoded_vertex_data);
+        gpu_vertex_data = encoded_vertex_data;
+    }
+    if (vertex_format.quantized_positions and !bounding_box.is_empty()) {
+        // snorm [-1, 1] covers the box, flat boxes keep a scale of 1 so the matrix stays invertible
+        const glm::vec3 half_extent = bounding_box.get_extents();
+        dequantization_matrix = glm::mat4(1.0f);
+        dequantization_matrix[0][0] = half_extent.x > 0.0f ? half_extent.x : 1.0f;
+        dequantization_matrix[1][1] = half_extent.y > 0.0f ? half_extent.y : 1.0f;
+        dequantization_matrix[2][2] = half_extent.z > 0.0f ? half_extent.z : 1.0f;
+        dequantization_matrix[3] = glm::vec4(bounding_box.get_center(), 1.0f);
+    }
 
+    // indices are relative to the mesh vertices (arenas add the base vertex), so small meshes fit 16-bit indices
+    const size_t mesh_vertex_count = vertex_data.size() / layout.get_floats_per_vertex();
+    std::vector<uint16_t> short_indices{};
+    std::span<const std::byte> index_data = std::as_bytes(indices);
+    index_size = sizeof(unsigned int);
+    if (mesh_vertex_count <= std::numeric_limits<uint16_t>::max()) {
+        index_size = sizeof(uint16_t);
+        short_indices.assign(indices.begin(), indices.end());
+        index_data = std::as_bytes(std::span<const uint16_t>(short_indices));
+    }
+
+    if (use_geometry_arena) {
+        arena = ge.meshes.allocate_geometry(layout, index_size, gpu_vertex_data, index_data, allocation);
+        if (arena != nullptr)
+            return;
+        Engine::debug_warning("Mesh couldn't be placed into a GeometryArena, it will use its own buffers.");
+    }
 
-void Mesh::load_mesh_to_gpu(const std::vector<float>* vertex_data, const std::vector<unsigned int>* indices, const bool has_uvs, const bool has_normals, const bool has_tangents, const bool has_vertex_colors) {
     glGenBuffers(1, &vertex_buffer_object);
     glGenBuffers(1, &element_buffer_object);
 
     glGenVertexArrays(1, &vertex_array_object);
-    glBindVertexArray(vertex_array_object);
-
-    vertex_count = static_cast<int>(indices->size());
+    ge.gl_state.bind_vertex_array(vertex_array_object);
 
     glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<int>(vertex_data->size()) * static_cast<int>(sizeof(float)), vertex_data->data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(gpu_vertex_data.size()), gpu_vertex_data.data(), GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, vertex_count * static_cast<int>(sizeof(unsigned int)), indices->data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_data.size()), index_data.data(), GL_STATIC_DRAW);
+
+    layout.setup_vertex_attributes();
+    allocation = GeometryAllocation{0, static_cast<unsigned int>(mesh_vertex_count), 0, static_cast<unsigned int>(indices.size())};
+
+    if (ge.meshes.position_streams) {
+        std::vector<std::byte> positions{};
+        layout.extract_positions(gpu_vertex_data, positions);
+        glGenBuffers(1, &position_buffer_object);
+        glBindBuffer(GL_ARRAY_BUFFER, position_buffer_object);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(positions.size()), positions.data(), GL_STATIC_DRAW);
+    }
+
+    // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterward we can safely unbind
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ge.gl_state.bind_vertex_array(0);
+};
+
+
+bool VertexFormat::is_float() const {
+    return uv_encoding == UV_FLOAT and !octahedral_normals and !quantized_positions;
+}
+
+std::string VertexFormat::get_shader_defines() const {
+    // uvs are converted to floats by the vertex fetch, only decoding done in the shader needs a permutation
+    std::string defines;
+    defines += octahedral_normals ? "#define OCTAHEDRAL_NORMALS\n" : "";
+    defines += quantized_positions ? "#define QUANTIZED_POSITIONS\n" : "";
+    return defines;
+}
+
+
+namespace {
+    /// bytes of the attributes in a vertex buffer
+    constexpr unsigned int POSITION_FLOAT_SIZE = 3 * sizeof(float);
+    /// 3 snorm16 padded to 4 bytes
+    constexpr unsigned int POSITION_QUANTIZED_SIZE = 4 * sizeof(int16_t);
+    constexpr unsigned int UV_FLOAT_SIZE = 2 * sizeof(float);
+    constexpr unsigned int UV_16_SIZE = 2 * sizeof(uint16_t);
+    constexpr unsigned int DIRECTION_FLOAT_SIZE = 3 * sizeof(float);
+    constexpr unsigned int DIRECTION_OCTAHEDRAL_SIZE = 2 * sizeof(int16_t);
+    constexpr unsigned int COLOR_SIZE = 3 * sizeof(float);
+
+    /// Octahedral encoding of a direction into [-1, 1]^2, the lower hemisphere is folded over the diagonals
+    glm::vec2 encode_octahedral(const glm::vec3& direction) {
+        const float l1_norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+        if (l1_norm == 0.0f)
+            return glm::vec2(0.0f);
+        glm::vec2 encoded = glm::vec2(direction) / l1_norm;
+        if (direction.z < 0.0f) {
+            encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * glm::vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return encoded;
+    }
+}
+
+unsigned int VertexLayout::get_floats_per_vertex() const {
+    return 3 + (has_normals ? 3 : 0) + (has_uvs ? 2 : 0) + (has_tangents ? 3 : 0) + (has_vertex_colors ? 3 : 0);
+}
+
+unsigned int VertexLayout::get_vertex_size() const {
+    const unsigned int direction_size = format.octahedral_normals ? DIRECTION_OCTAHEDRAL_SIZE : DIRECTION_FLOAT_SIZE;
+    return (format.quantized_positions ? POSITION_QUANTIZED_SIZE : POSITION_FLOAT_SIZE)
+         + (has_uvs ? (format.uv_encoding == VertexFormat::UV_FLOAT ? UV_FLOAT_SIZE : UV_16_SIZE) : 0)
+         + (has_normals ? direction_size : 0)
+         + (has_tangents ? direction_size : 0)
+         + (has_vertex_colors ? COLOR_SIZE : 0);
+}
+
+unsigned int VertexLayout::get_position_size() const {
+    return format.quantized_positions ? POSITION_QUANTIZED_SIZE : POSITION_FLOAT_SIZE;
+}
+
+unsigned int VertexLayout::get_key() const {
+    return has_uvs | has_normals << 1 | has_tangents << 2 | has_vertex_colors << 3
+         | format.uv_encoding << 4 | format.octahedral_normals << 6 | format.quantized_positions << 7;
+}
 
-    const int stride = (3 + (has_normals ? 3 : 0) + (has_uvs ? 2 : 0) + (has_tangents ? 3 : 0) + (has_vertex_colors ? 3 : 0)) * static_cast<int>(sizeof(float));
+void VertexLayout::setup_vertex_attributes() const {
+    const auto stride = static_cast<int>(get_vertex_size());
+    size_t offset = 0;
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+    if (format.quantized_positions) {
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, nullptr);
+        offset += POSITION_QUANTIZED_SIZE;
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+        offset += POSITION_FLOAT_SIZE;
+    }
     glEnableVertexAttribArray(0);
 
     if (has_uvs) {
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(3 * sizeof(float)));
+        if (format.uv_encoding == VertexFormat::UV_HALF_FLOAT)
+            glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offset));
+        else if (format.uv_encoding == VertexFormat::UV_UNORM16)
+            glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<void *>(offset));
+        else
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offset));
         glEnableVertexAttribArray(1);
+        offset += format.uv_encoding == VertexFormat::UV_FLOAT ? UV_FLOAT_SIZE : UV_16_SIZE;
     }
 
-    if (has_normals) {
-        glVertexAttribPointer(1 + has_uvs, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>((3 + 2 * has_uvs) * sizeof(float)));
-        glEnableVertexAttribArray(1 + has_uvs);
-    }
+    // octahedral normals and tangents are decoded in the vertex shader (OCTAHEDRAL_NORMALS)
+    const auto direction_attribute = [&](const unsigned int location) {
+        if (format.octahedral_normals) {
+            glVertexAttribPointer(location, 2, GL_SHORT, GL_TRUE, stride, reinterpret_cast<void *>(offset));
+            offset += DIRECTION_OCTAHEDRAL_SIZE;
+        } else {
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offset));
+            offset += DIRECTION_FLOAT_SIZE;
+        }
+        glEnableVertexAttribArray(location);
+    };
 
-    if (has_tangents) {
-        glVertexAttribPointer(1 + has_normals + has_uvs, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>((3 + 3 * has_normals + 2 * has_uvs) * sizeof(float)));
-        glEnableVertexAttribArray(1 + has_normals + has_uvs);
-    }
+    if (has_normals)
+        direction_attribute(1 + has_uvs);
+
+    if (has_tangents)
+        direction_attribute(1 + has_normals + has_uvs);
 
     if (has_vertex_colors) {
-        glVertexAttribPointer(1 + has_normals + has_uvs, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>((3 + 3 * has_normals + 3 * has_tangents + 2 * has_uvs) * sizeof(float)));
+        glVertexAttribPointer(1 + has_normals + has_uvs, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offset));
         glEnableVertexAttribArray(1 + has_normals + has_uvs);
     }
+}
 
-    // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterward we can safely unbind
+void VertexLayout::setup_position_attribute(const bool position_stream) const {
+    const auto stride = static_cast<int>(position_stream ? get_position_size() : get_vertex_size());
+    if (format.quantized_positions)
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, nullptr);
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+    glEnableVertexAttribArray(0);
+}
+
+void VertexLayout::extract_positions(const std::span<const std::byte> vertex_data, std::vector<std::byte>& out) const {
+    const unsigned int vertex_size = get_vertex_size();
+    const unsigned int position_size = get_position_size();
+    const size_t vertex_count = vertex_data.size() / vertex_size;
+    out.resize(vertex_count * position_size);
+    // position is the first attribute of every vertex
+    for (size_t v = 0; v < vertex_count; ++v)
+        std::memcpy(out.data() + v * position_size, vertex_data.data() + v * vertex_size, position_size);
+}
+
+void VertexLayout::encode(const std::span<const float> vertex_data, const BoundingBox& position_bounds, std::vector<std::byte>& out) const {
+    const unsigned int floats_per_vertex = get_floats_per_vertex();
+    const size_t vertex_count = vertex_data.size() / floats_per_vertex;
+    out.resize(vertex_count * get_vertex_size());
+
+    // positions map onto [-1, 1] of the box, see Mesh.get_dequantization_matrix()
+    const glm::vec3 center = position_bounds.is_empty() ? glm::vec3(0.0f) : position_bounds.get_center();
+    const glm::vec3 half_extent = position_bounds.is_empty() ? glm::vec3(0.0f) : position_bounds.get_extents();
+    const glm::vec3 inverse_half_extent{half_extent.x > 0.0f ? 1.0f / half_extent.x : 1.0f, half_extent.y > 0.0f ? 1.0f / half_extent.y : 1.0f, half_extent.z > 0.0f ? 1.0f / half_extent.z : 1.0f};
+
+    const glm::vec3 tangent_scale = format.quantized_positions ? inverse_half_extent : glm::vec3(1.0f);
+
+    std::byte* write = out.data();
+    const auto put = [&write](const auto value) {
+        std::memcpy(write, &value, sizeof(value));
+        write += sizeof(value);
+    };
+    const auto put_direction = [&](const float* direction, const glm::vec3& scale) {
+        const glm::vec3 value = glm::vec3{direction[0], direction[1], direction[2]} * scale;
+        if (format.octahedral_normals)
+            put(glm::packSnorm2x16(encode_octahedral(value)));
+        else
+            put(value);
+    };
+
+    for (size_t v = 0; v < vertex_count; v++) {
+        const float* vertex = &vertex_data[v * floats_per_vertex];
+        const glm::vec3 position{vertex[0], vertex[1], vertex[2]};
+        if (format.quantized_positions)
+            put(glm::packSnorm4x16(glm::vec4((position - center) * inverse_half_extent, 0.0f)));
+        else
+            put(position);
+        vertex += 3;
+
+        if (has_uvs) {
+            const glm::vec2 uv{vertex[0], vertex[1]};
+            if (format.uv_encoding == VertexFormat::UV_HALF_FLOAT)
+                put(glm::packHalf2x16(uv));
+            else if (format.uv_encoding == VertexFormat::UV_UNORM16)
+                put(glm::packUnorm2x16(uv));
+            else
+                put(uv);
+            vertex += 2;
+        }
+        if (has_normals) {
+            put_direction(vertex, glm::vec3(1.0f));
+            vertex += 3;
+        }
+        if (has_tangents) {
+            // tangents are transformed by the model matrix, which includes the dequantization, so they are stored in quantized space
+            put_direction(vertex, tangent_scale);
+            vertex += 3;
+        }
+        if (has_vertex_colors)
+            put(glm::vec3{vertex[0], vertex[1], vertex[2]});
+    }
+}
+
+
+void InstanceData::setup_vertex_attributes(const unsigned int instance_buffer, const size_t first_instance) {
+    // per instance data, advances once per instance
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    constexpr auto stride = static_cast<int>(sizeof(InstanceData));
+    constexpr unsigned int loc = FIRST_ATTRIBUTE_LOCATION;
+    const size_t base = first_instance * sizeof(InstanceData);
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribPointer(loc + i, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(base + offsetof(InstanceData, transform) + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(loc + i);
+        glVertexAttribDivisor(loc + i, 1);
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+        glVertexAttribPointer(loc + 4 + i, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(base + offsetof(InstanceData, normal_matrix) + i * sizeof(glm::vec3)));
+        glEnableVertexAttribArray(loc + 4 + i);
+        glVertexAttribDivisor(loc + 4 + i, 1);
+    }
+    glVertexAttribPointer(loc + 7, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(base + offsetof(InstanceData, tint)));
+    glEnableVertexAttribArray(loc + 7);
+    glVertexAttribDivisor(loc + 7, 1);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-};
+}
+
+
+void Mesh::compute_bounds(const std::span<const float> vertex_data) {
+    const size_t floats_per_vertex = get_vertex_layout().get_floats_per_vertex();
+
+    bounding_box = BoundingBox{};
+    for (size_t i = 0; i + 2 < vertex_data.size(); i += floats_per_vertex) {
+        bounding_box.expand(glm::vec3{vertex_data[i], vertex_data[i + 1], vertex_data[i + 2]});
+    }
+
+    // sphere around the box center, radius from the furthest vertex (tighter than half of the box diagonal)
+    bounding_sphere = BoundingSphere{};
+    if (bounding_box.is_empty())
+        return;
+    bounding_sphere.center = bounding_box.get_center();
+    float max_distance_sq = 0.0f;
+    for (size_t i = 0; i + 2 < vertex_data.size(); i += floats_per_vertex) {
+        const glm::vec3 d = glm::vec3{vertex_data[i], vertex_data[i + 1], vertex_data[i + 2]} - bounding_sphere.center;
+        max_distance_sq = std::max(max_distance_sq, glm::dot(d, d));
+    }
+    bounding_sphere.radius = std::sqrt(max_distance_sq);
+}
+
+unsigned int Mesh::get_id() const {
+    return id;
+}
+
+const BoundingBox& Mesh::get_bounding_box() const {
+    return bounding_box;
+}
+
+const BoundingSphere& Mesh::get_bounding_sphere() const {
+    return bounding_sphere;
+}
 
 
-Mesh::Mesh(const std::vector<float>* vertex_data, const std::vector<unsigned int>* indices, const bool has_uvs, const bool has_normals, const bool has_tangents, const bool has_vertex_colors) : has_uvs(has_uvs), has_normals(has_normals), has_tangents(has_tangents) {
-    load_mesh_to_gpu(vertex_data, indices, has_uvs, has_normals, has_tangents, has_vertex_colors);
+unsigned int Mesh::get_instanced_vertex_array_object(const unsigned int instance_buffer) {
+    if (arena != nullptr)
+        return arena->get_instanced_vertex_array_object(instance_buffer);
+
+    if (instanced_vertex_array_object != 0 and instanced_vao_instance_buffer == instance_buffer)
+        return instanced_vertex_array_object;
+
+    if (instanced_vertex_array_object == 0)
+        glGenVertexArrays(1, &instanced_vertex_array_object);
+    instanced_vao_instance_buffer = instance_buffer;
+
+    ge.gl_state.bind_vertex_array(instanced_vertex_array_object);
+    // mesh data
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object);
+    get_vertex_layout().setup_vertex_attributes();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object);
+    InstanceData::setup_vertex_attributes(instance_buffer);
+
+    ge.gl_state.bind_vertex_array(0);
+    return instanced_vertex_array_object;
+}
+
+unsigned int Mesh::get_depth_vertex_array_object(const unsigned int instance_buffer) {
+    if (arena != nullptr)
+        return arena->get_depth_vertex_array_object(instance_buffer);
+
+    if (depth_vertex_array_object != 0 and depth_vao_instance_buffer == instance_buffer)
+        return depth_vertex_array_object;
+
+    if (depth_vertex_array_object == 0)
+        glGenVertexArrays(1, &depth_vertex_array_object);
+    depth_vao_instance_buffer = instance_buffer;
+
+    ge.gl_state.bind_vertex_array(depth_vertex_array_object);
+    // only positions, from their own stream if the mesh has one
+    const bool position_stream = position_buffer_object != 0;
+    glBindBuffer(GL_ARRAY_BUFFER, position_stream ? position_buffer_object : vertex_buffer_object);
+    get_vertex_layout().setup_position_attribute(position_stream);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object);
+    InstanceData::setup_vertex_attributes(instance_buffer);
+
+    ge.gl_state.bind_vertex_array(0);
+    return depth_vertex_array_object;
+}
+
+
+Mesh::Mesh(const std::vector<float>* vertex_data, const std::vector<unsigned int>* indices, const bool has_uvs, const bool has_normals, const bool has_tangents, const bool has_vertex_colors, const bool use_geometry_arena) : has_uvs(has_uvs), has_normals(has_normals), has_tangents(has_tangents), use_geometry_arena(use_geometry_arena) {
+    load_mesh_to_gpu(*vertex_data, *indices, has_vertex_colors);
 }
 
 unsigned int Mesh::get_vertex_array_object() const {
+    if (arena != nullptr)
+        return arena->get_vertex_array_object();
     return vertex_array_object;
 }
 
@@ -68,6 +401,50 @@ int Mesh::get_vertex_count() const {
     return vertex_count;
 }
 
+unsigned int Mesh::get_lod_count() const {
+    return static_cast<unsigned int>(lods.size());
+}
+
+const MeshLod& Mesh::get_lod(const unsigned int level) const {
+    return lods[std::min<size_t>(level, lods.size() - 1)];
+}
+
+unsigned int Mesh::get_first_index() const {
+    return allocation.first_index;
+}
+
+unsigned int Mesh::get_index_type() const {
+    return index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+unsigned int Mesh::get_index_size() const {
+    return index_size;
+}
+
+const void* Mesh::get_index_offset(const MeshLod& level) const {
+    return reinterpret_cast<const void*>(static_cast<uintptr_t>(allocation.first_index + level.first_index) * index_size);
+}
+
+int Mesh::get_base_vertex() const {
+    return static_cast<int>(allocation.base_vertex);
+}
+
+GeometryArena* Mesh::get_geometry_arena() const {
+    return arena.get();
+}
+
+VertexLayout Mesh::get_vertex_layout() const {
+    return VertexLayout{has_uvs, has_normals, has_tangents, has_vertex_colors, vertex_format};
+}
+
+bool Mesh::has_quantized_positions() const {
+    return vertex_format.quantized_positions;
+}
+
+const glm::mat4& Mesh::get_dequantization_matrix() const {
+    return dequantization_matrix;
+}
+
 bool Mesh::does_have_uvs() const {
     return has_uvs;
 }
@@ -77,6 +454,18 @@ bool Mesh::does_have_normals() const {
 }
 
 
+// .gemesh options, the kind of load in the high bits (a Mesh and a Model of the same file produce different data), LOD and optimization settings above them
+static constexpr uint32_t MESH_CACHE_OPTIONS = 1 << 8;
+static constexpr uint32_t MODEL_CACHE_OPTIONS = 2 << 8;
+
+/// Prints how the mesh optimization changed the vertex cache efficiency of a cooked file
+static void report_mesh_optimization(const char* file_path, const VertexCacheStats& before, const VertexCacheStats& after) {
+    char stats[128];
+    std::snprintf(stats, sizeof(stats), "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", before.get_acmr(), after.get_acmr(), before.get_atvr(), after.get_atvr());
+    Engine::debug_message("Optimized mesh " + std::string(file_path) + ": " + stats);
+}
+
+
 // OBJ PARSER STRUCTS FOR HASHMAP
 struct UniqueVertexDataPoint {
     std::array<float, 8> vd = {0, 0, 0, 0, 0, 0, 0, 0};
@@ -178,13 +567,14 @@ TextureParseData parse_mtl_texture_statement(const std::string& statement) {
 
 
 
-/// Parses a mtl file
+/// Parses a mtl file, every material is created anew (Resources::load_mtl_materials shares them)
 /// @param file_path .mtl file path
 /// @param has_normals if .obj file that links this mtl has normal data (so appropriate shaders can be chosen)
 /// @param has_uvs -- // -- has uvs data (so appropriate shaders can be chosen)
 /// @param tangent_maps_action what to do with Normal,Bump maps or any other maps that use tangent calculations - Auto - If material need them, have them OR Force ignore the maps OR Force shaders to support tangents, just in case
+/// @param async_textures textures are decoded on worker threads, materials bind placeholders until they are uploaded (see Resources)
 /// @returns an unordered map [material name : std::shared_ptr of instanced material]
-std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const char* file_path, bool has_normals, bool has_uvs, const Model::TangentAction& tangent_maps_action) {
+std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const char* file_path, bool has_normals, bool has_uvs, const Model::TangentAction& tangent_maps_action, const bool async_textures) {
     std::unordered_map<std::string, std::shared_ptr<Material>> materials;
 
     std::ifstream file(file_path);
@@ -199,6 +589,13 @@ std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const
 
     auto vtx_uv_n_t_sp_id = ge.shaders.get_base_material(Shaders::VERTEX_UV_NORMAL_TANGENT)->get_shader_program_id();
 
+    // texture from a map statement, while loading asynchronously the material binds the placeholder
+    auto load_texture = [async_textures](const std::string& path, const bool sRGB, const bool clamp, const Shaders::PlaceholderTextures placeholder) {
+        if (async_textures)
+            return ge.resources.load_texture_async(path.c_str(), sRGB, true, clamp, placeholder);
+        return ge.resources.load_texture(path.c_str(), sRGB, true, clamp);
+    };
+
     auto template_shader_program = tangent_maps_action != Model::FORCE_GENERATE_ALL ?
         ge.shaders.get_base_material(has_uvs, has_normals)->get_shader_program()
             :
@@ -274,7 +671,7 @@ std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const
 
                 if (line[char_offset + 5] == 'd') {
                     // assume sRGB for diffuse textures
-                    auto texture = std::make_shared<Texture>(data.texture_path.c_str(), ge.gamma_correction_enabled(), true, data.clamp);
+                    auto texture = load_texture(data.texture_path, ge.gamma_correction_enabled(), data.clamp, Shaders::PlaceholderTextures::WHITE);
                     mat->set_uniform("albedo_texture", texture);
                     mat->set_uniform("material.albedo_texture_scale", data.scale);
                     //mat->set_uniform("material.albedo_texture_offset", data.offset);
@@ -296,7 +693,7 @@ std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const
                             mat->set_uniform("material.bump_map_scale", Vector2{1.0});
                             mat->set_uniform("material.bump_map_strength", 0.0f);
                         }
-                        auto texture = std::make_shared<Texture>(data.texture_path.c_str(), false, true, data.clamp);
+                        auto texture = load_texture(data.texture_path, false, data.clamp, Shaders::PlaceholderTextures::NORMAL_MAP);
                         mat->set_uniform("normal_map", texture);
                         mat->set_uniform("material.normal_map_scale", data.scale);
                         //mat->set_uniform("material.normal_map_offset", data.offset);
@@ -312,7 +709,7 @@ std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const
                             mat->set_uniform("material.normal_map_strength", 1.0f);
                         }
 
-                        auto texture = std::make_shared<Texture>(data.texture_path.c_str(), false, true, data.clamp);
+                        auto texture = load_texture(data.texture_path, false, data.clamp, Shaders::PlaceholderTextures::WHITE);
                         mat->set_uniform("bump_map", texture);
                         mat->set_uniform("material.bump_map_strength", data.bm);
                         mat->set_uniform("material.bump_map_scale", data.scale);
@@ -328,8 +725,102 @@ std::unordered_map<std::string, std::shared_ptr<Material>> parse_mtl_file(const
 }
 
 
+// PARSES A "v", "vt" OR "vn" LINE
+void parse_obj_vertex_line(const char* line, std::vector<float> (&vertex_data_vec)[3], bool &has_uvs, bool &has_normals) {
+    char data_type = 0;
+    if (line[1] == 't') {
+        data_type = 1;
+        has_uvs = true;
+    } else if (line[1] == 'n') {
+        data_type = 2;
+        has_normals = true;
+    }
+
+    // get only a slice of line (only the 3 floats in text)
+    const char * l = line + 2;
+    // fast parse
+    char * end;
+    vertex_data_vec[data_type].push_back(std::strtof(l, &end));
+    vertex_data_vec[data_type].push_back(std::strtof(end, &end));
+    if (data_type != 1) {
+        vertex_data_vec[data_type].push_back(std::strtof(end, nullptr));
+    }
+}
+
+
+// PARSES A "f" LINE, A QUAD IS SPLIT INTO 2 TRIANGLES
+void parse_obj_face_line(const char* line, std::vector<size_t>& vertex_group, const bool has_uvs, const bool has_normals) {
+    const char *l = line + 2;
+    char * end = const_cast<char *>(l);
+    // fast parse of x/y/z (because of '/' we have an offset in the pointer)
+    for (int i = 0; i < 3; i++) {
+        vertex_group.push_back(std::strtol(end, &end, 10));
+
+        if (has_normals || has_uvs)
+            vertex_group.push_back(std::strtol(end + 1, &end, 10));
+        if (has_normals && has_uvs)
+            vertex_group.push_back(std::strtol(end + 1, &end, 10));
+
+    }
+    // IF THERE IS A FORTH POINT IN A FACE (A QUAD)
+    if (*end != '\0' and *(end + 1) != '\0') {
+        int vertex_data_group_size = 1 + has_normals + has_uvs;
+
+        size_t vtx_group_list_end = vertex_group.size() - 1;
+        // spawn second triangle
+        // fill in points to form a triangle
+        // point 1
+        vertex_group.push_back(
+            vertex_group[ vtx_group_list_end - 3 * vertex_data_group_size + 1]
+            );
+
+        if (has_normals || has_uvs) {
+            vertex_group.push_back(
+                vertex_group[vtx_group_list_end - 3 * vertex_data_group_size + 2]
+            );
+        }
+
+        if (has_normals && has_uvs) {
+            vertex_group.push_back(
+                vertex_group[vtx_group_list_end - 3 * vertex_data_group_size + 3]
+            );
+        }
+
+        //point 2
+        vertex_group.push_back(
+            vertex_group[vtx_group_list_end - 1 * vertex_data_group_size + 1]
+            );
+
+        if (has_normals || has_uvs) {
+            vertex_group.push_back(
+                vertex_group[vtx_group_list_end - 1 * vertex_data_group_size + 2]
+            );
+        }
+
+        if (has_normals && has_uvs) {
+            vertex_group.push_back(
+                vertex_group[vtx_group_list_end - 1 * vertex_data_group_size + 3]
+            );
+        }
+
+        //parse NEW point
+        int dp_idx = std::strtol(end + 1, &end, 10);
+        vertex_group.push_back(dp_idx);
+
+        if (has_normals || has_uvs) {
+            dp_idx = std::strtol(end + 1, &end, 10);
+            vertex_group.push_back(dp_idx);
+        }
+        if (has_normals && has_uvs) {
+            dp_idx = std::strtol(end + 1, &end, 10);
+            vertex_group.push_back(dp_idx);
+        }
+    }
+}
+
+
 // PARSES OBJ FILE AS A MODEL (separating vertex groups, parsing materials from mtllib)
-void parse_obj_file(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<std::vector<size_t>>& vertex_groups, std::vector<std::shared_ptr<Material>>& materials, bool &has_uvs, bool &has_normals, const Model::TangentAction &tangent_action) {
+void parse_obj_file(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<std::vector<size_t>>& vertex_groups, std::vector<std::string>& material_names, std::string& mtl_path, bool &has_uvs, bool &has_normals) {
     std::ifstream file(file_path);
     if (!file.good()) {
         std::cerr << "ENGINE ERROR: FAILED LOADING .obj file: " << file_path << std::endl;
@@ -337,131 +828,35 @@ void parse_obj_file(const char* file_path, std::vector<float> (&vertex_data_vec)
     }
     std::string line;
 
-    size_t current_group_idx = -1;
-
     has_normals = false;
     has_uvs = false;
 
-    std::filesystem::path mtl_path;
-    bool generated_materials = false;
-    std::unordered_map<std::string, std::shared_ptr<Material>> mtl_materials;
 
     // PARSING OF .OBJ FILE
     // go line by line
-    // TODO seems a bit slow, after parsing unordered map is instant, this will be the constraint
     while (std::getline(file, line)) {
         // mtllib X
         if (line[0] == 'm') {
             auto mlt_file = normalize_path(after_char(line, ' '));
             std::filesystem::path path(file_path);
-            mtl_path = path.parent_path() / mlt_file;
+            mtl_path = (path.parent_path() / mlt_file).string();
         }
         // if v data
         else if (line[0] == 'v') {
-            char data_type = 0;
-            if (line[1] == 't') {
-                data_type = 1;
-                has_uvs = true;
-            } else if (line[1] == 'n') {
-                data_type = 2;
-                has_normals = true;
-            }
-
-            // get only a slice of line (only the 3 floats in text)
-            const char * l = line.c_str() + 2;
-            // fast parse
-            char * end;
-            vertex_data_vec[data_type].push_back(std::strtof(l, &end));
-            vertex_data_vec[data_type].push_back(std::strtof(end, &end));
-            if (data_type != 1) {
-                vertex_data_vec[data_type].push_back(std::strtof(end, nullptr));
-            }
+            parse_obj_vertex_line(line.c_str(), vertex_data_vec, has_uvs, has_normals);
         }
-        // if face definition
+        // if face definition, faces before the first usemtl have no group and are skipped
         else if (line[0] == 'f') {
-            const char *l = line.c_str() + 2;
-            char * end = const_cast<char *>(l);
-            // fast parse of x/y/z (because of '/' we have an offset in the pointer)
-            for (int i = 0; i < 3; i++) {
-                // read first f
-                vertex_groups[current_group_idx].push_back(std::strtol(end, &end, 10));
-
-                if (has_normals || has_uvs)
-                    vertex_groups[current_group_idx].push_back(std::strtol(end + 1, &end, 10));
-                if (has_normals && has_uvs)
-                    vertex_groups[current_group_idx].push_back(std::strtol(end + 1, &end, 10));
-            }
-
-            // IF THERE IS A FORTH POINT IN A FACE (A QUAD)
-            if (*end != '\0' and *(end + 1) != '\0') {
-                int vertex_data_group_size = 1 + has_normals + has_uvs;
-                size_t vtx_group_list_end = vertex_groups[current_group_idx].size() - 1;
-                // spawn second triangle
-
-                // fill in points to form a triangle
-                // point 1
-                vertex_groups[current_group_idx].push_back(
-                    vertex_groups[current_group_idx][ vtx_group_list_end - 3 * vertex_data_group_size + 1]
-                    );
-
-                if (has_normals || has_uvs) {
-                    vertex_groups[current_group_idx].push_back(
-                        vertex_groups[current_group_idx][vtx_group_list_end - 3 * vertex_data_group_size + 2]
-                    );
-                }
-
-                if (has_normals && has_uvs) {
-                    vertex_groups[current_group_idx].push_back(
-                        vertex_groups[current_group_idx][vtx_group_list_end - 3 * vertex_data_group_size + 3]
-                    );
-                }
-
-                //point 2
-                vertex_groups[current_group_idx].push_back(
-                    vertex_groups[current_group_idx][vtx_group_list_end - 1 * vertex_data_group_size + 1]
-                    );
-
-                if (has_normals || has_uvs) {
-                    vertex_groups[current_group_idx].push_back(
-                        vertex_groups[current_group_idx][vtx_group_list_end - 1 * vertex_data_group_size + 2]
-                    );
-                }
-
-                if (has_normals && has_uvs) {
-                    vertex_groups[current_group_idx].push_back(
-                        vertex_groups[current_group_idx][vtx_group_list_end - 1 * vertex_data_group_size + 3]
-                    );
-                }
-
-                //parse NEW point
-                int dp_idx = std::strtol(end + 1, &end, 10);
-                vertex_groups[current_group_idx].push_back(dp_idx);
-
-                if (has_normals || has_uvs) {
-                    dp_idx = std::strtol(end + 1, &end, 10);
-                    vertex_groups[current_group_idx].push_back(dp_idx);
-                }
-                if (has_normals && has_uvs) {
-                    dp_idx = std::strtol(end + 1, &end, 10);
-                    vertex_groups[current_group_idx].push_back(dp_idx);
-                }
-            }
+            if (!vertex_groups.empty())
+                parse_obj_face_line(line.c_str(), vertex_groups.back(), has_uvs, has_normals);
         }
         // usemtl X
         else if (line[0] == 'u') {
-            // generate materials only once we know if .obj has normals and uvs
-            if (!generated_materials) {
-                mtl_materials = parse_mtl_file(mtl_path.string().c_str(), has_normals, has_uvs, tangent_action);
-                generated_materials = true;
-            }
-
-
-            std::string material_name = after_char(line, ' ');
-            materials.push_back(mtl_materials[material_name]);
+            // materials are generated after parsing, once we know if .obj has normals and uvs
+            material_names.push_back(after_char(line, ' '));
 
             // create
             vertex_groups.emplace_back();
-            current_group_idx += 1;
         }
     }
 }
@@ -480,101 +875,214 @@ void parse_obj_file(const char* file_path, std::vector<float> (&vertex_data_vec)
 
     // PARSING OF .OBJ FILE
     // go line by line
-    // TODO seems a bit slow, after parsing, unordered map is instant, this will be the constraint
     while (std::getline(file, line)) {
         // if v data
         if (line[0] == 'v') {
-            char data_type = 0;
-            if (line[1] == 't') {
-                data_type = 1;
-                has_uvs = true;
-            } else if (line[1] == 'n') {
-                data_type = 2;
-                has_normals = true;
-            }
-            // get only a slice of line (only the 3 floats in text)
-            const char * l = line.c_str() + 2;
-            // fast parse
-            char * end;
-            vertex_data_vec[data_type].push_back(std::strtof(l, &end));
-            vertex_data_vec[data_type].push_back(std::strtof(end, &end));
-            if (data_type != 1) {
-                vertex_data_vec[data_type].push_back(std::strtof(end, nullptr));
-            }
+            parse_obj_vertex_line(line.c_str(), vertex_data_vec, has_uvs, has_normals);
         }
         // if face definition
         else if (line[0] == 'f') {
-            const char *l = line.c_str() + 2;
-            char * end = const_cast<char *>(l);
-            // fast parse of x/y/z (because of '/' we have an offset in the pointer)
-            for (int i = 0; i < 3; i++) {
-                vertex_group.push_back(std::strtol(end, &end, 10));
+            parse_obj_face_line(line.c_str(), vertex_group, has_uvs, has_normals);
+        }
+    }
+}
+
+
+/// Part of an .obj file parsed by one worker
+struct ObjFileChunk {
+    /// byte range in the file, starts at a line start, ends after a '\n' (or at the end of the file)
+    size_t begin = 0;
+    size_t end = 0;
+    /// if the chunk contains vt / vn lines
+    bool contains_uvs = false;
+    bool contains_normals = false;
+    /// if vt / vn lines appeared before the chunk
+    bool starts_with_uvs = false;
+    bool starts_with_normals = false;
+    /// v, vt and vn data of the chunk
+    std::vector<float> vertex_data_vec[3];
+    /// face data, groups[0] continues the group open at the start of the chunk, every usemtl starts a new one
+    std::vector<std::vector<size_t>> groups{1};
+    /// usemtl names of groups[1..]
+    std::vector<std::string> material_names{};
+    /// last mtllib line of the chunk
+    std::string mtllib_line{};
+};
+
+
+/// Calls on_line(line) for every line of the range, line is NUL terminated and without '\n' like from std::getline
+template<typename F>
+void for_each_obj_line(const char* data, const size_t begin, const size_t end, std::string& line, F&& on_line) {
+    size_t position = begin;
+    while (position < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(data + position, '\n', end - position));
+        const size_t line_length = line_end == nullptr ? end - position : static_cast<size_t>(line_end - (data + position));
+        line.assign(data + position, line_length);
+        on_line(line);
+        position += line_length + 1;
+    }
+}
 
-                if (has_normals || has_uvs)
-                    vertex_group.push_back(std::strtol(end + 1, &end, 10));
-                if (has_normals && has_uvs)
-                    vertex_group.push_back(std::strtol(end + 1, &end, 10));
 
+/// Splits the file into chunks at line boundaries, then finds which chunks have vt / vn lines (parallel).
+/// Faces are parsed depending on whether vt / vn lines appeared before them, so each chunk starts with the flags of all chunks before it.
+/// @returns the chunks, empty if the file can't be read
+std::vector<ObjFileChunk> split_obj_file(const MappedFile& file, ThreadPool& workers) {
+    const char* data = reinterpret_cast<const char*>(file.get_data().data());
+    const size_t size = file.get_data().size();
+
+    std::vector<ObjFileChunk> chunks;
+    const size_t chunk_count = std::max<size_t>(1, std::min((workers.get_thread_count() + 1) * 4, size / OBJ_PARALLEL_MIN_CHUNK_SIZE));
+    size_t begin = 0;
+    for (size_t i = 1; i <= chunk_count and begin < size; i++) {
+        size_t end = i == chunk_count ? size : std::max(begin, size * i / chunk_count);
+        // move the end after the next new line
+        const void* new_line = end < size ? std::memchr(data + end, '\n', size - end) : nullptr;
+        end = new_line == nullptr ? size : static_cast<size_t>(static_cast<const char*>(new_line) - data) + 1;
+
+        ObjFileChunk& chunk = chunks.emplace_back();
+        chunk.begin = begin;
+        chunk.end = end;
+        begin = end;
+    }
+
+    workers.parallel_for(chunks.size(), [&chunks, data](const size_t i) {
+        ObjFileChunk& chunk = chunks[i];
+        size_t position = chunk.begin;
+        while (position < chunk.end and !(chunk.contains_uvs and chunk.contains_normals)) {
+            if (data[position] == 'v' and position + 1 < chunk.end) {
+                chunk.contains_uvs |= data[position + 1] == 't';
+                chunk.contains_normals |= data[position + 1] == 'n';
             }
-            // IF THERE IS A FORTH POINT IN A FACE (A QUAD)
-            if (*end != '\0' and *(end + 1) != '\0') {
-                int vertex_data_group_size = 1 + has_normals + has_uvs;
-
-                size_t vtx_group_list_end = vertex_group.size() - 1;
-                // spawn second triangle
-                // fill in points to form a triangle
-                // point 1
-               vertex_group.push_back(
-                    vertex_group[ vtx_group_list_end - 3 * vertex_data_group_size + 1]
-                    );
-
-                if (has_normals || has_uvs) {
-                    vertex_group.push_back(
-                        vertex_group[vtx_group_list_end - 3 * vertex_data_group_size + 2]
-                    );
-                }
+            const void* new_line = std::memchr(data + position, '\n', chunk.end - position);
+            if (new_line == nullptr)
+                break;
+            position = static_cast<size_t>(static_cast<const char*>(new_line) - data) + 1;
+        }
+    });
 
-                if (has_normals && has_uvs) {
-                    vertex_group.push_back(
-                        vertex_group[vtx_group_list_end - 3 * vertex_data_group_size + 3]
-                    );
-                }
+    for (size_t i = 1; i < chunks.size(); i++) {
+        chunks[i].starts_with_uvs = chunks[i - 1].starts_with_uvs or chunks[i - 1].contains_uvs;
+        chunks[i].starts_with_normals = chunks[i - 1].starts_with_normals or chunks[i - 1].contains_normals;
+    }
+    return chunks;
+}
 
-                //point 2
-                vertex_group.push_back(
-                    vertex_group[vtx_group_list_end - 1 * vertex_data_group_size + 1]
-                    );
 
-                if (has_normals || has_uvs) {
-                    vertex_group.push_back(
-                        vertex_group[vtx_group_list_end - 1 * vertex_data_group_size + 2]
-                    );
-                }
+/// Appends the vertex data of all chunks in file order, so global .obj indices stay valid
+void merge_obj_vertex_data(std::vector<ObjFileChunk>& chunks, std::vector<float> (&vertex_data_vec)[3], ThreadPool& workers) {
+    workers.parallel_for(3, [&chunks, &vertex_data_vec](const size_t data_type) {
+        size_t total = 0;
+        for (const auto& chunk : chunks)
+            total += chunk.vertex_data_vec[data_type].size();
+        vertex_data_vec[data_type].reserve(vertex_data_vec[data_type].size() + total);
+        for (auto& chunk : chunks) {
+            vertex_data_vec[data_type].insert(vertex_data_vec[data_type].end(), chunk.vertex_data_vec[data_type].begin(), chunk.vertex_data_vec[data_type].end());
+            std::vector<float>().swap(chunk.vertex_data_vec[data_type]);
+        }
+    });
+}
 
-                if (has_normals && has_uvs) {
-                    vertex_group.push_back(
-                        vertex_group[vtx_group_list_end - 1 * vertex_data_group_size + 3]
-                    );
-                }
 
-                //parse NEW point
-                int dp_idx = std::strtol(end + 1, &end, 10);
-                vertex_group.push_back(dp_idx);
+// PARSES OBJ FILE AS A MODEL IN PARALLEL CHUNKS, same result as the serial parse_obj_file
+void parse_obj_file_parallel(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<std::vector<size_t>>& vertex_groups, std::vector<std::string>& material_names, std::string& mtl_path, bool &has_uvs, bool &has_normals, ThreadPool& workers) {
+    const MappedFile file(file_path);
+    if (!file.is_open()) {
+        std::cerr << "ENGINE ERROR: FAILED LOADING .obj file: " << file_path << std::endl;
+        return;
+    }
+    const char* data = reinterpret_cast<const char*>(file.get_data().data());
+    std::vector<ObjFileChunk> chunks = split_obj_file(file, workers);
+    has_uvs = false;
+    has_normals = false;
+    if (chunks.empty())
+        return;
 
-                if (has_normals || has_uvs) {
-                    dp_idx = std::strtol(end + 1, &end, 10);
-                    vertex_group.push_back(dp_idx);
-                }
-                if (has_normals && has_uvs) {
-                    dp_idx = std::strtol(end + 1, &end, 10);
-                    vertex_group.push_back(dp_idx);
-                }
+    workers.parallel_for(chunks.size(), [&chunks, data](const size_t i) {
+        ObjFileChunk& chunk = chunks[i];
+        bool chunk_has_uvs = chunk.starts_with_uvs;
+        bool chunk_has_normals = chunk.starts_with_normals;
+        std::string line;
+        for_each_obj_line(data, chunk.begin, chunk.end, line, [&](const std::string& l) {
+            if (l[0] == 'm') {
+                chunk.mtllib_line = l;
+            } else if (l[0] == 'v') {
+                parse_obj_vertex_line(l.c_str(), chunk.vertex_data_vec, chunk_has_uvs, chunk_has_normals);
+            } else if (l[0] == 'f') {
+                parse_obj_face_line(l.c_str(), chunk.groups.back(), chunk_has_uvs, chunk_has_normals);
+            } else if (l[0] == 'u') {
+                chunk.material_names.push_back(after_char(l, ' '));
+                chunk.groups.emplace_back();
             }
+        });
+    });
+
+    has_uvs = chunks.back().starts_with_uvs or chunks.back().contains_uvs;
+    has_normals = chunks.back().starts_with_normals or chunks.back().contains_normals;
+    merge_obj_vertex_data(chunks, vertex_data_vec, workers);
+
+    // groups in file order, the first group of a chunk continues the last group so far
+    std::string mtllib_line;
+    for (auto& chunk : chunks) {
+        if (!vertex_groups.empty())
+            vertex_groups.back().insert(vertex_groups.back().end(), chunk.groups[0].begin(), chunk.groups[0].end());
+        for (size_t i = 1; i < chunk.groups.size(); i++) {
+            vertex_groups.push_back(std::move(chunk.groups[i]));
+            material_names.push_back(std::move(chunk.material_names[i - 1]));
         }
+        if (!chunk.mtllib_line.empty())
+            mtllib_line = std::move(chunk.mtllib_line);
+    }
+
+    if (!mtllib_line.empty()) {
+        auto mlt_file = normalize_path(after_char(mtllib_line, ' '));
+        std::filesystem::path path(file_path);
+        mtl_path = (path.parent_path() / mlt_file).string();
     }
 }
 
 
+// PARSE OBJ FILE AS A UNIFORM MESH WITH NO MATERIAL IN PARALLEL CHUNKS, same result as the serial parse_obj_file
+void parse_obj_file_parallel(const char* file_path, std::vector<float> (&vertex_data_vec)[3], std::vector<size_t>& vertex_group, bool &has_uvs, bool &has_normals, ThreadPool& workers) {
+    const MappedFile file(file_path);
+    if (!file.is_open()) {
+        std::cerr << "ENGINE ERROR: FAILED LOADING .obj file: " << file_path << std::endl;
+        return;
+    }
+    const char* data = reinterpret_cast<const char*>(file.get_data().data());
+    std::vector<ObjFileChunk> chunks = split_obj_file(file, workers);
+    has_uvs = false;
+    has_normals = false;
+    if (chunks.empty())
+        return;
+
+    workers.parallel_for(chunks.size(), [&chunks, data](const size_t i) {
+        ObjFileChunk& chunk = chunks[i];
+        bool chunk_has_uvs = chunk.starts_with_uvs;
+        bool chunk_has_normals = chunk.starts_with_normals;
+        std::string line;
+        for_each_obj_line(data, chunk.begin, chunk.end, line, [&](const std::string& l) {
+            if (l[0] == 'v') {
+                parse_obj_vertex_line(l.c_str(), chunk.vertex_data_vec, chunk_has_uvs, chunk_has_normals);
+            } else if (l[0] == 'f') {
+                parse_obj_face_line(l.c_str(), chunk.groups[0], chunk_has_uvs, chunk_has_normals);
+            }
+        });
+    });
+
+    has_uvs = chunks.back().starts_with_uvs or chunks.back().contains_uvs;
+    has_normals = chunks.back().starts_with_normals or chunks.back().contains_normals;
+    merge_obj_vertex_data(chunks, vertex_data_vec, workers);
+
+    size_t total = 0;
+    for (const auto& chunk : chunks)
+        total += chunk.groups[0].size();
+    vertex_group.reserve(vertex_group.size() + total);
+    for (const auto& chunk : chunks)
+        vertex_group.insert(vertex_group.end(), chunk.groups[0].begin(), chunk.groups[0].end());
+}
+
+
 void construct_mesh_data_from_parsed_obj_data(const std::vector<float> (&vertex_data_vec)[3], const std::vector<size_t>& vertex_triplets, const std::vector<float>& tangents, const bool has_normals, const bool has_texture_cords, std::vector<float>& out_vertex_data, std::vector<unsigned int>& out_indices) {
     std::unordered_map<UniqueVertexDataPoint, unsigned int, UniqueVertexDataPointHash> unique_vertex_data_points;
 
@@ -677,69 +1185,224 @@ std::vector<float> calculate_tangents(const std::vector<float> (&vertex_data_vec
 }
 
 
-Mesh::Mesh(const char* file_path, bool generate_tangents) {
-    vertex_buffer_object = -1;
-    vertex_array_object = -1;
-    element_buffer_object = -1;
+Mesh::Mesh(const std::span<const float> vertex_data, const std::span<const unsigned int> indices, const VertexLayout& layout, const bool use_geometry_arena, const std::span<const MeshLod> lods) : has_uvs(layout.has_uvs), has_normals(layout.has_normals), has_tangents(layout.has_tangents), use_geometry_arena(use_geometry_arena) {
+    load_mesh_to_gpu(vertex_data, indices, layout.has_vertex_colors, lods);
+}
+
+MeshFileData::MeshFileData() = default;
+MeshFileData::MeshFileData(MeshFileData&&) noexcept = default;
+MeshFileData& MeshFileData::operator=(MeshFileData&&) noexcept = default;
+MeshFileData::~MeshFileData() = default;
+
+ModelFileData::ModelFileData() = default;
+ModelFileData::ModelFileData(ModelFileData&&) noexcept = default;
+ModelFileData& ModelFileData::operator=(ModelFileData&&) noexcept = default;
+ModelFileData::~ModelFileData() = default;
+
+
+bool Mesh::read_file(const char* file_path, const bool generate_tangents, MeshFileData& data) {
+    // try the binary cache first
+    const uint32_t cache_options = MESH_CACHE_OPTIONS | generate_tangents | ge.meshes.get_processing_cache_options();
+    const uint64_t source_hash = ge.meshes.mesh_cache_enabled ? MeshCache::hash_file(file_path) : 0;
+    if (ge.meshes.mesh_cache_enabled) {
+        auto cache_file = std::make_unique<MappedFile>(ge.meshes.get_mesh_cache_path(file_path));
+        MeshCacheData cached;
+        if (MeshCache::read(*cache_file, source_hash, cache_options, cached) and cached.meshes.size() == 1) {
+            data.layout = cached.meshes[0].layout;
+            data.vertex_data = cached.meshes[0].vertex_data;
+            data.indices = cached.meshes[0].indices;
+            data.lods.assign(cached.meshes[0].lods.begin(), cached.meshes[0].lods.end());
+            data.cache_file = std::move(cache_file);
+            return true;
+        }
+    }
 
     // define structures
     std::vector<float> vertex_data_vec[3];
     std::vector<size_t> vertex_group;
+    bool has_uvs = false;
+    bool has_normals = false;
 
-    // use structures to parse .obj file
-    parse_obj_file(file_path, vertex_data_vec, vertex_group, has_uvs, has_normals);
+    // use structures to parse .obj file, large files in chunks on the worker threads
+    if (ge.meshes.should_parse_in_parallel(file_path))
+        parse_obj_file_parallel(file_path, vertex_data_vec, vertex_group, has_uvs, has_normals, ge.workers);
+    else
+        parse_obj_file(file_path, vertex_data_vec, vertex_group, has_uvs, has_normals);
 
     // calculate tangents if told so
     std::vector<float> tangents{};
     if (generate_tangents)
         tangents = calculate_tangents(vertex_data_vec, vertex_group);
-    has_tangents = generate_tangents;
-
-    // define new structures, for reordering
-    std::vector<float> vertex_data;
-    std::vector<unsigned int> indices;
 
     // use structures to create correctly formated values for Mesh
+    // this is just a mesh, so we merged_all_groups, and now we work with only one group
+    construct_mesh_data_from_parsed_obj_data(vertex_data_vec, vertex_group, tangents, has_normals, has_uvs, data.owned_vertex_data, data.owned_indices);
+    data.layout = VertexLayout{has_uvs, has_normals, generate_tangents, false};
+    data.vertex_data = data.owned_vertex_data;
+    data.indices = data.owned_indices;
+    if (const auto [before, after] = ge.meshes.process_mesh_data(data); ge.meshes.optimize_meshes)
+        report_mesh_optimization(file_path, before, after);
+
+    if (ge.meshes.mesh_cache_enabled and source_hash != 0 and !data.indices.empty()) {
+        MeshCacheData cache_data{source_hash, cache_options, has_uvs, has_normals};
+        cache_data.meshes.push_back(CachedMesh{data.layout, data.vertex_data, data.indices, data.lods});
+        if (!MeshCache::write(ge.meshes.get_mesh_cache_path(file_path), cache_data))
+            Engine::debug_warning("Failed to write mesh cache of: " + std::string(file_path));
+    }
+    return !data.indices.empty();
+}
+
+Mesh::Mesh(const MeshFileData& data, const bool use_geometry_arena) : Mesh(data.vertex_data, data.indices, data.layout, use_geometry_arena, data.lods) {
 
-    // vertex_groups[0], because usually we would loop through all the groups and create the appropriate Mesh
-    // but this is just a mesh, so we merged_all_groups, and now we work with only one group
-    construct_mesh_data_from_parsed_obj_data(vertex_data_vec, vertex_group, tangents, has_normals, has_uvs, vertex_data, indices);
-    load_mesh_to_gpu(&vertex_data, &indices, has_uvs, has_normals, generate_tangents);
 }
 
-Model::Model(const char* file_path, const TangentAction& action) {
-    // define structures
-    std::vector<float> vertex_data_vec[3];
-    std::vector<std::vector<size_t>> vertex_groups;
+Mesh::Mesh(const char* file_path, const bool generate_tangents) {
+    MeshFileData data;
+    read_file(file_path, generate_tangents, data);
+    has_uvs = data.layout.has_uvs;
+    has_normals = data.layout.has_normals;
+    has_tangents = data.layout.has_tangents;
+    load_mesh_to_gpu(data.vertex_data, data.indices, data.layout.has_vertex_colors, data.lods);
+}
 
-    // use structures to parse .obj file
-    parse_obj_file(file_path, vertex_data_vec, vertex_groups, materials, has_uvs, has_normals, action);
 
-    for (size_t i = 0; i < vertex_groups.size(); ++i) {
-        auto& vertex_group = vertex_groups[i];
-        if (vertex_group.empty())
-            continue;
+void Model::load_materials(const std::string& mtl_path, const std::vector<std::string>& material_names, const TangentAction& action, const bool async_textures) {
+    if (material_names.empty())
+        return;
+    // shared with other models using the same library
+    materials = ge.resources.load_mtl_materials(mtl_path, material_names, has_normals, has_uvs, action, async_textures);
+}
+
+void Model::add_mesh(const std::shared_ptr<Mesh>& mesh) {
+    meshes.push_back(mesh);
+    bounding_box.expand(mesh->get_bounding_box());
+
+    // sphere around the model box center, containing all mesh spheres
+    bounding_sphere.center = bounding_box.get_center();
+    bounding_sphere.radius = 0.0f;
+    for (const auto& msh : meshes) {
+        const BoundingSphere& mesh_sphere = msh->get_bounding_sphere();
+        bounding_sphere.radius = std::max(bounding_sphere.radius, glm::length(mesh_sphere.center - bounding_sphere.center) + mesh_sphere.radius);
+    }
+}
+
+
+bool Model::read_file(const char* file_path, const TangentAction& action, ModelFileData& data) {
+    data.file_path = file_path;
+    data.action = action;
+
+    // try the binary cache first
+    data.source_hash = ge.meshes.mesh_cache_enabled ? MeshCache::hash_file(file_path) : 0;
+    if (ge.meshes.mesh_cache_enabled) {
+        data.cache_file = std::make_unique<MappedFile>(ge.meshes.get_mesh_cache_path(file_path));
+        MeshCacheData cached;
+        if (MeshCache::read(*data.cache_file, data.source_hash, MODEL_CACHE_OPTIONS | action | ge.meshes.get_processing_cache_options(), cached)) {
+            data.has_uvs = cached.has_uvs;
+            data.has_normals = cached.has_normals;
+            data.mtl_path = std::move(cached.mtl_path);
+            data.material_names = std::move(cached.material_names);
+            for (const auto& cached_mesh : cached.meshes) {
+                MeshFileData& mesh_data = data.meshes.emplace_back();
+                mesh_data.layout = cached_mesh.layout;
+                mesh_data.vertex_data = cached_mesh.vertex_data;
+                mesh_data.indices = cached_mesh.indices;
+                mesh_data.lods.assign(cached_mesh.lods.begin(), cached_mesh.lods.end());
+            }
+            data.from_cache = true;
+            return true;
+        }
+        data.cache_file = nullptr;
+    }
+
+    // use structures to parse .obj file, large files in chunks on the worker threads
+    if (ge.meshes.should_parse_in_parallel(file_path))
+        parse_obj_file_parallel(file_path, data.vertex_data_vec, data.vertex_groups, data.material_names, data.mtl_path, data.has_uvs, data.has_normals, ge.workers);
+    else
+        parse_obj_file(file_path, data.vertex_data_vec, data.vertex_groups, data.material_names, data.mtl_path, data.has_uvs, data.has_normals);
+    return !data.vertex_groups.empty();
+}
 
-        // define new structures, for reordering
-        std::vector<float> vertex_data;
-        std::vector<unsigned int> indices;
 
-        // tangents
-        bool will_have_tangents = action == FORCE_GENERATE_ALL;
-        if (action == AUTO_GENERATE) {
+void Model::pick_tangent_groups(ModelFileData& data) const {
+    const unsigned int tangent_sp_id = ge.shaders.get_base_material(Shaders::VERTEX_UV_NORMAL_TANGENT)->get_shader_program_id();
+    data.group_tangents.resize(data.vertex_groups.size());
+    for (size_t i = 0; i < data.vertex_groups.size(); ++i) {
+        bool will_have_tangents = data.action == FORCE_GENERATE_ALL;
+        if (data.action == AUTO_GENERATE) {
             // generate if material linked to this mesh supports tangents i.e. the mtl paser found a map texture requiring tangents
-            will_have_tangents = materials.size() >= i + 1 and (materials[i]->get_shader_program_id() == ge.shaders.get_base_material(Shaders::VERTEX_UV_NORMAL_TANGENT)->get_shader_program_id());
+            will_have_tangents = materials.size() >= i + 1 and materials[i] != nullptr and materials[i]->get_shader_program_id() == tangent_sp_id;
         }
+        data.group_tangents[i] = will_have_tangents;
+    }
+}
+
+
+void Model::build_meshes(ModelFileData& data) {
+    if (data.from_cache)
+        return;
+
+    VertexCacheStats stats_before{};
+    VertexCacheStats stats_after{};
+    for (size_t i = 0; i < data.vertex_groups.size(); ++i) {
+        auto& vertex_group = data.vertex_groups[i];
+        if (vertex_group.empty())
+            continue;
+
         std::vector<float> tangents;
-        if (will_have_tangents)
-            tangents = calculate_tangents(vertex_data_vec, vertex_group);
+        if (data.group_tangents[i])
+            tangents = calculate_tangents(data.vertex_data_vec, vertex_group);
 
         // use structures to create correctly formated values for Mesh
-        construct_mesh_data_from_parsed_obj_data(vertex_data_vec, vertex_group, tangents, has_normals, has_uvs, vertex_data, indices);
+        MeshFileData& mesh_data = data.meshes.emplace_back();
+        construct_mesh_data_from_parsed_obj_data(data.vertex_data_vec, vertex_group, tangents, data.has_normals, data.has_uvs, mesh_data.owned_vertex_data, mesh_data.owned_indices);
+        mesh_data.layout = VertexLayout{data.has_uvs, data.has_normals, static_cast<bool>(data.group_tangents[i]), false};
+        mesh_data.vertex_data = mesh_data.owned_vertex_data;
+        mesh_data.indices = mesh_data.owned_indices;
+        const auto [before, after] = ge.meshes.process_mesh_data(mesh_data);
+        stats_before += before;
+        stats_after += after;
+    }
+    if (ge.meshes.optimize_meshes and stats_before.triangle_count > 0)
+        report_mesh_optimization(data.file_path.c_str(), stats_before, stats_after);
+
+    // parsed data is no longer needed
+    for (auto& vertex_data : data.vertex_data_vec)
+        std::vector<float>().swap(vertex_data);
+    std::vector<std::vector<size_t>>().swap(data.vertex_groups);
+
+    if (ge.meshes.mesh_cache_enabled and data.source_hash != 0 and !data.meshes.empty()) {
+        MeshCacheData cache_data{data.source_hash, MODEL_CACHE_OPTIONS | data.action | ge.meshes.get_processing_cache_options(), data.has_uvs, data.has_normals, data.mtl_path, data.mtl_path.empty() ? 0 : MeshCache::hash_file(data.mtl_path), data.material_names};
+        for (const auto& mesh_data : data.meshes) {
+            cache_data.meshes.push_back(CachedMesh{mesh_data.layout, mesh_data.vertex_data, mesh_data.indices, mesh_data.lods});
+        }
+        if (!MeshCache::write(ge.meshes.get_mesh_cache_path(data.file_path.c_str()), cache_data))
+            Engine::debug_warning("Failed to write mesh cache of: " + data.file_path);
+    }
+}
+
+
+void Model::create_meshes(const ModelFileData& data, const bool use_geometry_arena) {
+    for (const auto& mesh_data : data.meshes) {
+        add_mesh(std::make_shared<Mesh>(mesh_data, use_geometry_arena));
+    }
+}
 
-        auto msh = std::make_shared<Mesh>(&vertex_data, &indices, has_uvs, has_normals, will_have_tangents);
-        meshes.push_back(msh);
+
+Model::Model(const char* file_path, const TangentAction& action, const bool use_geometry_arena) {
+    ModelFileData data;
+    read_file(file_path, action, data);
+    load(data, use_geometry_arena);
+}
+
+void Model::load(ModelFileData& data, const bool use_geometry_arena) {
+    has_uvs = data.has_uvs;
+    has_normals = data.has_normals;
+    load_materials(data.mtl_path, data.material_names, data.action);
+    if (!data.from_cache) {
+        pick_tangent_groups(data);
+        build_meshes(data);
     }
+    create_meshes(data, use_geometry_arena);
 }
 
 std::shared_ptr<Material> Model::get_material(size_t index) const {
@@ -762,21 +1425,44 @@ bool Model::get_has_normals() const {
     return has_normals;
 }
 
+const BoundingBox& Model::get_bounding_box() const {
+    return bounding_box;
+}
+
+const BoundingSphere& Model::get_bounding_sphere() const {
+    return bounding_sphere;
+}
+
 Mesh::~Mesh() {
+    if (arena != nullptr) {
+        arena->free(allocation);
+        return;
+    }
+    ge.gl_state.forget_vertex_array(vertex_array_object);
     glDeleteVertexArrays(1,  &vertex_array_object);
+    if (instanced_vertex_array_object != 0) {
+        ge.gl_state.forget_vertex_array(instanced_vertex_array_object);
+        glDeleteVertexArrays(1, &instanced_vertex_array_object);
+    }
+    if (depth_vertex_array_object != 0) {
+        ge.gl_state.forget_vertex_array(depth_vertex_array_object);
+        glDeleteVertexArrays(1, &depth_vertex_array_object);
+    }
     glDeleteBuffers(1, &vertex_buffer_object);
     glDeleteBuffers(1, &element_buffer_object);
+    if (position_buffer_object != 0)
+        glDeleteBuffers(1, &position_buffer_object);
 }
 
 void Meshes::load_base_meshes()
 {
-    plane = std::make_shared<Mesh>("engine/res/meshes/plane.obj");
-    cube = std::make_shared<Mesh>("engine/res/meshes/cube.obj");
-    sphere = std::make_shared<Mesh>("engine/res/meshes/sphere.obj");
+    plane = ge.resources.load_mesh("engine/res/meshes/plane.obj");
+    cube = ge.resources.load_mesh("engine/res/meshes/cube.obj");
+    sphere = ge.resources.load_mesh("engine/res/meshes/sphere.obj");
 
-    tangent_plane = std::make_shared<Mesh>("engine/res/meshes/plane.obj", true);
-    tangent_cube = std::make_shared<Mesh>("engine/res/meshes/cube.obj", true);
-    tangent_sphere = std::make_shared<Mesh>("engine/res/meshes/sphere.obj", true);
+    tangent_plane = ge.resources.load_mesh("engine/res/meshes/plane.obj", true);
+    tangent_cube = ge.resources.load_mesh("engine/res/meshes/cube.obj", true);
+    tangent_sphere = ge.resources.load_mesh("engine/res/meshes/sphere.obj", true);
     std::cout << "ENGINE MESSAGE: Default meshes created" << std::endl;
 }
 
@@ -791,6 +1477,101 @@ void Meshes::unload_base_meshes()
     tangent_sphere = nullptr;
 }
 
+std::filesystem::path Meshes::get_mesh_cache_path(const char* source_path) const {
+    std::filesystem::path source{source_path};
+    if (mesh_cache_directory.empty()) {
+        source += ".gemesh";
+        return source;
+    }
+    // files from different directories can share a name, so the full path is part of the cache file name
+    const std::string source_string = source.lexically_normal().generic_string();
+    const uint64_t path_hash = MeshCache::hash({reinterpret_cast<const std::byte*>(source_string.data()), source_string.size()});
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(path_hash));
+    return mesh_cache_directory / (source.filename().string() + "." + hex + ".gemesh");
+}
+
+void Meshes::generate_lods(MeshFileData& data) const {
+    if (lod_levels <= 1 or data.owned_indices.empty())
+        return;
+    std::vector<unsigned int> indices{};
+    generate_mesh_lods(data.owned_vertex_data, data.layout.get_floats_per_vertex(), data.owned_indices, lod_levels, lod_reduction, lod_max_error, indices, data.lods);
+    if (data.lods.size() <= 1) {
+        data.lods.clear();
+        return;
+    }
+    data.owned_indices = std::move(indices);
+    data.indices = data.owned_indices;
+}
+
+std::pair<VertexCacheStats, VertexCacheStats> Meshes::process_mesh_data(MeshFileData& data) const {
+    const unsigned int floats_per_vertex = data.layout.get_floats_per_vertex();
+    const size_t vertex_count = data.owned_vertex_data.size() / floats_per_vertex;
+    const VertexCacheStats before = analyze_vertex_cache(data.owned_indices, vertex_count);
+    if (!optimize_meshes or data.owned_indices.empty()) {
+        generate_lods(data);
+        return {before, before};
+    }
+
+    // the levels of detail are simplified from the optimized order, which keeps most of its locality
+    optimize_vertex_cache(data.owned_indices, vertex_count);
+    optimize_overdraw(data.owned_indices, data.owned_vertex_data, floats_per_vertex, overdraw_threshold);
+    generate_lods(data);
+    for (size_t level = 1; level < data.lods.size(); level++) {
+        const MeshLod& lod = data.lods[level];
+        optimize_vertex_cache(std::span(data.owned_indices).subspan(lod.first_index, lod.index_count), vertex_count);
+    }
+
+    // vertices in the order the full detail mesh uses them, the levels only use a subset of them
+    optimize_vertex_fetch(data.owned_vertex_data, floats_per_vertex, data.owned_indices);
+    data.vertex_data = data.owned_vertex_data;
+    data.indices = data.owned_indices;
+
+    const size_t full_detail_count = data.lods.empty() ? data.indices.size() : data.lods[0].index_count;
+    const VertexCacheStats after = analyze_vertex_cache(data.indices.first(full_detail_count), data.vertex_data.size() / floats_per_vertex);
+    return {before, after};
+}
+
+uint32_t Meshes::get_processing_cache_options() const {
+    if (lod_levels <= 1 and !optimize_meshes)
+        return 0;
+    // the settings hashed into the upper 16 bits (never 0), the lower ones hold the kind of load
+    const float settings[5] = {static_cast<float>(lod_levels), lod_reduction, lod_max_error, static_cast<float>(optimize_meshes), overdraw_threshold};
+    const uint64_t settings_hash = MeshCache::hash({reinterpret_cast<const std::byte*>(settings), sizeof(settings)});
+    return static_cast<uint32_t>((settings_hash | 1) & 0xffff) << 16;
+}
+
+unsigned int Meshes::get_mesh_identificator() {
+    next_mesh_id += 1;
+    return next_mesh_id - 1;
+}
+
+bool Meshes::should_parse_in_parallel(const char* source_path) const {
+    if (parallel_parsing_threshold == 0 or ge.workers.get_thread_count() == 0)
+        return false;
+    std::error_code error;
+    const auto size = std::filesystem::file_size(source_path, error);
+    return !error and size >= parallel_parsing_threshold;
+}
+
+std::shared_ptr<GeometryArena> Meshes::allocate_geometry(const VertexLayout& layout, const unsigned int index_size, const std::span<const std::byte> vertex_data, const std::span<const std::byte> index_data, GeometryAllocation& allocation) {
+    // one multi draw reads one index type, so 16 and 32-bit meshes live in different arenas, and arenas with position streams are kept apart from ones without
+    auto& layout_arenas = geometry_arenas[layout.get_key() << 2 | position_streams << 1 | (index_size == sizeof(uint16_t))];
+    for (const auto& arena : layout_arenas) {
+        if (arena->allocate(vertex_data, index_data, allocation))
+            return arena;
+    }
+
+    // no space left, meshes larger than a default arena get an arena of their size
+    const auto vertex_count = static_cast<unsigned int>(vertex_data.size() / layout.get_vertex_size());
+    const auto index_count = static_cast<unsigned int>(index_data.size() / index_size);
+    auto arena = std::make_shared<GeometryArena>(layout, index_size, std::max(vertex_count, GeometryArena::DEFAULT_VERTEX_CAPACITY), std::max(index_count, GeometryArena::DEFAULT_INDEX_CAPACITY), position_streams);
+    if (!arena->allocate(vertex_data, index_data, allocation))
+        return nullptr;
+    layout_arenas.push_back(arena);
+    return arena;
+}
+
 std::shared_ptr<Mesh> Meshes::get_plane(const bool with_tangents) const {
     if (!with_tangents)
         return plane;
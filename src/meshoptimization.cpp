@@ -0,0 +1,306 @@
+#include "meshoptimization.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <glm/glm.hpp>
+
+
+namespace {
+    /// Size of the LRU cache the Forsyth scores model, larger than real caches so the order suits all of them
+    constexpr unsigned int FORSYTH_CACHE_SIZE = 32;
+    constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+    /// no cache position, the vertex isn't cached
+    constexpr int NOT_CACHED = -1;
+
+    /// Score of a vertex by its LRU cache position and the amount of triangles still using it
+    float forsyth_vertex_score(const int cache_position, const unsigned int remaining_triangles) {
+        if (remaining_triangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cache_position >= 0) {
+            // the vertices of the last triangle get a fixed score, so it doesn't matter in which order they were used
+            if (cache_position < 3) {
+                score = FORSYTH_LAST_TRIANGLE_SCORE;
+            } else {
+                const float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+            }
+        }
+        // vertices with few triangles left are finished first, so they don't end up as lone triangles later
+        score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining_triangles), -FORSYTH_VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    /// Triangles using every vertex, in compressed rows (offsets + triangle list)
+    struct VertexTriangles {
+        std::vector<unsigned int> counts{};
+        std::vector<unsigned int> offsets{};
+        std::vector<unsigned int> triangles{};
+
+        VertexTriangles(const std::span<const unsigned int> indices, const size_t vertex_count) : counts(vertex_count, 0), offsets(vertex_count, 0), triangles(indices.size()) {
+            for (const unsigned int index : indices)
+                counts[index]++;
+            for (size_t v = 1; v < vertex_count; v++)
+                offsets[v] = offsets[v - 1] + counts[v - 1];
+
+            std::vector<unsigned int> fill = offsets;
+            for (size_t i = 0; i < indices.size(); i++)
+                triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    };
+}
+
+
+float VertexCacheStats::get_acmr() const {
+    return triangle_count == 0 ? 0.0f : static_cast<float>(cache_misses) / static_cast<float>(triangle_count);
+}
+
+float VertexCacheStats::get_atvr() const {
+    return vertex_count == 0 ? 0.0f : static_cast<float>(cache_misses) / static_cast<float>(vertex_count);
+}
+
+VertexCacheStats& VertexCacheStats::operator+=(const VertexCacheStats& other) {
+    triangle_count += other.triangle_count;
+    vertex_count += other.vertex_count;
+    cache_misses += other.cache_misses;
+    return *this;
+}
+
+
+VertexCacheStats analyze_vertex_cache(const std::span<const unsigned int> indices, const size_t vertex_count, const unsigned int cache_size) {
+    VertexCacheStats stats{};
+    stats.triangle_count = indices.size() / 3;
+
+    // a vertex is in the FIFO while less than cache_size misses happened since it entered
+    std::vector<unsigned int> cache_time(vertex_count, 0);
+    std::vector<bool> used(vertex_count, false);
+    unsigned int timestamp = cache_size + 1;
+    for (const unsigned int index : indices) {
+        if (timestamp - cache_time[index] > cache_size) {
+            cache_time[index] = timestamp++;
+            stats.cache_misses++;
+        }
+        if (!used[index]) {
+            used[index] = true;
+            stats.vertex_count++;
+        }
+    }
+    return stats;
+}
+
+
+void optimize_vertex_cache(const std::span<unsigned int> indices, const size_t vertex_count) {
+    const size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    VertexTriangles adjacency(indices, vertex_count);
+    // counts shrink as triangles are emitted, the rows keep only the live triangles first
+    std::vector<unsigned int>& remaining = adjacency.counts;
+
+    std::vector<int> cache_position(vertex_count, NOT_CACHED);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++)
+        vertex_score[v] = forsyth_vertex_score(NOT_CACHED, remaining[v]);
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<unsigned int> output{};
+    output.reserve(indices.size());
+
+    // the cache holds up to 3 vertices more than its size while a triangle is being added
+    std::vector<unsigned int> cache{};
+    std::vector<unsigned int> new_cache{};
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t best_triangle = triangle_count;
+    size_t next_unemitted = 0;
+    for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++) {
+        if (best_triangle == triangle_count) {
+            // nothing in the cache has triangles left, continue with the next unused triangle
+            while (emitted[next_unemitted])
+                next_unemitted++;
+            best_triangle = next_unemitted;
+        }
+
+        const unsigned int* triangle = &indices[best_triangle * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best_triangle] = true;
+
+        // the triangle's vertices go to the front of the cache, others move back
+        new_cache.clear();
+        for (int k = 0; k < 3; k++) {
+            const unsigned int v = triangle[k];
+            new_cache.push_back(v);
+
+            unsigned int* row = &adjacency.triangles[adjacency.offsets[v]];
+            const auto position = std::find(row, row + remaining[v], static_cast<unsigned int>(best_triangle));
+            std::swap(*position, row[remaining[v] - 1]);
+            remaining[v]--;
+        }
+        for (const unsigned int v : cache) {
+            if (v != triangle[0] and v != triangle[1] and v != triangle[2])
+                new_cache.push_back(v);
+        }
+        std::swap(cache, new_cache);
+
+        // rescore the touched vertices, the ones pushed out of the cache lose their position
+        for (size_t i = 0; i < cache.size(); i++) {
+            const unsigned int v = cache[i];
+            cache_position[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : NOT_CACHED;
+            vertex_score[v] = forsyth_vertex_score(cache_position[v], remaining[v]);
+        }
+
+        // pick the best triangle touching the cache
+        best_triangle = triangle_count;
+        float best_score = -1.0f;
+        for (const unsigned int v : cache) {
+            const unsigned int* row = &adjacency.triangles[adjacency.offsets[v]];
+            for (unsigned int i = 0; i < remaining[v]; i++) {
+                const unsigned int t = row[i];
+                const float score = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+                if (score > best_score) {
+                    best_score = score;
+                    best_triangle = t;
+                }
+            }
+        }
+        if (cache.size() > FORSYTH_CACHE_SIZE)
+            cache.resize(FORSYTH_CACHE_SIZE);
+    }
+
+    std::ranges::copy(output, indices.begin());
+}
+
+
+void optimize_overdraw(const std::span<unsigned int> indices, const std::span<const float> vertex_data, const unsigned int floats_per_vertex, const float threshold) {
+    const size_t triangle_count = indices.size() / 3;
+    const size_t vertex_count = vertex_data.size() / floats_per_vertex;
+    if (triangle_count < 2)
+        return;
+
+    // hard cluster boundaries, triangles whose 3 vertices all miss the cache start over, cutting there costs nothing
+    std::vector<unsigned int> cache_time(vertex_count, 0);
+    unsigned int timestamp = VERTEX_CACHE_ANALYSIS_SIZE + 1;
+    const auto simulate = [&](const size_t t) {
+        unsigned int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            const unsigned int v = indices[t * 3 + k];
+            if (timestamp - cache_time[v] > VERTEX_CACHE_ANALYSIS_SIZE) {
+                cache_time[v] = timestamp++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+    std::vector<unsigned int> hard_starts{};
+    std::vector<unsigned char> triangle_misses(triangle_count);
+    for (size_t t = 0; t < triangle_count; t++) {
+        triangle_misses[t] = static_cast<unsigned char>(simulate(t));
+        if (t == 0 or triangle_misses[t] == 3)
+            hard_starts.push_back(static_cast<unsigned int>(t));
+    }
+    hard_starts.push_back(static_cast<unsigned int>(triangle_count));
+
+    std::vector<unsigned int> cluster_starts{};
+    // soft boundaries, a hard cluster is cut where the part before the cut is about as cache efficient as the whole cluster
+    for (size_t c = 0; c + 1 < hard_starts.size(); c++) {
+        const unsigned int start = hard_starts[c];
+        const unsigned int end = hard_starts[c + 1];
+        unsigned int cluster_misses = 0;
+        for (unsigned int t = start; t < end; t++)
+            cluster_misses += triangle_misses[t];
+        const float cluster_acmr = static_cast<float>(cluster_misses) / static_cast<float>(end - start);
+
+        cluster_starts.push_back(start);
+        // misses of the part restart as if the cache was empty, like after being reordered
+        timestamp += VERTEX_CACHE_ANALYSIS_SIZE + 1;
+        unsigned int part_start = start;
+        unsigned int part_misses = 0;
+        for (unsigned int t = start; t < end; t++) {
+            part_misses += simulate(t);
+            const float part_acmr = static_cast<float>(part_misses) / static_cast<float>(t + 1 - part_start);
+            if (t + 1 < end and part_acmr <= cluster_acmr * threshold) {
+                part_start = t + 1;
+                part_misses = 0;
+                cluster_starts.push_back(part_start);
+                timestamp += VERTEX_CACHE_ANALYSIS_SIZE + 1;
+            }
+        }
+    }
+    cluster_starts.push_back(static_cast<unsigned int>(triangle_count));
+    const size_t cluster_count = cluster_starts.size() - 1;
+    if (cluster_count < 2)
+        return;
+
+    // area weighted centroids and normals of the clusters and of the whole mesh
+    const auto position = [&](const unsigned int v) {
+        return glm::vec3(vertex_data[v * floats_per_vertex], vertex_data[v * floats_per_vertex + 1], vertex_data[v * floats_per_vertex + 2]);
+    };
+    std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0.0f));
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < cluster_count; c++) {
+        float cluster_area = 0.0f;
+        for (unsigned int t = cluster_starts[c]; t < cluster_starts[c + 1]; t++) {
+            const glm::vec3 a = position(indices[t * 3]);
+            const glm::vec3 b = position(indices[t * 3 + 1]);
+            const glm::vec3 cc = position(indices[t * 3 + 2]);
+            const glm::vec3 cross = glm::cross(b - a, cc - a);
+            const float area = glm::length(cross);
+            cluster_centroids[c] += (a + b + cc) * (area / 3.0f);
+            cluster_normals[c] += cross;
+            cluster_area += area;
+        }
+        mesh_centroid += cluster_centroids[c];
+        mesh_area += cluster_area;
+        if (cluster_area > 0.0f)
+            cluster_centroids[c] /= cluster_area;
+    }
+    if (mesh_area > 0.0f)
+        mesh_centroid /= mesh_area;
+
+    // clusters facing away from the center are likely in front of the others, drawing them first lets the depth test reject the rest
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++) {
+        const float length = glm::length(cluster_normals[c]);
+        sort_keys[c] = length > 0.0f ? glm::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c] / length) : 0.0f;
+    }
+    std::vector<unsigned int> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, [&](const unsigned int a, const unsigned int b) {
+        return sort_keys[a] > sort_keys[b];
+    });
+
+    std::vector<unsigned int> output{};
+    output.reserve(indices.size());
+    for (const unsigned int c : order)
+        output.insert(output.end(), indices.begin() + cluster_starts[c] * 3, indices.begin() + cluster_starts[c + 1] * 3);
+    std::ranges::copy(output, indices.begin());
+}
+
+
+void optimize_vertex_fetch(std::vector<float>& vertex_data, const unsigned int floats_per_vertex, const std::span<unsigned int> indices) {
+    const size_t vertex_count = vertex_data.size() / floats_per_vertex;
+    constexpr unsigned int UNUSED = static_cast<unsigned int>(-1);
+
+    std::vector<unsigned int> remap(vertex_count, UNUSED);
+    unsigned int next_vertex = 0;
+    for (unsigned int& index : indices) {
+        if (remap[index] == UNUSED)
+            remap[index] = next_vertex++;
+        index = remap[index];
+    }
+
+    std::vector<float> reordered(static_cast<size_t>(next_vertex) * floats_per_vertex);
+    for (size_t v = 0; v < vertex_count; v++) {
+        if (remap[v] != UNUSED)
+            std::copy_n(vertex_data.begin() + v * floats_per_vertex, floats_per_vertex, reordered.begin() + static_cast<size_t>(remap[v]) * floats_per_vertex);
+    }
+    vertex_data = std::move(reordered);
+}
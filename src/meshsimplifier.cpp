@@ -0,0 +1,321 @@
+#include "meshsimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include "bounds.hpp"
+
+
+namespace {
+    /// Weight of the planes keeping open borders in place, relative to the triangle planes
+    constexpr double BORDER_WEIGHT = 10.0;
+
+    /// Sum of weighted squared distances to planes, a symmetric 4x4 matrix
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        /// sum of the plane weights, normalizes the error into a squared distance
+        double weight = 0;
+
+        void add_plane(const glm::dvec3& normal, const double distance, const double plane_weight) {
+            a00 += plane_weight * normal.x * normal.x;
+            a01 += plane_weight * normal.x * normal.y;
+            a02 += plane_weight * normal.x * normal.z;
+            a03 += plane_weight * normal.x * distance;
+            a11 += plane_weight * normal.y * normal.y;
+            a12 += plane_weight * normal.y * normal.z;
+            a13 += plane_weight * normal.y * distance;
+            a22 += plane_weight * normal.z * normal.z;
+            a23 += plane_weight * normal.z * distance;
+            a33 += plane_weight * distance * distance;
+            weight += plane_weight;
+        }
+
+        void add(const Quadric& other) {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+            a11 += other.a11; a12 += other.a12; a13 += other.a13;
+            a22 += other.a22; a23 += other.a23;
+            a33 += other.a33;
+            weight += other.weight;
+        }
+
+        /// v^T * Q * v with v = (point, 1)
+        [[nodiscard]] double evaluate(const glm::dvec3& p) const {
+            return a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x
+                 + a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y
+                 + a22 * p.z * p.z + 2.0 * a23 * p.z
+                 + a33;
+        }
+    };
+
+    /// What a vertex (position group) may do
+    enum VertexKind : unsigned char {
+        /// collapses along any edge
+        MANIFOLD,
+        /// on an open border, collapses only along the border
+        BORDER,
+        /// never moves (attribute seams, non-manifold geometry), other vertices may collapse onto it
+        LOCKED
+    };
+
+    uint64_t edge_key(unsigned int a, unsigned int b) {
+        if (a > b)
+            std::swap(a, b);
+        return static_cast<uint64_t>(a) << 32 | b;
+    }
+}
+
+
+std::vector<unsigned int> simplify_mesh(const std::span<const float> vertex_data, const unsigned int floats_per_vertex, const std::span<const unsigned int> indices, const size_t target_index_count, const float max_error, float* out_error) {
+    std::vector<unsigned int> result(indices.begin(), indices.end());
+    if (out_error != nullptr)
+        *out_error = 0.0f;
+    const size_t vertex_count = floats_per_vertex < 3 ? 0 : vertex_data.size() / floats_per_vertex;
+    if (vertex_count == 0 or result.size() <= target_index_count)
+        return result;
+
+    std::vector<glm::dvec3> positions(vertex_count);
+    BoundingBox bounds{};
+    for (size_t i = 0; i < vertex_count; i++) {
+        const float* p = vertex_data.data() + i * floats_per_vertex;
+        positions[i] = glm::dvec3{p[0], p[1], p[2]};
+        bounds.expand(glm::vec3{p[0], p[1], p[2]});
+    }
+    const glm::vec3 size = bounds.max - bounds.min;
+    const double extent = std::max({size.x, size.y, size.z});
+    if (!(extent > 0.0))
+        return result;
+
+    // vertices sharing a position (split by uvs or normals) form one group, the geometry is simplified on groups
+    std::vector<unsigned int> order(vertex_count);
+    std::iota(order.begin(), order.end(), 0u);
+    std::ranges::sort(order, [&](const unsigned int a, const unsigned int b) {
+        const glm::dvec3& pa = positions[a];
+        const glm::dvec3& pb = positions[b];
+        if (pa.x != pb.x)
+            return pa.x < pb.x;
+        if (pa.y != pb.y)
+            return pa.y < pb.y;
+        return pa.z < pb.z;
+    });
+    std::vector<unsigned int> group(vertex_count);
+    std::vector<unsigned int> group_vertex_counts{};
+    for (size_t i = 0; i < vertex_count; i++) {
+        if (i == 0 or positions[order[i]] != positions[order[i - 1]])
+            group_vertex_counts.push_back(0);
+        group[order[i]] = static_cast<unsigned int>(group_vertex_counts.size() - 1);
+        group_vertex_counts.back() += 1;
+    }
+    const size_t group_count = group_vertex_counts.size();
+
+    std::vector<Quadric> quadrics(group_count);
+    std::vector<VertexKind> kinds(group_count);
+    std::unordered_map<uint64_t, unsigned int> edge_counts{};
+    auto count_edges = [&] {
+        edge_counts.clear();
+        for (size_t t = 0; t + 2 < result.size(); t += 3) {
+            for (int e = 0; e < 3; e++) {
+                edge_counts[edge_key(group[result[t + e]], group[result[t + (e + 1) % 3]])] += 1;
+            }
+        }
+    };
+    auto is_border_edge = [&](const unsigned int a, const unsigned int b) {
+        const auto it = edge_counts.find(edge_key(group[a], group[b]));
+        return it != edge_counts.end() and it->second == 1;
+    };
+
+    // triangle planes weighted by area, border edges get planes perpendicular to their triangle
+    count_edges();
+    for (size_t t = 0; t + 2 < result.size(); t += 3) {
+        const glm::dvec3& p0 = positions[result[t]];
+        const glm::dvec3& p1 = positions[result[t + 1]];
+        const glm::dvec3& p2 = positions[result[t + 2]];
+        const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+        const double double_area = glm::length(cross);
+        if (double_area == 0.0)
+            continue;
+        const glm::dvec3 normal = cross / double_area;
+        for (int e = 0; e < 3; e++) {
+            quadrics[group[result[t + e]]].add_plane(normal, -glm::dot(normal, p0), double_area * 0.5);
+        }
+        for (int e = 0; e < 3; e++) {
+            const unsigned int a = result[t + e];
+            const unsigned int b = result[t + (e + 1) % 3];
+            if (!is_border_edge(a, b))
+                continue;
+            const glm::dvec3 edge = positions[b] - positions[a];
+            const double length = glm::length(edge);
+            if (length == 0.0)
+                continue;
+            const glm::dvec3 border_normal = glm::normalize(glm::cross(edge, normal));
+            const double distance = -glm::dot(border_normal, positions[a]);
+            quadrics[group[a]].add_plane(border_normal, distance, length * length * BORDER_WEIGHT);
+            quadrics[group[b]].add_plane(border_normal, distance, length * length * BORDER_WEIGHT);
+        }
+    }
+
+    const double max_cost = std::pow(static_cast<double>(max_error) * extent, 2.0);
+    double result_cost = 0.0;
+
+    std::vector<unsigned int> remap(vertex_count);
+    std::vector<unsigned int> adjacency_offsets(vertex_count + 1);
+    std::vector<unsigned int> adjacency{};
+    std::vector<unsigned int> border_edge_counts(group_count);
+    std::vector<unsigned int> targets(vertex_count);
+    std::vector<double> costs(vertex_count);
+    std::vector<unsigned int> candidates{};
+    std::vector<char> touched(vertex_count);
+
+    // passes of independent collapses, every pass rebuilds the topology
+    while (result.size() > target_index_count) {
+        count_edges();
+
+        // seams never move, border vertices with other than 2 border edges are corners or non-manifold
+        std::ranges::fill(border_edge_counts, 0u);
+        std::ranges::fill(kinds, MANIFOLD);
+        for (const auto& [key, count] : edge_counts) {
+            const auto a = static_cast<unsigned int>(key >> 32);
+            const auto b = static_cast<unsigned int>(key & 0xffffffffu);
+            if (count > 2) {
+                kinds[a] = LOCKED;
+                kinds[b] = LOCKED;
+            } else if (count == 1) {
+                border_edge_counts[a] += 1;
+                border_edge_counts[b] += 1;
+            }
+        }
+        for (size_t g = 0; g < group_count; g++) {
+            if (group_vertex_counts[g] > 1 or (border_edge_counts[g] != 0 and border_edge_counts[g] != 2))
+                kinds[g] = LOCKED;
+            else if (border_edge_counts[g] == 2 and kinds[g] == MANIFOLD)
+                kinds[g] = BORDER;
+        }
+
+        // triangles around every vertex
+        std::ranges::fill(adjacency_offsets, 0u);
+        for (const unsigned int index : result)
+            adjacency_offsets[index + 1] += 1;
+        std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+        adjacency.resize(result.size());
+        {
+            std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                adjacency[fill[result[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        // cheapest collapse of every vertex that may move
+        std::ranges::fill(targets, static_cast<unsigned int>(-1));
+        auto consider_collapse = [&](const unsigned int a, const unsigned int b) {
+            const VertexKind kind = kinds[group[a]];
+            if (kind == LOCKED or (kind == BORDER and !is_border_edge(a, b)))
+                return;
+            const Quadric& qa = quadrics[group[a]];
+            const Quadric& qb = quadrics[group[b]];
+            const double cost = std::max((qa.evaluate(positions[b]) + qb.evaluate(positions[b])) / std::max(qa.weight + qb.weight, 1e-30), 0.0);
+            if (targets[a] == static_cast<unsigned int>(-1) or cost < costs[a]) {
+                targets[a] = b;
+                costs[a] = cost;
+            }
+        };
+        for (size_t t = 0; t + 2 < result.size(); t += 3) {
+            for (int e = 0; e < 3; e++) {
+                consider_collapse(result[t + e], result[t + (e + 1) % 3]);
+                consider_collapse(result[t + (e + 1) % 3], result[t + e]);
+            }
+        }
+        candidates.clear();
+        for (unsigned int v = 0; v < vertex_count; v++) {
+            if (targets[v] != static_cast<unsigned int>(-1))
+                candidates.push_back(v);
+        }
+        std::ranges::sort(candidates, [&](const unsigned int a, const unsigned int b) { return costs[a] < costs[b]; });
+
+        // a collapse removes about 2 triangles, leave room for the following passes to pick better ones
+        const size_t collapse_limit = (result.size() - target_index_count) / 6 + 1;
+        size_t collapse_count = 0;
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::ranges::fill(touched, 0);
+
+        for (const unsigned int a : candidates) {
+            if (collapse_count >= collapse_limit or costs[a] > max_cost)
+                break;
+            const unsigned int b = targets[a];
+            if (touched[a] or touched[b])
+                continue;
+
+            // reject collapses that flip a remaining triangle
+            bool flips = false;
+            for (unsigned int i = adjacency_offsets[a]; i < adjacency_offsets[a + 1] and !flips; i++) {
+                const unsigned int* triangle = result.data() + static_cast<size_t>(adjacency[i]) * 3;
+                if (triangle[0] == b or triangle[1] == b or triangle[2] == b)
+                    continue;
+                glm::dvec3 p[3], moved[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = positions[triangle[k]];
+                    moved[k] = triangle[k] == a ? positions[b] : p[k];
+                }
+                const glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                const glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                flips = glm::dot(before, after) <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            remap[a] = b;
+            quadrics[group[b]].add(quadrics[group[a]]);
+            result_cost = std::max(result_cost, costs[a]);
+            collapse_count += 1;
+            // neighbours keep their triangles this pass, so the flip tests stay valid
+            for (unsigned int i = adjacency_offsets[a]; i < adjacency_offsets[a + 1]; i++) {
+                const unsigned int* triangle = result.data() + static_cast<size_t>(adjacency[i]) * 3;
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            touched[b] = 1;
+        }
+        if (collapse_count == 0)
+            break;
+
+        // apply, dropping triangles that lost their area
+        size_t write = 0;
+        for (size_t t = 0; t + 2 < result.size(); t += 3) {
+            const unsigned int i0 = remap[result[t]], i1 = remap[result[t + 1]], i2 = remap[result[t + 2]];
+            if (group[i0] == group[i1] or group[i1] == group[i2] or group[i0] == group[i2])
+                continue;
+            result[write++] = i0;
+            result[write++] = i1;
+            result[write++] = i2;
+        }
+        result.resize(write);
+    }
+
+    if (out_error != nullptr)
+        *out_error = static_cast<float>(std::sqrt(result_cost) / extent);
+    return result;
+}
+
+
+void generate_mesh_lods(const std::span<const float> vertex_data, const unsigned int floats_per_vertex, const std::span<const unsigned int> indices, const unsigned int max_levels, const float reduction, const float max_error, std::vector<unsigned int>& out_indices, std::vector<MeshLod>& out_lods) {
+    out_indices.assign(indices.begin(), indices.end());
+    out_lods.assign(1, MeshLod{0, static_cast<unsigned int>(indices.size()), 0.0f});
+
+    std::vector<unsigned int> previous(indices.begin(), indices.end());
+    float error = 0.0f;
+    for (unsigned int level = 1; level < max_levels; level++) {
+        const size_t target_index_count = static_cast<size_t>(static_cast<float>(previous.size()) * reduction) / 3 * 3;
+        if (target_index_count < MIN_LOD_TRIANGLES * 3 or error >= max_error)
+            break;
+
+        float level_error = 0.0f;
+        std::vector<unsigned int> lod = simplify_mesh(vertex_data, floats_per_vertex, previous, target_index_count, max_error - error, &level_error);
+        // a level has to save at least half of what was asked for to be worth its memory
+        if (static_cast<float>(lod.size()) > static_cast<float>(previous.size()) * (1.0f + reduction) * 0.5f)
+            break;
+
+        error += level_error;
+        out_lods.push_back(MeshLod{static_cast<unsigned int>(out_indices.size()), static_cast<unsigned int>(lod.size()), error});
+        out_indices.insert(out_indices.end(), lod.begin(), lod.end());
+        previous = std::move(lod);
+    }
+}
@@ -0,0 +1,307 @@
+#include "occlusionculler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "meshes.hpp"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GE_OCCLUSION_SSE2
+#endif
+
+
+OccluderMesh::OccluderMesh(std::vector<glm::vec3> positions, std::vector<unsigned int> indices) : positions(std::move(positions)), indices(std::move(indices)) {
+    for (const glm::vec3& position : this->positions)
+        bounding_box.expand(position);
+}
+
+OccluderMesh::OccluderMesh(const std::span<const float> vertex_data, const unsigned int floats_per_vertex, const std::span<const unsigned int> indices) : indices(indices.begin(), indices.end()) {
+    positions.reserve(vertex_data.size() / floats_per_vertex);
+    for (size_t i = 0; i + 2 < vertex_data.size(); i += floats_per_vertex) {
+        positions.emplace_back(vertex_data[i], vertex_data[i + 1], vertex_data[i + 2]);
+        bounding_box.expand(positions.back());
+    }
+}
+
+OccluderMesh::OccluderMesh(const MeshFileData& data, const unsigned int lod) : OccluderMesh(data.vertex_data, data.layout.get_floats_per_vertex(),
+    data.lods.empty() ? data.indices : data.indices.subspan(data.lods[std::min<size_t>(lod, data.lods.size() - 1)].first_index, data.lods[std::min<size_t>(lod, data.lods.size() - 1)].index_count)) {
+}
+
+OccluderMesh OccluderMesh::box(const BoundingBox& box) {
+    std::vector<glm::vec3> corners(8);
+    for (unsigned int i = 0; i < 8; i++)
+        corners[i] = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+    // two triangles per side, both faces get rasterized so the winding doesn't matter
+    return OccluderMesh{std::move(corners), {
+        0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,
+        0, 4, 5, 0, 5, 1,  2, 3, 7, 2, 7, 6,
+        0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3
+    }};
+}
+
+const std::vector<glm::vec3>& OccluderMesh::get_positions() const {
+    return positions;
+}
+
+const std::vector<unsigned int>& OccluderMesh::get_indices() const {
+    return indices;
+}
+
+const BoundingBox& OccluderMesh::get_bounding_box() const {
+    return bounding_box;
+}
+
+size_t OccluderMesh::get_triangle_count() const {
+    return indices.size() / 3;
+}
+
+
+OcclusionCuller::OcclusionCuller(const unsigned int width, const unsigned int height) {
+    resize(width, height);
+}
+
+void OcclusionCuller::resize(const unsigned int width, const unsigned int height) {
+    // rows are rasterized 4 pixels at a time
+    unsigned int level_width = std::max((width + 3) / 4 * 4, 4u);
+    unsigned int level_height = std::max(height, 1u);
+    levels.clear();
+    levels.push_back(HierarchyLevel{level_width, level_height, {}, std::vector<float>(static_cast<size_t>(level_width) * level_height, 1.0f)});
+    while (level_width > 1 or level_height > 1) {
+        level_width = (level_width + 1) / 2;
+        level_height = (level_height + 1) / 2;
+        const size_t texel_count = static_cast<size_t>(level_width) * level_height;
+        levels.push_back(HierarchyLevel{level_width, level_height, std::vector<float>(texel_count, 1.0f), std::vector<float>(texel_count, 1.0f)});
+    }
+}
+
+void OcclusionCuller::begin_frame(const glm::mat4& view_projection) {
+    this->view_projection = view_projection;
+    rasterized_triangle_count = 0;
+    std::ranges::fill(levels[0].max_depth, 1.0f);
+}
+
+void OcclusionCuller::rasterize(const OccluderMesh& occluder, const glm::mat4& world_matrix) {
+    const glm::mat4 matrix = view_projection * world_matrix;
+    const auto width = static_cast<float>(levels[0].width);
+    const auto height = static_cast<float>(levels[0].height);
+
+    // w = 0 marks vertices in front of the near plane
+    const std::vector<glm::vec3>& positions = occluder.get_positions();
+    screen_vertices.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        const glm::vec4 clip = matrix * glm::vec4(positions[i], 1.0f);
+        if (clip.w <= 0.0f or clip.z < -clip.w) {
+            screen_vertices[i] = glm::vec4(0.0f);
+            continue;
+        }
+        const float inverse_w = 1.0f / clip.w;
+        screen_vertices[i] = glm::vec4((clip.x * inverse_w * 0.5f + 0.5f) * width, (clip.y * inverse_w * 0.5f + 0.5f) * height, clip.z * inverse_w * 0.5f + 0.5f, 1.0f);
+    }
+
+    // triangles crossing the near plane are skipped instead of clipped, a missing occluder only lets more through
+    const std::vector<unsigned int>& indices = occluder.get_indices();
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const glm::vec4& v0 = screen_vertices[indices[i]];
+        const glm::vec4& v1 = screen_vertices[indices[i + 1]];
+        const glm::vec4& v2 = screen_vertices[indices[i + 2]];
+        if (v0.w == 0.0f or v1.w == 0.0f or v2.w == 0.0f)
+            continue;
+        rasterize_triangle(v0, v1, v2);
+        rasterized_triangle_count += 1;
+    }
+}
+
+void OcclusionCuller::rasterize_triangle(const glm::vec4& v0, glm::vec4 v1, glm::vec4 v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (area == 0.0f)
+        return;
+    // both faces are drawn, clockwise triangles are flipped
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    HierarchyLevel& base = levels[0];
+    // pixel centers inside the triangle bounds, clamped to the screen
+    const float first_x = std::max(std::ceil(std::min({v0.x, v1.x, v2.x}) - 0.5f), 0.0f);
+    const float last_x = std::min(std::floor(std::max({v0.x, v1.x, v2.x}) - 0.5f), static_cast<float>(base.width - 1));
+    const float first_y = std::max(std::ceil(std::min({v0.y, v1.y, v2.y}) - 0.5f), 0.0f);
+    const float last_y = std::min(std::floor(std::max({v0.y, v1.y, v2.y}) - 0.5f), static_cast<float>(base.height - 1));
+    if (first_x > last_x or first_y > last_y)
+        return;
+    // blocks of 4 pixels start at multiples of 4, the width is one too
+    const unsigned int x_begin = static_cast<unsigned int>(first_x) & ~3u;
+    const auto x_end = static_cast<unsigned int>(last_x);
+    const auto y_begin = static_cast<unsigned int>(first_y);
+    const auto y_end = static_cast<unsigned int>(last_y);
+
+    // edge functions, >= 0 on the inside of the opposite edge of every vertex, they sum up to the area
+    const float inverse_area = 1.0f / area;
+    const float e0_dx = v1.y - v2.y, e0_dy = v2.x - v1.x;
+    const float e1_dx = v2.y - v0.y, e1_dy = v0.x - v2.x;
+    const float e2_dx = v0.y - v1.y, e2_dy = v1.x - v0.x;
+    // depth is linear in screen space
+    const float z_dx = (e0_dx * v0.z + e1_dx * v1.z + e2_dx * v2.z) * inverse_area;
+    const float z_dy = (e0_dy * v0.z + e1_dy * v1.z + e2_dy * v2.z) * inverse_area;
+    // a pixel gets the farthest depth of the plane over its square instead of the depth at its center,
+    // the triangle itself never reaches past its farthest vertex
+    const float z_corner = 0.5f * (std::abs(z_dx) + std::abs(z_dy));
+    const float z_max = std::max({v0.z, v1.z, v2.z});
+
+    for (unsigned int y = y_begin; y <= y_end; y++) {
+        // evaluated again every row, so errors only add up along one row
+        const float px = static_cast<float>(x_begin) + 0.5f;
+        const float py = static_cast<float>(y) + 0.5f;
+        float e0 = e0_dx * (px - v1.x) + e0_dy * (py - v1.y);
+        float e1 = e1_dx * (px - v2.x) + e1_dy * (py - v2.y);
+        float e2 = e2_dx * (px - v0.x) + e2_dy * (py - v0.y);
+        float z = (e0 * v0.z + e1 * v1.z + e2 * v2.z) * inverse_area + z_corner;
+        float* row = base.max_depth.data() + static_cast<size_t>(y) * base.width;
+
+#ifdef GE_OCCLUSION_SSE2
+        const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 z_max_4 = _mm_set1_ps(z_max);
+        __m128 e0_4 = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(lane, _mm_set1_ps(e0_dx)));
+        __m128 e1_4 = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(lane, _mm_set1_ps(e1_dx)));
+        __m128 e2_4 = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(lane, _mm_set1_ps(e2_dx)));
+        __m128 z_4 = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(lane, _mm_set1_ps(z_dx)));
+        const __m128 e0_step = _mm_set1_ps(4.0f * e0_dx);
+        const __m128 e1_step = _mm_set1_ps(4.0f * e1_dx);
+        const __m128 e2_step = _mm_set1_ps(4.0f * e2_dx);
+        const __m128 z_step = _mm_set1_ps(4.0f * z_dx);
+        for (unsigned int x = x_begin; x <= x_end; x += 4) {
+            const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0_4, zero), _mm_cmpge_ps(e1_4, zero)), _mm_cmpge_ps(e2_4, zero));
+            if (_mm_movemask_ps(inside) != 0) {
+                const __m128 depth = _mm_loadu_ps(row + x);
+                const __m128 nearest = _mm_min_ps(depth, _mm_min_ps(z_4, z_max_4));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, depth)));
+            }
+            e0_4 = _mm_add_ps(e0_4, e0_step);
+            e1_4 = _mm_add_ps(e1_4, e1_step);
+            e2_4 = _mm_add_ps(e2_4, e2_step);
+            z_4 = _mm_add_ps(z_4, z_step);
+        }
+#else
+        for (unsigned int x = x_begin; x <= x_end; x++) {
+            if (e0 >= 0.0f and e1 >= 0.0f and e2 >= 0.0f)
+                row[x] = std::min({row[x], z, z_max});
+            e0 += e0_dx;
+            e1 += e1_dx;
+            e2 += e2_dx;
+            z += z_dx;
+        }
+#endif
+    }
+}
+
+void OcclusionCuller::build_hierarchy() {
+    for (size_t l = 1; l < levels.size(); l++) {
+        const HierarchyLevel& finer = levels[l - 1];
+        HierarchyLevel& level = levels[l];
+        // level 0 holds one depth per pixel, it's both the min and the max
+        const std::vector<float>& finer_min = l == 1 ? finer.max_depth : finer.min_depth;
+        for (unsigned int y = 0; y < level.height; y++) {
+            const size_t row_0 = static_cast<size_t>(2 * y) * finer.width;
+            const size_t row_1 = static_cast<size_t>(std::min(2 * y + 1, finer.height - 1)) * finer.width;
+            for (unsigned int x = 0; x < level.width; x++) {
+                const unsigned int x_0 = 2 * x;
+                const unsigned int x_1 = std::min(2 * x + 1, finer.width - 1);
+                const size_t texel = static_cast<size_t>(y) * level.width + x;
+                level.min_depth[texel] = std::min({finer_min[row_0 + x_0], finer_min[row_0 + x_1], finer_min[row_1 + x_0], finer_min[row_1 + x_1]});
+                level.max_depth[texel] = std::max({finer.max_depth[row_0 + x_0], finer.max_depth[row_0 + x_1], finer.max_depth[row_1 + x_0], finer.max_depth[row_1 + x_1]});
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::is_occluded(const BoundingBox& box) const {
+    if (box.is_empty())
+        return false;
+
+    const HierarchyLevel& base = levels[0];
+    const auto width = static_cast<float>(base.width);
+    const auto height = static_cast<float>(base.height);
+
+    // screen rectangle and nearest depth of the corners
+    glm::vec2 screen_min{std::numeric_limits<float>::max()};
+    glm::vec2 screen_max{std::numeric_limits<float>::lowest()};
+    float nearest = std::numeric_limits<float>::max();
+    // the corners are the projected min corner plus projected edges, one matrix multiplication for all of them
+    const glm::vec4 min_corner = view_projection * glm::vec4(box.min, 1.0f);
+    const glm::vec3 size = box.max - box.min;
+    const glm::vec4 edge_x = view_projection[0] * size.x;
+    const glm::vec4 edge_y = view_projection[1] * size.y;
+    const glm::vec4 edge_z = view_projection[2] * size.z;
+    for (unsigned int i = 0; i < 8; i++) {
+        glm::vec4 clip = min_corner;
+        if (i & 1)
+            clip += edge_x;
+        if (i & 2)
+            clip += edge_y;
+        if (i & 4)
+            clip += edge_z;
+        // crosses the near plane, the projection isn't bounded
+        if (clip.w <= 0.0f or clip.z < -clip.w)
+            return false;
+        const float inverse_w = 1.0f / clip.w;
+        const glm::vec2 screen{(clip.x * inverse_w * 0.5f + 0.5f) * width, (clip.y * inverse_w * 0.5f + 0.5f) * height};
+        screen_min = glm::min(screen_min, screen);
+        screen_max = glm::max(screen_max, screen);
+        nearest = std::min(nearest, clip.z * inverse_w * 0.5f + 0.5f);
+    }
+    // outside the screen is left to frustum culling
+    if (screen_max.x < 0.0f or screen_max.y < 0.0f or screen_min.x >= width or screen_min.y >= height)
+        return false;
+
+    // every pixel the rectangle touches
+    const auto x0 = static_cast<unsigned int>(std::max(screen_min.x, 0.0f));
+    const auto y0 = static_cast<unsigned int>(std::max(screen_min.y, 0.0f));
+    const auto x1 = static_cast<unsigned int>(std::min(screen_max.x, width - 1.0f));
+    const auto y1 = static_cast<unsigned int>(std::min(screen_max.y, height - 1.0f));
+
+    // start on the level where the rectangle covers at most 2 x 2 texels
+    size_t level = 0;
+    while (level + 1 < levels.size() and ((x1 >> level) - (x0 >> level) > 1 or (y1 >> level) - (y0 >> level) > 1))
+        level += 1;
+    return is_region_occluded(level, x0, y0, x1, y1, nearest);
+}
+
+bool OcclusionCuller::is_region_occluded(const size_t level, const unsigned int x0, const unsigned int y0, const unsigned int x1, const unsigned int y1, const float depth) const {
+    const HierarchyLevel& texels = levels[level];
+    const auto shift = static_cast<unsigned int>(level);
+    for (unsigned int ty = y0 >> shift; ty <= y1 >> shift; ty++) {
+        for (unsigned int tx = x0 >> shift; tx <= x1 >> shift; tx++) {
+            const size_t texel = static_cast<size_t>(ty) * texels.width + tx;
+            // behind everything in the texel
+            if (depth > texels.max_depth[texel])
+                continue;
+            // in front of everything in the texel, finer levels can't hide it either
+            if (level == 0 or depth <= texels.min_depth[texel])
+                return false;
+            // partly, decided by the texels below, restricted to the rectangle
+            const unsigned int child_x0 = std::max(x0, tx << shift);
+            const unsigned int child_y0 = std::max(y0, ty << shift);
+            const unsigned int child_x1 = std::min(x1, ((tx + 1) << shift) - 1);
+            const unsigned int child_y1 = std::min(y1, ((ty + 1) << shift) - 1);
+            if (!is_region_occluded(level - 1, child_x0, child_y0, child_x1, child_y1, depth))
+                return false;
+        }
+    }
+    return true;
+}
+
+unsigned int OcclusionCuller::get_width() const {
+    return levels[0].width;
+}
+
+unsigned int OcclusionCuller::get_height() const {
+    return levels[0].height;
+}
+
+std::span<const float> OcclusionCuller::get_depth_buffer() const {
+    return levels[0].max_depth;
+}
+
+size_t OcclusionCuller::get_rasterized_triangle_count() const {
+    return rasterized_triangle_count;
+}
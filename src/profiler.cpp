@@ -0,0 +1,210 @@
+#include "profiler.hpp"
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include "graphicengine.hpp"
+
+
+namespace {
+    /// Writes a string as a JSON string literal
+    void write_json_string(std::ostream& out, const char* text) {
+        out << '"';
+        for (const char* c = text; *c != '\0'; c++) {
+            if (*c == '"' or *c == '\\')
+                out << '\\' << *c;
+            else if (static_cast<unsigned char>(*c) < 0x20)
+                out << ' ';
+            else
+                out << *c;
+        }
+        out << '"';
+    }
+}
+
+
+Profiler::~Profiler() {
+    for (GpuFrame& frame : gpu_frames) {
+        if (!frame.queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+    }
+}
+
+uint64_t Profiler::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::add_cpu_event(const char* name, const uint64_t start, const uint64_t end) {
+    const unsigned int thread = ThreadPool::get_worker_index();
+    std::lock_guard lock(events_mutex);
+    frame_events.push_back(Event{name, start, end - start, thread});
+}
+
+void Profiler::begin_gpu_zone(const char* name) {
+    GpuFrame& frame = gpu_frames[current_gpu_frame];
+    if (frame.used_queries == 0) {
+        glGetInteger64v(GL_TIMESTAMP, &frame.gpu_sync);
+        frame.cpu_sync = now();
+    }
+    // a begin and an end timestamp per zone
+    if (frame.queries.size() < frame.used_queries + 2) {
+        const size_t old_size = frame.queries.size();
+        frame.queries.resize(std::max<size_t>(16, old_size * 2));
+        glGenQueries(static_cast<GLsizei>(frame.queries.size() - old_size), frame.queries.data() + old_size);
+    }
+
+    const size_t query = frame.used_queries;
+    frame.used_queries += 2;
+    glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+    frame.last_query = query;
+    frame.zones.push_back(GpuZone{name, query});
+    open_gpu_zones.push_back(query);
+}
+
+void Profiler::end_gpu_zone() {
+    if (open_gpu_zones.empty())
+        return;
+    GpuFrame& frame = gpu_frames[current_gpu_frame];
+    const size_t query = open_gpu_zones.back();
+    open_gpu_zones.pop_back();
+    glQueryCounter(frame.queries[query + 1], GL_TIMESTAMP);
+    frame.last_query = query + 1;
+}
+
+void Profiler::resolve_gpu_frame(GpuFrame& frame) {
+    if (!frame.zones.empty()) {
+        // timestamps finish in order, so the last one tells if all are available
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[frame.last_query], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            for (const GpuZone& zone : frame.zones) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(frame.queries[zone.query], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.queries[zone.query + 1], GL_QUERY_RESULT, &end);
+                const int64_t offset = static_cast<int64_t>(begin) - frame.gpu_sync;
+                const Event event{zone.name, static_cast<uint64_t>(std::max<int64_t>(0, static_cast<int64_t>(frame.cpu_sync) + offset)), end > begin ? end - begin : 0, GPU_THREAD};
+                last_frame_events.push_back(event);
+                if (frame.captured)
+                    captured_events.push_back(event);
+            }
+        } else {
+            // the GPU lagging behind is usually not a one-off, so only the first dropped frame is reported
+            if (dropped_gpu_frames == 0)
+                Engine::debug_warning("Profiler: GPU timestamps of the previous frame aren't available yet, dropping its GPU zones (further dropped frames are only counted).");
+            dropped_gpu_frames += 1;
+        }
+    }
+    frame.zones.clear();
+    frame.used_queries = 0;
+    frame.captured = false;
+}
+
+void Profiler::end_frame() {
+    const uint64_t frame_end = now();
+    std::lock_guard lock(events_mutex);
+
+    frame_events.push_back(Event{"Frame", frame_start, frame_end - frame_start, ThreadPool::get_worker_index()});
+    last_frame_events.swap(frame_events);
+    frame_events.clear();
+
+    if (capture_frames_left > 0) {
+        captured_events.insert(captured_events.end(), last_frame_events.begin(), last_frame_events.end());
+        gpu_frames[current_gpu_frame].captured = true;
+        capture_frames_left -= 1;
+    }
+
+    // the next frame reuses the queries of the previous one, they had a whole frame to finish
+    open_gpu_zones.clear();
+    current_gpu_frame = (current_gpu_frame + 1) % GPU_FRAME_COUNT;
+    resolve_gpu_frame(gpu_frames[current_gpu_frame]);
+
+    frame_start = frame_end;
+}
+
+void Profiler::capture(const unsigned int frame_count) {
+    std::lock_guard lock(events_mutex);
+    captured_events.clear();
+    capture_frames_left = frame_count;
+    for (GpuFrame& frame : gpu_frames) {
+        frame.captured = false;
+    }
+}
+
+bool Profiler::is_capturing() const {
+    std::lock_guard lock(events_mutex);
+    if (capture_frames_left > 0)
+        return true;
+    for (const GpuFrame& frame : gpu_frames) {
+        if (frame.captured)
+            return true;
+    }
+    return false;
+}
+
+const std::vector<Profiler::Event>& Profiler::get_last_frame_events() const {
+    return last_frame_events;
+}
+
+unsigned int Profiler::get_dropped_gpu_frames() const {
+    return dropped_gpu_frames;
+}
+
+bool Profiler::write_chrome_trace(const char* file_path) const {
+    std::ofstream file(file_path);
+    if (!file.is_open()) {
+        Engine::debug_error("Profiler: can't write the trace file: " + std::string(file_path));
+        return false;
+    }
+
+    std::lock_guard lock(events_mutex);
+    // timestamps and durations in microseconds
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    std::set<unsigned int> threads{};
+    bool first = true;
+    for (const Event& event : captured_events) {
+        threads.insert(event.thread);
+        file << (first ? "\n" : ",\n") << "{\"name\":";
+        write_json_string(file, event.name);
+        file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+             << ",\"ts\":" << static_cast<double>(event.start) / 1000.0
+             << ",\"dur\":" << static_cast<double>(event.duration) / 1000.0 << "}";
+        first = false;
+    }
+    for (const unsigned int thread : threads) {
+        std::string name = thread == GPU_THREAD ? "GPU" : thread == 0 ? "Main" : "Worker " + std::to_string(thread);
+        file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":";
+        write_json_string(file, name.c_str());
+        file << "}}";
+        first = false;
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        Engine::debug_error("Profiler: failed writing the trace file: " + std::string(file_path));
+        return false;
+    }
+    return true;
+}
+
+
+ProfileZone::ProfileZone(const char* name) : name(ge.profiler.enabled ? name : nullptr) {
+    if (this->name != nullptr)
+        start = ge.profiler.now();
+}
+
+ProfileZone::~ProfileZone() {
+    if (name != nullptr)
+        ge.profiler.add_cpu_event(name, start, ge.profiler.now());
+}
+
+
+GpuProfileZone::GpuProfileZone(const char* name) : cpu_zone(name), active(ge.profiler.enabled) {
+    if (active)
+        ge.profiler.begin_gpu_zone(name);
+}
+
+GpuProfileZone::~GpuProfileZone() {
+    if (active)
+        ge.profiler.end_gpu_zone();
+}
@@ -0,0 +1,121 @@
+#include "programcache.hpp"
+#include "meshcache.hpp"
+#include "graphicengine.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+
+/// Fixed size header at the start of a .gebin file
+struct ProgramFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binary_format;
+    uint32_t binary_size;
+};
+
+static constexpr char MAGIC[4] = {'G', 'E', 'P', 'B'};
+
+
+uint64_t ProgramBinaryCache::get_key(const std::string& vertex_source, const std::string& fragment_source) {
+    std::string key_source = vertex_source;
+    key_source += '\0';
+    key_source += fragment_source;
+    for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const auto driver_string = reinterpret_cast<const char*>(glGetString(name));
+        key_source += '\0';
+        key_source += driver_string != nullptr ? driver_string : "";
+    }
+    return MeshCache::hash(std::as_bytes(std::span(key_source)));
+}
+
+
+std::filesystem::path ProgramBinaryCache::get_path(const uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.gebin", static_cast<unsigned long long>(key));
+    return directory / name;
+}
+
+
+bool ProgramBinaryCache::load(const unsigned int program, const uint64_t key) const {
+    if (!enabled)
+        return false;
+
+    const MappedFile file(get_path(key));
+    if (!file.is_open())
+        return false;
+    const std::span<const std::byte> bytes = file.get_data();
+    if (bytes.size() < sizeof(ProgramFileHeader))
+        return false;
+
+    ProgramFileHeader header{};
+    std::memcpy(&header, bytes.data(), sizeof(ProgramFileHeader));
+    if (std::memcmp(header.magic, MAGIC, 4) != 0 or header.version != VERSION or header.key != key or bytes.size() - sizeof(ProgramFileHeader) < header.binary_size)
+        return false;
+
+    ge.gl_extensions.program_binary(program, header.binary_format, bytes.data() + sizeof(ProgramFileHeader), static_cast<GLsizei>(header.binary_size));
+
+    // the driver rejects binaries of a different driver build, GPU etc.
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        Engine::debug_message("Cached program binary rejected by the driver, compiling from source.");
+        std::error_code error;
+        std::filesystem::remove(get_path(key), error);
+        return false;
+    }
+    return true;
+}
+
+
+void ProgramBinaryCache::save(const unsigned int program, const uint64_t key) const {
+    if (!enabled)
+        return;
+
+    int binary_size = 0;
+    glGetProgramiv(program, GLExtensions::PROGRAM_BINARY_LENGTH, &binary_size);
+    if (binary_size <= 0)
+        return;
+
+    std::vector<std::byte> binary(binary_size);
+    GLenum binary_format = 0;
+    ge.gl_extensions.get_program_binary(program, binary_size, &binary_size, &binary_format, binary.data());
+
+    const ProgramFileHeader header{
+        {MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]},
+        VERSION,
+        key,
+        binary_format,
+        static_cast<uint32_t>(binary_size)
+    };
+
+    // write through a temporary file, so a reader never sees a partial file
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    const std::filesystem::path path = get_path(key);
+    const std::filesystem::path temp_path = MeshCache::get_temp_path(path);
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.good()) {
+            Engine::debug_warning("Failed to write program binary cache: " + path.string());
+            std::filesystem::remove(temp_path, error);
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(ProgramFileHeader));
+        file.write(reinterpret_cast<const char*>(binary.data()), binary_size);
+        file.close();
+        if (!file.good()) {
+            Engine::debug_warning("Failed to write program binary cache: " + path.string());
+            std::filesystem::remove(temp_path, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        Engine::debug_warning("Failed to write program binary cache: " + path.string());
+        std::filesystem::remove(temp_path, error);
+    }
+}
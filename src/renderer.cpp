@@ -1,5 +1,9 @@
 #include "renderer.hpp"
+#include <algorithm>
+#include <bit>
+#include <limits>
 #include "shaders.hpp"
+#include "occlusionculler.hpp"
 #include "graphicengine.hpp"
 #include "gtc/type_ptr.inl"
 
@@ -8,6 +12,7 @@ ColorPass::ColorPass(Color color) : color(color) {
 };
 
 void ColorPass::render() {
+    GE_PROFILE_GPU_ZONE("ColorPass");
     if (ge.auto_clear_screen and (!ge.was_color_buffer_cleared() or !ge.was_depth_buffer_cleared())) {
         ge.clear_framebuffers();
     }
@@ -15,11 +20,35 @@ void ColorPass::render() {
     glClearColor(color.r, color.g, color.b, color.a);
 }
 
+unsigned int StreamBuffer::get_id() {
+    if (buffer == 0)
+        glGenBuffers(1, &buffer);
+    return buffer;
+}
+
+void StreamBuffer::upload(const unsigned int target, const void* data, const size_t size) {
+    glBindBuffer(target, get_id());
+    if (size > capacity) {
+        // grow, at least double so we don't reallocate every frame
+        capacity = std::max(size, capacity * 2);
+    }
+    glBufferData(target, static_cast<GLsizeiptr>(capacity), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, static_cast<GLsizeiptr>(size), data);
+    glBindBuffer(target, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+    if (buffer != 0)
+        glDeleteBuffers(1, &buffer);
+}
+
+
 ForwardOpaque3DPass::ForwardOpaque3DPass(const geRef<Camera> _camera, const unsigned int render_layer) : render_layer(render_layer), camera(_camera) {
 }
 
 
 void ForwardOpaque3DPass::render() {
+    GE_PROFILE_GPU_ZONE("ForwardOpaque3DPass");
     if (ge.auto_clear_screen and (!ge.was_color_buffer_cleared() or !ge.was_depth_buffer_cleared())) {
         ge.clear_framebuffers();
     }
@@ -27,6 +56,8 @@ void ForwardOpaque3DPass::render() {
     camera->transform_to_view_matrix();
 
     ge.lights.update(camera->transform.position);
+    // clusters are tiles of the framebuffer, the shader finds its tile from gl_FragCoord
+    ge.lights.update_clusters(*camera.get(), ge.window.framebuffer_width, ge.window.framebuffer_height);
 
     // update Camera Data Uniform Buffer
     glBindBuffer(GL_UNIFORM_BUFFER, ge.camera_matrix_ubo);
@@ -34,29 +65,337 @@ void ForwardOpaque3DPass::render() {
     glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(camera->view));
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    unsigned int current_sp = -1;
-    uint64_t current_mat_id = -1;
+    current_sp = -1;
+    current_mat_id = -1;
+
+    frustum = camera->get_frustum();
+    frustum_culled_count = 0;
+    occlusion_culled_count = 0;
+    if (occlusion_culling)
+        rasterize_occluders();
 
-    for (const auto& [mat, id] : ge.thing_ids_by_shader_program) {
+    // view depth of the mesh centers, normalized by the far plane, for front-to-back ordering
+    const glm::vec4 view_depth_row{-camera->view[0][2], -camera->view[1][2], -camera->view[2][2], -camera->view[3][2]};
+    const float far_plane = camera->get_far_plane() > 0.0f ? camera->get_far_plane() : 1.0f;
+    // screen height fraction covered by a sphere of radius 1 at depth 1, perspective projections divide by depth
+    const float projected_scale = camera->projection[1][1];
+    const bool perspective = camera->projection[3][3] == 0.0f;
+
+    render_queue.clear();
+    for (MeshThing* thing : ge.mesh_things) {
         // skip not renderable entities || or || an entity that does bitwise match by render layer
-        if (!ge.get_thing(id)->visible or !(ge.get_thing(id)->render_layer & render_layer))
+        const unsigned int matching_layers = thing->render_layer & render_layer;
+        if (!thing->visible or matching_layers == 0)
             continue;
-        // switch shader program if need be
-        if (mat->get_shader_program_id() != current_sp) {
-            current_sp = mat->get_shader_program_id();
-            mat->get_shader_program().use();
+
+        const Mesh* mesh = thing->get_mesh_pointer();
+        const glm::mat4& world_matrix = thing->get_world_matrix();
+        // skip entities outside the camera view or hidden behind occluders, before any GL state changes
+        if (frustum_culling or occlusion_culling) {
+            const BoundingBox world_box = mesh->get_bounding_box().transformed(world_matrix);
+            if (frustum_culling and !frustum.intersects(world_box)) {
+                frustum_culled_count += 1;
+                continue;
+            }
+            // occluders would hide themselves
+            if (occlusion_culling and thing->occluder == nullptr and occlusion_culler.is_occluded(world_box)) {
+                occlusion_culled_count += 1;
+                continue;
+            }
         }
-        // update uniform values only if mat id changes, which means we can repeat uniform setting, but only when 2 different material have the same values
-        if (mat->get_id() != current_mat_id) {
-            current_mat_id = mat->get_id();
-            mat->apply_uniform_values();
+
+        float depth = 0.0f;
+        const bool select_lod = lod_selection and mesh->get_lod_count() > 1;
+        if (front_to_back or select_lod) {
+            const glm::vec4 center = world_matrix * glm::vec4(mesh->get_bounding_sphere().center, 1.0f);
+            const float view_depth = glm::dot(view_depth_row, center);
+            depth = view_depth / far_plane;
+
+            if (select_lod) {
+                const float scale_sq = std::max({glm::dot(world_matrix[0], world_matrix[0]), glm::dot(world_matrix[1], world_matrix[1]), glm::dot(world_matrix[2], world_matrix[2])});
+                const float radius = mesh->get_bounding_sphere().radius * std::sqrt(scale_sq);
+                // inside the sphere counts as covering the whole screen
+                const float screen_size = !perspective ? radius * projected_scale : view_depth > radius ? radius * projected_scale / view_depth : std::numeric_limits<float>::max();
+                thing->lod = choose_lod(thing->lod, std::min(mesh->get_lod_count() - 1, static_cast<unsigned int>(lod_screen_sizes.size())), screen_size);
+            }
+        }
+        const Material* mat = thing->get_material_pointer();
+        render_queue.push(RenderQueue::make_key(std::countr_zero(matching_layers), mat->get_shader_program_id(), mat->get_id(), mesh->get_id(), depth), thing);
+    }
+    render_queue.sort();
+
+    PrepassQueries& queries = prepass_queries[current_prepass_query];
+    if (depth_prepass)
+        draw_depth_prepass();
+
+    GE_PROFILE_ZONE("Draw render queue");
+
+    const auto& items = render_queue.get_items();
+    size_t i = 0;
+    while (i < items.size()) {
+        Material* mat = items[i].thing->get_material_pointer();
+        const ShaderProgram* instanced_sp = ge.shaders.get_instanced_variant(mat->get_shader_program_id());
+        instanced_batch.clear();
+
+        // go through the run of entities sharing this material
+        for (; i < items.size() and items[i].thing->get_material_pointer() == mat; ++i) {
+            MeshThing* thing = items[i].thing;
+
+            // drawn later together with entities sharing the same mesh
+            if (is_instanced(*thing, instanced_sp)) {
+                instanced_batch.push_back(thing);
+                continue;
+            }
+
+            use_material(*mat, mat->get_shader_program());
+            // render thing
+            thing->render();
         }
 
-        // render thing
-        ge.get_thing(id)->render();
+        if (!instanced_batch.empty()) {
+            use_material(*mat, *instanced_sp);
+            if (depth_prepass) {
+                // the pre-pass already wrote the depth of these, only the front-most surface is shaded
+                const GLenum depth_func = ge.gl_state.get_depth_func();
+                const bool depth_mask = ge.gl_state.get_depth_mask();
+                ge.gl_state.set_depth_func(GL_EQUAL);
+                ge.gl_state.set_depth_mask(false);
+                // only these are covered by the pre-pass, so only their samples are compared with it
+                if (queries.color_count == queries.color.size()) {
+                    queries.color.push_back(0);
+                    glGenQueries(1, &queries.color.back());
+                }
+                glBeginQuery(GL_SAMPLES_PASSED, queries.color[queries.color_count++]);
+                draw_instanced_batch(false);
+                glEndQuery(GL_SAMPLES_PASSED);
+                ge.gl_state.set_depth_func(depth_func);
+                ge.gl_state.set_depth_mask(depth_mask);
+            } else {
+                draw_instanced_batch(false);
+            }
+        }
+    }
+    ge.gl_state.bind_vertex_array(0);
+
+    if (depth_prepass) {
+        queries.pending = true;
+        current_prepass_query = (current_prepass_query + 1) % PREPASS_QUERY_FRAME_COUNT;
+    }
+}
+
+
+void ForwardOpaque3DPass::draw_depth_prepass() {
+    GE_PROFILE_GPU_ZONE("Depth pre-pass");
+    PrepassQueries& queries = prepass_queries[current_prepass_query];
+    if (queries.depth == 0)
+        glGenQueries(1, &queries.depth);
+    resolve_prepass_queries(queries);
+    queries.color_count = 0;
+
+    // every entity the color pass draws instanced, in queue order
+    instanced_batch.clear();
+    unsigned int sp_id = -1;
+    const ShaderProgram* instanced_sp = nullptr;
+    for (const RenderQueue::Item& item : render_queue.get_items()) {
+        const unsigned int item_sp_id = item.thing->get_material_pointer()->get_shader_program_id();
+        if (item_sp_id != sp_id) {
+            sp_id = item_sp_id;
+            instanced_sp = ge.shaders.get_instanced_variant(sp_id);
+        }
+        if (is_instanced(*item.thing, instanced_sp))
+            instanced_batch.push_back(item.thing);
+    }
+
+    const ShaderProgram& depth_sp = ge.shaders.get_depth_only_program();
+    current_sp = depth_sp.get_id();
+    depth_sp.use();
+
+    ge.gl_state.set_color_mask(false, false, false, false);
+    glBeginQuery(GL_SAMPLES_PASSED, queries.depth);
+    if (!instanced_batch.empty())
+        draw_instanced_batch(true);
+    glEndQuery(GL_SAMPLES_PASSED);
+    ge.gl_state.set_color_mask(true, true, true, true);
+}
+
+
+void ForwardOpaque3DPass::resolve_prepass_queries(PrepassQueries& queries) {
+    if (!queries.pending)
+        return;
+    // results not ready after the whole ring are dropped, waiting for them would stall the CPU
+    queries.pending = false;
+    int available = 0;
+    glGetQueryObjectiv(queries.depth, GL_QUERY_RESULT_AVAILABLE, &available);
+    for (size_t i = 0; i < queries.color_count and available; i++)
+        glGetQueryObjectiv(queries.color[i], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+    glGetQueryObjectui64v(queries.depth, GL_QUERY_RESULT, &prepass_stats.depth_samples);
+    prepass_stats.shaded_samples = 0;
+    for (size_t i = 0; i < queries.color_count; i++) {
+        uint64_t samples = 0;
+        glGetQueryObjectui64v(queries.color[i], GL_QUERY_RESULT, &samples);
+        prepass_stats.shaded_samples += samples;
     }
 }
 
+
+bool ForwardOpaque3DPass::is_instanced(const MeshThing& thing, const ShaderProgram* instanced_shader_program) {
+    return instanced_shader_program != nullptr and thing.allow_instancing;
+}
+
+
+void ForwardOpaque3DPass::rasterize_occluders() {
+    GE_PROFILE_ZONE("Rasterize occluders");
+    occlusion_culler.begin_frame(camera->projection * camera->view);
+    for (MeshThing* thing : ge.mesh_things) {
+        if (thing->occluder == nullptr or !thing->visible or (thing->render_layer & render_layer) == 0)
+            continue;
+        const glm::mat4& world_matrix = thing->get_world_matrix();
+        if (frustum_culling and !frustum.intersects(thing->occluder->get_bounding_box().transformed(world_matrix)))
+            continue;
+        occlusion_culler.rasterize(*thing->occluder, world_matrix);
+    }
+    occlusion_culler.build_hierarchy();
+}
+
+
+unsigned int ForwardOpaque3DPass::choose_lod(unsigned int lod, const unsigned int max_lod, const float screen_size) const {
+    // a level is left only once the size is past its threshold by the hysteresis, so objects near a threshold don't switch every frame
+    lod = std::min(lod, max_lod);
+    while (lod < max_lod and screen_size < lod_screen_sizes[lod] * (1.0f - lod_hysteresis))
+        lod += 1;
+    while (lod > 0 and screen_size > lod_screen_sizes[lod - 1] * (1.0f + lod_hysteresis))
+        lod -= 1;
+    return lod;
+}
+
+
+void ForwardOpaque3DPass::use_material(const Material &material, const ShaderProgram &shader_program) {
+    const bool program_changed = shader_program.get_id() != current_sp;
+    // switch shader program if need be
+    if (program_changed) {
+        current_sp = shader_program.get_id();
+        shader_program.use();
+    }
+    // update uniform values only if mat id (or the program they are applied to) changes, which means we can repeat uniform setting, but only when 2 different material have the same values
+    if (program_changed or material.get_id() != current_mat_id) {
+        current_mat_id = material.get_id();
+        material.apply_uniform_values(shader_program);
+    }
+}
+
+
+void ForwardOpaque3DPass::draw_instanced_batch(const bool position_only) {
+    // group by arena (one VAO) and by mesh and level of detail within it, stable to keep the front-to-back order of the queue
+    std::ranges::stable_sort(instanced_batch, [](const MeshThing* a, const MeshThing* b) {
+        const Mesh* mesh_a = a->get_mesh_pointer();
+        const Mesh* mesh_b = b->get_mesh_pointer();
+        if (mesh_a->get_geometry_arena() != mesh_b->get_geometry_arena())
+            return mesh_a->get_geometry_arena() < mesh_b->get_geometry_arena();
+        if (mesh_a != mesh_b)
+            return mesh_a < mesh_b;
+        return a->lod < b->lod;
+    });
+
+    // instance data of the whole batch in batch order, every draw reads its own range
+    instance_data.clear();
+    for (MeshThing* thing : instanced_batch) {
+        const glm::mat3& normal_matrix = thing->get_world_normal_matrix();
+
+        InstanceData& data = instance_data.emplace_back();
+        const Mesh* mesh = thing->get_mesh_pointer();
+        data.transform = mesh->has_quantized_positions() ? thing->get_world_matrix() * mesh->get_dequantization_matrix() : thing->get_world_matrix();
+        data.normal_matrix[0] = normal_matrix[0];
+        data.normal_matrix[1] = normal_matrix[1];
+        data.normal_matrix[2] = normal_matrix[2];
+        data.tint = glm::vec4(thing->tint.r, thing->tint.g, thing->tint.b, thing->tint.a);
+    }
+    ge.instance_buffer.upload(GL_ARRAY_BUFFER, instance_data.data(), instance_data.size() * sizeof(InstanceData));
+    const unsigned int instance_buffer = ge.instance_buffer.get_id();
+    const bool use_multi_draw = multi_draw_indirect and ge.gl_extensions.multi_draw_indirect;
+
+    size_t run_start = 0;
+    while (run_start < instanced_batch.size()) {
+        Mesh* mesh = instanced_batch[run_start]->get_mesh_pointer();
+        GeometryArena* arena = mesh->get_geometry_arena();
+
+        // all meshes of the arena in one call, base_instance points each draw at its instance data
+        if (arena != nullptr and use_multi_draw) {
+            draw_commands.clear();
+            size_t arena_end = run_start;
+            while (arena_end < instanced_batch.size() and instanced_batch[arena_end]->get_mesh_pointer()->get_geometry_arena() == arena) {
+                const Mesh* run_mesh = instanced_batch[arena_end]->get_mesh_pointer();
+                const unsigned int run_lod = instanced_batch[arena_end]->lod;
+                size_t run_end = arena_end;
+                while (run_end < instanced_batch.size() and instanced_batch[run_end]->get_mesh_pointer() == run_mesh and instanced_batch[run_end]->lod == run_lod)
+                    run_end++;
+
+                const MeshLod& level = run_mesh->get_lod(run_lod);
+                draw_commands.push_back(DrawElementsIndirectCommand{
+                    level.index_count,
+                    static_cast<unsigned int>(run_end - arena_end),
+                    run_mesh->get_first_index() + level.first_index,
+                    run_mesh->get_base_vertex(),
+                    static_cast<unsigned int>(arena_end)
+                });
+                arena_end = run_end;
+            }
+
+            // the arena vertex arrays read instance data from the start of the buffer, base_instance does the rest
+            ge.gl_state.bind_vertex_array(position_only ? arena->get_depth_vertex_array_object(instance_buffer) : arena->get_instanced_vertex_array_object(instance_buffer));
+            ge.indirect_buffer.upload(GLExtensions::DRAW_INDIRECT_BUFFER, draw_commands.data(), draw_commands.size() * sizeof(DrawElementsIndirectCommand));
+            glBindBuffer(GLExtensions::DRAW_INDIRECT_BUFFER, ge.indirect_buffer.get_id());
+            ge.gl_extensions.multi_draw_elements_indirect(GL_TRIANGLES, arena->get_index_type(), nullptr, static_cast<GLsizei>(draw_commands.size()), 0);
+            glBindBuffer(GLExtensions::DRAW_INDIRECT_BUFFER, 0);
+
+            run_start = arena_end;
+            continue;
+        }
+
+        // one instanced draw per mesh and level of detail, instance attributes pointed at the range of the run
+        const unsigned int lod = instanced_batch[run_start]->lod;
+        size_t run_end = run_start;
+        while (run_end < instanced_batch.size() and instanced_batch[run_end]->get_mesh_pointer() == mesh and instanced_batch[run_end]->lod == lod)
+            run_end++;
+
+        const MeshLod& level = mesh->get_lod(lod);
+        ge.gl_state.bind_vertex_array(position_only ? mesh->get_depth_vertex_array_object(instance_buffer) : mesh->get_instanced_vertex_array_object(instance_buffer));
+        InstanceData::setup_vertex_attributes(instance_buffer, run_start);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(level.index_count), mesh->get_index_type(), mesh->get_index_offset(level), static_cast<GLsizei>(run_end - run_start), mesh->get_base_vertex());
+        // arena vertex arrays are shared with the multi draw path, which expects them to start at the first instance
+        if (arena != nullptr and run_start != 0)
+            InstanceData::setup_vertex_attributes(instance_buffer);
+
+        run_start = run_end;
+    }
+}
+
+unsigned int ForwardOpaque3DPass::get_frustum_culled_count() const {
+    return frustum_culled_count;
+}
+
+unsigned int ForwardOpaque3DPass::get_occlusion_culled_count() const {
+    return occlusion_culled_count;
+}
+
+const DepthPrepassStats& ForwardOpaque3DPass::get_depth_prepass_stats() const {
+    return prepass_stats;
+}
+
+uint64_t DepthPrepassStats::get_eliminated_samples() const {
+    return depth_samples > shaded_samples ? depth_samples - shaded_samples : 0;
+}
+
 void ForwardOpaque3DPass::change_resolution(const int width, const int height) {
     camera->change_resolution(width, height);
+}
+
+ForwardOpaque3DPass::~ForwardOpaque3DPass() {
+    for (const PrepassQueries& queries : prepass_queries) {
+        if (queries.depth != 0)
+            glDeleteQueries(1, &queries.depth);
+        if (!queries.color.empty())
+            glDeleteQueries(static_cast<GLsizei>(queries.color.size()), queries.color.data());
+    }
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "renderqueue.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+
+uint64_t RenderQueue::make_key(const unsigned int layer, const unsigned int program, const uint64_t material, const unsigned int mesh, const float depth) {
+    const float clamped_depth = std::isnan(depth) ? 1.0f : std::clamp(depth, 0.0f, 1.0f);
+    const auto quantized_depth = static_cast<uint64_t>(clamped_depth * 65535.0f);
+    return static_cast<uint64_t>(std::min(layer, 15u)) << 60 |
+        static_cast<uint64_t>(program & 0xFFF) << 48 |
+        (material & 0xFFFF) << 32 |
+        static_cast<uint64_t>(mesh & 0xFFFF) << 16 |
+        quantized_depth;
+}
+
+
+void RenderQueue::clear() {
+    items.clear();
+}
+
+void RenderQueue::push(const uint64_t key, MeshThing* thing) {
+    items.push_back(Item{key, thing});
+}
+
+
+void RenderQueue::sort() {
+    if (items.size() < 2)
+        return;
+    sort_buffer.resize(items.size());
+
+    // histograms of all 8 digits in one pass
+    std::array<std::array<size_t, 256>, 8> counts{};
+    for (const Item& item : items) {
+        for (size_t digit = 0; digit < 8; digit++) {
+            counts[digit][(item.key >> (digit * 8)) & 0xFF] += 1;
+        }
+    }
+
+    for (size_t digit = 0; digit < 8; digit++) {
+        auto& count = counts[digit];
+        // all keys share this digit, the pass wouldn't change the order
+        if (count[(items[0].key >> (digit * 8)) & 0xFF] == items.size())
+            continue;
+
+        // counts -> offsets
+        size_t offset = 0;
+        for (auto& c : count) {
+            const size_t digit_count = c;
+            c = offset;
+            offset += digit_count;
+        }
+
+        for (const Item& item : items) {
+            sort_buffer[count[(item.key >> (digit * 8)) & 0xFF]++] = item;
+        }
+        items.swap(sort_buffer);
+    }
+}
+
+
+size_t RenderQueue::size() const {
+    return items.size();
+}
+
+bool RenderQueue::empty() const {
+    return items.empty();
+}
+
+const std::vector<RenderQueue::Item>& RenderQueue::get_items() const {
+    return items;
+}
@@ -0,0 +1,238 @@
+#include "resources.hpp"
+#include <chrono>
+#include <filesystem>
+#include "graphicengine.hpp"
+
+
+std::string Resources::get_resource_key(const std::string& file_path, const uint32_t options) {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::weakly_canonical(file_path, error);
+    if (error)
+        path = std::filesystem::absolute(file_path, error).lexically_normal();
+    return path.generic_string() + '|' + std::to_string(options);
+}
+
+
+std::shared_ptr<Texture> Resources::load_texture(const char* file_path, const bool sRGB, const bool generate_minimap, const bool clamp) {
+    const std::string key = get_resource_key(file_path, sRGB | generate_minimap << 1 | clamp << 2);
+    if (auto texture = textures.find(key))
+        return texture;
+
+    auto texture = std::make_shared<Texture>(std::shared_ptr<Texture>{});
+    texture->upload(TextureData{file_path}, sRGB, generate_minimap, clamp);
+    Engine::debug_message("Loaded texture: " + std::string(file_path) + " id: " + std::to_string(texture->id));
+    textures.add(key, texture);
+    return texture;
+}
+
+
+std::shared_ptr<Mesh> Resources::load_mesh(const char* file_path, const bool generate_tangents, const bool use_geometry_arena) {
+    const std::string key = get_resource_key(file_path, generate_tangents | use_geometry_arena << 1);
+    if (auto mesh = meshes.find(key))
+        return mesh;
+
+    MeshFileData data;
+    if (!Mesh::read_file(file_path, generate_tangents, data))
+        Engine::debug_warning("Mesh file has no triangles: " + std::string(file_path));
+    auto mesh = std::make_shared<Mesh>(data, use_geometry_arena);
+    meshes.add(key, mesh);
+    return mesh;
+}
+
+
+std::shared_ptr<Model> Resources::load_model(const char* file_path, const Model::TangentAction& action, const bool use_geometry_arena) {
+    const std::string key = get_resource_key(file_path, action | use_geometry_arena << 2);
+    if (auto model = models.find(key))
+        return model;
+
+    ModelFileData data;
+    Model::read_file(file_path, action, data);
+    auto model = std::shared_ptr<Model>(new Model());
+    model->load(data, use_geometry_arena);
+    models.add(key, model);
+    return model;
+}
+
+
+std::vector<std::shared_ptr<Material>> Resources::load_mtl_materials(const std::string& mtl_path, const std::vector<std::string>& material_names, const bool has_normals, const bool has_uvs, const Model::TangentAction& action, const bool async_textures) {
+    const std::string library_key = get_resource_key(mtl_path, has_normals | has_uvs << 1 | action << 2);
+
+    std::vector<std::shared_ptr<Material>> result;
+    result.reserve(material_names.size());
+    bool complete = true;
+    for (const auto& name : material_names) {
+        result.push_back(materials.find(library_key + '|' + name));
+        complete = complete and result.back() != nullptr;
+    }
+    if (complete)
+        return result;
+
+    // parse the library, materials that are still in use are kept, so users keep sharing them
+    auto parsed = parse_mtl_file(mtl_path.c_str(), has_normals, has_uvs, action, async_textures);
+    for (size_t i = 0; i < material_names.size(); i++) {
+        if (result[i] != nullptr)
+            continue;
+        const auto it = parsed.find(material_names[i]);
+        if (it == parsed.end() or it->second == nullptr)
+            continue;
+        result[i] = it->second;
+        materials.add(library_key + '|' + material_names[i], it->second);
+    }
+    return result;
+}
+
+
+void Resources::release_expired() {
+    textures.release_expired();
+    meshes.release_expired();
+    models.release_expired();
+    materials.release_expired();
+}
+
+
+void Resources::queue_upload(std::function<void()> upload) {
+    std::lock_guard lock(uploads_mutex);
+    uploads.push_back(std::move(upload));
+}
+
+
+std::shared_ptr<Texture> Resources::load_texture_async(const char* file_path, const bool sRGB, const bool generate_minimap, const bool clamp, const Shaders::PlaceholderTextures placeholder) {
+    // a texture still loading is returned too, it shows its placeholder until then
+    const std::string key = get_resource_key(file_path, sRGB | generate_minimap << 1 | clamp << 2);
+    if (auto texture = textures.find(key))
+        return texture;
+
+    auto texture = std::make_shared<Texture>(ge.shaders.get_placeholder_texture(placeholder));
+    textures.add(key, texture);
+    pending_count += 1;
+
+    ge.workers.submit([this, texture, path = std::string(file_path), sRGB, generate_minimap, clamp] {
+        GE_PROFILE_ZONE("Texture decode");
+        auto data = std::make_shared<TextureData>(path.c_str());
+        queue_upload([this, texture, data, sRGB, generate_minimap, clamp] {
+            texture->upload(*data, sRGB, generate_minimap, clamp);
+            pending_count -= 1;
+        });
+    });
+    return texture;
+}
+
+
+ResourceHandle<Mesh> Resources::load_mesh_async(const char* file_path, const bool generate_tangents, const bool use_geometry_arena) {
+    const std::string key = get_resource_key(file_path, generate_tangents | use_geometry_arena << 1);
+    ResourceHandle<Mesh> handle;
+    if (auto mesh = meshes.find(key)) {
+        handle.state->resource = std::move(mesh);
+        handle.state->done = true;
+        return handle;
+    }
+    if (const auto loading = loading_meshes.find(key); loading != loading_meshes.end())
+        return loading->second;
+
+    loading_meshes.emplace(key, handle);
+    pending_count += 1;
+
+    ge.workers.submit([this, handle, key, path = std::string(file_path), generate_tangents, use_geometry_arena] {
+        GE_PROFILE_ZONE("Mesh parse");
+        auto data = std::make_shared<MeshFileData>();
+        const bool success = Mesh::read_file(path.c_str(), generate_tangents, *data);
+        queue_upload([this, handle, key, data, success, use_geometry_arena] {
+            auto mesh = success ? std::make_shared<Mesh>(*data, use_geometry_arena) : nullptr;
+            loading_meshes.erase(key);
+            if (mesh != nullptr)
+                meshes.add(key, mesh);
+            finish(handle, std::move(mesh));
+        });
+    });
+    return handle;
+}
+
+
+ResourceHandle<Model> Resources::load_model_async(const char* file_path, const Model::TangentAction& action, const bool use_geometry_arena) {
+    const std::string key = get_resource_key(file_path, action | use_geometry_arena << 2);
+    ResourceHandle<Model> handle;
+    if (auto model = models.find(key)) {
+        handle.state->resource = std::move(model);
+        handle.state->done = true;
+        return handle;
+    }
+    if (const auto loading = loading_models.find(key); loading != loading_models.end())
+        return loading->second;
+
+    loading_models.emplace(key, handle);
+    pending_count += 1;
+
+    // registers and completes the handle (main thread)
+    auto complete = [this, handle, key](std::shared_ptr<Model> model) {
+        loading_models.erase(key);
+        if (model != nullptr)
+            models.add(key, model);
+        finish(handle, std::move(model));
+    };
+
+    // worker: read the cache or parse the .obj
+    ge.workers.submit([this, complete, path = std::string(file_path), action, use_geometry_arena] {
+        GE_PROFILE_ZONE("Model parse");
+        auto data = std::make_shared<ModelFileData>();
+        if (!Model::read_file(path.c_str(), action, *data)) {
+            queue_upload([complete] { complete(nullptr); });
+            return;
+        }
+
+        // main thread: materials, textures load asynchronously
+        queue_upload([this, complete, data, use_geometry_arena] {
+            auto model = std::shared_ptr<Model>(new Model());
+            model->has_uvs = data->has_uvs;
+            model->has_normals = data->has_normals;
+            model->load_materials(data->mtl_path, data->material_names, data->action, true);
+            if (data->from_cache) {
+                model->create_meshes(*data, use_geometry_arena);
+                complete(model);
+                return;
+            }
+            model->pick_tangent_groups(*data);
+
+            // worker: final mesh data, tangents, cache
+            ge.workers.submit([this, complete, data, model, use_geometry_arena] {
+                GE_PROFILE_ZONE("Model build meshes");
+                Model::build_meshes(*data);
+
+                // main thread: GPU upload
+                queue_upload([complete, data, model, use_geometry_arena] {
+                    model->create_meshes(*data, use_geometry_arena);
+                    complete(model);
+                });
+            });
+        });
+    });
+    return handle;
+}
+
+
+void Resources::process_uploads() {
+    process_uploads(upload_budget_ms);
+}
+
+void Resources::process_uploads(const double budget_ms) {
+    GE_PROFILE_ZONE("Resources::process_uploads");
+    const auto start = std::chrono::steady_clock::now();
+    while (true) {
+        std::function<void()> upload;
+        {
+            std::lock_guard lock(uploads_mutex);
+            if (uploads.empty())
+                return;
+            upload = std::move(uploads.front());
+            uploads.pop_front();
+        }
+        upload();
+
+        if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budget_ms)
+            return;
+    }
+}
+
+
+size_t Resources::get_pending_count() const {
+    return pending_count.load();
+}
@@ -1,4 +1,6 @@
 #include "shaders.hpp"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <utility>
@@ -6,15 +8,10 @@
 #include "gtc/type_ptr.hpp"
 
 
-Shader::Shader(const char *file_path, const ShaderType shader_type, const std::string &define_header) {
-    id = glCreateShader(shader_type);
-
-    std::string shader_string;
-
+Shader::Shader(const char *file_path, const ShaderType shader_type, const std::string &define_header) : type(shader_type) {
     std::ifstream file(file_path);
 
     if (!file.good()) {
-        glDeleteShader(id);
         Engine::debug_error("Failed to load shader file: " + std::string(file_path));
         return;
     }
@@ -22,46 +19,37 @@ Shader::Shader(const char *file_path, const ShaderType shader_type, const std::s
     std::string line;
     bool prepended_header = false;
     while (std::getline(file, line)) {
-        shader_string += line + '\n';
+        source += line + '\n';
         if (!prepended_header and line[0] == '#' and line[1] == 'v') {
             prepended_header = true;
-            shader_string += define_header;
+            source += define_header;
 
             // add obligatory header (if not needed preprocessor will strip it away anyway)
             if (shader_type == GL_FRAGMENT_SHADER) {
-                shader_string += "#define NR_POINT_LIGHTS " + std::to_string(ge.lights.MAX_NR_POINT_LIGHTS) + "\n";
-                shader_string += "#define NR_DIRECTIONAL_LIGHTS " + std::to_string(ge.lights.MAX_NR_DIRECTIONAL_LIGHTS) + "\n";
-                shader_string += "#define NR_SPOT_LIGHTS " + std::to_string(ge.lights.MAX_NR_SPOT_LIGHTS) + "\n";
+                source += "#define NR_POINT_LIGHTS " + std::to_string(ge.lights.MAX_NR_POINT_LIGHTS) + "\n";
+                source += "#define NR_DIRECTIONAL_LIGHTS " + std::to_string(ge.lights.MAX_NR_DIRECTIONAL_LIGHTS) + "\n";
+                source += "#define NR_SPOT_LIGHTS " + std::to_string(ge.lights.MAX_NR_SPOT_LIGHTS) + "\n";
+                if (ge.lights.is_clustered_lighting_enabled())
+                    source += "#define CLUSTERED_LIGHTING\n";
             }
         }
     }
     file.close();
+}
 
-    file_path = shader_string.c_str();
-    glShaderSource(id, 1, &file_path, nullptr);
-    glCompileShader(id);
 
-    // check for shader compile errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(id, 512, nullptr, infoLog);
-        Engine::debug_error("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" + std::string(infoLog));
-    } else {
-        Engine::debug_message("Shader successfully compiled!");
-    }
+Shader::Shader(const std::string &shader_code, const ShaderType shader_type) : source(shader_code), type(shader_type) {
+
 }
 
 
-Shader::Shader(const std::string &shader_code, const ShaderType shader_type) {
-    id = glCreateShader(shader_type);
-    const char *content = shader_code.c_str();
+void Shader::compile() const {
+    compiled = true;
+    id = glCreateShader(type);
+    const char *content = source.c_str();
     glShaderSource(id, 1, &content, nullptr);
     glCompileShader(id);
 
-
     // check for shader compile errors
     int success;
     char infoLog[512];
@@ -71,17 +59,24 @@ Shader::Shader(const std::string &shader_code, const ShaderType shader_type) {
         glGetShaderInfoLog(id, 512, nullptr, infoLog);
         Engine::debug_error("ERROR::SHADER::COMPILATION_FAILED\n" + std::string(infoLog));
     } else {
-        Engine::debug_message("Shader successfully compiled from std::string");
+        Engine::debug_message("Shader successfully compiled!");
     }
 }
 
 unsigned int Shader::get_id() const {
+    if (!compiled)
+        compile();
     return id;
 }
 
+const std::string& Shader::get_source() const {
+    return source;
+}
+
 
 Shader::~Shader() {
-    glDeleteShader(id);
+    if (compiled)
+        glDeleteShader(id);
 }
 
 
@@ -125,18 +120,31 @@ ShaderProgram::~ShaderProgram() { // DESTRUCTOR WARNING !!
 
 
 ShaderProgram::ShaderProgram(const Shader &vertex_shader, const Shader &fragment_shader) {
-    id = glCreateProgram();
-    glAttachShader(id, vertex_shader.get_id());
-    glAttachShader(id, fragment_shader.get_id());
-    glLinkProgram(id);
+    const ProgramBinaryCache& cache = ge.shaders.program_binary_cache;
+    const uint64_t key = cache.enabled ? ProgramBinaryCache::get_key(vertex_shader.get_source(), fragment_shader.get_source()) : 0;
 
-    int success;
-    char infoLog[512];
-    glGetProgramiv(id, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(id, 512, nullptr, infoLog);
-        Engine::debug_error("Program link error:\n" + std::string(infoLog));
+    id = glCreateProgram();
+    // cached binary, falls back to compiling the sources when missing or rejected
+    if (!cache.load(id, key)) {
+        glDeleteProgram(id);
+        id = glCreateProgram();
+        if (cache.enabled)
+            ge.gl_extensions.program_parameteri(id, GLExtensions::PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+        glAttachShader(id, vertex_shader.get_id());
+        glAttachShader(id, fragment_shader.get_id());
+        glLinkProgram(id);
+
+        int success;
+        char infoLog[512];
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(id, 512, nullptr, infoLog);
+            Engine::debug_error("Program link error:\n" + std::string(infoLog));
+        } else {
+            cache.save(id, key);
+        }
     }
 
     glUniformBlockBinding(id, glGetUniformBlockIndex(id, "MATRICES"), 0);
@@ -146,6 +154,22 @@ ShaderProgram::ShaderProgram(const Shader &vertex_shader, const Shader &fragment
         glUniformBlockBinding(id, light_block_idx, 1);
     }
 
+    // clustered lighting, block and texture buffers have fixed bindings
+    const auto clusters_block_idx = glGetUniformBlockIndex(id, "CLUSTERS");
+    if (clusters_block_idx != GL_INVALID_INDEX) {
+        glUniformBlockBinding(id, clusters_block_idx, Lights::CLUSTERS_UBO_BINDING);
+        ge.gl_state.use_program(id);
+        glUniform1i(glGetUniformLocation(id, "cluster_grid"), Lights::CLUSTER_GRID_TEXTURE_UNIT);
+        glUniform1i(glGetUniformLocation(id, "cluster_light_indices"), Lights::CLUSTER_INDEX_TEXTURE_UNIT);
+        glUniform1i(glGetUniformLocation(id, "cluster_lights"), Lights::CLUSTER_LIGHT_TEXTURE_UNIT);
+        ge.gl_state.use_program(0);
+    }
+
+    const auto material_block_idx = glGetUniformBlockIndex(id, "MATERIAL");
+    if (material_block_idx != GL_INVALID_INDEX) {
+        glUniformBlockBinding(id, material_block_idx, Shaders::MATERIAL_UBO_BINDING);
+    }
+
     ge.shaders.add_shader_id_use(id);
 }
 
@@ -154,7 +178,7 @@ unsigned int ShaderProgram::get_id() const {
 }
 
 void ShaderProgram::use() const {
-    glUseProgram(id);
+    ge.gl_state.use_program(id);
 }
 
 void ShaderProgram::set_uniform(const char* uniform_name, glm::mat4 matrix) const {
@@ -173,18 +197,190 @@ unsigned int ShaderProgram::get_uniform_location(const char *uniform_name) const
     return glGetUniformLocation(id, uniform_name);
 }
 
+size_t MaterialUniformBuffer::get_slot_count(const size_t size) const {
+    return std::max<size_t>((size + slot_size - 1) / slot_size, 1);
+}
+
+size_t MaterialUniformBuffer::allocate(const size_t size) {
+    if (slot_size == 0) {
+        int alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = std::max(alignment, 1);
+        slot_size = (SLOT_SIZE + alignment - 1) / alignment * alignment;
+    }
+    const size_t slot_count = get_slot_count(size);
+
+    // reuse a freed slice of the same size
+    if (auto& free = free_slices[slot_count]; !free.empty()) {
+        const size_t offset = free.back();
+        free.pop_back();
+        return offset;
+    }
+
+    const size_t offset = end;
+    end += slot_count * slot_size;
+    if (end > capacity)
+        grow(std::max(end, capacity * 2));
+    return offset;
+}
+
+void MaterialUniformBuffer::release(const size_t offset, const size_t size) {
+    if (slot_size == 0)
+        return;
+    free_slices[get_slot_count(size)].push_back(offset);
+}
+
+void MaterialUniformBuffer::grow(const size_t min_capacity) {
+    unsigned int new_buffer = 0;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(min_capacity), nullptr, GL_DYNAMIC_DRAW);
+    if (buffer != 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(capacity));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        ge.gl_state.forget_buffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    buffer = new_buffer;
+    capacity = min_capacity;
+}
+
+void MaterialUniformBuffer::upload(const size_t offset, const void* data, const size_t size) const {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void MaterialUniformBuffer::bind(const size_t offset, const size_t size) const {
+    ge.gl_state.bind_uniform_buffer_range(Shaders::MATERIAL_UBO_BINDING, buffer, offset, size);
+}
+
+MaterialUniformBuffer::~MaterialUniformBuffer() {
+    if (buffer != 0) {
+        ge.gl_state.forget_buffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+}
+
+
 Material::Material(const ShaderProgram &_shader_program) : shader_program(_shader_program) {
     id = ge.shaders.get_material_identificator();
+    setup_block();
+}
+
+Material::~Material() {
+    release_block();
+}
+
+void Material::setup_block() {
+    block_layout = ge.shaders.get_material_block_layout(shader_program.get_id());
+    if (block_layout == nullptr or block_layout->size <= 0) {
+        block_layout = nullptr;
+        return;
+    }
+    block_data.assign(block_layout->size, 0);
+    block_offset = ge.shaders.material_uniform_buffer.allocate(block_data.size());
+    block_dirty = true;
+}
+
+void Material::release_block() {
+    if (!block_data.empty())
+        ge.shaders.material_uniform_buffer.release(block_offset, block_data.size());
+    block_data.clear();
+    block_layout = nullptr;
+}
+
+void Material::write_block_value(const MaterialBlockLayout::Member& member, const uniform_variant& value) {
+    // components as floats, converted to the member type below
+    std::array<float, 4> components{};
+    if (std::holds_alternative<float>(value)) {
+        components[0] = std::get<float>(value);
+    } else if (std::holds_alternative<int>(value)) {
+        components[0] = static_cast<float>(std::get<int>(value));
+    } else if (std::holds_alternative<bool>(value)) {
+        components[0] = std::get<bool>(value) ? 1.0f : 0.0f;
+    } else if (std::holds_alternative<Vector2>(value)) {
+        const auto vec = std::get<Vector2>(value);
+        components = {vec.x, vec.y, 0.0f, 0.0f};
+    } else if (std::holds_alternative<Vector3>(value)) {
+        const auto vec = std::get<Vector3>(value);
+        components = {vec.x, vec.y, vec.z, 0.0f};
+    } else if (std::holds_alternative<Color>(value)) {
+        const auto color = std::get<Color>(value);
+        components = {color.r, color.g, color.b, color.a};
+    } else {
+        Engine::debug_error("Textures can't be a part of the MATERIAL uniform block (material id " + std::to_string(id) + ")");
+        return;
+    }
+
+    unsigned char* destination = block_data.data() + member.offset;
+    switch (member.type) {
+        case GL_FLOAT:
+        case GL_FLOAT_VEC2:
+        case GL_FLOAT_VEC3:
+        case GL_FLOAT_VEC4: {
+            const int count = member.type == GL_FLOAT ? 1 : member.type == GL_FLOAT_VEC2 ? 2 : member.type == GL_FLOAT_VEC3 ? 3 : 4;
+            std::memcpy(destination, components.data(), count * sizeof(float));
+            break;
+        }
+        case GL_INT:
+        case GL_BOOL: {
+            const int integer = static_cast<int>(components[0]);
+            std::memcpy(destination, &integer, sizeof(int));
+            break;
+        }
+        default:
+            Engine::debug_error("Unsupported MATERIAL block member type (material id " + std::to_string(id) + ")");
+            return;
+    }
+    block_dirty = true;
 }
 
 void Material::apply_uniform_values() const {
+    apply_uniform_values(shader_program.get_id(), nullptr);
+}
+
+void Material::apply_uniform_values(const ShaderProgram &target_program) const {
+    if (target_program.get_id() == shader_program.get_id()) {
+        apply_uniform_values(shader_program.get_id(), nullptr);
+        return;
+    }
+
+    // translate uniform locations by name (built once per target program)
+    auto remap_it = uniform_location_remaps.find(target_program.get_id());
+    if (remap_it == uniform_location_remaps.end()) {
+        std::map<int, int> remap;
+        for (const auto& [name, loc] : uniform_name_to_loc) {
+            remap[loc] = glGetUniformLocation(target_program.get_id(), name.c_str());
+        }
+        remap_it = uniform_location_remaps.emplace(target_program.get_id(), std::move(remap)).first;
+    }
+    apply_uniform_values(target_program.get_id(), &remap_it->second);
+}
+
+void Material::apply_uniform_values(const unsigned int program_id, const std::map<int, int>* location_remap) const {
+    // the whole block in one bind, uploaded only after a change
+    if (block_layout != nullptr) {
+        if (block_dirty) {
+            ge.shaders.material_uniform_buffer.upload(block_offset, block_data.data(), block_data.size());
+            block_dirty = false;
+        }
+        ge.shaders.material_uniform_buffer.bind(block_offset, block_data.size());
+    }
+
     uniform_map::const_iterator it;
 
     // (only used when bindless textures are NOT supported)
     int bind_texture_slot = 0;
 
     for (it = uniforms.begin(); it != uniforms.end(); it++) {
-        const int uniform_loc = it->first;
+        int uniform_loc = it->first;
+        if (location_remap != nullptr) {
+            const auto remapped = location_remap->find(uniform_loc);
+            uniform_loc = remapped != location_remap->end() ? remapped->second : -1;
+        }
 
         if (uniform_variant value = it->second; std::holds_alternative<float>(value)) {
             glUniform1f(uniform_loc, std::get<float>(value));
@@ -194,14 +390,15 @@ void Material::apply_uniform_values() const {
             glUniform3f(uniform_loc, vec.x, vec.y, vec.z);
         }
         else if (std::holds_alternative<std::shared_ptr<Texture>>(value)) {
+            // placeholder while the texture is still loading
+            const Texture& texture = std::get<std::shared_ptr<Texture>>(value)->get_bound_texture();
             if (ge.are_bindless_textures_supported()) {
                 glProgramUniformHandleui64ARB(
-                    shader_program.get_id(),
+                    program_id,
                     uniform_loc,
-                    std::get<std::shared_ptr<Texture>>(value)->handle);
+                    texture.handle);
             } else {
-                glActiveTexture(GL_TEXTURE0 + bind_texture_slot);
-                glBindTexture(GL_TEXTURE_2D, std::get<std::shared_ptr<Texture>>(value)->id);
+                ge.gl_state.bind_texture(bind_texture_slot, GL_TEXTURE_2D, texture.id);
                 glUniform1i(uniform_loc, bind_texture_slot);
                 bind_texture_slot += 1;
             }
@@ -234,63 +431,65 @@ unsigned int Material::get_shader_program_id() const {
 std::shared_ptr<Material> Material::copy() const {
     auto mat = std::make_shared<Material>(shader_program);
     mat->uniforms = uniforms;
+    mat->uniform_name_to_loc = uniform_name_to_loc;
+    mat->block_uniforms = block_uniforms;
+    mat->block_data = block_data;
+    mat->block_dirty = true;
     return mat;
 }
 
 void Material::rebind_uniforms() {
-    for (auto it = uniform_name_to_loc.begin(); it != uniform_name_to_loc.end(); it++) {
-        int new_loc = get_uniform_location(it->first.c_str());
-        // edit key in uniforms map
-        auto nh = uniforms.extract(it->second);
-        nh.key() = new_loc;
-        uniforms.insert(std::move(nh));
-        //
-        uniform_name_to_loc[it->first] = new_loc;
+    uniform_location_remaps.clear();
+
+    // every named value is set again, it may move in or out of the MATERIAL block
+    std::map<std::string, uniform_variant> values = std::move(block_uniforms);
+    block_uniforms.clear();
+    for (const auto& [name, loc] : uniform_name_to_loc) {
+        if (auto nh = uniforms.extract(loc); !nh.empty())
+            values[name] = std::move(nh.mapped());
     }
+    uniform_name_to_loc.clear();
+
+    release_block();
+    setup_block();
+    for (const auto& [name, value] : values)
+        set_uniform(name.c_str(), value);
 }
 
 void Material::shader_program_switch(ShaderProgram new_sp) {
     // check if Material not in use
-    auto self = shared_from_this();
-    if (ge.thing_ids_by_shader_program.find(self) != ge.thing_ids_by_shader_program.end()) {
+    if (mesh_thing_count > 0) {
         Engine::debug_error("Material (id " + std::to_string(id) + ") is already in use ShaderProgram can't be changed no longer. Create a new Material and set it's uniforms to the uniforms here and call rebind_uniforms()");
         return;
     }
     shader_program = std::move(new_sp);
     rebind_uniforms();
-
-    /* THEORETICAL IN ENGINE RESORT, BUT STILL DOESN'T UPDATE ENTITIES THUS (SCRAPED FOR NOW)
-     *if (resort_engine_map) {
-        // find all
-        auto self = shared_from_this();
-        const auto [fst, snd] = ge.thing_ids_by_shader_program.equal_range(self);
-
-        // get iterators
-        std::vector<decltype(ge.thing_ids_by_shader_program)::node_type> nhs;
-        for (auto it = fst; it != snd;) {
-            nhs.push_back(ge.thing_ids_by_shader_program.extract(it++));
-        }
-
-        // extract and re-insert
-        for (auto &nh : nhs) {
-            ge.thing_ids_by_shader_program.insert(std::move(nh));
-        }
-    }*/
 }
 
 
 int Material::get_uniform_location(const char *uniform_name) const {
-    shader_program.use();
     return glGetUniformLocation(shader_program.get_id(), uniform_name);
 }
 
 void Material::set_uniform(const char *uniform_name, const uniform_variant &val) {
+    if (block_layout != nullptr) {
+        if (const auto member = block_layout->members.find(uniform_name); member != block_layout->members.end()) {
+            block_uniforms[uniform_name] = val;
+            write_block_value(member->second, val);
+            return;
+        }
+    }
+
     int loc = get_uniform_location(uniform_name);
+    if (!uniform_name_to_loc.contains(uniform_name))
+        uniform_location_remaps.clear();
     uniform_name_to_loc[uniform_name] = loc;
     uniforms[loc] = val;
 }
 
 uniform_variant Material::get_uniform(const char *uniform_name) const {
+    if (const auto block_it = block_uniforms.find(uniform_name); block_it != block_uniforms.end())
+        return block_it->second;
     auto it = uniforms.find(get_uniform_location(uniform_name));
     if (it != uniforms.end())
         return it->second;
@@ -313,12 +512,29 @@ void Shaders::remove_shader_id_use(const unsigned int sp_id) {
     shader_programs_id_used[sp_id] -= 1;
 
     if (shader_programs_id_used[sp_id] == 0) {
+        ge.gl_state.forget_program(sp_id);
         glDeleteProgram(sp_id);
         shader_programs_id_used.erase(sp_id);
         Engine::debug_message("deleting shader program " + std::to_string(sp_id));
+
+        // the id may be reused by OpenGL, so the instanced variant and the block layout can't stay linked to it
+        // (node is extracted first, the variant's destructor calls back into this method)
+        material_block_layouts.erase(sp_id);
+        auto variant = instanced_variants.extract(sp_id);
     }
 }
 
+void Shaders::register_instanced_variant(const ShaderProgram &shader_program, const ShaderProgram &instanced_shader_program) {
+    instanced_variants.insert_or_assign(shader_program.get_id(), instanced_shader_program);
+}
+
+const ShaderProgram* Shaders::get_instanced_variant(const unsigned int sp_id) const {
+    const auto it = instanced_variants.find(sp_id);
+    if (it == instanced_variants.end())
+        return nullptr;
+    return &it->second;
+}
+
 unsigned int Shaders::get_shader_use_by_id(unsigned int sp_id) {
     auto it = shader_programs_id_used.find(sp_id);
     if (it != shader_programs_id_used.end())
@@ -397,6 +613,13 @@ void Shaders::setup_base_materials() {
     mat = std::make_shared<Material>(no_normal_program_gen(false));
     mat->set_uniform("material.diffuse", Color::WHITE.no_alpha());
     base_materials[4] = mat;
+
+    // instanced variants, MTL materials share the base ShaderPrograms so they get these too
+    register_instanced_variant(base_materials[VERTEX_UV_NORMAL]->get_shader_program(), phong_shader_program_gen(true, false, true));
+    register_instanced_variant(base_materials[VERTEX_UV_NORMAL_TANGENT]->get_shader_program(), phong_shader_program_gen(true, true, true));
+    register_instanced_variant(base_materials[VERTEX_NORMAL]->get_shader_program(), phong_shader_program_gen(false, false, true));
+    register_instanced_variant(base_materials[VERTEX_UV]->get_shader_program(), no_normal_program_gen(true, true));
+    register_instanced_variant(base_materials[VERTEX]->get_shader_program(), no_normal_program_gen(false, true));
 }
 
 std::shared_ptr<Material> Shaders::get_base_material(const bool with_uvs, const bool with_normals, const bool with_tangents) {
@@ -434,13 +657,52 @@ uint64_t Shaders::get_material_identificator() {
     return next_material_id - 1;
 }
 
+const MaterialBlockLayout* Shaders::get_material_block_layout(const unsigned int sp_id) {
+    if (const auto it = material_block_layouts.find(sp_id); it != material_block_layouts.end())
+        return it->second.get();
+
+    std::unique_ptr<MaterialBlockLayout> layout = nullptr;
+    const unsigned int block_index = glGetUniformBlockIndex(sp_id, "MATERIAL");
+    if (block_index != GL_INVALID_INDEX) {
+        layout = std::make_unique<MaterialBlockLayout>();
+        glGetActiveUniformBlockiv(sp_id, block_index, GL_UNIFORM_BLOCK_DATA_SIZE, &layout->size);
+
+        int member_count = 0;
+        glGetActiveUniformBlockiv(sp_id, block_index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &member_count);
+        std::vector<int> member_indices(member_count);
+        if (member_count > 0)
+            glGetActiveUniformBlockiv(sp_id, block_index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, member_indices.data());
+
+        for (const int member_index : member_indices) {
+            const auto index = static_cast<unsigned int>(member_index);
+            char name[256];
+            glGetActiveUniformName(sp_id, index, sizeof(name), nullptr, name);
+            int offset = 0, type = 0;
+            glGetActiveUniformsiv(sp_id, 1, &index, GL_UNIFORM_OFFSET, &offset);
+            glGetActiveUniformsiv(sp_id, 1, &index, GL_UNIFORM_TYPE, &type);
+            layout->members[name] = {offset, static_cast<unsigned int>(type)};
+        }
+    }
+    return material_block_layouts.emplace(sp_id, std::move(layout)).first->second.get();
+}
+
 
 
 // SHADER GEN
-Shader Shaders::base_vertex_shader_gen(const bool support_uv, const bool support_normal, const bool support_tangents) {
+const ShaderProgram& Shaders::get_depth_only_program() {
+    if (!depth_only_program.has_value())
+        depth_only_program.emplace(base_vertex_shader_gen(false, false, false, true), Shader{"engine/res/shaders/depth_only.glsl", Shader::FRAGMENT_SHADER});
+    return *depth_only_program;
+}
+
+
+Shader Shaders::base_vertex_shader_gen(const bool support_uv, const bool support_normal, const bool support_tangents, const bool instanced) {
     std::string define_header;
     define_header += support_uv ? "#define HAS_UV\n" : "";
     define_header += support_normal ? "#define HAS_NORMALS\n" : "";
+    define_header += instanced ? "#define INSTANCED\n" : "";
+    // decoding of the vertex format meshes are uploaded in
+    define_header += ge.meshes.vertex_format.get_shader_defines();
 
     // tangent logic
     if (support_tangents) {
@@ -454,10 +716,11 @@ Shader Shaders::base_vertex_shader_gen(const bool support_uv, const bool support
 }
 
 
-Shader Shaders::base_phong_shader_gen(const bool support_uv, const bool support_tangents) const {
+Shader Shaders::base_phong_shader_gen(const bool support_uv, const bool support_tangents, const bool instanced) const {
     std::string define_header;
     define_header += support_uv ? "#define HAS_UV\n" : "";
     define_header += bindless_textures_supported ? "#define USE_BINDLESS\n" : "";
+    define_header += instanced ? "#define INSTANCED\n" : "";
 
     // tangent logic
     if (support_tangents) {
@@ -471,21 +734,22 @@ Shader Shaders::base_phong_shader_gen(const bool support_uv, const bool support_
 }
 
 
-Shader Shaders::base_no_normal_shader_gen(bool support_uv) const {
+Shader Shaders::base_no_normal_shader_gen(bool support_uv, bool instanced) const {
     std::string define_header;
     define_header += support_uv ? "#define HAS_UV\n" : "";
     define_header += bindless_textures_supported ? "#define USE_BINDLESS\n" : "";
+    define_header += instanced ? "#define INSTANCED\n" : "";
     return Shader{"engine/res/shaders/obj_no_normal.glsl", Shader::FRAGMENT_SHADER, define_header};
 }
 
 
-ShaderProgram Shaders::phong_shader_program_gen(bool has_uvs, bool has_tangents) const {
-    ShaderProgram sp {base_vertex_shader_gen(has_uvs, true, has_tangents), base_phong_shader_gen(has_uvs, has_tangents)};
+ShaderProgram Shaders::phong_shader_program_gen(bool has_uvs, bool has_tangents, bool instanced) const {
+    ShaderProgram sp {base_vertex_shader_gen(has_uvs, true, has_tangents, instanced), base_phong_shader_gen(has_uvs, has_tangents, instanced)};
     return sp;
 }
 
 
-ShaderProgram Shaders::no_normal_program_gen(bool has_uvs) const {
-    ShaderProgram sp {base_vertex_shader_gen(has_uvs, false), base_no_normal_shader_gen(has_uvs)};
+ShaderProgram Shaders::no_normal_program_gen(bool has_uvs, bool instanced) const {
+    ShaderProgram sp {base_vertex_shader_gen(has_uvs, false, false, instanced), base_no_normal_shader_gen(has_uvs, instanced)};
     return sp;
 }
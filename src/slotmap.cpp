@@ -0,0 +1,170 @@
+#include "slotmap.hpp"
+#include "graphicengine.hpp"
+
+
+unsigned int ThingSlotMap::make_id(const unsigned int index, const unsigned int generation) {
+    return (generation << INDEX_BITS) | (index & INDEX_MASK);
+}
+
+unsigned int ThingSlotMap::index_of(const unsigned int id) {
+    return id & INDEX_MASK;
+}
+
+unsigned int ThingSlotMap::generation_of(const unsigned int id) {
+    return (id >> INDEX_BITS) & GENERATION_MASK;
+}
+
+
+unsigned int ThingSlotMap::reserve() {
+    unsigned int index;
+    if (free_head != EMPTY) {
+        index = free_head;
+        free_head = slots[index].next_free;
+        if (free_head == EMPTY)
+            free_tail = EMPTY;
+        slots[index].next_free = EMPTY;
+        free_count -= 1;
+    } else {
+        if (!growth_allowed)
+            return NULL_ID;
+        if (slots.size() >= MAX_THINGS) {
+            Engine::debug_error("Maximum amount of Things (" + std::to_string(MAX_THINGS) + ") reached.");
+            return NULL_ID;
+        }
+        index = static_cast<unsigned int>(slots.size());
+        slots.emplace_back();
+    }
+    return make_id(index, slots[index].generation);
+}
+
+
+unsigned int ThingSlotMap::ensure_free_slots(const unsigned int count) {
+    while (free_count < count and slots.size() < MAX_THINGS) {
+        // a new slot starts at generation 1, like one appended by reserve()
+        const auto index = static_cast<unsigned int>(slots.size());
+        slots.emplace_back();
+        push_free(index);
+    }
+    return free_count;
+}
+
+void ThingSlotMap::set_growth_allowed(const bool allowed) {
+    growth_allowed = allowed;
+}
+
+
+void ThingSlotMap::push_free(const unsigned int index) {
+    slots[index].next_free = EMPTY;
+    if (free_tail == EMPTY) {
+        free_head = index;
+    } else {
+        slots[free_tail].next_free = index;
+    }
+    free_tail = index;
+    free_count += 1;
+}
+
+void ThingSlotMap::free_slot(const unsigned int index) {
+    Slot& slot = slots[index];
+    slot.dense_index = EMPTY;
+    // generation 0 is skipped, so a valid ID is never 0
+    slot.generation = slot.generation >= GENERATION_MASK ? 1 : slot.generation + 1;
+    push_free(index);
+}
+
+
+void ThingSlotMap::release(const unsigned int id) {
+    const unsigned int index = index_of(id);
+    if (index >= slots.size() or slots[index].generation != generation_of(id) or slots[index].dense_index != EMPTY) {
+        Engine::debug_warning("Releasing an ID (" + std::to_string(id) + ") that isn't reserved.");
+        return;
+    }
+    free_slot(index);
+}
+
+
+void ThingSlotMap::insert(const unsigned int id, std::unique_ptr<Thing> thing) {
+    const unsigned int index = index_of(id);
+    if (index >= slots.size() or slots[index].generation != generation_of(id)) {
+        Engine::debug_error("Inserting a Thing under a stale ID (" + std::to_string(id) + ").");
+        return;
+    }
+
+    Slot& slot = slots[index];
+    if (slot.dense_index != EMPTY) {
+        // slot already in use by the same ID, just swap the entity
+        dense_things[slot.dense_index] = std::move(thing);
+        return;
+    }
+
+    slot.dense_index = static_cast<unsigned int>(dense_things.size());
+    dense_things.push_back(std::move(thing));
+    dense_ids.push_back(id);
+}
+
+
+void ThingSlotMap::erase(const unsigned int id) {
+    if (!contains(id))
+        return;
+
+    const unsigned int index = index_of(id);
+    const unsigned int dense_index = slots[index].dense_index;
+    const unsigned int last = static_cast<unsigned int>(dense_things.size()) - 1;
+
+    // the entity is destroyed at the end of the scope, after the map is consistent again
+    std::unique_ptr<Thing> removed = std::move(dense_things[dense_index]);
+
+    // swap and pop, keeps the array dense
+    if (dense_index != last) {
+        dense_things[dense_index] = std::move(dense_things[last]);
+        dense_ids[dense_index] = dense_ids[last];
+        slots[index_of(dense_ids[dense_index])].dense_index = dense_index;
+    }
+    dense_things.pop_back();
+    dense_ids.pop_back();
+
+    free_slot(index);
+}
+
+
+Thing* ThingSlotMap::get(const unsigned int id) const {
+    const unsigned int index = index_of(id);
+    if (index >= slots.size())
+        return nullptr;
+    const Slot& slot = slots[index];
+    if (slot.generation != generation_of(id) or slot.dense_index == EMPTY)
+        return nullptr;
+    return dense_things[slot.dense_index].get();
+}
+
+bool ThingSlotMap::contains(const unsigned int id) const {
+    return get(id) != nullptr;
+}
+
+size_t ThingSlotMap::size() const {
+    return dense_things.size();
+}
+
+Thing* ThingSlotMap::at_dense(const size_t dense_index) const {
+    return dense_things[dense_index].get();
+}
+
+unsigned int ThingSlotMap::id_at_dense(const size_t dense_index) const {
+    return dense_ids[dense_index];
+}
+
+ThingSlotMap::iterator ThingSlotMap::begin() {
+    return dense_things.begin();
+}
+
+ThingSlotMap::iterator ThingSlotMap::end() {
+    return dense_things.end();
+}
+
+ThingSlotMap::const_iterator ThingSlotMap::begin() const {
+    return dense_things.begin();
+}
+
+ThingSlotMap::const_iterator ThingSlotMap::end() const {
+    return dense_things.end();
+}
@@ -0,0 +1,949 @@
+#include "texturecompression.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <glm/glm.hpp>
+#include "glextensions.hpp"
+#include "threadpool.hpp"
+
+
+bool CompressedImage::is_valid() const {
+    return format != TextureCompression::NONE and !levels.empty();
+}
+
+int CompressedImage::get_width() const {
+    return levels.empty() ? 0 : levels.front().width;
+}
+
+int CompressedImage::get_height() const {
+    return levels.empty() ? 0 : levels.front().height;
+}
+
+
+size_t get_block_size(const TextureCompression format) {
+    switch (format) {
+        case TextureCompression::BC1: return 8;
+        case TextureCompression::BC3:
+        case TextureCompression::BC5:
+        case TextureCompression::BC7: return 16;
+        default: return 0;
+    }
+}
+
+size_t get_compressed_level_size(const TextureCompression format, const int width, const int height) {
+    const size_t blocks_x = (std::max(width, 1) + 3) / 4;
+    const size_t blocks_y = (std::max(height, 1) + 3) / 4;
+    return blocks_x * blocks_y * get_block_size(format);
+}
+
+unsigned int get_compressed_gl_format(const TextureCompression format, const bool sRGB) {
+    switch (format) {
+        case TextureCompression::BC1: return sRGB ? GLExtensions::COMPRESSED_SRGB_S3TC_DXT1 : GLExtensions::COMPRESSED_RGB_S3TC_DXT1;
+        case TextureCompression::BC3: return sRGB ? GLExtensions::COMPRESSED_SRGB_ALPHA_S3TC_DXT5 : GLExtensions::COMPRESSED_RGBA_S3TC_DXT5;
+        case TextureCompression::BC5: return GL_COMPRESSED_RG_RGTC2;
+        case TextureCompression::BC7: return sRGB ? GLExtensions::COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GLExtensions::COMPRESSED_RGBA_BPTC_UNORM;
+        default: return 0;
+    }
+}
+
+
+//
+// FILES
+//
+
+namespace {
+    void set_error(std::string* error, const std::string& message) {
+        if (error != nullptr)
+            *error = message;
+    }
+
+    bool read_whole_file(const char* file_path, std::vector<unsigned char>& bytes, std::string* error) {
+        std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            set_error(error, "Failed to open texture file: " + std::string(file_path));
+            return false;
+        }
+        bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return static_cast<bool>(file);
+    }
+
+    template<typename T>
+    T read_value(const std::vector<unsigned char>& bytes, const size_t offset) {
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    void write_value(std::vector<unsigned char>& bytes, const T value) {
+        const auto* raw = reinterpret_cast<const unsigned char*>(&value);
+        bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+
+    void pad_to(std::vector<unsigned char>& bytes, const size_t alignment) {
+        bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+    }
+
+    bool write_whole_file(const char* file_path, const std::vector<unsigned char>& bytes, std::string* error) {
+        std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!file) {
+            set_error(error, "Failed to write texture file: " + std::string(file_path));
+            return false;
+        }
+        return true;
+    }
+
+    /// fills in the levels of a chain stored largest first from offset on, false if the data is too short
+    bool build_mip_chain(CompressedImage& image, const int width, const int height, const size_t level_count, size_t offset, const size_t data_size) {
+        int level_width = width;
+        int level_height = height;
+        for (size_t i = 0; i < level_count; i++) {
+            const size_t size = get_compressed_level_size(image.format, level_width, level_height);
+            if (offset + size > data_size)
+                return false;
+            image.levels.push_back({level_width, level_height, offset, size});
+            offset += size;
+            level_width = std::max(level_width / 2, 1);
+            level_height = std::max(level_height / 2, 1);
+        }
+        return true;
+    }
+
+    constexpr unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    constexpr size_t KTX2_HEADER_SIZE = 80;
+
+    /// VkFormat values of the supported formats
+    struct VkFormatEntry {
+        uint32_t vk_format;
+        TextureCompression format;
+        bool sRGB;
+    };
+    constexpr VkFormatEntry VK_FORMATS[] = {
+        {131, TextureCompression::BC1, false}, // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+        {132, TextureCompression::BC1, true},  // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+        {133, TextureCompression::BC1, false}, // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+        {134, TextureCompression::BC1, true},  // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+        {137, TextureCompression::BC3, false}, // VK_FORMAT_BC3_UNORM_BLOCK
+        {138, TextureCompression::BC3, true},  // VK_FORMAT_BC3_SRGB_BLOCK
+        {141, TextureCompression::BC5, false}, // VK_FORMAT_BC5_UNORM_BLOCK
+        {145, TextureCompression::BC7, false}, // VK_FORMAT_BC7_UNORM_BLOCK
+        {146, TextureCompression::BC7, true},  // VK_FORMAT_BC7_SRGB_BLOCK
+    };
+
+    /// DXGI_FORMAT values of the supported formats
+    struct DxgiFormatEntry {
+        uint32_t dxgi_format;
+        TextureCompression format;
+        bool sRGB;
+    };
+    constexpr DxgiFormatEntry DXGI_FORMATS[] = {
+        {71, TextureCompression::BC1, false}, // DXGI_FORMAT_BC1_UNORM
+        {72, TextureCompression::BC1, true},  // DXGI_FORMAT_BC1_UNORM_SRGB
+        {77, TextureCompression::BC3, false}, // DXGI_FORMAT_BC3_UNORM
+        {78, TextureCompression::BC3, true},  // DXGI_FORMAT_BC3_UNORM_SRGB
+        {83, TextureCompression::BC5, false}, // DXGI_FORMAT_BC5_UNORM
+        {98, TextureCompression::BC7, false}, // DXGI_FORMAT_BC7_UNORM
+        {99, TextureCompression::BC7, true},  // DXGI_FORMAT_BC7_UNORM_SRGB
+    };
+
+    constexpr uint32_t four_cc(const char a, const char b, const char c, const char d) {
+        return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+    }
+    constexpr size_t DDS_HEADER_SIZE = 4 + 124;
+    constexpr size_t DDS_DX10_HEADER_SIZE = 20;
+}
+
+
+bool read_ktx2_file(const char* file_path, CompressedImage& image, std::string* error) {
+    image = CompressedImage{};
+    std::vector<unsigned char> bytes;
+    if (!read_whole_file(file_path, bytes, error))
+        return false;
+    const std::string path{file_path};
+
+    if (bytes.size() < KTX2_HEADER_SIZE or std::memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        set_error(error, "Not a KTX2 file: " + path);
+        return false;
+    }
+    const auto vk_format = read_value<uint32_t>(bytes, 12);
+    const auto width = read_value<uint32_t>(bytes, 20);
+    const auto height = read_value<uint32_t>(bytes, 24);
+    const auto depth = read_value<uint32_t>(bytes, 28);
+    const auto layer_count = read_value<uint32_t>(bytes, 32);
+    const auto face_count = read_value<uint32_t>(bytes, 36);
+    const size_t level_count = std::max(read_value<uint32_t>(bytes, 40), 1u);
+    const auto supercompression = read_value<uint32_t>(bytes, 44);
+    const auto kvd_offset = read_value<uint32_t>(bytes, 56);
+    const auto kvd_length = read_value<uint32_t>(bytes, 60);
+
+    const auto entry = std::ranges::find(VK_FORMATS, vk_format, &VkFormatEntry::vk_format);
+    if (entry == std::end(VK_FORMATS)) {
+        set_error(error, "KTX2 format " + std::to_string(vk_format) + " not supported (BC1, BC3, BC5, BC7 only): " + path);
+        return false;
+    }
+    if (depth > 1 or layer_count > 1 or face_count != 1 or supercompression != 0) {
+        set_error(error, "KTX2 file is not a plain 2D texture without supercompression: " + path);
+        return false;
+    }
+    // a 32-bit size has at most 32 levels, checked before shifting by the level count
+    if (width == 0 or height == 0 or level_count > 32 or bytes.size() < KTX2_HEADER_SIZE + level_count * 24 or (level_count > 1 and (std::max(width, height) >> (level_count - 1)) == 0)) {
+        set_error(error, "KTX2 file is corrupted: " + path);
+        return false;
+    }
+    image.format = entry->format;
+    image.sRGB = entry->sRGB;
+
+    // levels may be stored in any order, copy them largest first
+    int level_width = static_cast<int>(width);
+    int level_height = static_cast<int>(height);
+    for (size_t i = 0; i < level_count; i++) {
+        const auto offset = read_value<uint64_t>(bytes, KTX2_HEADER_SIZE + i * 24);
+        const auto length = read_value<uint64_t>(bytes, KTX2_HEADER_SIZE + i * 24 + 8);
+        const size_t size = get_compressed_level_size(image.format, level_width, level_height);
+        if (length != size or offset > bytes.size() or bytes.size() - offset < size) {
+            set_error(error, "KTX2 file is corrupted: " + path);
+            image = CompressedImage{};
+            return false;
+        }
+        image.levels.push_back({level_width, level_height, image.data.size(), size});
+        image.data.insert(image.data.end(), bytes.begin() + static_cast<ptrdiff_t>(offset), bytes.begin() + static_cast<ptrdiff_t>(offset + size));
+        level_width = std::max(level_width / 2, 1);
+        level_height = std::max(level_height / 2, 1);
+    }
+
+    // default orientation is "rd" (top to bottom)
+    image.top_down = true;
+    size_t position = kvd_offset;
+    const size_t kvd_end = std::min<size_t>(static_cast<size_t>(kvd_offset) + kvd_length, bytes.size());
+    while (position + 4 <= kvd_end) {
+        const auto length = read_value<uint32_t>(bytes, position);
+        const size_t entry_start = position + 4;
+        if (entry_start + length > kvd_end)
+            break;
+        const std::string key_value(reinterpret_cast<const char*>(bytes.data() + entry_start), length);
+        const size_t separator = key_value.find('\0');
+        if (separator != std::string::npos and key_value.substr(0, separator) == "KTXorientation" and separator + 2 < key_value.size())
+            image.top_down = key_value[separator + 2] != 'u';
+        position = (entry_start + length + 3) / 4 * 4;
+    }
+    return true;
+}
+
+
+bool read_dds_file(const char* file_path, CompressedImage& image, std::string* error) {
+    image = CompressedImage{};
+    std::vector<unsigned char> bytes;
+    if (!read_whole_file(file_path, bytes, error))
+        return false;
+    const std::string path{file_path};
+
+    if (bytes.size() < DDS_HEADER_SIZE or read_value<uint32_t>(bytes, 0) != four_cc('D', 'D', 'S', ' ')) {
+        set_error(error, "Not a DDS file: " + path);
+        return false;
+    }
+    // offsets from the start of the file (after the magic)
+    const auto flags = read_value<uint32_t>(bytes, 4 + 4);
+    const auto height = read_value<uint32_t>(bytes, 4 + 8);
+    const auto width = read_value<uint32_t>(bytes, 4 + 12);
+    const auto mip_count = read_value<uint32_t>(bytes, 4 + 24);
+    const auto format_flags = read_value<uint32_t>(bytes, 4 + 76);
+    const auto format_four_cc = read_value<uint32_t>(bytes, 4 + 80);
+    const auto caps2 = read_value<uint32_t>(bytes, 4 + 108);
+
+    constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    constexpr uint32_t DDPF_FOURCC = 0x4;
+    constexpr uint32_t DDSCAPS2_CUBEMAP_OR_VOLUME = 0x200 | 0x200000;
+    const size_t level_count = (flags & DDSD_MIPMAPCOUNT) != 0 ? std::max(mip_count, 1u) : 1;
+
+    size_t data_offset = DDS_HEADER_SIZE;
+    if ((format_flags & DDPF_FOURCC) != 0 and format_four_cc == four_cc('D', 'X', '1', '0')) {
+        if (bytes.size() < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE) {
+            set_error(error, "DDS file is corrupted: " + path);
+            return false;
+        }
+        const auto dxgi_format = read_value<uint32_t>(bytes, DDS_HEADER_SIZE);
+        const auto dimension = read_value<uint32_t>(bytes, DDS_HEADER_SIZE + 4);
+        const auto array_size = read_value<uint32_t>(bytes, DDS_HEADER_SIZE + 12);
+        const auto entry = std::ranges::find(DXGI_FORMATS, dxgi_format, &DxgiFormatEntry::dxgi_format);
+        if (entry == std::end(DXGI_FORMATS)) {
+            set_error(error, "DDS format " + std::to_string(dxgi_format) + " not supported (BC1, BC3, BC5, BC7 only): " + path);
+            return false;
+        }
+        // 3 = D3D10_RESOURCE_DIMENSION_TEXTURE2D
+        if (dimension != 3 or array_size > 1) {
+            set_error(error, "DDS file is not a plain 2D texture: " + path);
+            return false;
+        }
+        image.format = entry->format;
+        image.sRGB = entry->sRGB;
+        data_offset += DDS_DX10_HEADER_SIZE;
+    } else if ((format_flags & DDPF_FOURCC) != 0 and format_four_cc == four_cc('D', 'X', 'T', '1')) {
+        image.format = TextureCompression::BC1;
+    } else if ((format_flags & DDPF_FOURCC) != 0 and format_four_cc == four_cc('D', 'X', 'T', '5')) {
+        image.format = TextureCompression::BC3;
+    } else if ((format_flags & DDPF_FOURCC) != 0 and (format_four_cc == four_cc('A', 'T', 'I', '2') or format_four_cc == four_cc('B', 'C', '5', 'U'))) {
+        image.format = TextureCompression::BC5;
+    } else {
+        set_error(error, "DDS pixel format not supported (DXT1, DXT5, ATI2, BC5U or DX10 header with BC1, BC3, BC5, BC7): " + path);
+        return false;
+    }
+    if ((caps2 & DDSCAPS2_CUBEMAP_OR_VOLUME) != 0) {
+        set_error(error, "DDS cube maps and volume textures are not supported: " + path);
+        return false;
+    }
+
+    if (width == 0 or height == 0 or !build_mip_chain(image, static_cast<int>(width), static_cast<int>(height), level_count, 0, bytes.size() - data_offset)) {
+        set_error(error, "DDS file is corrupted: " + path);
+        image = CompressedImage{};
+        return false;
+    }
+    const size_t data_size = image.levels.back().offset + image.levels.back().size;
+    image.data.assign(bytes.begin() + static_cast<ptrdiff_t>(data_offset), bytes.begin() + static_cast<ptrdiff_t>(data_offset + data_size));
+    image.top_down = true;
+    return true;
+}
+
+
+bool is_compressed_texture_file(const char* file_path) {
+    std::string extension = std::filesystem::path(file_path).extension().string();
+    std::ranges::transform(extension, extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+    return extension == ".ktx2" or extension == ".dds";
+}
+
+
+bool read_compressed_texture_file(const char* file_path, CompressedImage& image, std::string* error) {
+    std::string extension = std::filesystem::path(file_path).extension().string();
+    std::ranges::transform(extension, extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+    if (extension == ".ktx2")
+        return read_ktx2_file(file_path, image, error);
+    if (extension == ".dds")
+        return read_dds_file(file_path, image, error);
+    set_error(error, "Not a compressed texture file: " + std::string(file_path));
+    return false;
+}
+
+
+bool write_ktx2_file(const char* file_path, const CompressedImage& image, std::string* error) {
+    if (!image.is_valid()) {
+        set_error(error, "Empty image can't be written: " + std::string(file_path));
+        return false;
+    }
+    const auto entry = std::ranges::find_if(VK_FORMATS, [&image](const VkFormatEntry& e) {
+        // BC1 is written as RGB, the encoder never uses the punch through alpha mode
+        return e.format == image.format and e.sRGB == image.sRGB and e.vk_format != 133 and e.vk_format != 134;
+    });
+    if (entry == std::end(VK_FORMATS)) {
+        set_error(error, "Format can't be written to KTX2: " + std::string(file_path));
+        return false;
+    }
+    const auto level_count = static_cast<uint32_t>(image.levels.size());
+
+    // data format descriptor, one basic block
+    struct Sample {
+        uint8_t channel;
+        uint16_t bit_offset;
+        uint8_t bit_length;
+    };
+    std::vector<Sample> samples;
+    uint8_t color_model = 0;
+    switch (image.format) {
+        case TextureCompression::BC1: color_model = 128; samples = {{0, 0, 64}}; break;                 // KHR_DF_MODEL_BC1A, color
+        case TextureCompression::BC3: color_model = 130; samples = {{15, 0, 64}, {0, 64, 64}}; break;  // KHR_DF_MODEL_BC3, alpha + color
+        case TextureCompression::BC5: color_model = 132; samples = {{0, 0, 64}, {1, 64, 64}}; break;   // KHR_DF_MODEL_BC5, red + green
+        default: color_model = 134; samples = {{0, 0, 128}}; break;                                     // KHR_DF_MODEL_BC7, color
+    }
+    std::vector<unsigned char> dfd;
+    const auto block_size = static_cast<uint32_t>(24 + 16 * samples.size());
+    write_value<uint32_t>(dfd, 4 + block_size);
+    write_value<uint32_t>(dfd, 0); // vendor KHRONOS, basic descriptor
+    write_value<uint32_t>(dfd, 2 | block_size << 16); // version 1.3
+    // color model, BT709 primaries, transfer function, straight alpha
+    write_value<uint32_t>(dfd, color_model | 1u << 8 | (image.sRGB ? 2u : 1u) << 16);
+    write_value<uint32_t>(dfd, 3 | 3 << 8); // 4x4 texel blocks
+    write_value<uint32_t>(dfd, static_cast<uint32_t>(get_block_size(image.format)));
+    write_value<uint32_t>(dfd, 0);
+    for (const auto& sample : samples) {
+        write_value<uint32_t>(dfd, sample.bit_offset | static_cast<uint32_t>(sample.bit_length - 1) << 16 | static_cast<uint32_t>(sample.channel) << 24);
+        write_value<uint32_t>(dfd, 0);
+        write_value<uint32_t>(dfd, 0);
+        write_value<uint32_t>(dfd, 0xFFFFFFFF);
+    }
+
+    // key value data, sorted by key
+    std::vector<unsigned char> kvd;
+    auto add_key_value = [&kvd](const std::string& key, const std::string& value) {
+        write_value<uint32_t>(kvd, static_cast<uint32_t>(key.size() + value.size() + 2));
+        kvd.insert(kvd.end(), key.begin(), key.end());
+        kvd.push_back(0);
+        kvd.insert(kvd.end(), value.begin(), value.end());
+        kvd.push_back(0);
+        pad_to(kvd, 4);
+    };
+    add_key_value("KTXorientation", image.top_down ? "rd" : "ru");
+    add_key_value("KTXwriter", "graphicengine");
+
+    const size_t level_index_offset = KTX2_HEADER_SIZE;
+    const size_t dfd_offset = level_index_offset + level_count * 24;
+    const size_t kvd_offset = dfd_offset + dfd.size();
+
+    std::vector<unsigned char> bytes(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+    write_value<uint32_t>(bytes, entry->vk_format);
+    write_value<uint32_t>(bytes, 1); // type size
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(image.get_width()));
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(image.get_height()));
+    write_value<uint32_t>(bytes, 0); // depth
+    write_value<uint32_t>(bytes, 0); // layers
+    write_value<uint32_t>(bytes, 1); // faces
+    write_value<uint32_t>(bytes, level_count);
+    write_value<uint32_t>(bytes, 0); // supercompression
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(dfd_offset));
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(dfd.size()));
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(kvd_offset));
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(kvd.size()));
+    write_value<uint64_t>(bytes, 0); // supercompression global data
+    write_value<uint64_t>(bytes, 0);
+    bytes.resize(dfd_offset, 0); // level index, filled in below
+    bytes.insert(bytes.end(), dfd.begin(), dfd.end());
+    bytes.insert(bytes.end(), kvd.begin(), kvd.end());
+
+    // levels are stored smallest first, each aligned to the block size
+    for (size_t i = level_count; i-- > 0;) {
+        const CompressedMipLevel& level = image.levels[i];
+        pad_to(bytes, 16);
+        const uint64_t offset = bytes.size();
+        const uint64_t size = level.size;
+        std::memcpy(bytes.data() + level_index_offset + i * 24, &offset, 8);
+        std::memcpy(bytes.data() + level_index_offset + i * 24 + 8, &size, 8);
+        std::memcpy(bytes.data() + level_index_offset + i * 24 + 16, &size, 8);
+        bytes.insert(bytes.end(), image.data.begin() + static_cast<ptrdiff_t>(level.offset), image.data.begin() + static_cast<ptrdiff_t>(level.offset + level.size));
+    }
+    return write_whole_file(file_path, bytes, error);
+}
+
+
+bool write_dds_file(const char* file_path, const CompressedImage& image, std::string* error) {
+    if (!image.is_valid()) {
+        set_error(error, "Empty image can't be written: " + std::string(file_path));
+        return false;
+    }
+    if (!image.top_down) {
+        set_error(error, "DDS files are stored top to bottom, flip the image first: " + std::string(file_path));
+        return false;
+    }
+    const auto entry = std::ranges::find_if(DXGI_FORMATS, [&image](const DxgiFormatEntry& e) {
+        return e.format == image.format and e.sRGB == image.sRGB;
+    });
+    if (entry == std::end(DXGI_FORMATS)) {
+        set_error(error, "Format can't be written to DDS: " + std::string(file_path));
+        return false;
+    }
+
+    std::vector<unsigned char> bytes;
+    write_value<uint32_t>(bytes, four_cc('D', 'D', 'S', ' '));
+    write_value<uint32_t>(bytes, 124);
+    // caps, height, width, pixel format, mipmap count, linear size
+    write_value<uint32_t>(bytes, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000);
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(image.get_height()));
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(image.get_width()));
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(image.levels.front().size));
+    write_value<uint32_t>(bytes, 0); // depth
+    write_value<uint32_t>(bytes, static_cast<uint32_t>(image.levels.size()));
+    bytes.resize(bytes.size() + 11 * 4, 0);
+    // pixel format
+    write_value<uint32_t>(bytes, 32);
+    write_value<uint32_t>(bytes, 0x4);
+    write_value<uint32_t>(bytes, four_cc('D', 'X', '1', '0'));
+    bytes.resize(bytes.size() + 5 * 4, 0);
+    // texture, complex + mipmap if there are levels
+    write_value<uint32_t>(bytes, 0x1000 | (image.levels.size() > 1 ? 0x8 | 0x400000 : 0));
+    bytes.resize(DDS_HEADER_SIZE, 0);
+    // DX10 header
+    write_value<uint32_t>(bytes, entry->dxgi_format);
+    write_value<uint32_t>(bytes, 3); // texture 2D
+    write_value<uint32_t>(bytes, 0);
+    write_value<uint32_t>(bytes, 1); // array size
+    write_value<uint32_t>(bytes, 0);
+
+    bytes.insert(bytes.end(), image.data.begin(), image.data.end());
+    return write_whole_file(file_path, bytes, error);
+}
+
+
+//
+// FLIPPING
+//
+
+namespace {
+    /// reorders the 4 rows of 4 2 bit indices of a BC1 color block, row r takes the row order[r]
+    void reorder_bc1_rows(unsigned char* block, const std::array<int, 4>& order) {
+        unsigned char rows[4];
+        std::memcpy(rows, block + 4, 4);
+        for (int r = 0; r < 4; r++)
+            block[4 + r] = rows[order[r]];
+    }
+
+    /// reorders the 4 rows of 4 3 bit indices of a BC4 block
+    void reorder_bc4_rows(unsigned char* block, const std::array<int, 4>& order) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, block + 2, 6);
+        uint64_t reordered = 0;
+        for (int r = 0; r < 4; r++)
+            reordered |= (bits >> (12 * order[r]) & 0xFFF) << (12 * r);
+        std::memcpy(block + 2, &reordered, 6);
+    }
+
+    void reorder_block_rows(const TextureCompression format, unsigned char* block, const std::array<int, 4>& order) {
+        switch (format) {
+            case TextureCompression::BC1: reorder_bc1_rows(block, order); break;
+            case TextureCompression::BC3: reorder_bc4_rows(block, order); reorder_bc1_rows(block + 8, order); break;
+            case TextureCompression::BC5: reorder_bc4_rows(block, order); reorder_bc4_rows(block + 8, order); break;
+            default: break;
+        }
+    }
+}
+
+
+bool flip_vertically(CompressedImage& image) {
+    if (image.format != TextureCompression::BC1 and image.format != TextureCompression::BC3 and image.format != TextureCompression::BC5)
+        return false;
+    // rows of a block can only be swapped within it, heights above 4 need whole blocks
+    for (const auto& level : image.levels) {
+        if (level.height > 4 and level.height % 4 != 0)
+            return false;
+    }
+
+    const size_t block_size = get_block_size(image.format);
+    for (const auto& level : image.levels) {
+        const size_t blocks_x = (level.width + 3) / 4;
+        const size_t blocks_y = (level.height + 3) / 4;
+        unsigned char* data = image.data.data() + level.offset;
+
+        // swap block rows
+        for (size_t y = 0; y < blocks_y / 2; y++) {
+            std::swap_ranges(data + y * blocks_x * block_size, data + (y + 1) * blocks_x * block_size, data + (blocks_y - 1 - y) * blocks_x * block_size);
+        }
+        // reverse the used rows inside the blocks, the padding rows stay
+        const int used_rows = std::min(level.height, 4);
+        std::array<int, 4> order{0, 1, 2, 3};
+        for (int r = 0; r < used_rows; r++)
+            order[r] = used_rows - 1 - r;
+        for (size_t block = 0; block < blocks_x * blocks_y; block++)
+            reorder_block_rows(image.format, data + block * block_size, order);
+    }
+    image.top_down = !image.top_down;
+    return true;
+}
+
+
+//
+// ENCODING
+//
+
+namespace {
+    /// 5:6:5 color to 8 bit channels (bit replication, as the hardware does)
+    glm::vec3 unpack_565(const uint16_t color) {
+        const int r = color >> 11 & 31;
+        const int g = color >> 5 & 63;
+        const int b = color & 31;
+        return {static_cast<float>(r << 3 | r >> 2), static_cast<float>(g << 2 | g >> 4), static_cast<float>(b << 3 | b >> 2)};
+    }
+
+    uint16_t pack_565(const glm::vec3& color) {
+        const glm::vec3 clamped = glm::clamp(color, 0.0f, 255.0f);
+        const auto r = static_cast<uint16_t>(std::lround(clamped.r * 31.0f / 255.0f));
+        const auto g = static_cast<uint16_t>(std::lround(clamped.g * 63.0f / 255.0f));
+        const auto b = static_cast<uint16_t>(std::lround(clamped.b * 31.0f / 255.0f));
+        return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    /// principal axis of the points (power iteration on the covariance), direction of the largest spread
+    template<int N>
+    glm::vec<N, float> principal_axis(const glm::vec<N, float>* points, const int count, const glm::vec<N, float>& mean) {
+        glm::mat<N, N, float> covariance{0.0f};
+        for (int i = 0; i < count; i++) {
+            const glm::vec<N, float> d = points[i] - mean;
+            covariance += glm::outerProduct(d, d);
+        }
+        glm::vec<N, float> axis{1.0f};
+        for (int iteration = 0; iteration < 8; iteration++) {
+            const glm::vec<N, float> next = covariance * axis;
+            const float length = glm::length(next);
+            if (length < 1e-6f)
+                break;
+            axis = next / length;
+        }
+        return axis;
+    }
+
+    /// endpoints spanning the projection of the points onto their principal axis
+    template<int N>
+    void fit_endpoints(const glm::vec<N, float>* points, const int count, glm::vec<N, float>& start, glm::vec<N, float>& end) {
+        glm::vec<N, float> mean{0.0f};
+        for (int i = 0; i < count; i++)
+            mean += points[i];
+        mean /= static_cast<float>(count);
+        const glm::vec<N, float> axis = principal_axis<N>(points, count, mean);
+
+        float min_t = 0.0f, max_t = 0.0f;
+        for (int i = 0; i < count; i++) {
+            const float t = glm::dot(points[i] - mean, axis);
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+        start = mean + axis * min_t;
+        end = mean + axis * max_t;
+    }
+
+    /// least squares endpoints for fixed interpolation weights (weight of end), keeps the old ones if the system is singular
+    template<int N>
+    void refit_endpoints(const glm::vec<N, float>* points, const float* weights, const int count, glm::vec<N, float>& start, glm::vec<N, float>& end) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        glm::vec<N, float> ax{0.0f}, bx{0.0f};
+        for (int i = 0; i < count; i++) {
+            const float b = weights[i];
+            const float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * points[i];
+            bx += b * points[i];
+        }
+        const float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return;
+        start = (ax * bb - bx * ab) / determinant;
+        end = (bx * aa - ax * ab) / determinant;
+    }
+
+    void encode_bc1(const unsigned char* rgba, unsigned char* block) {
+        glm::vec3 points[16];
+        for (int i = 0; i < 16; i++)
+            points[i] = {rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]};
+
+        glm::vec3 start, end;
+        fit_endpoints<3>(points, 16, start, end);
+
+        uint16_t best_colors[2]{};
+        uint8_t best_indices[16]{};
+        float best_error = std::numeric_limits<float>::max();
+        // interpolation weight of color1 per index (4 color mode)
+        constexpr float index_weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+        for (int iteration = 0; iteration < 3; iteration++) {
+            const uint16_t colors[2] = {pack_565(end), pack_565(start)};
+            const glm::vec3 c0 = unpack_565(colors[0]);
+            const glm::vec3 c1 = unpack_565(colors[1]);
+            const glm::vec3 palette[4] = {c0, c1, (2.0f * c0 + c1) / 3.0f, (c0 + 2.0f * c1) / 3.0f};
+
+            uint8_t indices[16];
+            float weights[16];
+            float error = 0.0f;
+            for (int i = 0; i < 16; i++) {
+                float best_distance = std::numeric_limits<float>::max();
+                for (uint8_t p = 0; p < 4; p++) {
+                    const glm::vec3 d = points[i] - palette[p];
+                    const float distance = glm::dot(d, d);
+                    if (distance < best_distance) {
+                        best_distance = distance;
+                        indices[i] = p;
+                    }
+                }
+                weights[i] = index_weights[indices[i]];
+                error += best_distance;
+            }
+            if (error < best_error) {
+                best_error = error;
+                best_colors[0] = colors[0];
+                best_colors[1] = colors[1];
+                std::memcpy(best_indices, indices, 16);
+            }
+            if (error == 0.0f)
+                break;
+            // endpoints, weights are of color1 = start
+            glm::vec3 new_end = end, new_start = start;
+            refit_endpoints<3>(points, weights, 16, new_end, new_start);
+            end = new_end;
+            start = new_start;
+        }
+
+        // color0 > color1 selects the 4 color mode, swapping the colors swaps the index pairs
+        if (best_colors[0] < best_colors[1]) {
+            std::swap(best_colors[0], best_colors[1]);
+            for (auto& index : best_indices)
+                index ^= 1;
+        } else if (best_colors[0] == best_colors[1]) {
+            std::ranges::fill(best_indices, 0);
+        }
+
+        uint32_t index_bits = 0;
+        for (int i = 0; i < 16; i++)
+            index_bits |= static_cast<uint32_t>(best_indices[i]) << (2 * i);
+        std::memcpy(block, &best_colors[0], 2);
+        std::memcpy(block + 2, &best_colors[1], 2);
+        std::memcpy(block + 4, &index_bits, 4);
+    }
+
+    /// single channel block, channel is the byte offset inside a pixel
+    void encode_bc4(const unsigned char* rgba, const int channel, unsigned char* block) {
+        int min_value = 255, max_value = 0;
+        for (int i = 0; i < 16; i++) {
+            min_value = std::min<int>(min_value, rgba[i * 4 + channel]);
+            max_value = std::max<int>(max_value, rgba[i * 4 + channel]);
+        }
+
+        // 8 value mode (value0 > value1), index 0 = value0, 1 = value1, 2 - 7 in between
+        int palette[8] = {max_value, min_value};
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * max_value + i * min_value) / 7;
+
+        uint64_t index_bits = 0;
+        for (int i = 0; i < 16; i++) {
+            const int value = rgba[i * 4 + channel];
+            int best_index = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(palette[p] - value) < std::abs(palette[best_index] - value))
+                    best_index = p;
+            }
+            index_bits |= static_cast<uint64_t>(best_index) << (3 * i);
+        }
+        block[0] = static_cast<unsigned char>(max_value);
+        block[1] = static_cast<unsigned char>(min_value);
+        std::memcpy(block + 2, &index_bits, 6);
+    }
+
+    /// writes bits into a 128 bit block, least significant first
+    class BlockWriter {
+        unsigned char* block;
+        int position = 0;
+    public:
+        explicit BlockWriter(unsigned char* block) : block(block) {
+            std::memset(block, 0, 16);
+        }
+        void write(const uint32_t value, const int bit_count) {
+            for (int i = 0; i < bit_count; i++, position++) {
+                if ((value >> i & 1) != 0)
+                    block[position / 8] |= static_cast<unsigned char>(1 << (position % 8));
+            }
+        }
+    };
+
+    /// quantizes an RGBA endpoint to 7 bits + a shared p-bit, picks the p-bit with the smaller error
+    void quantize_bc7_endpoint(const glm::vec4& endpoint, glm::ivec4& quantized, int& p_bit) {
+        float best_error = std::numeric_limits<float>::max();
+        for (int p = 0; p < 2; p++) {
+            glm::ivec4 q;
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                q[c] = std::clamp(static_cast<int>(std::lround((endpoint[c] - static_cast<float>(p)) / 2.0f)), 0, 127);
+                const float d = static_cast<float>(q[c] << 1 | p) - endpoint[c];
+                error += d * d;
+            }
+            if (error < best_error) {
+                best_error = error;
+                quantized = q;
+                p_bit = p;
+            }
+        }
+    }
+
+    /// BC7 mode 6: one subset, RGBA endpoints 7 bits + p-bit, 4 bit indices
+    void encode_bc7(const unsigned char* rgba, unsigned char* block) {
+        constexpr int WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+        glm::vec4 points[16];
+        for (int i = 0; i < 16; i++)
+            points[i] = {rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2], rgba[i * 4 + 3]};
+
+        glm::vec4 start, end;
+        fit_endpoints<4>(points, 16, start, end);
+
+        glm::ivec4 best_endpoints[2]{};
+        int best_p_bits[2]{};
+        uint8_t best_indices[16]{};
+        float best_error = std::numeric_limits<float>::max();
+
+        for (int iteration = 0; iteration < 3; iteration++) {
+            glm::ivec4 quantized[2];
+            int p_bits[2];
+            quantize_bc7_endpoint(start, quantized[0], p_bits[0]);
+            quantize_bc7_endpoint(end, quantized[1], p_bits[1]);
+            const glm::ivec4 e0 = quantized[0] << 1 | p_bits[0];
+            const glm::ivec4 e1 = quantized[1] << 1 | p_bits[1];
+
+            glm::vec4 palette[16];
+            for (int p = 0; p < 16; p++)
+                palette[p] = glm::vec4(((64 - WEIGHTS[p]) * e0 + WEIGHTS[p] * e1 + 32) >> 6);
+
+            uint8_t indices[16];
+            float weights[16];
+            float error = 0.0f;
+            for (int i = 0; i < 16; i++) {
+                float best_distance = std::numeric_limits<float>::max();
+                for (uint8_t p = 0; p < 16; p++) {
+                    const glm::vec4 d = points[i] - palette[p];
+                    const float distance = glm::dot(d, d);
+                    if (distance < best_distance) {
+                        best_distance = distance;
+                        indices[i] = p;
+                    }
+                }
+                weights[i] = static_cast<float>(WEIGHTS[indices[i]]) / 64.0f;
+                error += best_distance;
+            }
+            if (error < best_error) {
+                best_error = error;
+                best_endpoints[0] = quantized[0];
+                best_endpoints[1] = quantized[1];
+                best_p_bits[0] = p_bits[0];
+                best_p_bits[1] = p_bits[1];
+                std::memcpy(best_indices, indices, 16);
+            }
+            if (error == 0.0f)
+                break;
+            refit_endpoints<4>(points, weights, 16, start, end);
+            start = glm::clamp(start, 0.0f, 255.0f);
+            end = glm::clamp(end, 0.0f, 255.0f);
+        }
+
+        // the first index has an implicit 0 most significant bit, swap the endpoints if it's set
+        if (best_indices[0] >= 8) {
+            std::swap(best_endpoints[0], best_endpoints[1]);
+            std::swap(best_p_bits[0], best_p_bits[1]);
+            for (auto& index : best_indices)
+                index = 15 - index;
+        }
+
+        BlockWriter writer{block};
+        writer.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.write(best_endpoints[0][c], 7);
+            writer.write(best_endpoints[1][c], 7);
+        }
+        writer.write(best_p_bits[0], 1);
+        writer.write(best_p_bits[1], 1);
+        writer.write(best_indices[0], 3);
+        for (int i = 1; i < 16; i++)
+            writer.write(best_indices[i], 4);
+    }
+
+    float srgb_to_linear(const float value) {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linear_to_srgb(const float value) {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    /// half size RGBA8 level (2x2 box filter, edges clamp for odd sizes)
+    std::vector<unsigned char> downsample(const std::vector<unsigned char>& pixels, const int width, const int height, const bool sRGB) {
+        static const std::array<float, 256> to_linear = [] {
+            std::array<float, 256> table{};
+            for (int i = 0; i < 256; i++)
+                table[i] = srgb_to_linear(static_cast<float>(i) / 255.0f);
+            return table;
+        }();
+
+        const int new_width = std::max(width / 2, 1);
+        const int new_height = std::max(height / 2, 1);
+        std::vector<unsigned char> result(static_cast<size_t>(new_width) * new_height * 4);
+        for (int y = 0; y < new_height; y++) {
+            for (int x = 0; x < new_width; x++) {
+                const int xs[2] = {std::min(x * 2, width - 1), std::min(x * 2 + 1, width - 1)};
+                const int ys[2] = {std::min(y * 2, height - 1), std::min(y * 2 + 1, height - 1)};
+                for (int c = 0; c < 4; c++) {
+                    const bool linearize = sRGB and c < 3;
+                    float sum = 0.0f;
+                    for (const int sy : ys) {
+                        for (const int sx : xs) {
+                            const unsigned char value = pixels[(static_cast<size_t>(sy) * width + sx) * 4 + c];
+                            sum += linearize ? to_linear[value] : static_cast<float>(value) / 255.0f;
+                        }
+                    }
+                    const float average = linearize ? linear_to_srgb(sum / 4.0f) : sum / 4.0f;
+                    result[(static_cast<size_t>(y) * new_width + x) * 4 + c] = static_cast<unsigned char>(std::lround(std::clamp(average, 0.0f, 1.0f) * 255.0f));
+                }
+            }
+        }
+        return result;
+    }
+}
+
+
+void encode_block(const unsigned char* rgba, const TextureCompression format, unsigned char* block) {
+    switch (format) {
+        case TextureCompression::BC1:
+            encode_bc1(rgba, block);
+            break;
+        case TextureCompression::BC3:
+            encode_bc4(rgba, 3, block);
+            encode_bc1(rgba, block + 8);
+            break;
+        case TextureCompression::BC5:
+            encode_bc4(rgba, 0, block);
+            encode_bc4(rgba, 1, block + 8);
+            break;
+        case TextureCompression::BC7:
+            encode_bc7(rgba, block);
+            break;
+        default:
+            break;
+    }
+}
+
+
+CompressedImage compress_image(const unsigned char* rgba_pixels, const int width, const int height, const TextureCompression format, const bool sRGB, const bool generate_mipmaps, const bool top_down, ThreadPool* workers) {
+    CompressedImage image;
+    if (rgba_pixels == nullptr or width <= 0 or height <= 0 or format == TextureCompression::NONE)
+        return image;
+    image.format = format;
+    image.sRGB = sRGB and format != TextureCompression::BC5;
+    image.top_down = top_down;
+
+    const size_t block_size = get_block_size(format);
+    std::vector<unsigned char> pixels(rgba_pixels, rgba_pixels + static_cast<size_t>(width) * height * 4);
+    int level_width = width;
+    int level_height = height;
+    while (true) {
+        const size_t blocks_x = (level_width + 3) / 4;
+        const size_t blocks_y = (level_height + 3) / 4;
+        const CompressedMipLevel level{level_width, level_height, image.data.size(), blocks_x * blocks_y * block_size};
+        image.levels.push_back(level);
+        image.data.resize(level.offset + level.size);
+
+        // one block row per call, pixels outside of the image repeat the edge
+        auto encode_row = [&, level_width, level_height, blocks_x](const size_t block_y) {
+            unsigned char block_pixels[16 * 4];
+            for (size_t block_x = 0; block_x < blocks_x; block_x++) {
+                for (int r = 0; r < 4; r++) {
+                    const size_t y = std::min<size_t>(block_y * 4 + r, level_height - 1);
+                    for (int c = 0; c < 4; c++) {
+                        const size_t x = std::min<size_t>(block_x * 4 + c, level_width - 1);
+                        std::memcpy(block_pixels + (r * 4 + c) * 4, pixels.data() + (y * level_width + x) * 4, 4);
+                    }
+                }
+                encode_block(block_pixels, format, image.data.data() + level.offset + (block_y * blocks_x + block_x) * block_size);
+            }
+        };
+        if (workers != nullptr) {
+            workers->parallel_for(blocks_y, encode_row);
+        } else {
+            for (size_t block_y = 0; block_y < blocks_y; block_y++)
+                encode_row(block_y);
+        }
+
+        if (!generate_mipmaps or (level_width == 1 and level_height == 1))
+            break;
+        pixels = downsample(pixels, level_width, level_height, image.sRGB);
+        level_width = std::max(level_width / 2, 1);
+        level_height = std::max(level_height / 2, 1);
+    }
+    return image;
+}
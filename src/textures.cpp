@@ -19,56 +19,147 @@ constexpr int channel_internal_formats[4] ={
     GL_RGBA
 };
 
-unsigned int setup_texture_from_file(const char* file_path, const bool sRGB, const bool generate_minimaps, const bool clamp) {
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    int width, height, channel_count;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(file_path, &width, &height, &channel_count, 0);
-
-    if (data == nullptr) {
+TextureData::TextureData(const char* file_path) {
+    if (is_compressed_texture_file(file_path)) {
+        std::string error;
+        if (!read_compressed_texture_file(file_path, compressed, &error)) {
+            Engine::debug_error(error);
+            return;
+        }
+        width = compressed.get_width();
+        height = compressed.get_height();
+        // OpenGL expects the bottom row first
+        if (compressed.top_down and !flip_vertically(compressed)) {
+            Engine::debug_warning("Compressed texture is stored top to bottom and can't be flipped, it will appear upside down (store it bottom to top, e.g. .ktx2 with KTXorientation \"ru\"): " + std::string(file_path));
+        }
+        return;
+    }
+
+    // per thread flag, decoding runs on worker threads too
+    stbi_set_flip_vertically_on_load_thread(true);
+    pixels = stbi_load(file_path, &width, &height, &channel_count, 0);
+
+    if (pixels == nullptr) {
         Engine::debug_error("Failed to load texture from file: " + std::string(file_path));
     }
+}
+
+TextureData::TextureData(TextureData&& other) noexcept : pixels(other.pixels), width(other.width), height(other.height), channel_count(other.channel_count), compressed(std::move(other.compressed)) {
+    other.pixels = nullptr;
+}
+
+TextureData& TextureData::operator=(TextureData&& other) noexcept {
+    if (this == &other)
+        return *this;
+    stbi_image_free(pixels);
+    pixels = other.pixels;
+    width = other.width;
+    height = other.height;
+    channel_count = other.channel_count;
+    compressed = std::move(other.compressed);
+    other.pixels = nullptr;
+    return *this;
+}
+
+TextureData::~TextureData() {
+    stbi_image_free(pixels);
+}
+
+
+Texture::Texture(const char* file_path, const bool sRGB, const bool generate_minimap, const bool clamp) {
+    upload(TextureData{file_path}, sRGB, generate_minimap, clamp);
+    Engine::debug_message("Loaded texture: " + std::string(file_path) + " id: " + std::to_string(id));
+}
+
+Texture::Texture(std::shared_ptr<Texture> placeholder) : placeholder(std::move(placeholder)) {
+
+}
+
+void Texture::upload(const TextureData& data, const bool sRGB, const bool generate_minimap, const bool clamp) {
+    if (data.compressed.is_valid()) {
+        if (upload_compressed(data.compressed, sRGB, clamp)) {
+            generate_bindless_handle();
+            ready = true;
+            placeholder = nullptr;
+        }
+        return;
+    }
 
-    glBindTexture(GL_TEXTURE_2D, texture);
+    if (data.pixels == nullptr)
+        return;
+
+    if (data.channel_count == 2) {
+        Engine::debug_error("Texture has 2 channels, not supported.");
+        return;
+    }
+
+    if (sRGB and data.channel_count < 3) {
+        Engine::debug_error("sRGB not supported on textures with 1 channel.");
+        return;
+    }
+
+    glGenTextures(1, &id);
+    ge.gl_state.bind_texture(0, GL_TEXTURE_2D, id);
     // set the texture wrapping/filtering options (on the currently bound texture object)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, clamp ? GL_CLAMP_TO_BORDER : GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, clamp ? GL_CLAMP_TO_BORDER : GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    if (channel_count == 2) {
-        std::cerr << "ENGINE ERROR: Texture has 2 channels ? " << file_path << std::endl;
-        return 0;
-    }
+    const auto format = channel_to_format[data.channel_count - 1];
+    const auto internal_format = !sRGB ? channel_internal_formats[data.channel_count - 1] : (data.channel_count == 4 ? GL_SRGB_ALPHA : GL_SRGB);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, data.width, data.height, 0, format, GL_UNSIGNED_BYTE, data.pixels);
 
-    if (sRGB and channel_count < 3) {
-        std::cerr << "ENGINE ERROR: sRGB not supported on textures with 1 channel" << file_path << std::endl;
-        return 0;
+    if (generate_minimap) {
+        glGenerateMipmap(GL_TEXTURE_2D);
     }
 
-    const auto format = channel_to_format[channel_count - 1];
-    const auto internal_format = !sRGB ? channel_internal_formats[channel_count - 1] : (channel_count == 4 ? GL_SRGB_ALPHA : GL_SRGB);
+    generate_bindless_handle();
+    ready = true;
+    placeholder = nullptr;
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+bool Texture::upload_compressed(const CompressedImage& image, const bool sRGB, const bool clamp) {
+    const bool supported = image.format == TextureCompression::BC5
+        or (image.format == TextureCompression::BC7 ? ge.gl_extensions.texture_compression_bptc : ge.gl_extensions.texture_compression_s3tc);
+    if (!supported) {
+        Engine::debug_error("Compressed texture format not supported by the OpenGL context.");
+        return false;
+    }
+    // BC5 has no sRGB variant, it's meant for normal maps anyway
+    const unsigned int internal_format = get_compressed_gl_format(image.format, (image.sRGB or sRGB) and image.format != TextureCompression::BC5);
+    const auto level_count = static_cast<int>(image.levels.size());
 
-    if (generate_minimaps) {
-        glGenerateMipmap(GL_TEXTURE_2D);
+    glGenTextures(1, &id);
+    ge.gl_state.bind_texture(0, GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, clamp ? GL_CLAMP_TO_BORDER : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, clamp ? GL_CLAMP_TO_BORDER : GL_REPEAT);
+    // mipmaps come from the file, compressed textures can't generate them
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+
+    for (int i = 0; i < level_count; i++) {
+        const CompressedMipLevel& level = image.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, internal_format, level.width, level.height, 0, static_cast<GLsizei>(level.size), image.data.data() + level.offset);
     }
-    stbi_image_free(data);
-    return texture;
+    return true;
 }
 
+bool Texture::is_ready() const {
+    return ready;
+}
 
-Texture::Texture(const char* file_path, bool sRGB, bool generate_minimap, bool clamp) {
-    id = setup_texture_from_file(file_path, sRGB, generate_minimap, clamp);
-    Engine::debug_message("Loaded texture: " + std::string(file_path) + " id: " + std::to_string(id));
-    generate_bindless_handle();
+const Texture& Texture::get_bound_texture() const {
+    if (ready or placeholder == nullptr)
+        return *this;
+    return *placeholder;
 }
 
 Texture::Texture(Color color, const bool alpha) {
     glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
+    ge.gl_state.bind_texture(0, GL_TEXTURE_2D, id);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -92,6 +183,7 @@ Texture::Texture(Color color, const bool alpha) {
     glTexImage2D(GL_TEXTURE_2D, 0, format, 1, 1, 0, format, GL_UNSIGNED_BYTE, data);
     delete data;
     generate_bindless_handle();
+    ready = true;
 }
 
 void Texture::generate_bindless_handle() {
@@ -107,9 +199,12 @@ void Texture::generate_bindless_handle() {
 
 
 Texture::~Texture() {
+    if (id == 0)
+        return;
     if (ge.are_bindless_textures_supported()) {
         glMakeTextureHandleNonResidentARB(handle);
     }
+    ge.gl_state.forget_texture(id);
     glDeleteTextures(1, &id);
     std::cout << "ENGINE MESSAGE: Deleting texture " << id << "/" << handle << std::endl;
 }
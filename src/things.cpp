@@ -81,6 +81,11 @@ void Camera::transform_to_view_matrix() {
 }
 
 
+Frustum Camera::get_frustum() const {
+    return Frustum{projection * view};
+}
+
+
 //
 // THINGS:
 //
@@ -94,6 +99,18 @@ SpatialThing::SpatialThing() {
     transform = Transform{};
 }
 
+const glm::mat4& SpatialThing::get_world_matrix() {
+    if (hierarchy_index == static_cast<size_t>(-1))
+        return transform.get_world_matrix();
+    return ge.transforms.get_world_matrix(hierarchy_index);
+}
+
+const glm::mat3& SpatialThing::get_world_normal_matrix() {
+    if (hierarchy_index == static_cast<size_t>(-1))
+        return transform.get_normal_matrix();
+    return ge.transforms.get_normal_matrix(hierarchy_index);
+}
+
 
 
 MeshThing::MeshThing (std::shared_ptr<Mesh> _mesh, std::shared_ptr<Material> _material, unsigned int _render_layer) {
@@ -113,28 +130,44 @@ std::shared_ptr<Mesh> MeshThing::get_mesh() {
     return mesh;
 }
 
+Mesh* MeshThing::get_mesh_pointer() const {
+    return mesh.get();
+}
+
 std::shared_ptr<Material> MeshThing::get_material() {
     return material;
 }
 
+Material* MeshThing::get_material_pointer() const {
+    return material.get();
+}
+
 
 void MeshThing::render() {
-    glm::mat4 model = transform.position.get_transformation_matrix() * transform.rotation.get_transformation_matrix() * transform.scale.get_transformation_matrix();
+    // cached, rebuilt only when the transform (or a parent) changes
+    const glm::mat4& model = get_world_matrix();
 
     if (vs_uniform_normal_matrix > -1) {
-        glUniformMatrix3fv(vs_uniform_normal_matrix, 1, GL_FALSE, &glm::mat3(inverseTranspose(model))[0][0]);
+        glUniformMatrix3fv(vs_uniform_normal_matrix, 1, GL_FALSE, &get_world_normal_matrix()[0][0]);
     }
 
-    glUniformMatrix4fv(vs_uniform_transform_loc, 1, GL_FALSE, &model[0][0]);
-    glBindVertexArray(mesh->get_vertex_array_object());
-    glDrawElements(GL_TRIANGLES, mesh->get_vertex_count(), GL_UNSIGNED_INT, nullptr);
+    if (mesh->has_quantized_positions()) {
+        // positions are stored in the bounding box of the mesh, the vertex shader receives them already dequantized by the transform
+        const glm::mat4 transform = model * mesh->get_dequantization_matrix();
+        glUniformMatrix4fv(vs_uniform_transform_loc, 1, GL_FALSE, &transform[0][0]);
+    } else {
+        glUniformMatrix4fv(vs_uniform_transform_loc, 1, GL_FALSE, &model[0][0]);
+    }
+    ge.gl_state.bind_vertex_array(mesh->get_vertex_array_object());
+    const MeshLod& level = mesh->get_lod(lod);
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(level.index_count), mesh->get_index_type(), mesh->get_index_offset(level), mesh->get_base_vertex());
 }
 
 
 ModelThing::ModelThing(std::shared_ptr<Model> _model, std::vector<std::shared_ptr<Material>> _materials, unsigned int _render_layer) {
     model = std::move(_model);
     materials = std::move(_materials);
-    const unsigned int model_geref_id = ge.get_last_used_geRef_id();
+    const unsigned int model_geref_id = Engine::get_constructing_thing_id();
     std::cout << "model thing id: " << model_geref_id << std::endl;
     for (size_t i = 0; i < model->get_mesh_count(); i++) {
         std::shared_ptr<Material> mat;
@@ -151,9 +184,10 @@ ModelThing::ModelThing(std::shared_ptr<Model> _model, std::vector<std::shared_pt
             mat = ge.shaders.get_base_material(model->get_has_uvs(), model->get_has_normals());
 
         // spawn slave
-        auto slave = ge.add<ModelSlaveThing>(model->get_mesh(i), mat, geRef<ModelThing>(model_geref_id, &ge));
+        // the slave isn't inserted until the spawning update ends, so everything is passed to its constructor
+        auto slave = ge.add<ModelSlaveThing>(model->get_mesh(i), mat, geRef<ModelThing>(model_geref_id, &ge), _render_layer);
         slave_ids.push_back(slave.id);
-        slave->render_layer = _render_layer;
+        ge.transforms.set_parent(slave.id, model_geref_id);
     }
 }
 
@@ -172,29 +206,11 @@ void ModelThing::on_remove() {
 }
 
 
-ModelSlaveThing::ModelSlaveThing(std::shared_ptr<Mesh> _mesh, std::shared_ptr<Material> _material, const geRef<ModelThing> _manager):
-MeshThing(std::move(_mesh), std::move(_material)) {
+ModelSlaveThing::ModelSlaveThing(std::shared_ptr<Mesh> _mesh, std::shared_ptr<Material> _material, const geRef<ModelThing> _manager, const unsigned int _render_layer):
+MeshThing(std::move(_mesh), std::move(_material), _render_layer) {
     manager = _manager;
 
     if (mesh->does_have_uvs()) {
         vs_uniform_normal_matrix = glGetUniformLocation(material->get_shader_program_id(), "normal_matrix");
     }
 };
-
-
-
-void ModelSlaveThing::render() {
-    // copy manager position (the slave part)
-    transform = manager->transform;
-
-    // standard MeshThing render
-    glm::mat4 model = transform.position.get_transformation_matrix() * transform.rotation.get_transformation_matrix() * transform.scale.get_transformation_matrix();
-
-    if (vs_uniform_normal_matrix > -1) {
-        glUniformMatrix3fv(vs_uniform_normal_matrix, 1, GL_FALSE, &glm::mat3(inverseTranspose(model))[0][0]);
-    }
-
-    glUniformMatrix4fv(vs_uniform_transform_loc, 1, GL_FALSE, &model[0][0]);
-    glBindVertexArray(mesh->get_vertex_array_object());
-    glDrawElements(GL_TRIANGLES, mesh->get_vertex_count(), GL_UNSIGNED_INT, nullptr);
-}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+/// index of the worker thread, 0 for threads not owned by a pool
+static thread_local unsigned int current_worker_index = 0;
+
+
+ThreadPool::ThreadPool(unsigned int thread_count) {
+    if (thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    threads.reserve(thread_count);
+    for (unsigned int i = 0; i < thread_count; i++) {
+        threads.emplace_back(&ThreadPool::worker_loop, this, i + 1);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(tasks_mutex);
+        stopping = true;
+    }
+    tasks_available.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+void ThreadPool::worker_loop(const unsigned int worker_index) {
+    current_worker_index = worker_index;
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(tasks_mutex);
+            tasks_available.wait(lock, [this] { return stopping or !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard lock(tasks_mutex);
+        tasks.push_back(std::move(task));
+    }
+    tasks_available.notify_one();
+}
+
+
+size_t ThreadPool::get_thread_count() const {
+    return threads.size();
+}
+
+unsigned int ThreadPool::get_worker_index() {
+    return current_worker_index;
+}
+
+
+void ThreadPool::parallel_for(const size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0)
+        return;
+    if (count == 1 or threads.empty()) {
+        for (size_t i = 0; i < count; i++)
+            body(i);
+        return;
+    }
+
+    // shared, so helpers that start after the caller returned don't touch freed memory
+    struct State {
+        std::function<void(size_t)> body;
+        size_t count;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex{};
+        std::condition_variable finished{};
+    };
+    auto state = std::make_shared<State>();
+    state->body = body;
+    state->count = count;
+
+    // grabs indices until none are left
+    auto work = [state] {
+        size_t processed = 0;
+        for (size_t i = state->next.fetch_add(1); i < state->count; i = state->next.fetch_add(1)) {
+            state->body(i);
+            processed += 1;
+        }
+        if (processed > 0 and state->done.fetch_add(processed) + processed == state->count) {
+            std::lock_guard lock(state->mutex);
+            state->finished.notify_all();
+        }
+    };
+
+    const size_t helpers = std::min(count - 1, threads.size());
+    for (size_t i = 0; i < helpers; i++) {
+        enqueue(work);
+    }
+    work();
+
+    // the caller waits for indices, not for helpers, so a call from a busy worker can't deadlock
+    std::unique_lock lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->done.load() == state->count; });
+}
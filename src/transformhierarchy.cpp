@@ -0,0 +1,162 @@
+#include "transformhierarchy.hpp"
+#include <algorithm>
+#include "graphicengine.hpp"
+
+
+bool TransformHierarchy::set_parent(const unsigned int child_id, const unsigned int parent_id) {
+    // other threads may be reading the relations, applied when the parallel update is merged
+    if (ge.is_in_parallel_update()) {
+        ge.queue_set_parent(child_id, parent_id);
+        return true;
+    }
+    if (parent_id == ThingSlotMap::NULL_ID) {
+        clear_parent(child_id);
+        return true;
+    }
+    // walk up from the new parent, reaching the child would close a cycle
+    for (unsigned int ancestor = parent_id; ancestor != ThingSlotMap::NULL_ID; ancestor = get_parent(ancestor)) {
+        if (ancestor == child_id) {
+            Engine::debug_error("TransformHierarchy: attaching Thing " + std::to_string(child_id) + " to Thing " + std::to_string(parent_id) + " would create a cycle. Ignoring it.");
+            return false;
+        }
+    }
+
+    if (get_parent(child_id) == parent_id)
+        return true;
+    clear_parent(child_id);
+    parents[child_id] = parent_id;
+    children[parent_id].push_back(child_id);
+    relations_changed = true;
+    return true;
+}
+
+void TransformHierarchy::clear_parent(const unsigned int child_id) {
+    if (ge.is_in_parallel_update()) {
+        ge.queue_set_parent(child_id, ThingSlotMap::NULL_ID);
+        return;
+    }
+    const auto it = parents.find(child_id);
+    if (it == parents.end())
+        return;
+
+    const auto siblings = children.find(it->second);
+    std::erase(siblings->second, child_id);
+    if (siblings->second.empty())
+        children.erase(siblings);
+    parents.erase(it);
+    relations_changed = true;
+}
+
+unsigned int TransformHierarchy::get_parent(const unsigned int child_id) const {
+    const auto it = parents.find(child_id);
+    return it == parents.end() ? ThingSlotMap::NULL_ID : it->second;
+}
+
+std::vector<unsigned int> TransformHierarchy::get_children(const unsigned int parent_id) const {
+    const auto it = children.find(parent_id);
+    return it == children.end() ? std::vector<unsigned int>{} : it->second;
+}
+
+void TransformHierarchy::remove(const unsigned int thing_id) {
+    clear_parent(thing_id);
+    const auto it = children.find(thing_id);
+    if (it == children.end())
+        return;
+    for (const unsigned int child_id : it->second) {
+        parents.erase(child_id);
+    }
+    children.erase(it);
+    relations_changed = true;
+}
+
+
+void TransformHierarchy::rebuild() {
+    // entities that dropped out of the hierarchy go back to their own Transform
+    for (const Node& node : nodes) {
+        if (ge.things.contains(node.thing_id))
+            node.thing->hierarchy_index = -1;
+    }
+    nodes.clear();
+
+    // relations of removed entities and of entities without a Transform can't be propagated
+    const auto resolve = [](const unsigned int id) {
+        return dynamic_cast<SpatialThing*>(ge.get_thing(id));
+    };
+    std::vector<unsigned int> invalid{};
+    for (const auto& [child_id, parent_id] : parents) {
+        if (resolve(child_id) == nullptr or resolve(parent_id) == nullptr)
+            invalid.push_back(child_id);
+    }
+    for (const unsigned int child_id : invalid) {
+        Engine::debug_warning("TransformHierarchy: Thing " + std::to_string(child_id) + " or its parent isn't a spawned SpatialThing. Dropping the relation.");
+        clear_parent(child_id);
+    }
+
+    // depth first from every root, so a parent always comes before its children
+    std::vector<std::pair<unsigned int, unsigned int>> stack{};
+    for (const auto& [parent_id, child_ids] : children) {
+        if (parents.contains(parent_id))
+            continue;
+        stack.emplace_back(parent_id, NO_PARENT);
+        while (!stack.empty()) {
+            const auto [id, parent] = stack.back();
+            stack.pop_back();
+
+            const auto index = static_cast<unsigned int>(nodes.size());
+            SpatialThing* thing = resolve(id);
+            thing->hierarchy_index = index;
+            nodes.push_back(Node{id, thing, parent, 0, true});
+
+            if (const auto it = children.find(id); it != children.end()) {
+                for (const unsigned int child_id : it->second) {
+                    stack.emplace_back(child_id, index);
+                }
+            }
+        }
+    }
+
+    world_matrices.resize(nodes.size());
+    normal_matrices.resize(nodes.size());
+    relations_changed = false;
+}
+
+void TransformHierarchy::propagate() {
+    GE_PROFILE_FUNCTION();
+    // after a rebuild every node is recomputed, its matrices moved
+    const bool rebuilt = relations_changed;
+    if (relations_changed)
+        rebuild();
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        Node& node = nodes[i];
+        Transform& local = node.thing->transform;
+        const unsigned int version = local.get_version();
+        const bool parent_changed = node.parent != NO_PARENT and nodes[node.parent].changed;
+
+        node.changed = rebuilt or parent_changed or version != node.local_version;
+        if (!node.changed)
+            continue;
+        node.local_version = version;
+
+        if (node.parent == NO_PARENT) {
+            world_matrices[i] = local.get_world_matrix();
+            normal_matrices[i] = local.get_normal_matrix();
+        } else {
+            world_matrices[i] = world_matrices[node.parent] * local.get_world_matrix();
+            normal_matrices[i] = glm::transpose(glm::inverse(glm::mat3(world_matrices[i])));
+        }
+    }
+}
+
+
+const glm::mat4& TransformHierarchy::get_world_matrix(const size_t index) const {
+    return world_matrices[index];
+}
+
+const glm::mat3& TransformHierarchy::get_normal_matrix(const size_t index) const {
+    return normal_matrices[index];
+}
+
+size_t TransformHierarchy::size() const {
+    return nodes.size();
+}
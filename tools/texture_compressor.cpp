@@ -0,0 +1,98 @@
+// Compresses PNG / JPG / TGA / BMP images into BC1, BC3, BC5 or BC7 .ktx2 / .dds files with their whole mip chain.
+// Built with -DGRAPHICENGINE_BUILD_TOOLS=ON.
+//
+// usage: texture_compressor <input image> <output .ktx2 | .dds> [options]
+//   --format bc1|bc3|bc5|bc7   default bc7 for images with alpha, bc1 otherwise, use bc5 for normal maps
+//   --srgb                     the image is color (albedo / diffuse), mip levels are averaged in linear space
+//   --no-mipmaps               only the full size level
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "texturecompression.hpp"
+#include "threadpool.hpp"
+
+// own copy, the engine's one lives next to the OpenGL upload code
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "../utils/stb_image.h"
+
+
+namespace {
+    void print_usage() {
+        std::cout << "usage: texture_compressor <input image> <output .ktx2 | .dds> [--format bc1|bc3|bc5|bc7] [--srgb] [--no-mipmaps]" << std::endl;
+    }
+
+    bool parse_format(const std::string& name, TextureCompression& format) {
+        if (name == "bc1") format = TextureCompression::BC1;
+        else if (name == "bc3") format = TextureCompression::BC3;
+        else if (name == "bc5") format = TextureCompression::BC5;
+        else if (name == "bc7") format = TextureCompression::BC7;
+        else return false;
+        return true;
+    }
+}
+
+
+int main(const int argc, char** argv) {
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+    const char* input_path = argv[1];
+    const char* output_path = argv[2];
+
+    TextureCompression format = TextureCompression::NONE;
+    bool sRGB = false;
+    bool mipmaps = true;
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--format") == 0 and i + 1 < argc) {
+            if (!parse_format(argv[++i], format)) {
+                std::cerr << "unknown format: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--srgb") == 0) {
+            sRGB = true;
+        } else if (std::strcmp(argv[i], "--no-mipmaps") == 0) {
+            mipmaps = false;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    const std::string extension = std::filesystem::path(output_path).extension().string();
+    const bool ktx2 = extension == ".ktx2";
+    if (!ktx2 and extension != ".dds") {
+        std::cerr << "output has to be a .ktx2 or a .dds file" << std::endl;
+        return 1;
+    }
+
+    // .ktx2 is stored bottom to top (as OpenGL expects, no flipping on load), .dds is always top to bottom
+    stbi_set_flip_vertically_on_load(ktx2);
+    int width = 0, height = 0, channel_count = 0;
+    unsigned char* pixels = stbi_load(input_path, &width, &height, &channel_count, 4);
+    if (pixels == nullptr) {
+        std::cerr << "failed to load image: " << input_path << " (" << stbi_failure_reason() << ")" << std::endl;
+        return 1;
+    }
+    if (format == TextureCompression::NONE)
+        format = channel_count == 4 or channel_count == 2 ? TextureCompression::BC7 : TextureCompression::BC1;
+    if (channel_count == 2 and format == TextureCompression::BC1)
+        std::cerr << "warning: BC1 drops the alpha channel" << std::endl;
+
+    ThreadPool workers;
+    const CompressedImage image = compress_image(pixels, width, height, format, sRGB, mipmaps, !ktx2, &workers);
+    stbi_image_free(pixels);
+
+    std::string error;
+    if (!(ktx2 ? write_ktx2_file(output_path, image, &error) : write_dds_file(output_path, image, &error))) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    const size_t uncompressed_size = static_cast<size_t>(width) * height * 4;
+    std::cout << output_path << ": " << width << "x" << height << ", " << image.levels.size() << " levels, "
+              << image.data.size() << " bytes (" << uncompressed_size << " bytes RGBA8 without mipmaps)" << std::endl;
+    return 0;
+}